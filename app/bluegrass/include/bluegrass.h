@@ -21,6 +21,21 @@
 extern "C" {
 #endif
 
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+struct bluegrass_batch_stats {
+	uint32_t publishes;
+	uint32_t messages;
+	/* Updates that were published to their own topic */
+	uint32_t bypass;
+	uint32_t fill_percent_last;
+	uint32_t fill_percent_avg;
+	uint32_t latency_ms_last;
+	uint32_t latency_ms_max;
+	uint32_t latency_ms_avg;
+};
+
 /******************************************************************************/
 /* Global Function Prototypes                                                 */
 /******************************************************************************/
@@ -70,6 +85,11 @@ void bluegrass_disconnected_callback(void);
  */
 bool bluegrass_ready_for_publish(void);
 
+/**
+ * @brief Copy the statistics of the batch publisher.
+ */
+void bluegrass_get_batch_stats(struct bluegrass_batch_stats *stats);
+
 #ifdef __cplusplus
 }
 #endif
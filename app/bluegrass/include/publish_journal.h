@@ -0,0 +1,93 @@
+/**
+ * @file publish_journal.h
+ * @brief Persistent store-and-forward queue for cloud publishes.
+ *
+ * Messages that cannot be published are appended to a journal in the file
+ * system.  They are replayed in order once publishing is possible.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __PUBLISH_JOURNAL_H__
+#define __PUBLISH_JOURNAL_H__
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr/types.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+/**
+ * @brief Publish function used to replay the journal.
+ *
+ * @param payload NUL terminated
+ * @param topic NULL for the gateway topic
+ *
+ * @retval 0 on success
+ */
+typedef int publish_journal_send_t(char *payload, uint8_t *topic);
+
+struct publish_journal_stats {
+	uint32_t appended;
+	uint32_t sent;
+	uint32_t evicted; /* oldest records removed to honour the byte cap */
+	uint32_t dropped; /* records that were too large or couldn't be written */
+	uint32_t compactions;
+	uint32_t truncated; /* torn or corrupt records */
+};
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Mount the file system and recover the journal.
+ * Records that were sent before a reset are not replayed.
+ *
+ * @retval negative error code, 0 on success
+ */
+int publish_journal_init(void);
+
+/**
+ * @brief Append a message to the journal.  The oldest records are evicted
+ * if the journal would exceed its byte cap.
+ *
+ * @param topic NULL for the gateway topic
+ *
+ * @retval negative error code, 0 on success
+ */
+int publish_journal_append(const uint8_t *topic, const char *payload,
+			   size_t length);
+
+/**
+ * @retval true if there aren't any records waiting to be sent
+ */
+bool publish_journal_empty(void);
+
+/**
+ * @brief Publish the oldest record.  It is removed from the journal
+ * only if the publish succeeds.
+ *
+ * @retval -ENOENT if the journal is empty, 0 on success,
+ * otherwise the error from the file system or send function.
+ */
+int publish_journal_send_oldest(publish_journal_send_t *send);
+
+/**
+ * @brief Get a copy of the journal statistics.
+ */
+void publish_journal_get_stats(struct publish_journal_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PUBLISH_JOURNAL_H__ */
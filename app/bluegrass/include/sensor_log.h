@@ -36,6 +36,9 @@ typedef struct SensorLog SensorLog_t;
 /* ["1234",4294967295,"1234"] */
 #define SENSOR_LOG_ENTRY_JSON_STR_SIZE 26
 
+/* "eventLog":[], */
+#define SENSOR_LOG_JSON_OVERHEAD_SIZE 14
+
 /******************************************************************************/
 /* Global Function Prototypes                                                 */
 /******************************************************************************/
@@ -63,6 +66,24 @@ void SensorLog_Add(SensorLog_t *pLog, SensorLogEvent_t *pEvent);
  */
 void SensorLog_GenerateJson(SensorLog_t *pLog, JsonMsg_t *pMsg);
 
+/**
+ * @brief Add the most recent entries of the sensor log to JSON message.
+ *
+ * @param Count is the maximum number of entries (oldest first).
+ */
+void SensorLog_GenerateJsonNewest(SensorLog_t *pLog, JsonMsg_t *pMsg,
+				  size_t Count);
+
+/**
+ * @brief Get the number of bytes required to add the most recent
+ * entries of the log to a JSON message.
+ *
+ * @param Count is the maximum number of entries.
+ *
+ * @retval 0 if there aren't any entries
+ */
+size_t SensorLog_GetJsonSize(SensorLog_t *pLog, size_t Count);
+
 /**
  * @brief Get the maximum number of entries in the log.
  */
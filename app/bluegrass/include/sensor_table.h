@@ -173,6 +173,15 @@ void SensorTable_DecomissionHandler(void);
  */
 void SensorTable_UnsubscribeAll(void);
 
+/**
+ * @brief A sensor update that couldn't be published (MQTT in-flight window
+ * was full) is sent again with the next update of the sensor.
+ *
+ * @param pTopic of the update.  If it doesn't belong to a sensor (batch or
+ * single topic), then all sensors are updated.
+ */
+void SensorTable_RepublishHandler(const char *pTopic);
+
 /**
  * @brief After reset or disconnect read shadow to re-populate event log.
  *
@@ -9,10 +9,28 @@
 #ifndef __SENSOR_TASK_H__
 #define __SENSOR_TASK_H__
 
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr/types.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+typedef struct SensorTaskAdStats {
+	uint32_t processed;
+	uint32_t dropped; /** ring was full */
+	uint32_t highWater; /** maximum number of ads waiting in ring */
+	uint32_t lastBatch; /** ads processed by the last drain */
+	uint32_t maxBatch;
+	uint32_t dedupLookups; /** event ads checked against dedup cache */
+	uint32_t dedupHits; /** repeated events discarded */
+} SensorTaskAdStats_t;
+
 /******************************************************************************/
 /* Global Function Prototypes                                                 */
 /******************************************************************************/
@@ -21,6 +39,11 @@ extern "C" {
  */
 void SensorTask_Initialize(void);
 
+/**
+ * @brief Get a copy of the advertisement processing statistics.
+ */
+void SensorTask_GetAdStats(SensorTaskAdStats_t *pStats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -30,6 +30,21 @@ extern "C" {
 #define SB_IS_NOT_STRING true
 #define SB_IS_STRING false
 
+/**
+ * @brief Pre-escaped key token ("key":) with a length that is known at
+ * compile time.  The key must not contain characters that require escaping.
+ */
+typedef struct ShadowBuilderKey {
+	const char *str;
+	size_t length;
+} ShadowBuilderKey_t;
+
+#define SB_KEY_STR(k) "\"" k "\":"
+
+#define SB_KEY(k)                                                              \
+	(&(const ShadowBuilderKey_t){ .str = SB_KEY_STR(k),                    \
+				      .length = sizeof(SB_KEY_STR(k)) - 1 })
+
 /******************************************************************************/
 /* Global Function Prototypes                                                 */
 /******************************************************************************/
@@ -53,6 +68,15 @@ void ShadowBuilder_AddUint32(JsonMsg_t *pJsonMsg, const char *restrict pKey,
 void ShadowBuilder_AddSigned32(JsonMsg_t *pJsonMsg, const char *restrict pKey,
 			       int32_t Value);
 
+/**
+ * @brief Key token versions of the above.  The output is identical.
+ */
+void ShadowBuilder_AddUint32Key(JsonMsg_t *pJsonMsg,
+				const ShadowBuilderKey_t *pKey, uint32_t Value);
+void ShadowBuilder_AddSigned32Key(JsonMsg_t *pJsonMsg,
+				  const ShadowBuilderKey_t *pKey,
+				  int32_t Value);
+
 /**
  * @brief Adds a JSON pair to the message being built.  "<pKey>" : pValue
  *
@@ -64,6 +88,9 @@ void ShadowBuilder_AddSigned32(JsonMsg_t *pJsonMsg, const char *restrict pKey,
  */
 void ShadowBuilder_AddPair(JsonMsg_t *pJsonMsg, const char *restrict pKey,
 			   const char *restrict pValue, bool IsNotString);
+void ShadowBuilder_AddPairKey(JsonMsg_t *pJsonMsg,
+			      const ShadowBuilderKey_t *pKey,
+			      const char *restrict pValue, bool IsNotString);
 
 /**
  * @brief Adds a JSON version x.x.x
@@ -72,6 +99,9 @@ void ShadowBuilder_AddPair(JsonMsg_t *pJsonMsg, const char *restrict pKey,
  */
 void ShadowBuilder_AddVersion(JsonMsg_t *pJsonMsg, const char *restrict pKey,
 			      uint8_t Major, uint8_t Minor, uint8_t Build);
+void ShadowBuilder_AddVersionKey(JsonMsg_t *pJsonMsg,
+				 const ShadowBuilderKey_t *pKey, uint8_t Major,
+				 uint8_t Minor, uint8_t Build);
 
 /**
  * @brief Adds pair with true, false, or null
@@ -79,6 +109,8 @@ void ShadowBuilder_AddVersion(JsonMsg_t *pJsonMsg, const char *restrict pKey,
  * @param pKey name of key
  */
 void ShadowBuilder_AddNull(JsonMsg_t *pJsonMsg, const char *restrict pKey);
+void ShadowBuilder_AddNullKey(JsonMsg_t *pJsonMsg,
+			      const ShadowBuilderKey_t *pKey);
 void ShadowBuilder_AddTrue(JsonMsg_t *pJsonMsg, const char *restrict pKey);
 void ShadowBuilder_AddFalse(JsonMsg_t *pJsonMsg, const char *restrict pKey);
 
@@ -88,6 +120,8 @@ void ShadowBuilder_AddFalse(JsonMsg_t *pJsonMsg, const char *restrict pKey);
  * @param pKey name of key
  */
 void ShadowBuilder_StartArray(JsonMsg_t *pJsonMsg, const char *restrict pKey);
+void ShadowBuilder_StartArrayKey(JsonMsg_t *pJsonMsg,
+				 const ShadowBuilderKey_t *pKey);
 
 /**
  * @brief Closes JSON array
@@ -107,6 +141,8 @@ void ShadowBuilder_AddSensorTableArrayEntry(JsonMsg_t *pJsonMsg,
  * @param pKey name of key
  */
 void ShadowBuilder_StartGroup(JsonMsg_t *pJsonMsg, const char *restrict pKey);
+void ShadowBuilder_StartGroupKey(JsonMsg_t *pJsonMsg,
+				 const ShadowBuilderKey_t *pKey);
 
 /**
  * @brief Closes JSON group
@@ -125,6 +161,21 @@ void ShadowBuilder_AddString(JsonMsg_t *pJsonMsg, const char *restrict pKey,
  */
 void ShadowBuilder_AddEventLogEntry(JsonMsg_t *pJsonMsg, SensorLogEvent_t *p);
 
+/**
+ * @brief Format an event log entry (including the trailing comma).
+ *
+ * @param pOut must be at least SENSOR_LOG_ENTRY_JSON_STR_SIZE bytes.
+ *
+ * @retval number of characters written (not NUL terminated)
+ */
+size_t ShadowBuilder_FormatEventLogEntry(char *pOut, SensorLogEvent_t *p);
+
+/**
+ * @brief Add preformatted JSON to the buffer.
+ */
+void ShadowBuilder_AddRaw(JsonMsg_t *pJsonMsg, const char *pData,
+			  size_t Length);
+
 #ifdef __cplusplus
 }
 #endif
@@ -14,6 +14,7 @@ LOG_MODULE_REGISTER(bluegrass, CONFIG_BLUEGRASS_LOG_LEVEL);
 /* Includes                                                                   */
 /******************************************************************************/
 #include <kernel.h>
+#include <string.h>
 
 #include "aws.h"
 #include "sensor_task.h"
@@ -27,6 +28,10 @@ LOG_MODULE_REGISTER(bluegrass, CONFIG_BLUEGRASS_LOG_LEVEL);
 #include "ct_ble.h"
 #endif
 
+#ifdef CONFIG_BLUEGRASS_PUBLISH_JOURNAL
+#include "publish_journal.h"
+#endif
+
 #include "bluegrass.h"
 
 /******************************************************************************/
@@ -38,6 +43,23 @@ LOG_MODULE_REGISTER(bluegrass, CONFIG_BLUEGRASS_LOG_LEVEL);
 
 #define CONNECT_TO_SUBSCRIBE_DELAY 4
 
+#ifdef CONFIG_BLUEGRASS_BATCH_PUBLISH
+#define BATCH_START "{\"messages\":["
+#define BATCH_ENTRY_TOPIC "{\"topic\":\""
+#define BATCH_ENTRY_PAYLOAD "\",\"payload\":"
+#define BATCH_ENTRY_END "}"
+#define BATCH_SEPARATOR ","
+#define BATCH_END "]}"
+
+#define BATCH_ENTRY_OVERHEAD                                                   \
+	(sizeof(BATCH_SEPARATOR) - 1 + sizeof(BATCH_ENTRY_TOPIC) - 1 +         \
+	 sizeof(BATCH_ENTRY_PAYLOAD) - 1 + sizeof(BATCH_ENTRY_END) - 1)
+
+/* Includes null terminator */
+#define BATCH_FIXED_OVERHEAD (sizeof(BATCH_START) - 1 + sizeof(BATCH_END))
+
+#endif
+
 /******************************************************************************/
 /* Local Data Definitions                                                     */
 /******************************************************************************/
@@ -48,6 +70,28 @@ static struct {
 	bool get_shadow_processed;
 	struct k_work_delayable heartbeat;
 	uint32_t subscription_delay;
+	/* Latest gateway shadow that didn't fit in the in-flight window */
+	JsonMsg_t *gateway_retry;
+	/* Latest ESS reading that didn't fit in the in-flight window */
+	ESSSensorMsg_t *ess_retry;
+#ifdef CONFIG_BLUEGRASS_BATCH_PUBLISH
+	struct k_work_delayable batch_timeout;
+	int64_t batch_start_time;
+	size_t batch_count;
+	size_t batch_length;
+	/* Location of first payload so that a single update can be sent
+	 * without the envelope.
+	 */
+	size_t first_payload_offset;
+	size_t first_payload_length;
+	char first_topic[CONFIG_AWS_TOPIC_MAX_SIZE];
+	char batch_topic[CONFIG_AWS_TOPIC_MAX_SIZE];
+	char batch_buf[CONFIG_BLUEGRASS_BATCH_MAX_BYTES];
+	struct bluegrass_batch_stats batch_stats;
+#endif
+#ifdef CONFIG_BLUEGRASS_PUBLISH_JOURNAL
+	struct k_work_delayable journal_drain;
+#endif
 } bg;
 
 /******************************************************************************/
@@ -56,6 +100,25 @@ static struct {
 static void heartbeat_work_handler(struct k_work *work);
 static void aws_init_shadow(void);
 
+#ifdef CONFIG_BLUEGRASS_BATCH_PUBLISH
+static void batch_timeout_work_handler(struct k_work *work);
+static void batch_append(const char *topic, const char *payload,
+			 size_t payload_length);
+static void batch_publish(void);
+static void batch_discard(void);
+static void batch_update_stats(void);
+static FwkMsgHandler_t batch_timeout_msg_handler;
+#endif
+
+static void sensor_publish(char *payload, uint8_t *topic);
+static void sensor_republish_request(const uint8_t *topic);
+static void gateway_publish_retry(void);
+
+#ifdef CONFIG_BLUEGRASS_PUBLISH_JOURNAL
+static void journal_drain_work_handler(struct k_work *work);
+static FwkMsgHandler_t journal_drain_msg_handler;
+#endif
+
 static FwkMsgHandler_t sensor_publish_msg_handler;
 static FwkMsgHandler_t gateway_publish_msg_handler;
 static FwkMsgHandler_t subscription_msg_handler;
@@ -69,6 +132,13 @@ static FwkMsgHandler_t heartbeat_msg_handler;
 void bluegrass_initialize(void)
 {
 	k_work_init_delayable(&bg.heartbeat, heartbeat_work_handler);
+#ifdef CONFIG_BLUEGRASS_BATCH_PUBLISH
+	k_work_init_delayable(&bg.batch_timeout, batch_timeout_work_handler);
+#endif
+#ifdef CONFIG_BLUEGRASS_PUBLISH_JOURNAL
+	k_work_init_delayable(&bg.journal_drain, journal_drain_work_handler);
+	publish_journal_init();
+#endif
 
 #ifdef CONFIG_SENSOR_TASK
 	SensorTask_Initialize();
@@ -109,6 +179,10 @@ void bluegrass_disconnected_callback(void)
 	bg.subscribed_to_get_accepted = false;
 	bg.get_shadow_processed = false;
 
+#ifdef CONFIG_BLUEGRASS_BATCH_PUBLISH
+	batch_discard();
+#endif
+
 	FRAMEWORK_MSG_CREATE_AND_BROADCAST(FWK_ID_RESERVED,
 					   FMC_AWS_DISCONNECTED);
 }
@@ -119,10 +193,23 @@ bool bluegrass_ready_for_publish(void)
 		bg.gateway_subscribed);
 }
 
+#ifdef CONFIG_BLUEGRASS_BATCH_PUBLISH
+void bluegrass_get_batch_stats(struct bluegrass_batch_stats *stats)
+{
+	*stats = bg.batch_stats;
+}
+#endif
+
 DispatchResult_t bluegrass_msg_handler(FwkMsgReceiver_t *pMsgRxer,
 				       FwkMsg_t *pMsg)
 {
 	if (!awsConnected()) {
+#ifdef CONFIG_BLUEGRASS_PUBLISH_JOURNAL
+		/* Sensor updates are stored until they can be published. */
+		if (pMsg->header.msgCode == FMC_SENSOR_PUBLISH) {
+			return sensor_publish_msg_handler(pMsgRxer, pMsg);
+		}
+#endif
 		return DISPATCH_OK;
 	}
 
@@ -135,6 +222,12 @@ DispatchResult_t bluegrass_msg_handler(FwkMsgReceiver_t *pMsgRxer,
 	case FMC_AWS_GET_ACCEPTED_RECEIVED: return get_accepted_msg_handler(pMsgRxer, pMsg);
 	case FMC_ESS_SENSOR_EVENT:          return ess_sensor_msg_handler(pMsgRxer, pMsg);
 	case FMC_AWS_HEARTBEAT:             return heartbeat_msg_handler(pMsgRxer, pMsg);
+#ifdef CONFIG_BLUEGRASS_BATCH_PUBLISH
+	case FMC_AWS_BATCH_TIMEOUT:         return batch_timeout_msg_handler(pMsgRxer, pMsg);
+#endif
+#ifdef CONFIG_BLUEGRASS_PUBLISH_JOURNAL
+	case FMC_AWS_JOURNAL_DRAIN:         return journal_drain_msg_handler(pMsgRxer, pMsg);
+#endif
 	default:                            return DISPATCH_OK;
 	}
 	/* clang-format on */
@@ -144,11 +237,16 @@ int bluegrass_subscription_handler(void)
 {
 	int rc = 0;
 
+	gateway_publish_retry();
+
 	if (!awsConnected()) {
 		bg.subscription_delay = CONNECT_TO_SUBSCRIBE_DELAY;
 		return rc;
 	}
 
+	/* Retry if the window was full when the connection was made. */
+	aws_init_shadow();
+
 	if (CONFIG_USE_SINGLE_AWS_TOPIC) {
 		return rc;
 	}
@@ -176,6 +274,9 @@ int bluegrass_subscription_handler(void)
 
 			FRAMEWORK_MSG_CREATE_AND_BROADCAST(FWK_ID_CLOUD,
 							   FMC_BLUEGRASS_READY);
+#ifdef CONFIG_BLUEGRASS_PUBLISH_JOURNAL
+			k_work_reschedule(&bg.journal_drain, K_NO_WAIT);
+#endif
 		}
 	}
 
@@ -206,7 +307,9 @@ static void aws_init_shadow(void)
 
 		r = awsPublishShadowPersistentData();
 
-		if (r != 0) {
+		if (r == -EAGAIN) {
+			LOG_DBG("Shadow publish deferred");
+		} else if (r != 0) {
 			LOG_ERR("Could not publish shadow (%d)", r);
 		} else {
 			bg.init_shadow = false;
@@ -220,24 +323,114 @@ static DispatchResult_t sensor_publish_msg_handler(FwkMsgReceiver_t *pMsgRxer,
 	ARG_UNUSED(pMsgRxer);
 	JsonMsg_t *pJsonMsg = (JsonMsg_t *)pMsg;
 
+#ifdef CONFIG_BLUEGRASS_PUBLISH_JOURNAL
+	/* Updates are stored until the gateway is ready. */
+	if (!bluegrass_ready_for_publish()) {
+		publish_journal_append(CONFIG_USE_SINGLE_AWS_TOPIC ?
+						     GATEWAY_TOPIC :
+						     (uint8_t *)pJsonMsg->topic,
+				       pJsonMsg->buffer,
+				       strlen(pJsonMsg->buffer));
+		return DISPATCH_OK;
+	}
+#endif
+
 	if (bluegrass_ready_for_publish()) {
-		awsSendData(pJsonMsg->buffer, CONFIG_USE_SINGLE_AWS_TOPIC ?
-							    GATEWAY_TOPIC :
-							    pJsonMsg->topic);
+#ifdef CONFIG_BLUEGRASS_BATCH_PUBLISH
+		batch_append(pJsonMsg->topic, pJsonMsg->buffer,
+			     strlen(pJsonMsg->buffer));
+#else
+		sensor_publish(pJsonMsg->buffer, CONFIG_USE_SINGLE_AWS_TOPIC ?
+							 GATEWAY_TOPIC :
+							 pJsonMsg->topic);
+#endif
 	}
 
 	return DISPATCH_OK;
 }
 
+static void sensor_publish(char *payload, uint8_t *topic)
+{
+#ifdef CONFIG_BLUEGRASS_PUBLISH_JOURNAL
+	int r = -EAGAIN;
+
+	/* Updates are published in order.  While there is a backlog an update
+	 * is appended so that an older record can't overwrite it.
+	 */
+	if (publish_journal_empty()) {
+		r = awsSendData(payload, topic);
+	}
+	if (r < 0) {
+		publish_journal_append(topic, payload, strlen(payload));
+		k_work_schedule(
+			&bg.journal_drain,
+			K_MSEC(CONFIG_BLUEGRASS_PUBLISH_JOURNAL_DRAIN_INTERVAL_MS));
+	}
+#else
+	if (awsSendData(payload, topic) == -EAGAIN) {
+		sensor_republish_request(topic);
+	}
+#endif
+}
+
+/* Without the journal an update that didn't fit in the in-flight window is
+ * rebuilt by the sensor table.  A batch marks every sensor.
+ */
+static void sensor_republish_request(const uint8_t *topic)
+{
+#ifdef CONFIG_SENSOR_TASK
+	JsonMsg_t *pMsg = BP_TRY_TO_TAKE(FWK_BUFFER_MSG_SIZE(JsonMsg_t, 0));
+	if (pMsg == NULL) {
+		LOG_WRN("Sensor update dropped");
+		return;
+	}
+
+	pMsg->header.msgCode = FMC_SENSOR_REPUBLISH;
+	pMsg->header.rxId = FWK_ID_SENSOR_TASK;
+	strncpy(pMsg->topic, (const char *)topic, sizeof(pMsg->topic) - 1);
+	FRAMEWORK_MSG_SEND(pMsg);
+#else
+	ARG_UNUSED(topic);
+#endif
+}
+
 static DispatchResult_t gateway_publish_msg_handler(FwkMsgReceiver_t *pMsgRxer,
 						    FwkMsg_t *pMsg)
 {
 	ARG_UNUSED(pMsgRxer);
 	JsonMsg_t *pJsonMsg = (JsonMsg_t *)pMsg;
 
-	awsSendData(pJsonMsg->buffer, GATEWAY_TOPIC);
+	if (awsSendData(pJsonMsg->buffer, GATEWAY_TOPIC) != -EAGAIN) {
+		return DISPATCH_OK;
+	}
+
+	/* Each gateway shadow replaces the previous one, so only the latest
+	 * is kept until the window has room.
+	 */
+	if (bg.gateway_retry != NULL) {
+		BufferPool_Free(bg.gateway_retry);
+	}
+	bg.gateway_retry = pJsonMsg;
+	return DISPATCH_DO_NOT_FREE;
+}
 
-	return DISPATCH_OK;
+/* Called from the periodic handler in the same thread as the publish. */
+static void gateway_publish_retry(void)
+{
+	ESSSensorMsg_t *p = bg.ess_retry;
+
+	if (bg.gateway_retry != NULL &&
+	    awsSendData(bg.gateway_retry->buffer, GATEWAY_TOPIC) != -EAGAIN) {
+		BufferPool_Free(bg.gateway_retry);
+		bg.gateway_retry = NULL;
+	}
+
+	if (p != NULL &&
+	    awsPublishESSSensorData(p->temperatureC, p->humidityPercent,
+				    p->pressurePa) != -EAGAIN) {
+		BufferPool_Free(p);
+		bg.ess_retry = NULL;
+	}
 }
 
 static DispatchResult_t subscription_msg_handler(FwkMsgReceiver_t *pMsgRxer,
@@ -275,11 +468,18 @@ static DispatchResult_t ess_sensor_msg_handler(FwkMsgReceiver_t *pMsgRxer,
 	ARG_UNUSED(pMsgRxer);
 	ESSSensorMsg_t *pBmeMsg = (ESSSensorMsg_t *)pMsg;
 
-	awsPublishESSSensorData(pBmeMsg->temperatureC,
-				pBmeMsg->humidityPercent,
-				pBmeMsg->pressurePa);
+	if (awsPublishESSSensorData(pBmeMsg->temperatureC,
+				    pBmeMsg->humidityPercent,
+				    pBmeMsg->pressurePa) != -EAGAIN) {
+		return DISPATCH_OK;
+	}
 
-	return DISPATCH_OK;
+	/* Only the latest reading is kept until the window has room. */
+	if (bg.ess_retry != NULL) {
+		BufferPool_Free(bg.ess_retry);
+	}
+	bg.ess_retry = pBmeMsg;
+	return DISPATCH_DO_NOT_FREE;
 }
 
 static DispatchResult_t heartbeat_msg_handler(FwkMsgReceiver_t *pMsgRxer,
@@ -296,3 +496,185 @@ static DispatchResult_t heartbeat_msg_handler(FwkMsgReceiver_t *pMsgRxer,
 
 	return DISPATCH_OK;
 }
+
+#ifdef CONFIG_BLUEGRASS_BATCH_PUBLISH
+static void batch_timeout_work_handler(struct k_work *work)
+{
+	ARG_UNUSED(work);
+
+	FRAMEWORK_MSG_CREATE_AND_SEND(FWK_ID_CLOUD, FWK_ID_CLOUD,
+				      FMC_AWS_BATCH_TIMEOUT);
+}
+
+static DispatchResult_t batch_timeout_msg_handler(FwkMsgReceiver_t *pMsgRxer,
+						  FwkMsg_t *pMsg)
+{
+	ARG_UNUSED(pMsgRxer);
+	ARG_UNUSED(pMsg);
+
+	batch_publish();
+
+	return DISPATCH_OK;
+}
+
+static void batch_add_string(const char *str, size_t length)
+{
+	memcpy(&bg.batch_buf[bg.batch_length], str, length);
+	bg.batch_length += length;
+}
+
+/* Updates are copied so that buffer pool blocks aren't held
+ * for the duration of the window.
+ */
+static void batch_append(const char *topic, const char *payload,
+			 size_t payload_length)
+{
+	size_t topic_length = strlen(topic);
+	size_t entry_length = BATCH_ENTRY_OVERHEAD + topic_length +
+			      payload_length;
+
+	if ((bg.batch_length + entry_length + sizeof(BATCH_END)) >
+	    sizeof(bg.batch_buf)) {
+		batch_publish();
+	}
+
+	if ((BATCH_FIXED_OVERHEAD + entry_length) > sizeof(bg.batch_buf)) {
+		bg.batch_stats.bypass += 1;
+		sensor_publish((char *)payload, (uint8_t *)topic);
+		return;
+	}
+
+	if (bg.batch_count == 0) {
+		bg.batch_length = 0;
+		batch_add_string(BATCH_START, strlen(BATCH_START));
+		bg.batch_start_time = k_uptime_get();
+		strncpy(bg.first_topic, topic, sizeof(bg.first_topic) - 1);
+		k_work_reschedule(&bg.batch_timeout,
+				  K_MSEC(CONFIG_BLUEGRASS_BATCH_WINDOW_MS));
+	} else {
+		batch_add_string(BATCH_SEPARATOR, strlen(BATCH_SEPARATOR));
+	}
+
+	batch_add_string(BATCH_ENTRY_TOPIC, strlen(BATCH_ENTRY_TOPIC));
+	batch_add_string(topic, topic_length);
+	batch_add_string(BATCH_ENTRY_PAYLOAD, strlen(BATCH_ENTRY_PAYLOAD));
+	if (bg.batch_count == 0) {
+		bg.first_payload_offset = bg.batch_length;
+		bg.first_payload_length = payload_length;
+	}
+	batch_add_string(payload, payload_length);
+	batch_add_string(BATCH_ENTRY_END, strlen(BATCH_ENTRY_END));
+	bg.batch_count += 1;
+}
+
+static void batch_publish(void)
+{
+	if (bg.batch_count == 0) {
+		return;
+	}
+
+	k_work_cancel_delayable(&bg.batch_timeout);
+	batch_update_stats();
+
+	if (bg.batch_count == 1) {
+		/* The envelope isn't required for a single update. */
+		bg.batch_buf[bg.first_payload_offset +
+			     bg.first_payload_length] = 0;
+		sensor_publish(&bg.batch_buf[bg.first_payload_offset],
+			       (uint8_t *)bg.first_topic);
+	} else {
+		batch_add_string(BATCH_END, sizeof(BATCH_END));
+		snprintk(bg.batch_topic, sizeof(bg.batch_topic),
+			 CONFIG_BLUEGRASS_BATCH_TOPIC_FMT_STR,
+			 (char *)attr_get_quasi_static(ATTR_ID_gatewayId));
+		sensor_publish(bg.batch_buf, (uint8_t *)bg.batch_topic);
+	}
+
+	bg.batch_count = 0;
+	bg.batch_length = 0;
+}
+
+static void batch_discard(void)
+{
+#ifdef CONFIG_BLUEGRASS_PUBLISH_JOURNAL
+	/* The publish fails and the batch is stored in the journal. */
+	if (bg.batch_count > 0) {
+		batch_publish();
+		return;
+	}
+#endif
+	k_work_cancel_delayable(&bg.batch_timeout);
+	if (bg.batch_count > 0) {
+		LOG_WRN("Discarding %u batched sensor updates", bg.batch_count);
+	}
+	bg.batch_count = 0;
+	bg.batch_length = 0;
+}
+
+static void batch_update_stats(void)
+{
+	struct bluegrass_batch_stats *p = &bg.batch_stats;
+	uint32_t latency = (uint32_t)(k_uptime_get() - bg.batch_start_time);
+	uint32_t fill = (bg.batch_length * 100) / sizeof(bg.batch_buf);
+
+	p->publishes += 1;
+	p->messages += bg.batch_count;
+	p->fill_percent_last = fill;
+	p->latency_ms_last = latency;
+	p->latency_ms_max = MAX(p->latency_ms_max, latency);
+	/* Exponential moving average (alpha = 1/8) */
+	if (p->publishes == 1) {
+		p->fill_percent_avg = fill;
+		p->latency_ms_avg = latency;
+	} else {
+		p->fill_percent_avg = ((p->fill_percent_avg * 7) + fill) / 8;
+		p->latency_ms_avg = ((p->latency_ms_avg * 7) + latency) / 8;
+	}
+
+	LOG_DBG("Batch of %u updates fill: %u%% latency: %u ms",
+		bg.batch_count, fill, latency);
+}
+#endif
+
+#ifdef CONFIG_BLUEGRASS_PUBLISH_JOURNAL
+static void journal_drain_work_handler(struct k_work *work)
+{
+	ARG_UNUSED(work);
+
+	FRAMEWORK_MSG_CREATE_AND_SEND(FWK_ID_CLOUD, FWK_ID_CLOUD,
+				      FMC_AWS_JOURNAL_DRAIN);
+}
+
+/* Records are sent until the in-flight window is full.  The rest are sent
+ * after the next interval, when PUBACKs have freed the window.  Live updates
+ * are appended while there is a backlog so that the order is kept.
+ * Draining restarts when the gateway is ready again.
+ */
+static DispatchResult_t journal_drain_msg_handler(FwkMsgReceiver_t *pMsgRxer,
+						  FwkMsg_t *pMsg)
+{
+	ARG_UNUSED(pMsgRxer);
+	ARG_UNUSED(pMsg);
+	int r = 0;
+	int i;
+
+	if (!bluegrass_ready_for_publish()) {
+		return DISPATCH_OK;
+	}
+
+	for (i = 0; i < CONFIG_AWS_INFLIGHT_MAX && r == 0; i++) {
+		r = publish_journal_send_oldest(awsSendData);
+	}
+	if (r < 0 && r != -ENOENT && r != -EAGAIN) {
+		LOG_ERR("Unable to publish journal entry (%d)", r);
+	}
+
+	if (!publish_journal_empty()) {
+		k_work_reschedule(
+			&bg.journal_drain,
+			K_MSEC(CONFIG_BLUEGRASS_PUBLISH_JOURNAL_DRAIN_INTERVAL_MS));
+	}
+
+	return DISPATCH_OK;
+}
+#endif
@@ -0,0 +1,136 @@
+/**
+ * @file bluegrass_shell.c
+ * @brief
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <shell/shell.h>
+#include <init.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bluegrass.h"
+#include "aws.h"
+#ifdef CONFIG_SENSOR_TASK
+#include "sensor_task.h"
+#endif
+#ifdef CONFIG_BLUEGRASS_PUBLISH_JOURNAL
+#include "publish_journal.h"
+#endif
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static int shell_bluegrass_batch_cmd(const struct shell *shell, size_t argc,
+				     char **argv)
+{
+#ifdef CONFIG_BLUEGRASS_BATCH_PUBLISH
+	struct bluegrass_batch_stats stats;
+
+	bluegrass_get_batch_stats(&stats);
+	shell_print(shell, "publishes: %u", stats.publishes);
+	shell_print(shell, "messages: %u", stats.messages);
+	shell_print(shell, "bypass: %u", stats.bypass);
+	shell_print(shell, "fill %%: last %u avg %u", stats.fill_percent_last,
+		    stats.fill_percent_avg);
+	shell_print(shell, "latency ms: last %u avg %u max %u",
+		    stats.latency_ms_last, stats.latency_ms_avg,
+		    stats.latency_ms_max);
+
+	return 0;
+#else
+	shell_error(shell, "Batch publish not enabled");
+	return -ENOTSUP;
+#endif
+}
+
+static int shell_bluegrass_acks_cmd(const struct shell *shell, size_t argc,
+				    char **argv)
+{
+	struct aws_ack_stats stats;
+	size_t i;
+
+	awsGetAckStats(&stats);
+	shell_print(shell, "in flight: %u max %u", stats.inflight,
+		    stats.inflight_max);
+	shell_print(shell, "window full: %u", stats.window_full);
+	shell_print(shell, "retransmits: %u", stats.retransmits);
+	shell_print(shell, "expired: %u", stats.expired);
+	shell_print(shell, "abandoned: %u", stats.abandoned);
+	shell_print(shell, "unknown: %u", stats.unknown_acks);
+	shell_print(shell, "last latency ms: %d", (int32_t)stats.last_latency);
+	for (i = 0; i < AWS_ACK_LATENCY_BUCKETS; i++) {
+		shell_print(shell, "latency bucket %u: %u", i,
+			    stats.latency[i]);
+	}
+
+	return 0;
+}
+
+#ifdef CONFIG_SENSOR_TASK
+static int shell_bluegrass_ads_cmd(const struct shell *shell, size_t argc,
+				   char **argv)
+{
+	SensorTaskAdStats_t stats;
+
+	SensorTask_GetAdStats(&stats);
+	shell_print(shell, "processed: %u", stats.processed);
+	shell_print(shell, "dropped: %u", stats.dropped);
+	shell_print(shell, "ring high water: %u", stats.highWater);
+	shell_print(shell, "batch: last %u max %u", stats.lastBatch,
+		    stats.maxBatch);
+	shell_print(shell, "dedup: lookups %u hits %u", stats.dedupLookups,
+		    stats.dedupHits);
+
+	return 0;
+}
+#endif
+
+static int shell_bluegrass_journal_cmd(const struct shell *shell,
+				       size_t argc, char **argv)
+{
+#ifdef CONFIG_BLUEGRASS_PUBLISH_JOURNAL
+	struct publish_journal_stats stats;
+
+	publish_journal_get_stats(&stats);
+	shell_print(shell, "empty: %s", publish_journal_empty() ? "yes" : "no");
+	shell_print(shell, "appended: %u", stats.appended);
+	shell_print(shell, "sent: %u", stats.sent);
+	shell_print(shell, "evicted: %u", stats.evicted);
+	shell_print(shell, "dropped: %u", stats.dropped);
+	shell_print(shell, "compactions: %u", stats.compactions);
+	shell_print(shell, "truncated: %u", stats.truncated);
+
+	return 0;
+#else
+	shell_error(shell, "Publish journal not enabled");
+	return -ENOTSUP;
+#endif
+}
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+SHELL_STATIC_SUBCMD_SET_CREATE(
+	bluegrass_cmds,
+	SHELL_CMD(acks, NULL, "MQTT PUBACK statistics",
+		  shell_bluegrass_acks_cmd),
+#ifdef CONFIG_SENSOR_TASK
+	SHELL_CMD(ads, NULL, "Sensor advertisement statistics",
+		  shell_bluegrass_ads_cmd),
+#endif
+	SHELL_CMD(batch, NULL, "Batch publish statistics",
+		  shell_bluegrass_batch_cmd),
+	SHELL_CMD(journal, NULL, "Publish journal statistics",
+		  shell_bluegrass_journal_cmd),
+	SHELL_SUBCMD_SET_END /* Array terminated. */
+);
+
+SHELL_CMD_REGISTER(bluegrass, &bluegrass_cmds, "Bluegrass commands", NULL);
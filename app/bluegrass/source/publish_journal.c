@@ -0,0 +1,498 @@
+/**
+ * @file publish_journal.c
+ * @brief Append-only journal of messages waiting to be published.
+ *
+ * Each record is a header followed by the topic and payload.  The sequence
+ * number of the oldest unsent record is stored in a separate cursor file
+ * that is updated after every successful publish.  On reset the journal is
+ * scanned and every record that fails its CRC (and anything after it) is
+ * discarded, so a record torn by power loss is never replayed.
+ * A record may be sent twice if a reset occurs between the publish and
+ * the cursor update.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(publish_journal, CONFIG_BLUEGRASS_LOG_LEVEL);
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <kernel.h>
+#include <string.h>
+#include <fs/fs.h>
+#include <sys/crc.h>
+
+#include "file_system_utilities.h"
+#include "publish_journal.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define JOURNAL_FILE CONFIG_BLUEGRASS_PUBLISH_JOURNAL_FILE
+#define CURSOR_FILE CONFIG_BLUEGRASS_PUBLISH_JOURNAL_FILE ".idx"
+#define TEMP_FILE CONFIG_BLUEGRASS_PUBLISH_JOURNAL_FILE ".tmp"
+
+#define JOURNAL_MAX_BYTES CONFIG_BLUEGRASS_PUBLISH_JOURNAL_MAX_BYTES
+
+#define RECORD_MAGIC 0x4C4E524A /* JRNL */
+#define CURSOR_MAGIC 0x5255434A /* JCUR */
+
+#define COPY_CHUNK_SIZE 128
+
+struct record_header {
+	uint32_t magic;
+	/* The CRC covers the fields after it, the topic, and the payload. */
+	uint32_t crc;
+	uint32_t seq;
+	uint16_t topic_length;
+	uint16_t payload_length;
+};
+
+struct cursor {
+	uint32_t magic;
+	uint32_t next_seq;
+};
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+static struct {
+	bool ready;
+	off_t read_offset;
+	off_t end_offset;
+	uint32_t count;
+	uint32_t next_seq; /* oldest unsent record */
+	uint32_t append_seq;
+	struct publish_journal_stats stats;
+} pj;
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static int scan(void);
+static int read_header(struct fs_file_t *f, off_t offset,
+		       struct record_header *hdr);
+static uint32_t header_crc(const struct record_header *hdr);
+static size_t record_size(const struct record_header *hdr);
+static bool seq_before(uint32_t a, uint32_t b);
+static int evict_oldest(void);
+static int compact(void);
+static int write_cursor(void);
+static void reset(void);
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+int publish_journal_init(void)
+{
+	int r;
+
+	r = fsu_lfs_mount();
+	if (r < 0) {
+		LOG_ERR("Unable to mount file system for journal (%d)", r);
+		return r;
+	}
+
+	/* A compaction didn't complete; the journal is still intact. */
+	(void)fs_unlink(TEMP_FILE);
+
+	r = scan();
+	if (r == 0) {
+		pj.ready = true;
+		LOG_INF("Publish journal has %u records (%u bytes)", pj.count,
+			(uint32_t)(pj.end_offset - pj.read_offset));
+	} else {
+		LOG_ERR("Unable to recover publish journal (%d)", r);
+	}
+	return r;
+}
+
+int publish_journal_append(const uint8_t *topic, const char *payload,
+			   size_t length)
+{
+	struct fs_file_t f;
+	struct record_header hdr;
+	uint32_t crc;
+	ssize_t r;
+	bool evicted = false;
+
+	if (!pj.ready) {
+		return -ENODEV;
+	}
+
+	hdr.magic = RECORD_MAGIC;
+	hdr.seq = pj.append_seq;
+	hdr.topic_length = (topic == NULL) ? 0 : strlen((char *)topic);
+	hdr.payload_length = length;
+	size_t size = record_size(&hdr);
+	if (length > UINT16_MAX || size > JOURNAL_MAX_BYTES) {
+		pj.stats.dropped += 1;
+		return -EFBIG;
+	}
+
+	crc = header_crc(&hdr);
+	if (topic != NULL) {
+		crc = crc32_ieee_update(crc, topic, hdr.topic_length);
+	}
+	hdr.crc = crc32_ieee_update(crc, (const uint8_t *)payload, length);
+
+	/* Oldest-first eviction keeps the live records under the cap. */
+	while ((pj.end_offset - pj.read_offset) + size > JOURNAL_MAX_BYTES) {
+		r = evict_oldest();
+		if (r < 0) {
+			return r;
+		}
+		evicted = true;
+	}
+	if (evicted) {
+		(void)write_cursor();
+	}
+
+	/* Space used by sent records is only reclaimed when it is needed. */
+	if (pj.end_offset + size > JOURNAL_MAX_BYTES) {
+		r = compact();
+		if (r < 0) {
+			pj.stats.dropped += 1;
+			return r;
+		}
+	}
+
+	fs_file_t_init(&f);
+	r = fs_open(&f, JOURNAL_FILE, FS_O_RDWR | FS_O_CREATE);
+	if (r < 0) {
+		pj.stats.dropped += 1;
+		return r;
+	}
+
+	r = fs_seek(&f, pj.end_offset, FS_SEEK_SET);
+	if (r == 0) {
+		r = fs_write(&f, &hdr, sizeof(hdr));
+	}
+	if (r >= 0 && hdr.topic_length > 0) {
+		r = fs_write(&f, topic, hdr.topic_length);
+	}
+	if (r >= 0) {
+		r = fs_write(&f, payload, length);
+	}
+	if (r >= 0) {
+		r = fs_sync(&f);
+	}
+	if (r < 0) {
+		/* Don't leave a partial record */
+		(void)fs_truncate(&f, pj.end_offset);
+	}
+	(void)fs_close(&f);
+
+	if (r < 0) {
+		pj.stats.dropped += 1;
+		LOG_ERR("Unable to append to publish journal (%d)", r);
+		return r;
+	}
+
+	pj.end_offset += size;
+	pj.append_seq += 1;
+	pj.count += 1;
+	pj.stats.appended += 1;
+	return 0;
+}
+
+bool publish_journal_empty(void)
+{
+	return (pj.count == 0);
+}
+
+int publish_journal_send_oldest(publish_journal_send_t *send)
+{
+	struct fs_file_t f;
+	struct record_header hdr;
+	char *buf;
+	ssize_t r;
+
+	if (!pj.ready || pj.count == 0) {
+		return -ENOENT;
+	}
+
+	fs_file_t_init(&f);
+	r = fs_open(&f, JOURNAL_FILE, FS_O_READ);
+	if (r < 0) {
+		return r;
+	}
+
+	r = read_header(&f, pj.read_offset, &hdr);
+	if (r < 0) {
+		(void)fs_close(&f);
+		return r;
+	}
+
+	/* Topic and payload are each NUL terminated */
+	buf = k_malloc(hdr.topic_length + 1 + hdr.payload_length + 1);
+	if (buf == NULL) {
+		(void)fs_close(&f);
+		return -ENOMEM;
+	}
+	char *topic = buf;
+	char *payload = buf + hdr.topic_length + 1;
+
+	r = fs_read(&f, topic, hdr.topic_length);
+	if (r == hdr.topic_length) {
+		r = fs_read(&f, payload, hdr.payload_length);
+		if (r == hdr.payload_length) {
+			r = 0;
+		} else if (r >= 0) {
+			r = -EIO;
+		}
+	} else if (r >= 0) {
+		r = -EIO;
+	}
+	(void)fs_close(&f);
+
+	if (r < 0) {
+		k_free(buf);
+		return r;
+	}
+	topic[hdr.topic_length] = 0;
+	payload[hdr.payload_length] = 0;
+
+	/* The journal was validated at init; this catches media errors. */
+	uint32_t crc = header_crc(&hdr);
+	crc = crc32_ieee_update(crc, (uint8_t *)topic, hdr.topic_length);
+	crc = crc32_ieee_update(crc, (uint8_t *)payload, hdr.payload_length);
+	if (crc == hdr.crc) {
+		r = send(payload,
+			 (hdr.topic_length == 0) ? NULL : (uint8_t *)topic);
+	} else {
+		LOG_ERR("Discarding corrupt journal record %u", hdr.seq);
+		pj.stats.truncated += 1;
+		r = 0;
+	}
+	k_free(buf);
+
+	if (r == 0) {
+		pj.read_offset += record_size(&hdr);
+		pj.next_seq = hdr.seq + 1;
+		pj.count -= 1;
+		pj.stats.sent += 1;
+		if (pj.count == 0) {
+			reset();
+		}
+		(void)write_cursor();
+	}
+	return r;
+}
+
+void publish_journal_get_stats(struct publish_journal_stats *stats)
+{
+	memcpy(stats, &pj.stats, sizeof(struct publish_journal_stats));
+}
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+/* Find the oldest unsent record and discard anything that is invalid. */
+static int scan(void)
+{
+	struct fs_file_t f;
+	struct record_header hdr;
+	struct cursor cursor;
+	uint8_t chunk[COPY_CHUNK_SIZE];
+	off_t offset = 0;
+	bool found = false;
+	ssize_t r;
+
+	memset(&pj, 0, sizeof(pj));
+	r = fsu_read_abs(CURSOR_FILE, &cursor, sizeof(cursor));
+	if (r == sizeof(cursor) && cursor.magic == CURSOR_MAGIC) {
+		pj.next_seq = cursor.next_seq;
+	}
+	pj.append_seq = pj.next_seq;
+
+	fs_file_t_init(&f);
+	r = fs_open(&f, JOURNAL_FILE, FS_O_RDWR | FS_O_CREATE);
+	if (r < 0) {
+		return r;
+	}
+
+	while (read_header(&f, offset, &hdr) == 0) {
+		uint32_t crc = header_crc(&hdr);
+		size_t remaining = hdr.topic_length + hdr.payload_length;
+		while (remaining > 0) {
+			r = fs_read(&f, chunk, MIN(remaining, sizeof(chunk)));
+			if (r <= 0) {
+				break;
+			}
+			crc = crc32_ieee_update(crc, chunk, r);
+			remaining -= r;
+		}
+		if (remaining != 0 || crc != hdr.crc) {
+			break;
+		}
+
+		if (!seq_before(hdr.seq, pj.next_seq)) {
+			if (!found) {
+				found = true;
+				pj.read_offset = offset;
+				pj.next_seq = hdr.seq;
+			}
+			pj.count += 1;
+		}
+		pj.append_seq = hdr.seq + 1;
+		offset += record_size(&hdr);
+	}
+
+	pj.end_offset = offset;
+	if (fs_seek(&f, 0, FS_SEEK_END) == 0 && fs_tell(&f) > offset) {
+		LOG_WRN("Truncating publish journal at %u", (uint32_t)offset);
+		pj.stats.truncated += 1;
+		(void)fs_truncate(&f, offset);
+	}
+	(void)fs_close(&f);
+
+	if (!found) {
+		reset();
+	}
+	return 0;
+}
+
+static int read_header(struct fs_file_t *f, off_t offset,
+		       struct record_header *hdr)
+{
+	ssize_t r = fs_seek(f, offset, FS_SEEK_SET);
+	if (r == 0) {
+		r = fs_read(f, hdr, sizeof(struct record_header));
+	}
+	if (r < 0) {
+		return r;
+	} else if (r != sizeof(struct record_header) ||
+		   hdr->magic != RECORD_MAGIC ||
+		   record_size(hdr) > JOURNAL_MAX_BYTES) {
+		return -EIO;
+	} else {
+		return 0;
+	}
+}
+
+static uint32_t header_crc(const struct record_header *hdr)
+{
+	return crc32_ieee((const uint8_t *)&hdr->seq,
+			  sizeof(struct record_header) -
+				  offsetof(struct record_header, seq));
+}
+
+static size_t record_size(const struct record_header *hdr)
+{
+	return sizeof(struct record_header) + hdr->topic_length +
+	       hdr->payload_length;
+}
+
+static bool seq_before(uint32_t a, uint32_t b)
+{
+	return ((int32_t)(a - b) < 0);
+}
+
+static int evict_oldest(void)
+{
+	struct fs_file_t f;
+	struct record_header hdr;
+	int r;
+
+	if (pj.count == 0) {
+		return -ENOENT;
+	}
+
+	fs_file_t_init(&f);
+	r = fs_open(&f, JOURNAL_FILE, FS_O_READ);
+	if (r < 0) {
+		return r;
+	}
+	r = read_header(&f, pj.read_offset, &hdr);
+	(void)fs_close(&f);
+	if (r < 0) {
+		return r;
+	}
+
+	pj.read_offset += record_size(&hdr);
+	pj.next_seq = hdr.seq + 1;
+	pj.count -= 1;
+	pj.stats.evicted += 1;
+	if (pj.count == 0) {
+		reset();
+	}
+	return 0;
+}
+
+/* Copy unsent records to the start of a new file.  The rename replaces
+ * the journal atomically so a reset during compaction loses nothing.
+ */
+static int compact(void)
+{
+	struct fs_file_t src;
+	struct fs_file_t dst;
+	uint8_t chunk[COPY_CHUNK_SIZE];
+	off_t remaining = pj.end_offset - pj.read_offset;
+	ssize_t r;
+
+	fs_file_t_init(&src);
+	fs_file_t_init(&dst);
+	(void)fs_unlink(TEMP_FILE);
+
+	r = fs_open(&src, JOURNAL_FILE, FS_O_READ);
+	if (r < 0) {
+		return r;
+	}
+	r = fs_open(&dst, TEMP_FILE, FS_O_WRITE | FS_O_CREATE);
+	if (r < 0) {
+		(void)fs_close(&src);
+		return r;
+	}
+
+	r = fs_seek(&src, pj.read_offset, FS_SEEK_SET);
+	while (r >= 0 && remaining > 0) {
+		r = fs_read(&src, chunk, MIN(remaining, sizeof(chunk)));
+		if (r > 0) {
+			r = fs_write(&dst, chunk, r);
+		}
+		if (r <= 0) {
+			r = (r == 0) ? -EIO : r;
+			break;
+		}
+		remaining -= r;
+	}
+	(void)fs_close(&src);
+	(void)fs_close(&dst);
+
+	if (r >= 0) {
+		r = fs_rename(TEMP_FILE, JOURNAL_FILE);
+	}
+	if (r < 0) {
+		LOG_ERR("Publish journal compaction failed (%d)", r);
+		(void)fs_unlink(TEMP_FILE);
+		return r;
+	}
+
+	pj.end_offset -= pj.read_offset;
+	pj.read_offset = 0;
+	pj.stats.compactions += 1;
+	return 0;
+}
+
+static int write_cursor(void)
+{
+	struct cursor cursor = { .magic = CURSOR_MAGIC,
+				 .next_seq = pj.next_seq };
+	ssize_t r = fsu_write_abs(CURSOR_FILE, &cursor, sizeof(cursor));
+	return (r < 0) ? r : 0;
+}
+
+/* When everything has been sent the journal can be removed. */
+static void reset(void)
+{
+	(void)fs_unlink(JOURNAL_FILE);
+	pj.read_offset = 0;
+	pj.end_offset = 0;
+	pj.count = 0;
+	pj.next_seq = pj.append_seq;
+}
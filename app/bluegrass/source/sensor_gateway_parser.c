@@ -177,30 +177,38 @@ static int (*LocalConfigGet[MAX_WRITEABLE_LOCAL_OBJECTS])() = {
 /* Local Function Prototypes                                                  */
 /******************************************************************************/
 #if defined(CONFIG_COAP_FOTA) || defined(CONFIG_HTTP_FOTA)
-static void FotaParser(const char *pTopic, enum fota_image_type Type);
+static void FotaParser(const struct jsmn_context *ctx, const char *pTopic,
+		       enum fota_image_type Type);
 #endif
 #ifdef CONFIG_COAP_FOTA
-static void FotaHostParser(const char *pTopic);
-static void FotaBlockSizeParser(const char *pTopic);
+static void FotaHostParser(const struct jsmn_context *ctx, const char *pTopic);
+static void FotaBlockSizeParser(const struct jsmn_context *ctx,
+				const char *pTopic);
 #endif
 static void UnsubscribeToGetAcceptedHandler(void);
 
 #ifdef CONFIG_SENSOR_TASK
-static void GatewayParser(const char *pTopic);
-static void SensorParser(const char *pTopic);
-static void SensorDeltaParser(const char *pTopic);
-static void SensorEventLogParser(const char *pTopic);
-static void ParseEventArray(const char *pTopic);
-static void ParseArray(int ExpectedSensors);
+static void GatewayParser(const struct jsmn_context *ctx, const char *pTopic);
+static void SensorParser(const struct jsmn_context *ctx, const char *pTopic);
+static void SensorDeltaParser(const struct jsmn_context *ctx,
+			      const char *pTopic);
+static void SensorEventLogParser(const struct jsmn_context *ctx,
+				 const char *pTopic);
+static void ParseEventArray(const struct jsmn_context *ctx, const char *pTopic,
+			    int Index);
+static void ParseArray(const struct jsmn_context *ctx, int Index,
+		       int ExpectedSensors);
 #endif
 
 #if defined(CONFIG_SENSOR_TASK) || defined(CONFIG_BOARD_MG100)
-static int FindState(void);
-static bool FindUint(uint32_t *pVersion, const char *key);
+static int FindState(const struct jsmn_context *ctx);
+static bool FindUint(const struct jsmn_context *ctx, uint32_t *pVersion,
+		     const char *key);
 #endif
 
 #ifdef CONFIG_BOARD_MG100
-static void MiniGatewayParser(const char *pTopic);
+static void MiniGatewayParser(const struct jsmn_context *ctx,
+			      const char *pTopic);
 static bool ValuesUpdated(uint16_t Value);
 static void BuildAndSendLocalConfigResponse(void);
 static void BuildAndSendLocalConfigNullResponse(void);
@@ -211,46 +219,51 @@ static void BuildAndSendLocalConfigNullResponse(void);
 /******************************************************************************/
 void SensorGatewayParser(const char *pTopic, const char *pJson)
 {
-	jsmn_start(pJson);
-	if (!jsmn_valid()) {
-		LOG_ERR("Unable to parse subscription %d", jsmn_tokens_found());
+	struct jsmn_context context;
+	const struct jsmn_context *ctx = &context;
+
+	jsmn_start(&context, pJson);
+	if (!jsmn_valid(ctx)) {
+		LOG_ERR("Unable to parse subscription %d",
+			jsmn_tokens_found(ctx));
+		jsmn_end(&context);
 		return;
 	}
 
 	getAcceptedTopic = strstr(pTopic, GET_ACCEPTED_SUB_STR) != NULL;
 	if (strstr(pTopic, GATEWAY_TOPIC_SUB_STR) != NULL) {
 #ifdef CONFIG_SENSOR_TASK
-		GatewayParser(pTopic);
+		GatewayParser(ctx, pTopic);
 #endif
 
 #ifdef CONFIG_BOARD_MG100
-		MiniGatewayParser(pTopic);
+		MiniGatewayParser(ctx, pTopic);
 #endif
 
 #if defined(CONFIG_COAP_FOTA) || defined(CONFIG_HTTP_FOTA)
-		FotaParser(pTopic, APP_IMAGE_TYPE);
+		FotaParser(ctx, pTopic, APP_IMAGE_TYPE);
 		if (IS_ENABLED(CONFIG_MODEM_HL7800)) {
-			FotaParser(pTopic, MODEM_IMAGE_TYPE);
+			FotaParser(ctx, pTopic, MODEM_IMAGE_TYPE);
 		}
 #endif
 
 #ifdef CONFIG_COAP_FOTA
-		FotaHostParser(pTopic);
-		FotaBlockSizeParser(pTopic);
+		FotaHostParser(ctx, pTopic);
+		FotaBlockSizeParser(ctx, pTopic);
 #endif
 
 #ifdef CONFIG_CONTACT_TRACING
-		rpc_params_gateway_parser(getAcceptedTopic);
+		rpc_params_gateway_parser(ctx, getAcceptedTopic);
 #endif
 
 		UnsubscribeToGetAcceptedHandler();
 	} else {
 #ifdef CONFIG_SENSOR_TASK
-		SensorParser(pTopic);
+		SensorParser(ctx, pTopic);
 #endif
 	}
 
-	jsmn_end();
+	jsmn_end(&context);
 }
 
 /******************************************************************************/
@@ -336,7 +349,8 @@ static bool ValuesUpdated(uint16_t Value)
 	return ((Value & local_updates) == Value);
 }
 
-static void MiniGatewayParser(const char *pTopic)
+static void MiniGatewayParser(const struct jsmn_context *ctx,
+			      const char *pTopic)
 {
 	ARG_UNUSED(pTopic);
 	int objectData = 0;
@@ -346,8 +360,8 @@ static void MiniGatewayParser(const char *pTopic)
 	uint32_t version = 0;
 
 	/* Now try to find the desired local state for the gateway */
-	if (getAcceptedTopic || (FindState() <= 0) ||
-	    !FindUint(&version, "version")) {
+	if (getAcceptedTopic || (FindState(ctx) <= 0) ||
+	    !FindUint(ctx, &version, "version")) {
 		return;
 	}
 
@@ -357,7 +371,8 @@ static void MiniGatewayParser(const char *pTopic)
 	 */
 	local_updates = 0;
 	do {
-		if (FindUint(&objectData, WriteableLocalObject[objectIndex])) {
+		if (FindUint(ctx, &objectData,
+			     WriteableLocalObject[objectIndex])) {
 			/* flag values that have update requests */
 			local_updates |= LocalConfigUpdateBits[objectIndex];
 			/* execute the local updates */
@@ -397,23 +412,26 @@ static void MiniGatewayParser(const char *pTopic)
  * that it isn't repeatedly sent to the gateway.
  */
 #ifdef CONFIG_SENSOR_TASK
-static void GatewayParser(const char *pTopic)
+static void GatewayParser(const struct jsmn_context *ctx, const char *pTopic)
 {
-	jsmn_reset_index();
+	struct jsmn_cursor cursor;
+
+	jsmn_reset_index(&cursor);
 
 	/* Now try to find {"state": {"bt510": {"sensors": */
-	jsmn_find_type("state", JSMN_OBJECT, NEXT_PARENT);
+	jsmn_find_type(ctx, &cursor, "state", JSMN_OBJECT, NEXT_PARENT);
 	if (getAcceptedTopic) {
 		/* Add to heirarchy {"state":{"reported": ... */
-		jsmn_find_type("reported", JSMN_OBJECT, NEXT_PARENT);
+		jsmn_find_type(ctx, &cursor, "reported", JSMN_OBJECT,
+			       NEXT_PARENT);
 	}
-	jsmn_find_type("bt510", JSMN_OBJECT, NEXT_PARENT);
-	jsmn_find_type("sensors", JSMN_ARRAY, NEXT_PARENT);
+	jsmn_find_type(ctx, &cursor, "bt510", JSMN_OBJECT, NEXT_PARENT);
+	jsmn_find_type(ctx, &cursor, "sensors", JSMN_ARRAY, NEXT_PARENT);
 
-	if (jsmn_index() > 0) {
+	if (jsmn_index(&cursor) > 0) {
 		/* Backup one token to get the number of arrays (sensors). */
-		int expectedSensors = jsmn_size(jsmn_index() - 1);
-		ParseArray(expectedSensors);
+		int expectedSensors = jsmn_size(ctx, jsmn_index(&cursor) - 1);
+		ParseArray(ctx, jsmn_index(&cursor), expectedSensors);
 	} else {
 		LOG_DBG("Did not find sensor array");
 		/* It is okay for the list to be empty or non-existant.
@@ -434,18 +452,22 @@ static void UnsubscribeToGetAcceptedHandler(void)
 }
 
 #if defined(CONFIG_COAP_FOTA) || defined(CONFIG_HTTP_FOTA)
-static void FotaParser(const char *pTopic, enum fota_image_type Type)
+static void FotaParser(const struct jsmn_context *ctx, const char *pTopic,
+		       enum fota_image_type Type)
 {
+	struct jsmn_cursor cursor;
+	struct jsmn_cursor saved;
 	UNUSED_PARAMETER(pTopic);
 	const char *img_name;
 	int location = 0;
 
-	jsmn_reset_index();
+	jsmn_reset_index(&cursor);
 
 	/* Try to find "state":{"app":{"desired":"2.1.0","switchover":10}} */
-	jsmn_find_type("state", JSMN_OBJECT, NEXT_PARENT);
+	jsmn_find_type(ctx, &cursor, "state", JSMN_OBJECT, NEXT_PARENT);
 	if (getAcceptedTopic) {
-		jsmn_find_type("reported", JSMN_OBJECT, NEXT_PARENT);
+		jsmn_find_type(ctx, &cursor, "reported", JSMN_OBJECT,
+			       NEXT_PARENT);
 	}
 
 #ifdef CONFIG_COAP_FOTA
@@ -454,95 +476,104 @@ static void FotaParser(const char *pTopic, enum fota_image_type Type)
 	img_name = http_fota_get_image_name(Type);
 #endif
 
-	jsmn_find_type(img_name, JSMN_OBJECT, NEXT_PARENT);
+	jsmn_find_type(ctx, &cursor, img_name, JSMN_OBJECT, NEXT_PARENT);
 
-	if (jsmn_index() > 0) {
-		jsmn_save_index();
+	if (jsmn_index(&cursor) > 0) {
+		saved = cursor;
 
-		location = jsmn_find_type(SHADOW_FOTA_DESIRED_STR, JSMN_STRING,
-					  NEXT_PARENT);
+		location = jsmn_find_type(ctx, &cursor, SHADOW_FOTA_DESIRED_STR,
+					  JSMN_STRING, NEXT_PARENT);
 		if (location > 0) {
 #ifdef CONFIG_COAP_FOTA
-			coap_fota_set_desired_version(Type,
-						      jsmn_string(location),
-						      jsmn_strlen(location));
+			coap_fota_set_desired_version(
+				Type, jsmn_string(ctx, location),
+				jsmn_strlen(ctx, location));
 #else
-			http_fota_set_desired_version(Type,
-						      jsmn_string(location),
-						      jsmn_strlen(location));
+			http_fota_set_desired_version(
+				Type, jsmn_string(ctx, location),
+				jsmn_strlen(ctx, location));
 #endif
 		}
 
-		jsmn_restore_index();
+		cursor = saved;
 #ifdef CONFIG_COAP_FOTA
-		location = jsmn_find_type(SHADOW_FOTA_DESIRED_FILENAME_STR,
+		location = jsmn_find_type(ctx, &cursor,
+					  SHADOW_FOTA_DESIRED_FILENAME_STR,
 					  JSMN_STRING, NEXT_PARENT);
 		if (location > 0) {
-			coap_fota_set_desired_filename(Type,
-						       jsmn_string(location),
-						       jsmn_strlen(location));
+			coap_fota_set_desired_filename(
+				Type, jsmn_string(ctx, location),
+				jsmn_strlen(ctx, location));
 		}
 #else
-		location = jsmn_find_type(SHADOW_FOTA_DOWNLOAD_HOST_STR,
+		location = jsmn_find_type(ctx, &cursor,
+					  SHADOW_FOTA_DOWNLOAD_HOST_STR,
 					  JSMN_STRING, NEXT_PARENT);
 		if (location > 0) {
-			http_fota_set_download_host(Type, jsmn_string(location),
-						    jsmn_strlen(location));
+			http_fota_set_download_host(Type,
+						    jsmn_string(ctx, location),
+						    jsmn_strlen(ctx, location));
 		}
 
-		jsmn_restore_index();
-		location = jsmn_find_type(SHADOW_FOTA_DOWNLOAD_FILE_STR,
+		cursor = saved;
+		location = jsmn_find_type(ctx, &cursor,
+					  SHADOW_FOTA_DOWNLOAD_FILE_STR,
 					  JSMN_STRING, NEXT_PARENT);
 		if (location > 0) {
-			http_fota_set_download_file(Type, jsmn_string(location),
-						    jsmn_strlen(location));
+			http_fota_set_download_file(Type,
+						    jsmn_string(ctx, location),
+						    jsmn_strlen(ctx, location));
 		}
 
-		jsmn_restore_index();
-		location = jsmn_find_type(SHADOW_FOTA_HASH_STR, JSMN_STRING,
-					  NEXT_PARENT);
+		cursor = saved;
+		location = jsmn_find_type(ctx, &cursor, SHADOW_FOTA_HASH_STR,
+					  JSMN_STRING, NEXT_PARENT);
 		if (location > 0) {
-			http_fota_set_hash(Type, jsmn_string(location),
-					   jsmn_strlen(location));
+			http_fota_set_hash(Type, jsmn_string(ctx, location),
+					   jsmn_strlen(ctx, location));
 		}
 #endif
 
-		jsmn_restore_index();
-		location = jsmn_find_type(SHADOW_FOTA_SWITCHOVER_STR,
+		cursor = saved;
+		location = jsmn_find_type(ctx, &cursor,
+					  SHADOW_FOTA_SWITCHOVER_STR,
 					  JSMN_PRIMITIVE, NEXT_PARENT);
 		if (location > 0) {
 #ifdef CONFIG_COAP_FOTA
-			coap_fota_set_switchover(Type,
-						 jsmn_convert_uint(location));
+			coap_fota_set_switchover(
+				Type, jsmn_convert_uint(ctx, location));
 #else
-			http_fota_set_switchover(Type,
-						 jsmn_convert_uint(location));
+			http_fota_set_switchover(
+				Type, jsmn_convert_uint(ctx, location));
 #endif
 		}
 
-		jsmn_restore_index();
-		location = jsmn_find_type(SHADOW_FOTA_START_STR, JSMN_PRIMITIVE,
-					  NEXT_PARENT);
+		cursor = saved;
+		location = jsmn_find_type(ctx, &cursor, SHADOW_FOTA_START_STR,
+					  JSMN_PRIMITIVE, NEXT_PARENT);
 		if (location > 0) {
 #ifdef CONFIG_COAP_FOTA
-			coap_fota_set_start(Type, jsmn_convert_uint(location));
+			coap_fota_set_start(Type,
+					    jsmn_convert_uint(ctx, location));
 #else
-			http_fota_set_start(Type, jsmn_convert_uint(location));
+			http_fota_set_start(Type,
+					    jsmn_convert_uint(ctx, location));
 #endif
 		}
 
 		/* Don't overwrite error count when reading shadow. */
 		if (!getAcceptedTopic) {
-			jsmn_restore_index();
-			location = jsmn_find_type(SHADOW_FOTA_ERROR_STR,
+			cursor = saved;
+			location = jsmn_find_type(ctx, &cursor,
+						  SHADOW_FOTA_ERROR_STR,
 						  JSMN_PRIMITIVE, NEXT_PARENT);
 			if (location > 0) {
 #ifdef CONFIG_COAP_FOTA
 				coap_fota_set_error_count(
-					Type, jsmn_convert_uint(location));
+					Type, jsmn_convert_uint(ctx, location));
 #else
 				http_fota_set_error_count(
-					Type, jsmn_convert_uint(location));
+					Type, jsmn_convert_uint(ctx, location));
 #endif
 			}
 		}
@@ -551,65 +582,71 @@ static void FotaParser(const char *pTopic, enum fota_image_type Type)
 #endif /* COAP || HTTP FOTA */
 
 #ifdef CONFIG_COAP_FOTA
-static void FotaHostParser(const char *pTopic)
+static void FotaHostParser(const struct jsmn_context *ctx, const char *pTopic)
 {
+	struct jsmn_cursor cursor;
 	UNUSED_PARAMETER(pTopic);
 
-	jsmn_reset_index();
+	jsmn_reset_index(&cursor);
 
 	/* Try to find "state":{"fwBridge":"something.com"}} */
-	jsmn_find_type("state", JSMN_OBJECT, NEXT_PARENT);
+	jsmn_find_type(ctx, &cursor, "state", JSMN_OBJECT, NEXT_PARENT);
 	if (getAcceptedTopic) {
-		jsmn_find_type("reported", JSMN_OBJECT, NEXT_PARENT);
+		jsmn_find_type(ctx, &cursor, "reported", JSMN_OBJECT,
+			       NEXT_PARENT);
 	}
-	int location = jsmn_find_type(SHADOW_FOTA_BRIDGE_STR, JSMN_STRING,
-				      NEXT_PARENT);
+	int location = jsmn_find_type(ctx, &cursor, SHADOW_FOTA_BRIDGE_STR,
+				      JSMN_STRING, NEXT_PARENT);
 	if (location > 0) {
-		coap_fota_set_host(jsmn_string(location),
-				   jsmn_strlen(location));
+		coap_fota_set_host(jsmn_string(ctx, location),
+				   jsmn_strlen(ctx, location));
 	}
 }
 
-static void FotaBlockSizeParser(const char *pTopic)
+static void FotaBlockSizeParser(const struct jsmn_context *ctx,
+				const char *pTopic)
 {
+	struct jsmn_cursor cursor;
 	UNUSED_PARAMETER(pTopic);
 	int location;
 
-	jsmn_reset_index();
+	jsmn_reset_index(&cursor);
 
-	jsmn_find_type("state", JSMN_OBJECT, NEXT_PARENT);
+	jsmn_find_type(ctx, &cursor, "state", JSMN_OBJECT, NEXT_PARENT);
 	if (getAcceptedTopic) {
-		jsmn_find_type("reported", JSMN_OBJECT, NEXT_PARENT);
+		jsmn_find_type(ctx, &cursor, "reported", JSMN_OBJECT,
+			       NEXT_PARENT);
 	}
 
-	location = jsmn_find_type(SHADOW_FOTA_BLOCKSIZE_STR, JSMN_PRIMITIVE,
-				  NEXT_PARENT);
+	location = jsmn_find_type(ctx, &cursor, SHADOW_FOTA_BLOCKSIZE_STR,
+				  JSMN_PRIMITIVE, NEXT_PARENT);
 	if (location > 0) {
-		coap_fota_set_blocksize(jsmn_convert_uint(location));
+		coap_fota_set_blocksize(jsmn_convert_uint(ctx, location));
 	}
 }
 #endif /* CONFIG_COAP_FOTA */
 
 #ifdef CONFIG_SENSOR_TASK
-static void SensorParser(const char *pTopic)
+static void SensorParser(const struct jsmn_context *ctx, const char *pTopic)
 {
 	if (getAcceptedTopic) {
-		SensorEventLogParser(pTopic);
+		SensorEventLogParser(ctx, pTopic);
 	} else {
-		SensorDeltaParser(pTopic);
+		SensorDeltaParser(ctx, pTopic);
 	}
 }
 
-static void SensorDeltaParser(const char *pTopic)
+static void SensorDeltaParser(const struct jsmn_context *ctx,
+			      const char *pTopic)
 {
 	uint32_t version = 0;
-	int stateIndex = FindState();
-	if (!FindUint(&version, "configVersion") || stateIndex <= 0) {
+	int stateIndex = FindState(ctx);
+	if (!FindUint(ctx, &version, "configVersion") || stateIndex <= 0) {
 		return;
 	}
 
 	/* The state object contains a string of the values that need to be set. */
-	size_t stateLength = jsmn_strlen(stateIndex);
+	size_t stateLength = jsmn_strlen(ctx, stateIndex);
 	size_t bufSize = stateLength + strlen(SENSOR_CMD_SET_PREFIX) +
 			 strlen(SENSOR_CMD_SUFFIX) + 1;
 
@@ -633,26 +670,31 @@ static void SensorDeltaParser(const char *pTopic)
 		/* Format AWS data into a JSON-RPC set command */
 		strcat(pMsg->cmd, SENSOR_CMD_SET_PREFIX);
 		/* JSON string isn't null terminated */
-		strncat(pMsg->cmd, jsmn_string(stateIndex), stateLength);
+		strncat(pMsg->cmd, jsmn_string(ctx, stateIndex), stateLength);
 		strcat(pMsg->cmd, SENSOR_CMD_SUFFIX);
 		FRAMEWORK_DEBUG_ASSERT(strlen(pMsg->cmd) == bufSize - 1);
 		FRAMEWORK_MSG_SEND(pMsg);
 	}
 }
 
-static void SensorEventLogParser(const char *pTopic)
+static void SensorEventLogParser(const struct jsmn_context *ctx,
+				 const char *pTopic)
 {
-	jsmn_reset_index();
+	struct jsmn_cursor cursor;
+
+	jsmn_reset_index(&cursor);
 
 	/* Now try to find {"state":{"reported": ... "eventLog":
 	 * Parents are required because shadow contains timestamps
 	 * ("eventLog" wont be unique).
 	 */
-	(void)jsmn_find_type("state", JSMN_OBJECT, NEXT_PARENT);
-	(void)jsmn_find_type("reported", JSMN_OBJECT, NEXT_PARENT);
-	(void)jsmn_find_type("eventLog", JSMN_ARRAY, NEXT_PARENT);
+	(void)jsmn_find_type(ctx, &cursor, "state", JSMN_OBJECT, NEXT_PARENT);
+	(void)jsmn_find_type(ctx, &cursor, "reported", JSMN_OBJECT,
+			     NEXT_PARENT);
+	(void)jsmn_find_type(ctx, &cursor, "eventLog", JSMN_ARRAY,
+			     NEXT_PARENT);
 
-	ParseEventArray(pTopic);
+	ParseEventArray(ctx, pTopic, jsmn_index(&cursor));
 }
 
 /**
@@ -661,9 +703,10 @@ static void SensorEventLogParser(const char *pTopic)
  * ["addrString", epoch, greenlist (boolean)]
  * The epoch isn't used.
  */
-static void ParseArray(int ExpectedSensors)
+static void ParseArray(const struct jsmn_context *ctx, int Index,
+		       int ExpectedSensors)
 {
-	if (jsmn_index() <= 0) {
+	if (Index <= 0) {
 		return;
 	}
 
@@ -675,27 +718,32 @@ static void ParseArray(int ExpectedSensors)
 
 	size_t maxSensors = MIN(ExpectedSensors, CONFIG_SENSOR_TABLE_SIZE);
 	int sensorsFound = 0;
-	size_t i = jsmn_index();
-	while (((i + CHILD_ARRAY_SIZE) < jsmn_tokens_found()) &&
+	size_t i = Index;
+	while (((i + CHILD_ARRAY_SIZE) < jsmn_tokens_found(ctx)) &&
 	       (sensorsFound < maxSensors)) {
-		int addrLength = jsmn_strlen(i);
-		if ((jsmn_type(i + CHILD_ARRAY_INDEX) == JSMN_ARRAY) &&
-		    (jsmn_size(i + CHILD_ARRAY_INDEX) == CHILD_ARRAY_SIZE) &&
-		    (jsmn_type(i + ARRAY_NAME_INDEX) == JSMN_STRING) &&
-		    (jsmn_size(i + ARRAY_NAME_INDEX) == JSMN_NO_CHILDREN) &&
-		    (jsmn_type(i + ARRAY_EPOCH_INDEX) == JSMN_PRIMITIVE) &&
-		    (jsmn_size(i + ARRAY_EPOCH_INDEX) == JSMN_NO_CHILDREN) &&
-		    (jsmn_type(i + ARRAY_WLIST_INDEX) == JSMN_PRIMITIVE) &&
-		    (jsmn_size(i + ARRAY_WLIST_INDEX) == JSMN_NO_CHILDREN)) {
+		int addrLength = jsmn_strlen(ctx, i);
+		if ((jsmn_type(ctx, i + CHILD_ARRAY_INDEX) == JSMN_ARRAY) &&
+		    (jsmn_size(ctx, i + CHILD_ARRAY_INDEX) ==
+		     CHILD_ARRAY_SIZE) &&
+		    (jsmn_type(ctx, i + ARRAY_NAME_INDEX) == JSMN_STRING) &&
+		    (jsmn_size(ctx, i + ARRAY_NAME_INDEX) ==
+		     JSMN_NO_CHILDREN) &&
+		    (jsmn_type(ctx, i + ARRAY_EPOCH_INDEX) == JSMN_PRIMITIVE) &&
+		    (jsmn_size(ctx, i + ARRAY_EPOCH_INDEX) ==
+		     JSMN_NO_CHILDREN) &&
+		    (jsmn_type(ctx, i + ARRAY_WLIST_INDEX) == JSMN_PRIMITIVE) &&
+		    (jsmn_size(ctx, i + ARRAY_WLIST_INDEX) ==
+		     JSMN_NO_CHILDREN)) {
 			LOG_DBG("Found array at %d", i);
 			strncpy(pMsg->sensors[sensorsFound].addrString,
-				jsmn_string(i + ARRAY_NAME_INDEX),
+				jsmn_string(ctx, i + ARRAY_NAME_INDEX),
 				MIN(addrLength, SENSOR_ADDR_STR_LEN));
 			/* The 't' in true is used to determine true/false.
 			 * This is safe because primitives are
 			 * numbers, true, false, and null. */
 			pMsg->sensors[sensorsFound].greenlist =
-				(jsmn_string(i + ARRAY_WLIST_INDEX)[0] == 't');
+				(jsmn_string(ctx, i + ARRAY_WLIST_INDEX)[0] ==
+				 't');
 			sensorsFound += 1;
 			i += CHILD_ARRAY_SIZE + 1;
 		} else {
@@ -713,7 +761,8 @@ static void ParseArray(int ExpectedSensors)
 		sensorsFound, ExpectedSensors);
 }
 
-static void ParseEventArray(const char *pTopic)
+static void ParseEventArray(const struct jsmn_context *ctx, const char *pTopic,
+			    int Index)
 {
 	SensorShadowInitMsg_t *pMsg =
 		BP_TRY_TO_TAKE(sizeof(SensorShadowInitMsg_t));
@@ -722,34 +771,39 @@ static void ParseEventArray(const char *pTopic)
 	}
 
 	/* If the event log isn't found a message still needs to be sent. */
-	int expectedLogs = jsmn_size(jsmn_index() - 1);
+	int expectedLogs = 0;
 	int maxLogs = 0;
-	if (jsmn_index() <= 0) {
+	if (Index <= 0) {
 		LOG_DBG("Could not find event log");
 	} else {
+		expectedLogs = jsmn_size(ctx, Index - 1);
 		maxLogs = MIN(expectedLogs, CONFIG_SENSOR_LOG_MAX_SIZE);
 	}
 
 	/* 1st and 3rd items are hex. {"eventLog":[["01",466280,"0899"]] */
-	size_t i = jsmn_index();
+	size_t i = Index;
 	size_t j = 0;
-	while (((i + CHILD_ARRAY_SIZE) < jsmn_tokens_found()) &&
+	while (((i + CHILD_ARRAY_SIZE) < jsmn_tokens_found(ctx)) &&
 	       (j < maxLogs)) {
-		if ((jsmn_type(i + CHILD_ARRAY_INDEX) == JSMN_ARRAY) &&
-		    (jsmn_size(i + CHILD_ARRAY_INDEX) == CHILD_ARRAY_SIZE) &&
-		    (jsmn_type(i + RECORD_TYPE_INDEX) == JSMN_STRING) &&
-		    (jsmn_size(i + RECORD_TYPE_INDEX) == JSMN_NO_CHILDREN) &&
-		    (jsmn_type(i + ARRAY_EPOCH_INDEX) == JSMN_PRIMITIVE) &&
-		    (jsmn_size(i + ARRAY_EPOCH_INDEX) == JSMN_NO_CHILDREN) &&
-		    (jsmn_type(i + EVENT_DATA_INDEX) == JSMN_STRING) &&
-		    (jsmn_size(i + EVENT_DATA_INDEX) == JSMN_NO_CHILDREN)) {
+		if ((jsmn_type(ctx, i + CHILD_ARRAY_INDEX) == JSMN_ARRAY) &&
+		    (jsmn_size(ctx, i + CHILD_ARRAY_INDEX) ==
+		     CHILD_ARRAY_SIZE) &&
+		    (jsmn_type(ctx, i + RECORD_TYPE_INDEX) == JSMN_STRING) &&
+		    (jsmn_size(ctx, i + RECORD_TYPE_INDEX) ==
+		     JSMN_NO_CHILDREN) &&
+		    (jsmn_type(ctx, i + ARRAY_EPOCH_INDEX) == JSMN_PRIMITIVE) &&
+		    (jsmn_size(ctx, i + ARRAY_EPOCH_INDEX) ==
+		     JSMN_NO_CHILDREN) &&
+		    (jsmn_type(ctx, i + EVENT_DATA_INDEX) == JSMN_STRING) &&
+		    (jsmn_size(ctx, i + EVENT_DATA_INDEX) ==
+		     JSMN_NO_CHILDREN)) {
 			LOG_DBG("Found array at %d", i);
 			pMsg->events[j].recordType =
-				jsmn_convert_hex(i + RECORD_TYPE_INDEX);
+				jsmn_convert_hex(ctx, i + RECORD_TYPE_INDEX);
 			pMsg->events[j].epoch =
-				jsmn_convert_uint(i + ARRAY_EPOCH_INDEX);
+				jsmn_convert_uint(ctx, i + ARRAY_EPOCH_INDEX);
 			pMsg->events[j].data =
-				jsmn_convert_hex(i + EVENT_DATA_INDEX);
+				jsmn_convert_hex(ctx, i + EVENT_DATA_INDEX);
 			LOG_DBG("%u %x,%d,%x", j, pMsg->events[j].recordType,
 				pMsg->events[j].epoch, pMsg->events[j].data);
 			j += 1;
@@ -777,10 +831,12 @@ static void ParseEventArray(const char *pTopic)
  *
  * @retval index of state
  */
-static int FindState(void)
+static int FindState(const struct jsmn_context *ctx)
 {
-	jsmn_reset_index();
-	return jsmn_find_type("state", JSMN_OBJECT, NO_PARENT);
+	struct jsmn_cursor cursor;
+
+	jsmn_reset_index(&cursor);
+	return jsmn_find_type(ctx, &cursor, "state", JSMN_OBJECT, NO_PARENT);
 }
 
 /**
@@ -791,12 +847,16 @@ static int FindState(void)
  *
  * @note sets jsonIndex to 1
  */
-static bool FindUint(uint32_t *pValue, const char *key)
+static bool FindUint(const struct jsmn_context *ctx, uint32_t *pValue,
+		     const char *key)
 {
-	jsmn_reset_index();
-	int location = jsmn_find_type(key, JSMN_PRIMITIVE, NO_PARENT);
+	struct jsmn_cursor cursor;
+
+	jsmn_reset_index(&cursor);
+	int location = jsmn_find_type(ctx, &cursor, key, JSMN_PRIMITIVE,
+				      NO_PARENT);
 	if (location > 0) {
-		*pValue = jsmn_convert_uint(location);
+		*pValue = jsmn_convert_uint(ctx, location);
 		return true;
 	} else {
 		*pValue = 0;
@@ -26,6 +26,15 @@ struct SensorLog {
 	size_t writeIndex;
 	bool wrapped;
 	SensorLogEvent_t *pData;
+#ifdef CONFIG_SENSOR_LOG_JSON_CACHE
+	/* Ring buffer of serialized entries (oldest first) */
+	char *pJson;
+	size_t jsonSize;
+	size_t jsonStart;
+	size_t jsonLength;
+	/* Serialized length of each entry in pData */
+	uint8_t *pJsonEntryLength;
+#endif
 };
 
 /******************************************************************************/
@@ -34,6 +43,12 @@ struct SensorLog {
 static size_t GetNumberOfEntries(SensorLog_t *pLog);
 static void IncrementIndices(SensorLog_t *pLog);
 static void IncrementIndex(size_t *pIndex, size_t Max);
+static size_t GetNewestIndex(SensorLog_t *pLog, size_t Count);
+
+#ifdef CONFIG_SENSOR_LOG_JSON_CACHE
+static void CacheAdd(SensorLog_t *pLog, SensorLogEvent_t *pEvent);
+static size_t CacheLength(SensorLog_t *pLog, size_t Count);
+#endif
 
 /******************************************************************************/
 /* Global Function Definitions                                                */
@@ -50,12 +65,23 @@ SensorLog_t *SensorLog_Allocate(size_t Size)
 		size_t bytes = Size * sizeof(SensorLogEvent_t);
 		p->pData = k_malloc(bytes);
 		memset(p->pData, 0, bytes);
+#ifdef CONFIG_SENSOR_LOG_JSON_CACHE
+		p->jsonSize = Size * SENSOR_LOG_ENTRY_JSON_STR_SIZE;
+		p->jsonStart = 0;
+		p->jsonLength = 0;
+		p->pJson = k_malloc(p->jsonSize);
+		p->pJsonEntryLength = k_calloc(Size, sizeof(uint8_t));
+#endif
 	}
 	return p;
 }
 
 void SensorLog_Free(SensorLog_t *pLog)
 {
+#ifdef CONFIG_SENSOR_LOG_JSON_CACHE
+	k_free(pLog->pJsonEntryLength);
+	k_free(pLog->pJson);
+#endif
 	k_free(pLog->pData);
 	k_free(pLog);
 }
@@ -66,33 +92,74 @@ void SensorLog_Add(SensorLog_t *pLog, SensorLogEvent_t *pEvent)
 		return;
 	}
 
+#ifdef CONFIG_SENSOR_LOG_JSON_CACHE
+	CacheAdd(pLog, pEvent);
+#endif
 	memcpy(&pLog->pData[pLog->writeIndex], pEvent,
 	       sizeof(SensorLogEvent_t));
 	IncrementIndices(pLog);
 }
 
 void SensorLog_GenerateJson(SensorLog_t *pLog, JsonMsg_t *pMsg)
+{
+	SensorLog_GenerateJsonNewest(pLog, pMsg, SIZE_MAX);
+}
+
+void SensorLog_GenerateJsonNewest(SensorLog_t *pLog, JsonMsg_t *pMsg,
+				  size_t Count)
 {
 	if (pLog == NULL) {
 		return;
 	}
 
-	size_t entries = GetNumberOfEntries(pLog);
+	size_t entries = MIN(GetNumberOfEntries(pLog), Count);
 	LOG_DBG("Sensor Log has %d entries", entries);
 	if (entries == 0) {
 		return;
 	}
 
 	ShadowBuilder_StartArray(pMsg, "eventLog");
-	size_t readIndex = pLog->wrapped ? pLog->writeIndex : 0;
+#ifdef CONFIG_SENSOR_LOG_JSON_CACHE
+	/* The entries are already serialized; at most two copies are
+	 * required because the cache is a ring buffer.
+	 */
+	size_t length = CacheLength(pLog, entries);
+	size_t start = (pLog->jsonStart + pLog->jsonLength - length) %
+		       pLog->jsonSize;
+	size_t first = MIN(length, pLog->jsonSize - start);
+	ShadowBuilder_AddRaw(pMsg, &pLog->pJson[start], first);
+	if (first < length) {
+		ShadowBuilder_AddRaw(pMsg, pLog->pJson, length - first);
+	}
+#else
+	size_t readIndex = GetNewestIndex(pLog, entries);
 	size_t i;
 	for (i = 0; i < entries; i++) {
 		ShadowBuilder_AddEventLogEntry(pMsg, &pLog->pData[readIndex]);
 		IncrementIndex(&readIndex, pLog->size);
 	}
+#endif
 	ShadowBuilder_EndArray(pMsg);
 }
 
+size_t SensorLog_GetJsonSize(SensorLog_t *pLog, size_t Count)
+{
+	if (pLog == NULL) {
+		return 0;
+	}
+
+	size_t entries = MIN(GetNumberOfEntries(pLog), Count);
+	if (entries == 0) {
+		return 0;
+	}
+#ifdef CONFIG_SENSOR_LOG_JSON_CACHE
+	return SENSOR_LOG_JSON_OVERHEAD_SIZE + CacheLength(pLog, entries);
+#else
+	return SENSOR_LOG_JSON_OVERHEAD_SIZE +
+	       (entries * SENSOR_LOG_ENTRY_JSON_STR_SIZE);
+#endif
+}
+
 size_t SensorLog_GetSize(SensorLog_t *pLog)
 {
 	return (pLog == NULL) ? 0 : pLog->size;
@@ -121,3 +188,47 @@ static void IncrementIndex(size_t *pIndex, size_t Max)
 		*pIndex = 0;
 	}
 }
+
+/* Index of the oldest of the Count most recent entries */
+static size_t GetNewestIndex(SensorLog_t *pLog, size_t Count)
+{
+	return (pLog->writeIndex + pLog->size - Count) % pLog->size;
+}
+
+#ifdef CONFIG_SENSOR_LOG_JSON_CACHE
+/* Drop the oldest entry (head) when full and append the new one (tail). */
+static void CacheAdd(SensorLog_t *pLog, SensorLogEvent_t *pEvent)
+{
+	if (pLog->wrapped) {
+		size_t oldest = pLog->pJsonEntryLength[pLog->writeIndex];
+		pLog->jsonStart = (pLog->jsonStart + oldest) % pLog->jsonSize;
+		pLog->jsonLength -= oldest;
+	}
+
+	char entry[SENSOR_LOG_ENTRY_JSON_STR_SIZE];
+	size_t length = ShadowBuilder_FormatEventLogEntry(entry, pEvent);
+	size_t end = (pLog->jsonStart + pLog->jsonLength) % pLog->jsonSize;
+	size_t first = MIN(length, pLog->jsonSize - end);
+	memcpy(&pLog->pJson[end], entry, first);
+	memcpy(pLog->pJson, &entry[first], length - first);
+
+	pLog->pJsonEntryLength[pLog->writeIndex] = (uint8_t)length;
+	pLog->jsonLength += length;
+}
+
+/* Serialized length of the Count most recent entries */
+static size_t CacheLength(SensorLog_t *pLog, size_t Count)
+{
+	if (Count >= GetNumberOfEntries(pLog)) {
+		return pLog->jsonLength;
+	}
+
+	size_t length = 0;
+	size_t i = GetNewestIndex(pLog, Count);
+	while (Count--) {
+		length += pLog->pJsonEntryLength[i];
+		IncrementIndex(&i, pLog->size);
+	}
+	return length;
+}
+#endif
@@ -76,7 +76,7 @@ BUILD_ASSERT(CONFIG_SENSOR_GREENLIST_SIZE < CONFIG_SENSOR_TABLE_SIZE,
 #define GET_ACCEPTED_MSG "{\"message\":\"hi\"}"
 
 #define SHADOW_BUF_SIZE                                                        \
-	(JSON_DEFAULT_BUF_SIZE +                                               \
+	(JSON_DEFAULT_BUF_SIZE + SENSOR_LOG_JSON_OVERHEAD_SIZE +               \
 	 (CONFIG_SENSOR_LOG_MAX_SIZE * SENSOR_LOG_ENTRY_JSON_STR_SIZE))
 CHECK_BUFFER_SIZE(FWK_BUFFER_MSG_SIZE(JsonMsg_t, SHADOW_BUF_SIZE));
 
@@ -90,18 +90,44 @@ BUILD_ASSERT(((sizeof(SENSOR_SUBSCRIPTION_TOPIC_FMT_STR) +
 #define MANGLED_NAME_MAX_SIZE (MANGLED_NAME_MAX_STR_LEN + 1)
 
 /* {"reported":{"bt510":{"sensors":[["c13a7e4118a2",<epoch>,false], .... */
-#define SENSOR_GATEWAY_SHADOW_MAX_SIZE 600
+#define SENSOR_GATEWAY_SHADOW_ENTRY_SIZE 36
+#define SENSOR_GATEWAY_SHADOW_MAX_SIZE                                         \
+	MAX(600, (128 + (CONFIG_SENSOR_TABLE_SIZE *                            \
+			 SENSOR_GATEWAY_SHADOW_ENTRY_SIZE)))
 CHECK_BUFFER_SIZE(FWK_BUFFER_MSG_SIZE(JsonMsg_t,
 				      SENSOR_GATEWAY_SHADOW_MAX_SIZE));
 
+/* Reported fields that are only sent when they have changed. */
+enum ShadowField {
+	SHADOW_FIELD_BT_ADDR = 0,
+	SHADOW_FIELD_RSSI,
+	SHADOW_FIELD_NETWORK_ID,
+	SHADOW_FIELD_FLAGS,
+	SHADOW_FIELD_RESET_COUNT,
+	SHADOW_FIELD_TEMPERATURE,
+	SHADOW_FIELD_RSP,
+	SHADOW_FIELD_NAME,
+	SHADOW_FIELD_GATEWAY_ID,
+	SHADOW_FIELD_LOG_SIZE,
+	SHADOW_FIELD_LOG,
+	NUMBER_OF_SHADOW_FIELDS
+};
+BUILD_ASSERT(NUMBER_OF_SHADOW_FIELDS <= 32, "Too many shadow fields");
+
+#define SHADOW_FIELD(x) BIT(SHADOW_FIELD_##x)
+/* Temperature is only known after a temperature event has been received. */
+#define SHADOW_FIELDS_ALL                                                      \
+	((BIT(NUMBER_OF_SHADOW_FIELDS) - 1) & ~SHADOW_FIELD(TEMPERATURE))
+
 typedef struct SensorEntry {
 	bool inUse;
 	bool validAd;
 	bool validRsp;
-	bool updatedName;
-	bool updatedRsp;
+	uint32_t dirty;
 	char name[SENSOR_NAME_MAX_SIZE];
 	char addrString[SENSOR_ADDR_STR_SIZE];
+	/* Index key; the address in ad is overwritten by each advertisement */
+	bt_addr_t key;
 	LczSensorAdEvent_t ad;
 	LczSensorRsp_t rsp;
 	int8_t rssi;
@@ -122,12 +148,42 @@ typedef struct SensorEntry {
 	bool dumpBusy;
 	bool firstDumpComplete;
 	uint32_t adCount;
-	uint16_t lastFlags;
+	bool temperatureValid;
+	int32_t temperature;
+	size_t newLogEntries;
 	SensorLog_t *pLog;
 } SensorEntry_t;
 
 #define RSSI_UNKNOWN -127
 
+/* Open addressing (linear probing) is used to find sensors by address.
+ * The number of slots keeps the load factor below 0.5 so that
+ * probe sequences stay short and there is always an empty slot.
+ */
+#define SENSOR_INDEX_SLOTS ((2 * CONFIG_SENSOR_TABLE_SIZE) + 1)
+#define SENSOR_INDEX_EMPTY UINT16_MAX
+BUILD_ASSERT(CONFIG_SENSOR_TABLE_SIZE < SENSOR_INDEX_EMPTY,
+	     "Sensor table too large for index");
+
+typedef uint32_t (*IndexHashFunction_t)(size_t Index);
+
+typedef struct SensorIndex {
+	IndexHashFunction_t hash;
+	uint16_t slot[SENSOR_INDEX_SLOTS];
+} SensorIndex_t;
+
+#define SENSOR_TABLE_RAM_SIZE                                                  \
+	((CONFIG_SENSOR_TABLE_SIZE *                                           \
+	  (sizeof(SensorEntry_t) + sizeof(uint16_t))) +                        \
+	 (2 * sizeof(SensorIndex_t)))
+BUILD_ASSERT(SENSOR_TABLE_RAM_SIZE <= CONFIG_SENSOR_TABLE_RAM_MAX,
+	     "Sensor table exceeds SENSOR_TABLE_RAM_MAX");
+
+typedef bool (*IndexMatchFunction_t)(const void *pKey, size_t Index);
+
+#define FNV_OFFSET_BASIS 2166136261U
+#define FNV_PRIME 16777619U
+
 /******************************************************************************/
 /* Local Data Definitions                                                     */
 /******************************************************************************/
@@ -138,6 +194,16 @@ static uint64_t ttlUptime;
 static bool allowGatewayShadowGeneration;
 static size_t greenCount;
 
+static uint32_t AddrHash(size_t Index);
+static uint32_t AddrStringHash(size_t Index);
+
+static SensorIndex_t addrIndex = { .hash = AddrHash };
+static SensorIndex_t addrStringIndex = { .hash = AddrStringHash };
+
+/* Stack of unused table entries (lowest index on top after clear) */
+static uint16_t freeList[CONFIG_SENSOR_TABLE_SIZE];
+static size_t freeCount;
+
 /******************************************************************************/
 /* Local Function Prototypes                                                  */
 /******************************************************************************/
@@ -153,11 +219,12 @@ static size_t AddByAddress(const bt_addr_t *pAddr);
 static void AddEntry(SensorEntry_t *pEntry, const bt_addr_t *pAddr,
 		     int8_t Rssi);
 static size_t FindTableIndex(const bt_addr_le_t *pAddr);
+static size_t FindTableIndexByString(const char *pAddrString);
 static size_t FindFirstFree(void);
 static void AdEventHandler(LczSensorAdEvent_t *p, int8_t Rssi, uint32_t Index);
 
 static bool AddrMatch(const void *p, size_t Index);
-static bool AddrStringMatch(const char *str, size_t Index);
+static bool AddrStringMatch(const void *p, size_t Index);
 static bool NameMatch(const char *p, size_t Index);
 static bool RspMatch(const LczSensorRsp_t *p, size_t Index);
 static bool NewEvent(uint16_t Id, size_t Index);
@@ -173,7 +240,10 @@ static void ShadowBtHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry);
 static void ShadowAdHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry);
 static void ShadowRspHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry);
 static void ShadowFlagHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry);
-static void ShadowLogHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry);
+static size_t LogPublishCount(SensorEntry_t *pEntry);
+static void AddLogEvent(SensorEntry_t *pEntry);
+static void ShadowLogHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry,
+			     size_t Count);
 static void ShadowSpecialHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry);
 static void GatewayShadowMaker(bool GreenlistProcessed);
 
@@ -195,6 +265,20 @@ static void PublishToGetAccepted(SensorEntry_t *pEntry);
 
 static bool IsBt510(uint8_t productId);
 
+static void SetDirty(SensorEntry_t *pEntry, uint32_t Fields);
+static void SetAllDirty(SensorEntry_t *pEntry);
+static bool ConsumeDirty(SensorEntry_t *pEntry, uint32_t Field);
+static void UpdateAd(SensorEntry_t *pEntry, LczSensorAdEvent_t *p,
+		     int8_t Rssi);
+static bool IsTemperatureEvent(uint8_t RecordType);
+
+static uint32_t HashBytes(const void *p, size_t Length);
+static void IndexReset(SensorIndex_t *pIndex);
+static void IndexInsert(SensorIndex_t *pIndex, size_t Index);
+static void IndexRemove(SensorIndex_t *pIndex, size_t Index);
+static size_t IndexFind(SensorIndex_t *pIndex, uint32_t Hash,
+			IndexMatchFunction_t Match, const void *pKey);
+
 /******************************************************************************/
 /* Global Function Definitions                                                */
 /******************************************************************************/
@@ -249,7 +333,7 @@ void SensorTable_AdvertisementHandler(const bt_addr_le_t *pAddr, int8_t rssi,
 		size_t tableIndex = FindTableIndex(pAddr);
 		if (tableIndex < CONFIG_SENSOR_TABLE_SIZE) {
 			FRAMEWORK_DEBUG_ASSERT(
-				memcmp(sensorTable[tableIndex].ad.addr.val,
+				memcmp(sensorTable[tableIndex].key.val,
 				       pAddr->a.val, sizeof(bt_addr_t)) == 0);
 		}
 		/* Filtering out the BT610 requires using the product ID.
@@ -308,13 +392,7 @@ void SensorTable_ProcessGreenlistRequest(SensorGreenlistMsg_t *pMsg)
 
 DispatchResult_t SensorTable_AddConfigRequest(SensorCmdMsg_t *pMsg)
 {
-	size_t i;
-	for (i = 0; i < CONFIG_SENSOR_TABLE_SIZE; i++) {
-		if (AddrStringMatch(pMsg->addrString, i)) {
-			break;
-		}
-	}
-
+	size_t i = FindTableIndexByString(pMsg->addrString);
 	if (i >= CONFIG_SENSOR_TABLE_SIZE) {
 		LOG_ERR("Config request sensor not found");
 		return DISPATCH_ERROR;
@@ -457,6 +535,33 @@ void SensorTable_UnsubscribeAll(void)
 	for (i = 0; i < CONFIG_SENSOR_TABLE_SIZE; i++) {
 		sensorTable[i].subscribed = false;
 		sensorTable[i].getAcceptedSubscribed = false;
+		/* Publishes may have been lost */
+		SetAllDirty(&sensorTable[i]);
+	}
+}
+
+void SensorTable_RepublishHandler(const char *pTopic)
+{
+	char topic[CONFIG_AWS_TOPIC_MAX_SIZE];
+	size_t i;
+
+	/* The dirty fields were cleared when the update was built. */
+	for (i = 0; i < CONFIG_SENSOR_TABLE_SIZE; i++) {
+		if (sensorTable[i].inUse) {
+			snprintk(topic, sizeof(topic),
+				 SENSOR_UPDATE_TOPIC_FMT_STR,
+				 sensorTable[i].addrString);
+			if (strcmp(topic, pTopic) == 0) {
+				SetAllDirty(&sensorTable[i]);
+				return;
+			}
+		}
+	}
+
+	for (i = 0; i < CONFIG_SENSOR_TABLE_SIZE; i++) {
+		if (sensorTable[i].inUse) {
+			SetAllDirty(&sensorTable[i]);
+		}
 	}
 }
 
@@ -553,13 +658,7 @@ void SensorTable_InitShadowHandler(void)
 
 void SensorTable_ProcessShadowInitMsg(SensorShadowInitMsg_t *pMsg)
 {
-	size_t i;
-	for (i = 0; i < CONFIG_SENSOR_TABLE_SIZE; i++) {
-		if (AddrStringMatch(pMsg->addrString, i)) {
-			break;
-		}
-	}
-
+	size_t i = FindTableIndexByString(pMsg->addrString);
 	if (i >= CONFIG_SENSOR_TABLE_SIZE) {
 		LOG_ERR("Shadow Init sensor not found");
 		return;
@@ -567,6 +666,7 @@ void SensorTable_ProcessShadowInitMsg(SensorShadowInitMsg_t *pMsg)
 
 	SensorEntry_t *p = &sensorTable[i];
 	p->shadowInitReceived = true;
+	SetAllDirty(p);
 
 	/* To keep things simple, throw away the table. */
 	if (pMsg->eventCount > 0) {
@@ -619,9 +719,9 @@ void SensorTable_CreateShadowFromDumpResponse(FwkBufMsg_t *pRsp,
 	pMsg->size = size;
 
 	ShadowBuilder_Start(pMsg, SKIP_MEMSET);
-	ShadowBuilder_StartGroup(pMsg, "state");
+	ShadowBuilder_StartGroupKey(pMsg, SB_KEY("state"));
 	/* Clear desired because AWS gets all state information. */
-	ShadowBuilder_AddNull(pMsg, "desired");
+	ShadowBuilder_AddNullKey(pMsg, SB_KEY("desired"));
 	/* Add the entire response.  AWS app will ignore jsonrpc, id field,
 	 * and status fields.
 	 */
@@ -668,10 +768,29 @@ static void ClearTable(void)
 		ClearEntry(&sensorTable[i]);
 	}
 	tableCount = 0;
+
+	IndexReset(&addrIndex);
+	IndexReset(&addrStringIndex);
+	for (i = 0; i < CONFIG_SENSOR_TABLE_SIZE; i++) {
+		freeList[i] = CONFIG_SENSOR_TABLE_SIZE - 1 - i;
+	}
+	freeCount = CONFIG_SENSOR_TABLE_SIZE;
 }
 
 static void ClearEntry(SensorEntry_t *pEntry)
 {
+	size_t i = pEntry - sensorTable;
+
+	/* The entry must be removed from the indices before its
+	 * address is cleared because the hash is computed from the entry.
+	 */
+	if (pEntry->inUse) {
+		IndexRemove(&addrIndex, i);
+		IndexRemove(&addrStringIndex, i);
+		FRAMEWORK_DEBUG_ASSERT(freeCount < CONFIG_SENSOR_TABLE_SIZE);
+		freeList[freeCount++] = i;
+	}
+
 	FreeEntryBuffers(pEntry);
 	memset(pEntry, 0, sizeof(SensorEntry_t));
 }
@@ -705,11 +824,7 @@ static void AdEventHandler(LczSensorAdEvent_t *p, int8_t Rssi, uint32_t Index)
 	}
 
 	if (NewEvent(p->id, Index)) {
-		sensorTable[Index].validAd = true;
-		sensorTable[Index].lastRecordType =
-			sensorTable[Index].ad.recordType;
-		memcpy(&sensorTable[Index].ad, p, sizeof(LczSensorAdEvent_t));
-		sensorTable[Index].rssi = Rssi;
+		UpdateAd(&sensorTable[Index], p, Rssi);
 		/* If event occurs before epoch is set, then AWS shows ~1970. */
 		sensorTable[Index].rxEpoch = lcz_qrtc_get_epoch();
 		ShadowMaker(&sensorTable[Index]);
@@ -766,11 +881,11 @@ static size_t AddByScanResponse(const bt_addr_le_t *pAddr,
 	if ((pEntry != NULL) && (add || updateRsp || updateName)) {
 		pEntry->validRsp = true;
 		if (add || updateRsp) {
-			pEntry->updatedRsp = true;
+			SetDirty(pEntry, SHADOW_FIELD(RSP));
 			memcpy(&pEntry->rsp, pRsp, sizeof(LczSensorRsp_t));
 		}
 		if (add || updateName) {
-			pEntry->updatedName = true;
+			SetDirty(pEntry, SHADOW_FIELD(NAME));
 			memset(pEntry->name, 0, SENSOR_NAME_MAX_SIZE);
 			strncpy(pEntry->name, pNameHandle->pPayload,
 				MIN(SENSOR_NAME_MAX_STR_LEN,
@@ -794,17 +909,26 @@ static size_t AddByAddress(const bt_addr_t *pAddr)
 
 static void AddEntry(SensorEntry_t *pEntry, const bt_addr_t *pAddr, int8_t Rssi)
 {
+	size_t i = pEntry - sensorTable;
+	FRAMEWORK_DEBUG_ASSERT(freeCount > 0);
+	FRAMEWORK_DEBUG_ASSERT(freeList[freeCount - 1] == i);
+	freeCount -= 1;
+
 	tableCount += 1;
 	pEntry->ttl = CONFIG_SENSOR_TTL_SECONDS;
 	pEntry->inUse = true;
 	pEntry->rssi = Rssi;
+	SetAllDirty(pEntry);
 	memcpy(pEntry->ad.addr.val, pAddr->val, sizeof(bt_addr_t));
+	memcpy(pEntry->key.val, pAddr->val, sizeof(bt_addr_t));
 	/* The address is duplicated in the advertisement payload because
 	 * some operating systems don't provide the Bluetooth address to
 	 * the application.  The address is copied into the AD field
 	 * because the two formats are the same.
 	 */
 	SensorAddrToString(pEntry);
+	IndexInsert(&addrIndex, i);
+	IndexInsert(&addrStringIndex, i);
 	LOG_DBG("Added BT510 sensor %s '%s' RSSI: %d",
 		log_strdup(pEntry->addrString), log_strdup(pEntry->name),
 		pEntry->rssi);
@@ -814,37 +938,37 @@ static void AddEntry(SensorEntry_t *pEntry, const bt_addr_t *pAddr, int8_t Rssi)
 /* Find index of advertiser's address in the sensor table */
 static size_t FindTableIndex(const bt_addr_le_t *pAddr)
 {
-	size_t i;
-	for (i = 0; i < CONFIG_SENSOR_TABLE_SIZE; i++) {
-		if (sensorTable[i].inUse) {
-			if (AddrMatch(pAddr->a.val, i)) {
-				return i;
-			}
-		}
-	}
-	return CONFIG_SENSOR_TABLE_SIZE;
+	return IndexFind(&addrIndex,
+			 HashBytes(pAddr->a.val, sizeof(bt_addr_t)),
+			 AddrMatch, pAddr->a.val);
+}
+
+/* Find index of address string (from AWS) in the sensor table */
+static size_t FindTableIndexByString(const char *pAddrString)
+{
+	return IndexFind(&addrStringIndex,
+			 HashBytes(pAddrString,
+				   strnlen(pAddrString, SENSOR_ADDR_STR_LEN)),
+			 AddrStringMatch, pAddrString);
 }
 
 static size_t FindFirstFree(void)
 {
-	size_t i;
-	for (i = 0; i < CONFIG_SENSOR_TABLE_SIZE; i++) {
-		if (!sensorTable[i].inUse) {
-			return i;
-		}
+	if (freeCount > 0) {
+		return freeList[freeCount - 1];
+	} else {
+		return CONFIG_SENSOR_TABLE_SIZE;
 	}
-	return CONFIG_SENSOR_TABLE_SIZE;
 }
 
 static bool AddrMatch(const void *p, size_t Index)
 {
-	return (memcmp(p, sensorTable[Index].ad.addr.val, sizeof(bt_addr_t)) ==
-		0);
+	return (memcmp(p, sensorTable[Index].key.val, sizeof(bt_addr_t)) == 0);
 }
 
-static bool AddrStringMatch(const char *str, size_t Index)
+static bool AddrStringMatch(const void *p, size_t Index)
 {
-	return (strncmp(str, sensorTable[Index].addrString,
+	return (strncmp(p, sensorTable[Index].addrString,
 			SENSOR_ADDR_STR_LEN) == 0);
 }
 
@@ -880,19 +1004,36 @@ static void ShadowMaker(SensorEntry_t *pEntry)
 		}
 	}
 
-	JsonMsg_t *pMsg =
-		BP_TRY_TO_TAKE(FWK_BUFFER_MSG_SIZE(JsonMsg_t, SHADOW_BUF_SIZE));
+	/* The log is the only part of the shadow that varies significantly
+	 * in size, so the buffer is sized to what will be published.  The
+	 * event is added after the buffer is taken, so there is room for
+	 * one more entry.
+	 */
+	size_t logCount = 0;
+	size_t size = JSON_DEFAULT_BUF_SIZE;
+	if (!CONFIG_USE_SINGLE_AWS_TOPIC) {
+		logCount = LogPublishCount(pEntry);
+		size += SensorLog_GetJsonSize(pEntry->pLog, logCount) +
+			SENSOR_LOG_JSON_OVERHEAD_SIZE +
+			SENSOR_LOG_ENTRY_JSON_STR_SIZE;
+	}
+
+	JsonMsg_t *pMsg = BP_TRY_TO_TAKE(FWK_BUFFER_MSG_SIZE(JsonMsg_t, size));
 	if (pMsg == NULL) {
 		return;
 	}
 
+	if (!CONFIG_USE_SINGLE_AWS_TOPIC) {
+		AddLogEvent(pEntry);
+	}
+
 	pMsg->header.msgCode = FMC_SENSOR_PUBLISH;
 	pMsg->header.rxId = FWK_ID_CLOUD;
-	pMsg->size = SHADOW_BUF_SIZE;
+	pMsg->size = size;
 
 	ShadowBuilder_Start(pMsg, SKIP_MEMSET);
-	ShadowBuilder_StartGroup(pMsg, "state");
-	ShadowBuilder_StartGroup(pMsg, "reported");
+	ShadowBuilder_StartGroupKey(pMsg, SB_KEY("state"));
+	ShadowBuilder_StartGroupKey(pMsg, SB_KEY("reported"));
 	if (CONFIG_USE_SINGLE_AWS_TOPIC) {
 		ShadowTemperatureHandler(pMsg, pEntry);
 		/* Sending RSSI prevents an empty buffer when
@@ -904,7 +1045,7 @@ static void ShadowMaker(SensorEntry_t *pEntry)
 		ShadowBtHandler(pMsg, pEntry);
 		ShadowAdHandler(pMsg, pEntry);
 		ShadowRspHandler(pMsg, pEntry);
-		ShadowLogHandler(pMsg, pEntry);
+		ShadowLogHandler(pMsg, pEntry, logCount);
 		ShadowSpecialHandler(pMsg, pEntry);
 	}
 	ShadowBuilder_EndGroup(pMsg);
@@ -941,10 +1082,15 @@ static char *MangleKey(const char *pName, const char *pKey)
 
 static void ShadowBtHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry)
 {
-	ShadowBuilder_AddPair(pMsg, "bluetoothAddress", pEntry->addrString,
-			      SB_IS_STRING);
+	if (ConsumeDirty(pEntry, SHADOW_FIELD(BT_ADDR))) {
+		ShadowBuilder_AddPairKey(pMsg, SB_KEY("bluetoothAddress"),
+					 pEntry->addrString, SB_IS_STRING);
+	}
 
-	ShadowBuilder_AddSigned32(pMsg, "rssi", pEntry->rssi);
+	if (ConsumeDirty(pEntry, SHADOW_FIELD(RSSI))) {
+		ShadowBuilder_AddSigned32Key(pMsg, SB_KEY("rssi"),
+					     pEntry->rssi);
+	}
 }
 
 static void ShadowAdHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry)
@@ -957,9 +1103,14 @@ static void ShadowAdHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry)
 		return;
 	}
 
-	ShadowBuilder_AddUint32(pMsg, "networkId", pEntry->ad.networkId);
-	ShadowBuilder_AddUint32(pMsg, "flags", pEntry->ad.flags);
-	ShadowBuilder_AddUint32(pMsg, "resetCount", pEntry->ad.resetCount);
+	if (ConsumeDirty(pEntry, SHADOW_FIELD(NETWORK_ID))) {
+		ShadowBuilder_AddUint32Key(pMsg, SB_KEY("networkId"),
+					   pEntry->ad.networkId);
+	}
+	if (ConsumeDirty(pEntry, SHADOW_FIELD(RESET_COUNT))) {
+		ShadowBuilder_AddUint32Key(pMsg, SB_KEY("resetCount"),
+					   pEntry->ad.resetCount);
+	}
 
 	ShadowTemperatureHandler(pMsg, pEntry);
 	ShadowEventHandler(pMsg, pEntry);
@@ -977,32 +1128,31 @@ static void ShadowRspHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry)
 		return;
 	}
 
-	if (pEntry->updatedRsp) {
-		pEntry->updatedRsp = false;
-		ShadowBuilder_AddUint32(pMsg, "productId",
-					pEntry->rsp.productId);
-		ShadowBuilder_AddVersion(pMsg, "firmwareVersion",
-					 pEntry->rsp.firmwareVersionMajor,
-					 pEntry->rsp.firmwareVersionMinor,
-					 pEntry->rsp.firmwareVersionPatch);
-		ShadowBuilder_AddVersion(pMsg, "bootloaderVersion",
-					 pEntry->rsp.bootloaderVersionMajor,
-					 pEntry->rsp.bootloaderVersionMinor,
-					 pEntry->rsp.bootloaderVersionPatch);
-		ShadowBuilder_AddUint32(pMsg, "configVersion",
-					pEntry->rsp.configVersion);
-		ShadowBuilder_AddVersion(pMsg, "hardwareVersion",
-					 ADV_FORMAT_HW_VERSION_GET_MAJOR(
-						 pEntry->rsp.hardwareVersion),
-					 ADV_FORMAT_HW_VERSION_GET_MINOR(
-						 pEntry->rsp.hardwareVersion),
-					 0);
-	}
-
-	if (pEntry->updatedName) {
-		pEntry->updatedName = false;
-		ShadowBuilder_AddPair(pMsg, "sensorName", pEntry->name,
-				      SB_IS_STRING);
+	if (ConsumeDirty(pEntry, SHADOW_FIELD(RSP))) {
+		ShadowBuilder_AddUint32Key(pMsg, SB_KEY("productId"),
+					   pEntry->rsp.productId);
+		ShadowBuilder_AddVersionKey(pMsg, SB_KEY("firmwareVersion"),
+					    pEntry->rsp.firmwareVersionMajor,
+					    pEntry->rsp.firmwareVersionMinor,
+					    pEntry->rsp.firmwareVersionPatch);
+		ShadowBuilder_AddVersionKey(pMsg, SB_KEY("bootloaderVersion"),
+					    pEntry->rsp.bootloaderVersionMajor,
+					    pEntry->rsp.bootloaderVersionMinor,
+					    pEntry->rsp.bootloaderVersionPatch);
+		ShadowBuilder_AddUint32Key(pMsg, SB_KEY("configVersion"),
+					   pEntry->rsp.configVersion);
+		ShadowBuilder_AddVersionKey(
+			pMsg, SB_KEY("hardwareVersion"),
+			ADV_FORMAT_HW_VERSION_GET_MAJOR(
+				pEntry->rsp.hardwareVersion),
+			ADV_FORMAT_HW_VERSION_GET_MINOR(
+				pEntry->rsp.hardwareVersion),
+			0);
+	}
+
+	if (ConsumeDirty(pEntry, SHADOW_FIELD(NAME))) {
+		ShadowBuilder_AddPairKey(pMsg, SB_KEY("sensorName"),
+					 pEntry->name, SB_IS_STRING);
 	}
 }
 
@@ -1027,14 +1177,29 @@ static bool LowBatteryAlarm(SensorEntry_t *pEntry)
 
 static void ShadowTemperatureHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry)
 {
-	int32_t temperature = GetTemperature(pEntry);
+	int32_t temperature = pEntry->temperature;
 	if (CONFIG_USE_SINGLE_AWS_TOPIC) {
 		/* The desired format is degrees when publishing to a single topic
 		 * because that is how the BL654 Sensor data is formatted.
 		 */
 		temperature /= 100;
 	}
-	switch (pEntry->ad.recordType) {
+	/* The single topic format expects temperature with every event. */
+	if (ConsumeDirty(pEntry, SHADOW_FIELD(TEMPERATURE)) ||
+	    (CONFIG_USE_SINGLE_AWS_TOPIC &&
+	     IsTemperatureEvent(pEntry->ad.recordType))) {
+		ShadowBuilder_AddSigned32(
+			pMsg,
+			MangleKey(pEntry->name, CONFIG_USE_SINGLE_AWS_TOPIC ?
+							      "temperature" :
+							      "tempCc"),
+			temperature);
+	}
+}
+
+static bool IsTemperatureEvent(uint8_t RecordType)
+{
+	switch (RecordType) {
 	case SENSOR_EVENT_TEMPERATURE:
 	case SENSOR_EVENT_ALARM_HIGH_TEMP_1:
 	case SENSOR_EVENT_ALARM_HIGH_TEMP_2:
@@ -1044,15 +1209,9 @@ static void ShadowTemperatureHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry)
 	case SENSOR_EVENT_ALARM_LOW_TEMP_CLEAR:
 	case SENSOR_EVENT_ALARM_DELTA_TEMP:
 	case SENSOR_EVENT_ALARM_TEMPERATURE_RATE_OF_CHANGE:
-		ShadowBuilder_AddSigned32(
-			pMsg,
-			MangleKey(pEntry->name, CONFIG_USE_SINGLE_AWS_TOPIC ?
-							      "temperature" :
-							      "tempCc"),
-			temperature);
-		break;
+		return true;
 	default:
-		break;
+		return false;
 	}
 }
 
@@ -1062,14 +1221,15 @@ static void ShadowEventHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry)
 	switch (pEntry->ad.recordType) {
 	case SENSOR_EVENT_BATTERY_GOOD:
 	case SENSOR_EVENT_BATTERY_BAD:
-		ShadowBuilder_AddUint32(pMsg, "batteryVoltageMv",
-					(uint32_t)pEntry->ad.data.u16);
+		ShadowBuilder_AddUint32Key(pMsg, SB_KEY("batteryVoltageMv"),
+					   (uint32_t)pEntry->ad.data.u16);
 		break;
 	case SENSOR_EVENT_RESET:
-		ShadowBuilder_AddPair(pMsg, "resetReason",
-				      lcz_sensor_event_get_reset_reason_string(
-					      pEntry->ad.data.u16),
-				      false);
+		ShadowBuilder_AddPairKey(
+			pMsg, SB_KEY("resetReason"),
+			lcz_sensor_event_get_reset_reason_string(
+				pEntry->ad.data.u16),
+			false);
 		break;
 	default:
 		break;
@@ -1138,34 +1298,52 @@ static void ShadowIg60EventHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry)
 static void ShadowFlagHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry)
 {
 	uint16_t flags = pEntry->ad.flags;
-	if (flags != pEntry->lastFlags) {
-		ShadowBuilder_AddUint32(pMsg, "rtcSet",
-					GetFlag(flags, FLAG_TIME_WAS_SET));
-		ShadowBuilder_AddUint32(pMsg, "activeMode",
-					GetFlag(flags, FLAG_ACTIVE_MODE));
-		ShadowBuilder_AddUint32(pMsg, "anyAlarm",
-					GetFlag(flags, FLAG_ANY_ALARM));
-		ShadowBuilder_AddUint32(pMsg, "lowBatteryAlarm",
-					GetFlag(flags, FLAG_LOW_BATTERY_ALARM));
-		ShadowBuilder_AddUint32(pMsg, "highTemperatureAlarm",
-					GetFlag(flags, FLAG_HIGH_TEMP_ALARM));
-		ShadowBuilder_AddUint32(pMsg, "lowTemperatureAlarm",
-					GetFlag(flags, FLAG_LOW_TEMP_ALARM));
-		ShadowBuilder_AddUint32(pMsg, "deltaTemperatureAlarm",
-					GetFlag(flags, FLAG_DELTA_TEMP_ALARM));
-		ShadowBuilder_AddUint32(
-			pMsg, "rateOfChangeTemperatureAlarm",
+	if (ConsumeDirty(pEntry, SHADOW_FIELD(FLAGS))) {
+		ShadowBuilder_AddUint32Key(pMsg, SB_KEY("flags"), flags);
+		ShadowBuilder_AddUint32Key(pMsg, SB_KEY("rtcSet"),
+					   GetFlag(flags, FLAG_TIME_WAS_SET));
+		ShadowBuilder_AddUint32Key(pMsg, SB_KEY("activeMode"),
+					   GetFlag(flags, FLAG_ACTIVE_MODE));
+		ShadowBuilder_AddUint32Key(pMsg, SB_KEY("anyAlarm"),
+					   GetFlag(flags, FLAG_ANY_ALARM));
+		ShadowBuilder_AddUint32Key(
+			pMsg, SB_KEY("lowBatteryAlarm"),
+			GetFlag(flags, FLAG_LOW_BATTERY_ALARM));
+		ShadowBuilder_AddUint32Key(
+			pMsg, SB_KEY("highTemperatureAlarm"),
+			GetFlag(flags, FLAG_HIGH_TEMP_ALARM));
+		ShadowBuilder_AddUint32Key(pMsg, SB_KEY("lowTemperatureAlarm"),
+					   GetFlag(flags, FLAG_LOW_TEMP_ALARM));
+		ShadowBuilder_AddUint32Key(
+			pMsg, SB_KEY("deltaTemperatureAlarm"),
+			GetFlag(flags, FLAG_DELTA_TEMP_ALARM));
+		ShadowBuilder_AddUint32Key(
+			pMsg, SB_KEY("rateOfChangeTemperatureAlarm"),
 			GetFlag(flags, FLAG_RATE_OF_CHANGE_TEMP_ALARM));
-		ShadowBuilder_AddUint32(pMsg, "movementAlarm",
-					GetFlag(flags, FLAG_MOVEMENT_ALARM));
-		ShadowBuilder_AddUint32(pMsg, "magnetState",
-					GetFlag(flags, FLAG_MAGNET_STATE));
+		ShadowBuilder_AddUint32Key(pMsg, SB_KEY("movementAlarm"),
+					   GetFlag(flags, FLAG_MOVEMENT_ALARM));
+		ShadowBuilder_AddUint32Key(pMsg, SB_KEY("magnetState"),
+					   GetFlag(flags, FLAG_MAGNET_STATE));
+	}
+}
 
-		pEntry->lastFlags = flags;
+/* Returns the number of log entries that should be published once the
+ * current event has been added.
+ */
+static size_t LogPublishCount(SensorEntry_t *pEntry)
+{
+	/* The shadow replaces arrays, so the entire log is normally sent.
+	 * A cloud that accumulates the log can be sent only new entries.
+	 */
+	if (IS_ENABLED(CONFIG_SENSOR_LOG_PUBLISH_NEW_ENTRIES_ONLY) &&
+	    !(pEntry->dirty & SHADOW_FIELD(LOG))) {
+		return pEntry->newLogEntries + 1;
+	} else {
+		return SIZE_MAX;
 	}
 }
 
-static void ShadowLogHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry)
+static void AddLogEvent(SensorEntry_t *pEntry)
 {
 	SensorLogEvent_t event = { .epoch = pEntry->ad.epoch,
 				   .data = pEntry->ad.data.u16,
@@ -1173,19 +1351,31 @@ static void ShadowLogHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry)
 				   .idLsb = (uint8_t)pEntry->ad.id };
 
 	SensorLog_Add(pEntry->pLog, &event);
+	pEntry->newLogEntries += 1;
+}
 
-	SensorLog_GenerateJson(pEntry->pLog, pMsg);
+static void ShadowLogHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry,
+			     size_t Count)
+{
+	SensorLog_GenerateJsonNewest(pEntry->pLog, pMsg, Count);
+	ConsumeDirty(pEntry, SHADOW_FIELD(LOG));
+	pEntry->newLogEntries = 0;
 }
 
 /* These special items exist on the gateway and not on the sensor */
 static void ShadowSpecialHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry)
 {
-	ShadowBuilder_AddPair(pMsg, "gatewayId",
-			      (char *)attr_get_quasi_static(ATTR_ID_gatewayId),
-			      false);
+	if (ConsumeDirty(pEntry, SHADOW_FIELD(GATEWAY_ID))) {
+		ShadowBuilder_AddPairKey(
+			pMsg, SB_KEY("gatewayId"),
+			(char *)attr_get_quasi_static(ATTR_ID_gatewayId),
+			false);
+	}
 
-	ShadowBuilder_AddUint32(pMsg, "eventLogSize",
-				SensorLog_GetSize(pEntry->pLog));
+	if (ConsumeDirty(pEntry, SHADOW_FIELD(LOG_SIZE))) {
+		ShadowBuilder_AddUint32Key(pMsg, SB_KEY("eventLogSize"),
+					   SensorLog_GetSize(pEntry->pLog));
+	}
 }
 
 static void SensorAddrToString(SensorEntry_t *pEntry)
@@ -1221,16 +1411,16 @@ static void GatewayShadowMaker(bool GreenlistProcessed)
 	pMsg->size = SENSOR_GATEWAY_SHADOW_MAX_SIZE;
 
 	ShadowBuilder_Start(pMsg, SKIP_MEMSET);
-	ShadowBuilder_StartGroup(pMsg, "state");
+	ShadowBuilder_StartGroupKey(pMsg, SB_KEY("state"));
 	/* Setting the desired group to null lets the cloud know
 	 * that its request was processed.
 	 */
 	if (GreenlistProcessed) {
-		ShadowBuilder_AddNull(pMsg, "desired");
+		ShadowBuilder_AddNullKey(pMsg, SB_KEY("desired"));
 	}
-	ShadowBuilder_StartGroup(pMsg, "reported");
-	ShadowBuilder_StartGroup(pMsg, "bt510");
-	ShadowBuilder_StartArray(pMsg, "sensors");
+	ShadowBuilder_StartGroupKey(pMsg, SB_KEY("reported"));
+	ShadowBuilder_StartGroupKey(pMsg, SB_KEY("bt510"));
+	ShadowBuilder_StartArrayKey(pMsg, SB_KEY("sensors"));
 	size_t i;
 	for (i = 0; i < CONFIG_SENSOR_TABLE_SIZE; i++) {
 		SensorEntry_t *p = &sensorTable[i];
@@ -1253,15 +1443,13 @@ static void GatewayShadowMaker(bool GreenlistProcessed)
 /* Returns 1 if the value was changed from its current state. */
 static size_t GreenlistByAddress(const char *pAddrString, bool NextState)
 {
-	size_t i;
-	for (i = 0; i < CONFIG_SENSOR_TABLE_SIZE; i++) {
-		if (AddrStringMatch(pAddrString, i)) {
-			if (sensorTable[i].greenlisted != NextState) {
-				Greenlist(&sensorTable[i], NextState);
-				return 1;
-			} else {
-				return 0;
-			}
+	size_t i = FindTableIndexByString(pAddrString);
+	if (i < CONFIG_SENSOR_TABLE_SIZE) {
+		if (sensorTable[i].greenlisted != NextState) {
+			Greenlist(&sensorTable[i], NextState);
+			return 1;
+		} else {
+			return 0;
 		}
 	}
 	/* Don't add it to the table if it isn't greenlisted because
@@ -1296,6 +1484,7 @@ static void Greenlist(SensorEntry_t *pEntry, bool Enable)
 				pEntry->pLog = SensorLog_Allocate(
 					CONFIG_SENSOR_LOG_MAX_SIZE);
 			}
+			SetAllDirty(pEntry);
 			greenCount += 1;
 		} else {
 			/* In this case, Bluegrass will repeatedly try to enable sensor.
@@ -1463,3 +1652,158 @@ static bool IsBt510(uint8_t productId)
 		return false;
 	}
 }
+
+static uint32_t AddrHash(size_t Index)
+{
+	return HashBytes(sensorTable[Index].key.val, sizeof(bt_addr_t));
+}
+
+static uint32_t AddrStringHash(size_t Index)
+{
+	return HashBytes(sensorTable[Index].addrString,
+			 strnlen(sensorTable[Index].addrString,
+				 SENSOR_ADDR_STR_LEN));
+}
+
+/* FNV-1a */
+static uint32_t HashBytes(const void *p, size_t Length)
+{
+	const uint8_t *pByte = p;
+	uint32_t hash = FNV_OFFSET_BASIS;
+	size_t i;
+	for (i = 0; i < Length; i++) {
+		hash ^= pByte[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+static void IndexReset(SensorIndex_t *pIndex)
+{
+	size_t s;
+	for (s = 0; s < SENSOR_INDEX_SLOTS; s++) {
+		pIndex->slot[s] = SENSOR_INDEX_EMPTY;
+	}
+}
+
+static void IndexInsert(SensorIndex_t *pIndex, size_t Index)
+{
+	size_t s = pIndex->hash(Index) % SENSOR_INDEX_SLOTS;
+	while (pIndex->slot[s] != SENSOR_INDEX_EMPTY) {
+		s = (s + 1) % SENSOR_INDEX_SLOTS;
+	}
+	pIndex->slot[s] = Index;
+}
+
+/* Backward shift deletion is used so that tombstones aren't required. */
+static void IndexRemove(SensorIndex_t *pIndex, size_t Index)
+{
+	size_t hole = pIndex->hash(Index) % SENSOR_INDEX_SLOTS;
+	while (pIndex->slot[hole] != Index) {
+		if (pIndex->slot[hole] == SENSOR_INDEX_EMPTY) {
+			FRAMEWORK_DEBUG_ASSERT(false);
+			return;
+		}
+		hole = (hole + 1) % SENSOR_INDEX_SLOTS;
+	}
+
+	size_t s = hole;
+	size_t home;
+	bool move;
+	while (true) {
+		s = (s + 1) % SENSOR_INDEX_SLOTS;
+		if (pIndex->slot[s] == SENSOR_INDEX_EMPTY) {
+			break;
+		}
+		/* An entry can fill the hole if its home slot is not
+		 * cyclically in the range (hole, s].
+		 */
+		home = pIndex->hash(pIndex->slot[s]) % SENSOR_INDEX_SLOTS;
+		if (hole <= s) {
+			move = (home <= hole) || (home > s);
+		} else {
+			move = (home <= hole) && (home > s);
+		}
+		if (move) {
+			pIndex->slot[hole] = pIndex->slot[s];
+			hole = s;
+		}
+	}
+	pIndex->slot[hole] = SENSOR_INDEX_EMPTY;
+}
+
+static size_t IndexFind(SensorIndex_t *pIndex, uint32_t Hash,
+			IndexMatchFunction_t Match, const void *pKey)
+{
+	size_t s = Hash % SENSOR_INDEX_SLOTS;
+	while (pIndex->slot[s] != SENSOR_INDEX_EMPTY) {
+		if (Match(pKey, pIndex->slot[s])) {
+			return pIndex->slot[s];
+		}
+		s = (s + 1) % SENSOR_INDEX_SLOTS;
+	}
+	return CONFIG_SENSOR_TABLE_SIZE;
+}
+
+static void SetDirty(SensorEntry_t *pEntry, uint32_t Fields)
+{
+	pEntry->dirty |= Fields;
+}
+
+static void SetAllDirty(SensorEntry_t *pEntry)
+{
+	SetDirty(pEntry, SHADOW_FIELDS_ALL);
+	if (pEntry->temperatureValid) {
+		SetDirty(pEntry, SHADOW_FIELD(TEMPERATURE));
+	}
+}
+
+/* Returns true if the field needs to be published and clears its state. */
+static bool ConsumeDirty(SensorEntry_t *pEntry, uint32_t Field)
+{
+	if (pEntry->dirty & Field) {
+		pEntry->dirty &= ~Field;
+		return true;
+	} else {
+		return false;
+	}
+}
+
+static void UpdateAd(SensorEntry_t *pEntry, LczSensorAdEvent_t *p,
+		     int8_t Rssi)
+{
+	if (!pEntry->validAd) {
+		SetDirty(pEntry, SHADOW_FIELD(NETWORK_ID) | SHADOW_FIELD(FLAGS) |
+					 SHADOW_FIELD(RESET_COUNT));
+	} else {
+		if (p->networkId != pEntry->ad.networkId) {
+			SetDirty(pEntry, SHADOW_FIELD(NETWORK_ID));
+		}
+		if (p->flags != pEntry->ad.flags) {
+			SetDirty(pEntry, SHADOW_FIELD(FLAGS));
+		}
+		if (p->resetCount != pEntry->ad.resetCount) {
+			SetDirty(pEntry, SHADOW_FIELD(RESET_COUNT));
+		}
+	}
+
+	if (Rssi != pEntry->rssi) {
+		SetDirty(pEntry, SHADOW_FIELD(RSSI));
+	}
+
+	pEntry->validAd = true;
+	pEntry->lastRecordType = pEntry->ad.recordType;
+	memcpy(&pEntry->ad, p, sizeof(LczSensorAdEvent_t));
+	pEntry->rssi = Rssi;
+
+	if (IsTemperatureEvent(pEntry->ad.recordType)) {
+		/* Temperature alarms are always reported */
+		if (!pEntry->temperatureValid ||
+		    (GetTemperature(pEntry) != pEntry->temperature) ||
+		    (pEntry->ad.recordType != SENSOR_EVENT_TEMPERATURE)) {
+			SetDirty(pEntry, SHADOW_FIELD(TEMPERATURE));
+		}
+		pEntry->temperature = GetTemperature(pEntry);
+		pEntry->temperatureValid = true;
+	}
+}
@@ -24,6 +24,8 @@ LOG_MODULE_REGISTER(sensor_task, CONFIG_SENSOR_TASK_LOG_LEVEL);
 #include "lcz_bracket.h"
 #include "lcz_bluetooth.h"
 #include "lcz_bt_scan.h"
+#include "ad_find.h"
+#include "lcz_sensor_adv_format.h"
 #include "lcz_sensor_adv_match.h"
 #include "vsp_definitions.h"
 #include "lcz_qrtc.h"
@@ -47,12 +49,10 @@ LOG_MODULE_REGISTER(sensor_task, CONFIG_SENSOR_TASK_LOG_LEVEL);
 #define SENSOR_TASK_QUEUE_DEPTH 32
 #endif
 
-/** Limit the amount of space in the queue that can be used for processing
- * advertisements.
- */
-#ifndef SENSOR_TASK_MAX_OUTSTANDING_ADS
-#define SENSOR_TASK_MAX_OUTSTANDING_ADS (SENSOR_TASK_QUEUE_DEPTH / 2)
-#endif
+#define AD_RING_SIZE CONFIG_SENSOR_TASK_AD_RING_SIZE
+#define AD_RING_MASK (AD_RING_SIZE - 1)
+BUILD_ASSERT((AD_RING_SIZE & AD_RING_MASK) == 0,
+	     "Ad ring size must be a power of 2");
 
 /* At 1 second there are duplicate requests for shadow information. */
 #define SENSOR_TICK_RATE_SECONDS 3
@@ -71,6 +71,40 @@ LOG_MODULE_REGISTER(sensor_task, CONFIG_SENSOR_TASK_LOG_LEVEL);
 #define SENSOR_LATENCY 1
 #define SENSOR_TIMEOUT 400 /* in 10ms units, 400 = 4s */
 
+#ifdef CONFIG_SENSOR_AD_DEDUP
+#define DEDUP_CACHE_MASK (CONFIG_SENSOR_AD_DEDUP_CACHE_SIZE - 1)
+BUILD_ASSERT((CONFIG_SENSOR_AD_DEDUP_CACHE_SIZE & DEDUP_CACHE_MASK) == 0,
+	     "Dedup cache size must be a power of 2");
+
+#define DEDUP_REFRESH_MS (CONFIG_SENSOR_AD_DEDUP_REFRESH_SECONDS * MSEC_PER_SEC)
+
+/* Only accessed from BT RX thread context */
+typedef struct DedupEntry {
+	bool valid;
+	bt_addr_t addr;
+	uint16_t id;
+	uint8_t recordType;
+	uint32_t forwardTime;
+} DedupEntry_t;
+#endif
+
+typedef struct AdRecord {
+	bt_addr_le_t addr;
+	int8_t rssi;
+	uint8_t type;
+	Ad_t ad;
+} AdRecord_t;
+
+/* Single producer (BT RX thread), single consumer (sensor task).
+ * The producer only writes head and the consumer only writes tail.
+ */
+typedef struct AdRing {
+	atomic_t head;
+	atomic_t tail;
+	atomic_t drainPending;
+	AdRecord_t slot[AD_RING_SIZE];
+} AdRing_t;
+
 typedef struct SensorTask {
 	FwkMsgTask_t msgTask;
 	struct bt_conn *conn;
@@ -91,9 +125,9 @@ typedef struct SensorTask {
 	uint32_t fifoTicks;
 	int scanUserId;
 	uint32_t configDisconnects;
-	uint32_t adsProcessed;
-	atomic_t adsOutstanding; /* incremented in BT RX thread context */
+	SensorTaskAdStats_t adStats;
 	atomic_t adsDropped; /* incremented in BT RX thread context */
+	uint32_t adsDroppedReported;
 } SensorTaskObj_t;
 
 /* A connection is not created unless 1M is disabled. */
@@ -112,6 +146,12 @@ typedef struct SensorTask {
 /******************************************************************************/
 static SensorTaskObj_t st;
 
+static AdRing_t adRing;
+
+#ifdef CONFIG_SENSOR_AD_DEDUP
+static DedupEntry_t dedupCache[CONFIG_SENSOR_AD_DEDUP_CACHE_SIZE];
+#endif
+
 K_THREAD_STACK_DEFINE(sensorTaskStack, SENSOR_TASK_STACK_DEPTH);
 
 K_MSGQ_DEFINE(sensorTaskQueue, FWK_QUEUE_ENTRY_SIZE, SENSOR_TASK_QUEUE_DEPTH,
@@ -137,6 +177,7 @@ static FwkMsgHandler_t AwsConnectionMsgHandler;
 static FwkMsgHandler_t AwsDecommissionMsgHandler;
 static FwkMsgHandler_t SubscriptionAckMsgHandler;
 static FwkMsgHandler_t SensorShadowInitMsgHandler;
+static FwkMsgHandler_t SensorRepublishMsgHandler;
 
 static void RegisterConnectionCallbacks(void);
 static int StartDiscovery(void);
@@ -178,11 +219,21 @@ static void SendSensorResetTimerCallbackIsr(struct k_timer *timer_id);
 static void SensorTickCallbackIsr(struct k_timer *timer_id);
 static void StartSensorTick(SensorTaskObj_t *pObj);
 
+static void DrainAdRing(SensorTaskObj_t *pObj);
+
 #ifdef CONFIG_SCAN_FOR_BT510
 static void SensorTaskAdvHandler(const bt_addr_le_t *addr, int8_t rssi,
 				 uint8_t type, struct net_buf_simple *ad);
 #endif
 
+#ifdef CONFIG_SENSOR_AD_DEDUP
+static DedupEntry_t *DedupLookup(const bt_addr_le_t *pAddr,
+				 struct net_buf_simple *pAd,
+				 LczSensorAdEvent_t **ppEvent);
+static void DedupUpdate(DedupEntry_t *pEntry, const bt_addr_le_t *pAddr,
+			LczSensorAdEvent_t *pEvent);
+#endif
+
 /******************************************************************************/
 /* Framework Message Dispatcher                                               */
 /******************************************************************************/
@@ -207,6 +258,7 @@ static FwkMsgHandler_t *SensorTaskMsgDispatcher(FwkMsgCode_t MsgCode)
 	case FMC_AWS_DISCONNECTED:         return AwsConnectionMsgHandler;
 	case FMC_SUBSCRIBE_ACK:            return SubscriptionAckMsgHandler;
 	case FMC_SENSOR_SHADOW_INIT:       return SensorShadowInitMsgHandler;
+	case FMC_SENSOR_REPUBLISH:         return SensorRepublishMsgHandler;
 	case FMC_AWS_DECOMMISSION:         return AwsDecommissionMsgHandler;
 	default:                           return NULL;
 	}
@@ -242,6 +294,15 @@ void SensorTask_Initialize(void)
 	RegisterConnectionCallbacks();
 }
 
+void SensorTask_GetAdStats(SensorTaskAdStats_t *pStats)
+{
+	/* Counters are updated in sensor task context; a copy may be torn
+	 * but each field is consistent.
+	 */
+	memcpy(pStats, &st.adStats, sizeof(SensorTaskAdStats_t));
+	pStats->dropped = (uint32_t)atomic_get(&st.adsDropped);
+}
+
 /******************************************************************************/
 /* Local Function Definitions                                                 */
 /******************************************************************************/
@@ -273,26 +334,52 @@ static void SensorTaskThread(void *pArg1, void *pArg2, void *pArg3)
 	}
 }
 
+/* The message is only a signal that the ad ring has data. */
 DispatchResult_t AdvertisementMsgHandler(FwkMsgReceiver_t *pMsgRxer,
 					 FwkMsg_t *pMsg)
 {
-	AdvMsg_t *pAdvMsg = (AdvMsg_t *)pMsg;
-	SensorTable_AdvertisementHandler(&pAdvMsg->addr, pAdvMsg->rssi,
-					 pAdvMsg->type, &pAdvMsg->ad);
-
+	UNUSED_PARAMETER(pMsg);
 	SensorTaskObj_t *pObj = FWK_TASK_CONTAINER(SensorTaskObj_t);
-	pObj->adsProcessed += 1;
-	atomic_dec(&pObj->adsOutstanding);
+	DrainAdRing(pObj);
+
 	/* Attempt to limit prints when busy. */
-	if (atomic_get(&pObj->adsOutstanding) == 0) {
-		if (atomic_get(&pObj->adsDropped) > 0) {
-			atomic_val_t dropped = atomic_clear(&pObj->adsDropped);
-			LOG_WRN("%u advertisements dropped", dropped);
-		}
+	uint32_t dropped = (uint32_t)atomic_get(&pObj->adsDropped);
+	if (dropped != pObj->adsDroppedReported) {
+		LOG_WRN("%u advertisements dropped",
+			dropped - pObj->adsDroppedReported);
+		pObj->adsDroppedReported = dropped;
 	}
 	return DISPATCH_OK;
 }
 
+static void DrainAdRing(SensorTaskObj_t *pObj)
+{
+	/* Clear before reading head so that an ad added after the snapshot
+	 * generates another message.
+	 */
+	atomic_clear(&adRing.drainPending);
+
+	atomic_val_t tail = atomic_get(&adRing.tail);
+	atomic_val_t head = atomic_get(&adRing.head);
+	uint32_t count = (uint32_t)(head - tail);
+	if (count == 0) {
+		return;
+	}
+
+	while (tail != head) {
+		AdRecord_t *p = &adRing.slot[tail & AD_RING_MASK];
+		SensorTable_AdvertisementHandler(&p->addr, p->rssi, p->type,
+						 &p->ad);
+		tail += 1;
+		/* Release the slot to the producer */
+		atomic_set(&adRing.tail, tail);
+	}
+
+	pObj->adStats.processed += count;
+	pObj->adStats.lastBatch = count;
+	pObj->adStats.maxBatch = MAX(pObj->adStats.maxBatch, count);
+}
+
 static DispatchResult_t GreenlistRequestMsgHandler(FwkMsgReceiver_t *pMsgRxer,
 						   FwkMsg_t *pMsg)
 {
@@ -557,6 +644,14 @@ static DispatchResult_t SensorShadowInitMsgHandler(FwkMsgReceiver_t *pMsgRxer,
 	return DISPATCH_OK;
 }
 
+static DispatchResult_t SensorRepublishMsgHandler(FwkMsgReceiver_t *pMsgRxer,
+						  FwkMsg_t *pMsg)
+{
+	UNUSED_PARAMETER(pMsgRxer);
+	SensorTable_RepublishHandler(((JsonMsg_t *)pMsg)->topic);
+	return DISPATCH_OK;
+}
+
 static void RegisterConnectionCallbacks(void)
 {
 	static struct bt_conn_cb connectionCallbacks = {
@@ -904,33 +999,118 @@ static void SensorTickCallbackIsr(struct k_timer *timer_id)
 static void SensorTaskAdvHandler(const bt_addr_le_t *addr, int8_t rssi,
 				 uint8_t type, struct net_buf_simple *ad)
 {
-	/* After filtering for BT510 sensors, send a message so we can
-	 * process ads in Sensor Task context.
+	/* After filtering for BT510 sensors, copy the ad into the ring so we
+	 * can process ads in Sensor Task context.
 	 * This prevents the BLE RX task from being blocked.
 	 */
 	if (lcz_sensor_adv_match(ad, true, true) != RESERVED_AD_PROTOCOL_ID) {
-		if (atomic_get(&st.adsOutstanding) >
-		    SENSOR_TASK_MAX_OUTSTANDING_ADS) {
-			atomic_inc(&st.adsDropped);
+#ifdef CONFIG_SENSOR_AD_DEDUP
+		LczSensorAdEvent_t *pEvent = NULL;
+		DedupEntry_t *pDedup = DedupLookup(addr, ad, &pEvent);
+		if (pDedup == NULL) {
 			return;
 		}
-
-		AdvMsg_t *pMsg = BP_TRY_TO_TAKE(sizeof(AdvMsg_t));
-		if (pMsg == NULL) {
+#endif
+		atomic_val_t head = atomic_get(&adRing.head);
+		uint32_t used = (uint32_t)(head - atomic_get(&adRing.tail));
+		if (used >= AD_RING_SIZE) {
+			/* Signal periodically in case the message that should
+			 * have drained the ring could not be allocated.
+			 */
+			if ((atomic_inc(&st.adsDropped) & AD_RING_MASK) == 0) {
+				FRAMEWORK_MSG_SEND_TO_SELF(FWK_ID_SENSOR_TASK,
+							   FMC_ADV);
+			}
 			return;
 		}
 
-		pMsg->header.msgCode = FMC_ADV;
-		pMsg->header.rxId = FWK_ID_SENSOR_TASK;
+		AdRecord_t *p = &adRing.slot[head & AD_RING_MASK];
+		p->rssi = rssi;
+		p->type = type;
+		p->ad.len = MIN(CONFIG_SENSOR_MAX_AD_SIZE, ad->len);
+		memcpy(&p->addr, addr, sizeof(bt_addr_le_t));
+		memcpy(p->ad.data, ad->data, p->ad.len);
+		/* Publish the slot to the consumer */
+		atomic_set(&adRing.head, head + 1);
+
+#ifdef CONFIG_SENSOR_AD_DEDUP
+		/* Only remember ads that weren't dropped */
+		DedupUpdate(pDedup, addr, pEvent);
+#endif
 
-		pMsg->rssi = rssi;
-		pMsg->type = type;
-		pMsg->ad.len = ad->len;
-		memcpy(&pMsg->addr, addr, sizeof(bt_addr_le_t));
-		memcpy(pMsg->ad.data, ad->data,
-		       MIN(CONFIG_SENSOR_MAX_AD_SIZE, ad->len));
-		FRAMEWORK_MSG_SEND(pMsg);
-		atomic_inc(&st.adsOutstanding);
+		used += 1;
+		if (used > st.adStats.highWater) {
+			st.adStats.highWater = used;
+		}
+
+		/* Only one message is required to drain a batch of ads. */
+		if (atomic_cas(&adRing.drainPending, 0, 1)) {
+			FRAMEWORK_MSG_SEND_TO_SELF(FWK_ID_SENSOR_TASK, FMC_ADV);
+		}
 	}
 }
-#endif
\ No newline at end of file
+#endif
+
+#ifdef CONFIG_SENSOR_AD_DEDUP
+/**
+ * @brief Check if an ad is a repeat of the last event forwarded for a sensor.
+ *
+ * @param ppEvent is set to the event in the ad (NULL for a scan response)
+ *
+ * @retval NULL if the ad should be discarded, otherwise the cache entry
+ * that should be updated if the ad is forwarded.
+ */
+static DedupEntry_t *DedupLookup(const bt_addr_le_t *pAddr,
+				 struct net_buf_simple *pAd,
+				 LczSensorAdEvent_t **ppEvent)
+{
+	AdHandle_t manHandle = AdFind_Type(
+		pAd->data, pAd->len, BT_DATA_MANUFACTURER_DATA, BT_DATA_INVALID);
+	if (manHandle.pPayload == NULL) {
+		return NULL;
+	}
+
+	if (lcz_sensor_adv_match_1m(&manHandle)) {
+		*ppEvent = (LczSensorAdEvent_t *)manHandle.pPayload;
+	} else if (lcz_sensor_adv_match_coded(&manHandle)) {
+		*ppEvent = &((LczSensorAdCoded_t *)manHandle.pPayload)->ad;
+	}
+
+	/* The hash doesn't need to be good because there are few sensors. */
+	const uint8_t *a = pAddr->a.val;
+	uint32_t hash = (a[0] ^ (a[1] << 3) ^ (a[2] << 6) ^ (a[3] << 9) ^
+			 (a[4] << 12) ^ (a[5] << 15));
+	hash ^= hash >> 7;
+	DedupEntry_t *pEntry = &dedupCache[hash & DEDUP_CACHE_MASK];
+
+	if (*ppEvent == NULL) {
+		/* Scan responses are infrequent and always forwarded. */
+		return pEntry;
+	}
+
+	st.adStats.dedupLookups += 1;
+	if (pEntry->valid &&
+	    (memcmp(&pEntry->addr, &pAddr->a, sizeof(bt_addr_t)) == 0) &&
+	    (pEntry->id == (*ppEvent)->id) &&
+	    (pEntry->recordType == (*ppEvent)->recordType) &&
+	    ((k_uptime_get_32() - pEntry->forwardTime) < DEDUP_REFRESH_MS)) {
+		st.adStats.dedupHits += 1;
+		return NULL;
+	}
+	return pEntry;
+}
+
+static void DedupUpdate(DedupEntry_t *pEntry, const bt_addr_le_t *pAddr,
+			LczSensorAdEvent_t *pEvent)
+{
+	if (pEvent == NULL) {
+		return;
+	}
+	/* A collision replaces the previous sensor */
+	pEntry->valid = true;
+	memcpy(&pEntry->addr, &pAddr->a, sizeof(bt_addr_t));
+	pEntry->id = pEvent->id;
+	pEntry->recordType = pEvent->recordType;
+	pEntry->forwardTime = k_uptime_get_32();
+}
+#endif
@@ -23,54 +23,27 @@ LOG_MODULE_REGISTER(shadow_builder);
 /******************************************************************************/
 /* Local Constant, Macro and Type Definitions                                 */
 /******************************************************************************/
-#define JSON_APPEND_CHAR(c) JsonAppendChar(pJsonMsg, (uint8_t)(c))
-#define JSON_APPEND_STRING(s) JsonAppendString(pJsonMsg, (s), true)
-
-#define JSON_APPEND_VALUE_STRING(s)                                            \
-	do {                                                                   \
-		JSON_APPEND_CHAR('"');                                         \
-		JSON_APPEND_STRING(s);                                         \
-		JSON_APPEND_CHAR('"');                                         \
-	} while (0)
-
-#define JSON_APPEND_KEY(s)                                                     \
-	do {                                                                   \
-		JSON_APPEND_VALUE_STRING(s);                                   \
-		JSON_APPEND_CHAR(':');                                         \
-	} while (0)
-
-#define JSON_APPEND_U32(c)                                                     \
-	do {                                                                   \
-		memset(str, 0, MAXIMUM_LENGTH_OF_TO_STRING_OUTPUT);            \
-		ToString_Dec(str, (c));                                        \
-		JSON_APPEND_STRING(str);                                       \
-	} while (0)
-
-#define JSON_APPEND_HEX8(c)                                                    \
-	do {                                                                   \
-		memset(str, 0, MAXIMUM_LENGTH_OF_TO_STRING_OUTPUT);            \
-		ToString_Hex8(str, (c));                                       \
-		JSON_APPEND_VALUE_STRING(str);                                 \
-	} while (0)
-
-#define JSON_APPEND_HEX16(c)                                                   \
-	do {                                                                   \
-		memset(str, 0, MAXIMUM_LENGTH_OF_TO_STRING_OUTPUT);            \
-		ToString_Hex16(str, (c));                                      \
-		JSON_APPEND_VALUE_STRING(str);                                 \
-	} while (0)
-
-/******************************************************************************/
-/* Local Data Definitions                                                     */
-/******************************************************************************/
-static char str[MAXIMUM_LENGTH_OF_TO_STRING_OUTPUT];
+#define HEX8_STR_LEN 2
+#define HEX16_STR_LEN 4
 
 /******************************************************************************/
 /* Local Function Prototypes                                                  */
 /******************************************************************************/
+static char *JsonReserve(JsonMsg_t *pJsonMsg, size_t Length);
+static void JsonAppendRaw(JsonMsg_t *pJsonMsg, const char *pData,
+			  size_t Length);
 static void JsonAppendString(JsonMsg_t *pJsonMsg, const char *restrict pString,
 			     bool EscapeQuoteChar);
 static void JsonAppendChar(JsonMsg_t *pJsonMsg, char Character);
+static void JsonAppendKey(JsonMsg_t *pJsonMsg, const char *restrict pKey);
+static void JsonAppendUint32Field(JsonMsg_t *pJsonMsg, uint32_t Value,
+				  bool Negative);
+static void JsonAppendVersionField(JsonMsg_t *pJsonMsg, uint8_t Major,
+				   uint8_t Minor, uint8_t Build);
+static void JsonAppendValueField(JsonMsg_t *pJsonMsg,
+				 const char *restrict pValue,
+				 bool IsNotString);
+static const char *EscapeSequence(char Character, bool EscapeQuoteChar);
 
 /******************************************************************************/
 /* Global Function Definitions                                                */
@@ -83,7 +56,7 @@ void ShadowBuilder_Start(JsonMsg_t *pJsonMsg, bool ClearBuffer)
 		memset(pJsonMsg->buffer, 0, pJsonMsg->size);
 	}
 	pJsonMsg->length = 0;
-	JSON_APPEND_CHAR('{');
+	JsonAppendChar(pJsonMsg, '{');
 }
 
 void ShadowBuilder_Finalize(JsonMsg_t *pJsonMsg)
@@ -100,11 +73,18 @@ void ShadowBuilder_AddUint32(JsonMsg_t *pJsonMsg, const char *restrict pKey,
 	FRAMEWORK_ASSERT(pKey != NULL);
 	FRAMEWORK_ASSERT(strlen(pKey) > 0);
 
-	JSON_APPEND_KEY(pKey);
-	memset(str, 0, MAXIMUM_LENGTH_OF_TO_STRING_OUTPUT);
-	ToString_Dec(str, Value);
-	JSON_APPEND_STRING(str);
-	JSON_APPEND_CHAR(',');
+	JsonAppendKey(pJsonMsg, pKey);
+	JsonAppendUint32Field(pJsonMsg, Value, false);
+}
+
+void ShadowBuilder_AddUint32Key(JsonMsg_t *pJsonMsg,
+				const ShadowBuilderKey_t *pKey, uint32_t Value)
+{
+	FRAMEWORK_ASSERT(pJsonMsg != NULL);
+	FRAMEWORK_ASSERT(pKey != NULL);
+
+	JsonAppendRaw(pJsonMsg, pKey->str, pKey->length);
+	JsonAppendUint32Field(pJsonMsg, Value, false);
 }
 
 void ShadowBuilder_AddSigned32(JsonMsg_t *pJsonMsg, const char *restrict pKey,
@@ -114,16 +94,25 @@ void ShadowBuilder_AddSigned32(JsonMsg_t *pJsonMsg, const char *restrict pKey,
 	FRAMEWORK_ASSERT(pKey != NULL);
 	FRAMEWORK_ASSERT(strlen(pKey) > 0);
 
-	JSON_APPEND_KEY(pKey);
-	memset(str, 0, MAXIMUM_LENGTH_OF_TO_STRING_OUTPUT);
-	int32_t v = Value;
-	if (Value < 0) {
-		JSON_APPEND_CHAR('-');
-		v *= -1;
-	}
-	ToString_Dec(str, (uint32_t)v);
-	JSON_APPEND_STRING(str);
-	JSON_APPEND_CHAR(',');
+	JsonAppendKey(pJsonMsg, pKey);
+	JsonAppendUint32Field(pJsonMsg,
+			      (Value < 0) ? (0U - (uint32_t)Value) :
+						  (uint32_t)Value,
+			      (Value < 0));
+}
+
+void ShadowBuilder_AddSigned32Key(JsonMsg_t *pJsonMsg,
+				  const ShadowBuilderKey_t *pKey,
+				  int32_t Value)
+{
+	FRAMEWORK_ASSERT(pJsonMsg != NULL);
+	FRAMEWORK_ASSERT(pKey != NULL);
+
+	JsonAppendRaw(pJsonMsg, pKey->str, pKey->length);
+	JsonAppendUint32Field(pJsonMsg,
+			      (Value < 0) ? (0U - (uint32_t)Value) :
+						  (uint32_t)Value,
+			      (Value < 0));
 }
 
 void ShadowBuilder_AddPair(JsonMsg_t *pJsonMsg, const char *restrict pKey,
@@ -138,13 +127,23 @@ void ShadowBuilder_AddPair(JsonMsg_t *pJsonMsg, const char *restrict pKey,
 		FRAMEWORK_ASSERT(strlen(pValue) > 0);
 	}
 
-	JSON_APPEND_KEY(pKey);
+	JsonAppendKey(pJsonMsg, pKey);
+	JsonAppendValueField(pJsonMsg, pValue, IsNotString);
+}
+
+void ShadowBuilder_AddPairKey(JsonMsg_t *pJsonMsg,
+			      const ShadowBuilderKey_t *pKey,
+			      const char *restrict pValue, bool IsNotString)
+{
+	FRAMEWORK_ASSERT(pJsonMsg != NULL);
+	FRAMEWORK_ASSERT(pKey != NULL);
+	FRAMEWORK_ASSERT(pValue != NULL);
 	if (IsNotString) {
-		JSON_APPEND_STRING(pValue); /* uint32_t, int32_t, float, ... */
-	} else {
-		JSON_APPEND_VALUE_STRING(pValue);
+		FRAMEWORK_ASSERT(strlen(pValue) > 0);
 	}
-	JSON_APPEND_CHAR(',');
+
+	JsonAppendRaw(pJsonMsg, pKey->str, pKey->length);
+	JsonAppendValueField(pJsonMsg, pValue, IsNotString);
 }
 
 void ShadowBuilder_AddVersion(JsonMsg_t *pJsonMsg, const char *restrict pKey,
@@ -154,15 +153,19 @@ void ShadowBuilder_AddVersion(JsonMsg_t *pJsonMsg, const char *restrict pKey,
 	FRAMEWORK_ASSERT(pKey != NULL);
 	FRAMEWORK_ASSERT(strlen(pKey) > 0);
 
-	JSON_APPEND_KEY(pKey);
-	JSON_APPEND_CHAR('"');
-	JSON_APPEND_U32(Major);
-	JSON_APPEND_CHAR('.');
-	JSON_APPEND_U32(Minor);
-	JSON_APPEND_CHAR('.');
-	JSON_APPEND_U32(Build);
-	JSON_APPEND_CHAR('"');
-	JSON_APPEND_CHAR(',');
+	JsonAppendKey(pJsonMsg, pKey);
+	JsonAppendVersionField(pJsonMsg, Major, Minor, Build);
+}
+
+void ShadowBuilder_AddVersionKey(JsonMsg_t *pJsonMsg,
+				 const ShadowBuilderKey_t *pKey, uint8_t Major,
+				 uint8_t Minor, uint8_t Build)
+{
+	FRAMEWORK_ASSERT(pJsonMsg != NULL);
+	FRAMEWORK_ASSERT(pKey != NULL);
+
+	JsonAppendRaw(pJsonMsg, pKey->str, pKey->length);
+	JsonAppendVersionField(pJsonMsg, Major, Minor, Build);
 }
 
 void ShadowBuilder_AddNull(JsonMsg_t *pJsonMsg, const char *restrict pKey)
@@ -171,9 +174,18 @@ void ShadowBuilder_AddNull(JsonMsg_t *pJsonMsg, const char *restrict pKey)
 	FRAMEWORK_ASSERT(pKey != NULL);
 	FRAMEWORK_ASSERT(strlen(pKey) > 0);
 
-	JSON_APPEND_KEY(pKey);
-	JSON_APPEND_STRING("null");
-	JSON_APPEND_CHAR(',');
+	JsonAppendKey(pJsonMsg, pKey);
+	JsonAppendRaw(pJsonMsg, "null,", strlen("null,"));
+}
+
+void ShadowBuilder_AddNullKey(JsonMsg_t *pJsonMsg,
+			      const ShadowBuilderKey_t *pKey)
+{
+	FRAMEWORK_ASSERT(pJsonMsg != NULL);
+	FRAMEWORK_ASSERT(pKey != NULL);
+
+	JsonAppendRaw(pJsonMsg, pKey->str, pKey->length);
+	JsonAppendRaw(pJsonMsg, "null,", strlen("null,"));
 }
 
 void ShadowBuilder_AddTrue(JsonMsg_t *pJsonMsg, const char *restrict pKey)
@@ -182,9 +194,8 @@ void ShadowBuilder_AddTrue(JsonMsg_t *pJsonMsg, const char *restrict pKey)
 	FRAMEWORK_ASSERT(pKey != NULL);
 	FRAMEWORK_ASSERT(strlen(pKey) > 0);
 
-	JSON_APPEND_KEY(pKey);
-	JSON_APPEND_STRING("true");
-	JSON_APPEND_CHAR(',');
+	JsonAppendKey(pJsonMsg, pKey);
+	JsonAppendRaw(pJsonMsg, "true,", strlen("true,"));
 }
 
 void ShadowBuilder_AddFalse(JsonMsg_t *pJsonMsg, const char *restrict pKey)
@@ -193,9 +204,8 @@ void ShadowBuilder_AddFalse(JsonMsg_t *pJsonMsg, const char *restrict pKey)
 	FRAMEWORK_ASSERT(pKey != NULL);
 	FRAMEWORK_ASSERT(strlen(pKey) > 0);
 
-	JSON_APPEND_KEY(pKey);
-	JSON_APPEND_STRING("false");
-	JSON_APPEND_CHAR(',');
+	JsonAppendKey(pJsonMsg, pKey);
+	JsonAppendRaw(pJsonMsg, "false,", strlen("false,"));
 }
 
 void ShadowBuilder_StartGroup(JsonMsg_t *pJsonMsg, const char *restrict pKey)
@@ -204,8 +214,18 @@ void ShadowBuilder_StartGroup(JsonMsg_t *pJsonMsg, const char *restrict pKey)
 	FRAMEWORK_ASSERT(pKey != NULL);
 	FRAMEWORK_ASSERT(strlen(pKey) > 0);
 
-	JSON_APPEND_KEY(pKey);
-	JSON_APPEND_CHAR('{');
+	JsonAppendKey(pJsonMsg, pKey);
+	JsonAppendChar(pJsonMsg, '{');
+}
+
+void ShadowBuilder_StartGroupKey(JsonMsg_t *pJsonMsg,
+				 const ShadowBuilderKey_t *pKey)
+{
+	FRAMEWORK_ASSERT(pJsonMsg != NULL);
+	FRAMEWORK_ASSERT(pKey != NULL);
+
+	JsonAppendRaw(pJsonMsg, pKey->str, pKey->length);
+	JsonAppendChar(pJsonMsg, '{');
 }
 
 void ShadowBuilder_EndGroup(JsonMsg_t *pJsonMsg)
@@ -214,7 +234,7 @@ void ShadowBuilder_EndGroup(JsonMsg_t *pJsonMsg)
 	FRAMEWORK_ASSERT(pJsonMsg->buffer[pJsonMsg->length - 1] == ',');
 
 	pJsonMsg->buffer[pJsonMsg->length - 1] = '}';
-	JSON_APPEND_CHAR(',');
+	JsonAppendChar(pJsonMsg, ',');
 }
 
 void ShadowBuilder_StartArray(JsonMsg_t *pJsonMsg, const char *restrict pKey)
@@ -223,8 +243,18 @@ void ShadowBuilder_StartArray(JsonMsg_t *pJsonMsg, const char *restrict pKey)
 	FRAMEWORK_ASSERT(pKey != NULL);
 	FRAMEWORK_ASSERT(strlen(pKey) > 0);
 
-	JSON_APPEND_KEY(pKey);
-	JSON_APPEND_CHAR('[');
+	JsonAppendKey(pJsonMsg, pKey);
+	JsonAppendChar(pJsonMsg, '[');
+}
+
+void ShadowBuilder_StartArrayKey(JsonMsg_t *pJsonMsg,
+				 const ShadowBuilderKey_t *pKey)
+{
+	FRAMEWORK_ASSERT(pJsonMsg != NULL);
+	FRAMEWORK_ASSERT(pKey != NULL);
+
+	JsonAppendRaw(pJsonMsg, pKey->str, pKey->length);
+	JsonAppendChar(pJsonMsg, '[');
 }
 
 void ShadowBuilder_EndArray(JsonMsg_t *pJsonMsg)
@@ -233,7 +263,7 @@ void ShadowBuilder_EndArray(JsonMsg_t *pJsonMsg)
 	FRAMEWORK_ASSERT(pJsonMsg->buffer[pJsonMsg->length - 1] == ',');
 
 	pJsonMsg->buffer[pJsonMsg->length - 1] = ']';
-	JSON_APPEND_CHAR(',');
+	JsonAppendChar(pJsonMsg, ',');
 }
 
 void ShadowBuilder_AddSensorTableArrayEntry(JsonMsg_t *pJsonMsg,
@@ -244,28 +274,72 @@ void ShadowBuilder_AddSensorTableArrayEntry(JsonMsg_t *pJsonMsg,
 	FRAMEWORK_ASSERT(pAddrStr != NULL);
 	FRAMEWORK_ASSERT(strlen(pAddrStr) > 0);
 
-	JSON_APPEND_CHAR('[');
-	JSON_APPEND_VALUE_STRING(pAddrStr);
-	JSON_APPEND_CHAR(',');
-	JSON_APPEND_U32(Epoch);
-	JSON_APPEND_CHAR(',');
-	JSON_APPEND_STRING(Greenlisted ? "true" : "false");
-	JSON_APPEND_CHAR(']');
-	JSON_APPEND_CHAR(',');
+	char epoch[MAXIMUM_LENGTH_OF_TO_STRING_OUTPUT];
+	size_t epochLength = ToString_Dec(epoch, Epoch);
+	size_t addrLength = strlen(pAddrStr);
+	const char *pState = Greenlisted ? "true" : "false";
+	size_t stateLength = strlen(pState);
+
+	/* The address is hex so it doesn't require escaping. */
+	char *p = JsonReserve(pJsonMsg, strlen("[\"\",,],") + addrLength +
+						epochLength + stateLength);
+	if (p == NULL) {
+		return;
+	}
+	*p++ = '[';
+	*p++ = '"';
+	memcpy(p, pAddrStr, addrLength);
+	p += addrLength;
+	*p++ = '"';
+	*p++ = ',';
+	memcpy(p, epoch, epochLength);
+	p += epochLength;
+	*p++ = ',';
+	memcpy(p, pState, stateLength);
+	p += stateLength;
+	*p++ = ']';
+	*p = ',';
 }
 
 void ShadowBuilder_AddEventLogEntry(JsonMsg_t *pJsonMsg, SensorLogEvent_t *p)
 {
 	FRAMEWORK_ASSERT(pJsonMsg != NULL);
 
-	JSON_APPEND_CHAR('[');
-	JSON_APPEND_HEX8(p->recordType);
-	JSON_APPEND_CHAR(',');
-	JSON_APPEND_U32(p->epoch);
-	JSON_APPEND_CHAR(',');
-	JSON_APPEND_HEX16(p->data);
-	JSON_APPEND_CHAR(']');
-	JSON_APPEND_CHAR(',');
+	char entry[SENSOR_LOG_ENTRY_JSON_STR_SIZE];
+	size_t length = ShadowBuilder_FormatEventLogEntry(entry, p);
+	JsonAppendRaw(pJsonMsg, entry, length);
+}
+
+size_t ShadowBuilder_FormatEventLogEntry(char *pOut, SensorLogEvent_t *p)
+{
+	FRAMEWORK_ASSERT(pOut != NULL);
+
+	char *pStart = pOut;
+	/* ["12",4294967295,"1234"], */
+	*pOut++ = '[';
+	*pOut++ = '"';
+	/* Hex conversion writes a NUL that is overwritten by the next char. */
+	ToString_Hex8(pOut, p->recordType);
+	pOut += HEX8_STR_LEN;
+	*pOut++ = '"';
+	*pOut++ = ',';
+	pOut += ToString_Dec(pOut, p->epoch);
+	*pOut++ = ',';
+	*pOut++ = '"';
+	ToString_Hex16(pOut, p->data);
+	pOut += HEX16_STR_LEN;
+	*pOut++ = '"';
+	*pOut++ = ']';
+	*pOut++ = ',';
+	return pOut - pStart;
+}
+
+void ShadowBuilder_AddRaw(JsonMsg_t *pJsonMsg, const char *pData,
+			  size_t Length)
+{
+	FRAMEWORK_ASSERT(pJsonMsg != NULL);
+
+	JsonAppendRaw(pJsonMsg, pData, Length);
 }
 
 void ShadowBuilder_AddString(JsonMsg_t *pJsonMsg, const char *restrict pKey,
@@ -276,25 +350,49 @@ void ShadowBuilder_AddString(JsonMsg_t *pJsonMsg, const char *restrict pKey,
 	FRAMEWORK_ASSERT(strlen(pKey) > 0);
 	FRAMEWORK_ASSERT(pStr != NULL);
 
-	JSON_APPEND_KEY(pKey);
+	JsonAppendKey(pJsonMsg, pKey);
 	JsonAppendString(pJsonMsg, pStr, false);
-	JSON_APPEND_CHAR(',');
+	JsonAppendChar(pJsonMsg, ',');
 }
 
 /******************************************************************************/
 /* Local Function Definitions                                                 */
 /******************************************************************************/
-static void JsonAppendChar(JsonMsg_t *pJsonMsg, char Character)
+/* Bounds are checked once for each segment.
+ * Returns a pointer to the space reserved in the buffer or NULL.
+ */
+static char *JsonReserve(JsonMsg_t *pJsonMsg, size_t Length)
 {
 	FRAMEWORK_ASSERT(pJsonMsg != NULL);
 	/* Leave room for NULL terminator */
-	if (pJsonMsg->length < (pJsonMsg->size - 1)) {
-		pJsonMsg->buffer[pJsonMsg->length++] = Character;
+	if ((pJsonMsg->length + Length) < pJsonMsg->size) {
+		char *p = &pJsonMsg->buffer[pJsonMsg->length];
+		pJsonMsg->length += Length;
+		return p;
 	} else { /* buffer too small */
 		FRAMEWORK_ASSERT(false);
+		return NULL;
+	}
+}
+
+static void JsonAppendRaw(JsonMsg_t *pJsonMsg, const char *pData,
+			  size_t Length)
+{
+	char *p = JsonReserve(pJsonMsg, Length);
+	if (p != NULL) {
+		memcpy(p, pData, Length);
+	}
+}
+
+static void JsonAppendChar(JsonMsg_t *pJsonMsg, char Character)
+{
+	char *p = JsonReserve(pJsonMsg, 1);
+	if (p != NULL) {
+		*p = Character;
 	}
 }
 
+/* Runs of characters that don't require escaping are copied as a segment. */
 static void JsonAppendString(JsonMsg_t *pJsonMsg, const char *restrict pString,
 			     bool EscapeQuoteChar)
 {
@@ -303,57 +401,112 @@ static void JsonAppendString(JsonMsg_t *pJsonMsg, const char *restrict pString,
 		return;
 	}
 
-	size_t length = strlen(pString);
-	size_t i = 0;
-	/* Leave room for NULL terminator and an escaped char. */
-	while (i < length && (pJsonMsg->length < (pJsonMsg->size - 2))) {
-		/* Escape character handling */
-		switch (pString[i]) {
-		case '"':
-			if (EscapeQuoteChar) {
-				pJsonMsg->buffer[pJsonMsg->length++] = '\\';
+	const char *pRun = pString;
+	const char *pEscape;
+	while (*pRun != 0) {
+		const char *pEnd = pRun;
+		pEscape = NULL;
+		while (*pEnd != 0) {
+			pEscape = EscapeSequence(*pEnd, EscapeQuoteChar);
+			if (pEscape != NULL) {
+				break;
 			}
-			pJsonMsg->buffer[pJsonMsg->length++] = pString[i++];
-			break;
+			pEnd += 1;
+		}
 
-		case '\\':
-			pJsonMsg->buffer[pJsonMsg->length++] = '\\';
-			pJsonMsg->buffer[pJsonMsg->length++] = pString[i++];
-			break;
+		JsonAppendRaw(pJsonMsg, pRun, pEnd - pRun);
 
-		case '\b':
-			pJsonMsg->buffer[pJsonMsg->length++] = '\\';
-			pJsonMsg->buffer[pJsonMsg->length++] = 'b';
-			i += 1;
+		if (*pEnd == 0) {
 			break;
+		}
+		JsonAppendRaw(pJsonMsg, pEscape, strlen(pEscape));
+		pRun = pEnd + 1;
+	}
+}
 
-		case '\f':
-			pJsonMsg->buffer[pJsonMsg->length++] = '\\';
-			pJsonMsg->buffer[pJsonMsg->length++] = 'f';
-			i += 1;
-			break;
+static const char *EscapeSequence(char Character, bool EscapeQuoteChar)
+{
+	switch (Character) {
+	case '"':
+		return EscapeQuoteChar ? "\\\"" : NULL;
+	case '\\':
+		return "\\\\";
+	case '\b':
+		return "\\b";
+	case '\f':
+		return "\\f";
+	case '\n':
+		return "\\n";
+	case '\r':
+		return "\\r";
+	case '\t':
+		return "\\t";
+	default:
+		return NULL;
+	}
+}
 
-		case '\n':
-			pJsonMsg->buffer[pJsonMsg->length++] = '\\';
-			pJsonMsg->buffer[pJsonMsg->length++] = 'n';
-			i += 1;
-			break;
+static void JsonAppendKey(JsonMsg_t *pJsonMsg, const char *restrict pKey)
+{
+	JsonAppendChar(pJsonMsg, '"');
+	JsonAppendString(pJsonMsg, pKey, true);
+	JsonAppendRaw(pJsonMsg, "\":", strlen("\":"));
+}
 
-		case '\r':
-			pJsonMsg->buffer[pJsonMsg->length++] = '\\';
-			pJsonMsg->buffer[pJsonMsg->length++] = 'r';
-			i += 1;
-			break;
+/* <value>, */
+static void JsonAppendUint32Field(JsonMsg_t *pJsonMsg, uint32_t Value,
+				  bool Negative)
+{
+	char str[MAXIMUM_LENGTH_OF_TO_STRING_OUTPUT];
+	size_t length = ToString_Dec(str, Value);
 
-		case '\t':
-			pJsonMsg->buffer[pJsonMsg->length++] = '\\';
-			pJsonMsg->buffer[pJsonMsg->length++] = 't';
-			i += 1;
-			break;
+	char *p = JsonReserve(pJsonMsg, length + (Negative ? 2 : 1));
+	if (p == NULL) {
+		return;
+	}
+	if (Negative) {
+		*p++ = '-';
+	}
+	memcpy(p, str, length);
+	p[length] = ',';
+}
 
-		default:
-			pJsonMsg->buffer[pJsonMsg->length++] = pString[i++];
-			break;
-		}
+/* "x.y.z", */
+static void JsonAppendVersionField(JsonMsg_t *pJsonMsg, uint8_t Major,
+				   uint8_t Minor, uint8_t Build)
+{
+	char str[3][MAXIMUM_LENGTH_OF_TO_STRING_OUTPUT];
+	size_t length[3];
+	length[0] = ToString_Dec(str[0], Major);
+	length[1] = ToString_Dec(str[1], Minor);
+	length[2] = ToString_Dec(str[2], Build);
+
+	char *p = JsonReserve(pJsonMsg, strlen("\"..\",") + length[0] +
+						length[1] + length[2]);
+	if (p == NULL) {
+		return;
+	}
+	*p++ = '"';
+	size_t i;
+	for (i = 0; i < ARRAY_SIZE(length); i++) {
+		memcpy(p, str[i], length[i]);
+		p += length[i];
+		*p++ = (i < (ARRAY_SIZE(length) - 1)) ? '.' : '"';
+	}
+	*p = ',';
+}
+
+static void JsonAppendValueField(JsonMsg_t *pJsonMsg,
+				 const char *restrict pValue,
+				 bool IsNotString)
+{
+	if (IsNotString) {
+		/* uint32_t, int32_t, float, ... */
+		JsonAppendString(pJsonMsg, pValue, true);
+	} else {
+		JsonAppendChar(pJsonMsg, '"');
+		JsonAppendString(pJsonMsg, pValue, true);
+		JsonAppendChar(pJsonMsg, '"');
 	}
+	JsonAppendChar(pJsonMsg, ',');
 }
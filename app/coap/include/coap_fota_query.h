@@ -44,6 +44,14 @@ typedef struct coap_fota_query {
 	int32_t offset;
 	/* set by coap query size */
 	int32_t size;
+	/* set by firmware download */
+	uint32_t throughput;
+	uint32_t retransmits;
+
+	/* set by the FOTA task when the image is written to the secondary
+	 * slot instead of the file system
+	 */
+	bool direct;
 
 	/* not part of API - internal/housekeeping use only */
 	bool block_xfer;
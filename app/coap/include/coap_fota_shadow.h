@@ -40,6 +40,8 @@ enum fota_image_type { APP_IMAGE_TYPE = 0, MODEM_IMAGE_TYPE };
 #define SHADOW_FOTA_BRIDGE_STR               "fwBridge"
 #define SHADOW_FOTA_PRODUCT_STR              "fwProduct"
 #define SHADOW_FOTA_BLOCKSIZE_STR            "fwBlockSize"
+#define SHADOW_FOTA_THROUGHPUT_STR           "fwThroughput"
+#define SHADOW_FOTA_RETRANSMITS_STR          "fwRetransmits"
 #define SHADOW_FOTA_ERROR_STR                "errorCount"
 /* clang-format on */
 
@@ -121,6 +123,12 @@ void coap_fota_set_host(const char *p, size_t length);
  */
 void coap_fota_set_blocksize(uint32_t value);
 
+/**
+ * @brief Set the bytes per second and the number of block requests that
+ * were sent again for the last download.
+ */
+void coap_fota_set_download_stats(uint32_t throughput, uint32_t retransmits);
+
 /**
  * @brief Set the error count
  */
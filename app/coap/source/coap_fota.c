@@ -25,6 +25,13 @@ LOG_MODULE_REGISTER(coap_fota, CONFIG_COAP_FOTA_LOG_LEVEL);
 #include <net/net_ip.h>
 #include <net/udp.h>
 #include <net/coap.h>
+#include <fs/fs.h>
+#ifdef CONFIG_COAP_FOTA_DIRECT_TO_FLASH
+#include <device.h>
+#include <dfu/flash_img.h>
+#include <storage/flash_map.h>
+#include <storage/stream_flash.h>
+#endif
 
 #ifdef CONFIG_COAP_FOTA_BASE64
 #include <mbedtls/base64.h>
@@ -35,6 +42,9 @@ LOG_MODULE_REGISTER(coap_fota, CONFIG_COAP_FOTA_LOG_LEVEL);
 #include "coap_fota_query.h"
 #include "coap_fota_json_parser.h"
 #include "coap_fota.h"
+#ifdef CONFIG_FOTA_STREAMING_HASH
+#include "fota_hash.h"
+#endif
 
 /******************************************************************************/
 /* Local Constant, Macro and Type Definitions                                 */
@@ -48,11 +58,28 @@ LOG_MODULE_REGISTER(coap_fota, CONFIG_COAP_FOTA_LOG_LEVEL);
 #define COAP_ACK_MSG_SIZE COAP_MIN_HDR_SIZE
 #define COAP_CON_MSG_SIZE (COAP_MIN_HDR_SIZE + COAP_TOKEN_SIZE)
 
+/* Largest block after it is decoded */
+#ifdef CONFIG_COAP_FOTA_BASE64
+#define MAX_DECODED_BLOCK_SIZE CONFIG_COAP_FOTA_BASE64_TO_BIN_SIZE
+#else
+#define MAX_DECODED_BLOCK_SIZE (16 << CONFIG_COAP_FOTA_MAX_BLOCK_SIZE)
+#endif
+
+/* The write buffer only holds whole blocks.  A resumed download requests
+ * the block at the end of the file so the file can't end inside a block.
+ */
+BUILD_ASSERT(CONFIG_COAP_FOTA_WRITE_BUFFER_SIZE >= MAX_DECODED_BLOCK_SIZE,
+	     "Write buffer must hold a block");
+
+#ifdef CONFIG_COAP_FOTA_DIRECT_TO_FLASH
+BUILD_ASSERT((CONFIG_COAP_FOTA_DIRECT_CHECKPOINT_SIZE %
+	      CONFIG_IMG_BLOCK_BUF_SIZE) == 0,
+	     "Checkpoint must be written when it is saved");
+#endif
+
 #define COAP_OCTET_STREAM_FMT 42
 #define COAP_JSON_FMT 50
 
-#define LAST_BLOCK_RETVAL 1
-
 /* clang-format off */
 #define PRODUCT_QUERY_STR   "productId"
 #define IMAGE_QUERY_STR     "imageId"
@@ -89,6 +116,24 @@ static const sec_tag_t COAP_FOTA_TLS_TAG_LIST[] = {
 		break;                                                         \
 	}
 
+/* The block number is in the upper bits of the Block2 option value and the
+ * size exponent is in the lower three.
+ */
+#define BLOCK2_NUM(opt) ((uint32_t)(opt) >> 4)
+#define BLOCK2_SZX(opt) ((enum coap_block_size)((opt)&0x7))
+
+/* A block request that is in flight or a reply that arrived before the
+ * blocks in front of it.
+ */
+typedef struct block_slot {
+	uint32_t num;
+	int64_t sent;
+	uint32_t retries;
+	bool received;
+	uint16_t length;
+	uint8_t payload[CONFIG_COAP_FOTA_MAX_RESPONSE_SIZE];
+} block_slot_t;
+
 typedef struct coap_fota {
 	bool credentials_loaded;
 	sock_info_t sock_info;
@@ -111,6 +156,28 @@ typedef struct coap_fota {
 	uint8_t binary_payload[CONFIG_COAP_FOTA_BASE64_TO_BIN_SIZE];
 	size_t binary_length;
 #endif
+
+	block_slot_t window[CONFIG_COAP_FOTA_WINDOW_SIZE];
+	uint32_t next_send;
+	uint32_t next_write;
+	uint32_t end_block;
+	uint32_t retransmits;
+
+	struct fs_file_t file;
+	uint8_t write_buffer[CONFIG_COAP_FOTA_WRITE_BUFFER_SIZE];
+	size_t write_length;
+	size_t write_limit;
+
+#ifdef CONFIG_FOTA_STREAMING_HASH
+	struct fota_hash hash;
+#endif
+
+#ifdef CONFIG_COAP_FOTA_DIRECT_TO_FLASH
+	bool direct;
+	struct flash_img_context flash_ctx;
+	size_t flash_offset;
+	size_t checkpoint_interval;
+#endif
 } coap_fota_t;
 
 /******************************************************************************/
@@ -125,8 +192,13 @@ static coap_fota_t cf;
 static int get_payload(void);
 static int send_get_size(coap_fota_query_t *p);
 static int send_get_hash(coap_fota_query_t *p);
-static int send_get_firmware(coap_fota_query_t *p);
+static int send_get_firmware(coap_fota_query_t *p, uint32_t num);
 static int process_get_firmware_reply(coap_fota_query_t *p);
+static int adapt_block_size(uint32_t num, enum coap_block_size szx);
+static bool receive_timed_out(int r);
+static int fill_window(coap_fota_query_t *p);
+static int retransmit_expired(coap_fota_query_t *p);
+static int write_received_blocks(void);
 
 static int coap_start_client(coap_fota_query_t *p);
 static void coap_stop_client(void);
@@ -147,13 +219,21 @@ static int packet_append_unsigned_query(const char *name, int value);
 static bool valid_string_parameter(const char *str);
 
 static void coap_block_context_init(coap_fota_query_t *p);
-static int coap_block_context_update(void);
 
 static int packet_append_get_size_query(coap_fota_query_t *p);
 static int packet_append_get_hash_query(coap_fota_query_t *p);
 static int packet_append_get_firmware_query(coap_fota_query_t *p);
 
-static int file_manager(const char *abs_path, bool last_block);
+static int file_open(const char *abs_path, int32_t offset);
+static void file_close(void);
+#ifdef CONFIG_COAP_FOTA_DIRECT_TO_FLASH
+static int flash_open(const char *abs_path, int32_t offset);
+static int flash_write(const uint8_t *data, size_t length);
+static int flash_flush(void);
+#endif
+static int file_manager(const uint8_t *data, size_t length);
+static int file_write(const uint8_t *data, size_t length);
+static int file_flush(void);
 
 /******************************************************************************/
 /* Global Function Definitions                                                */
@@ -243,28 +323,60 @@ int coap_fota_get_firmware(coap_fota_query_t *p)
 	(void)fsu_build_full_name(abs_path, sizeof(abs_path), p->fs_path,
 				  p->filename);
 	p->block_xfer = true;
+	p->throughput = 0;
+	p->retransmits = 0;
 	cf.reply_payload_length = 0;
 	coap_block_context_init(p);
-	int r = coap_start_client(p);
+	int64_t start = k_uptime_get();
+	int r;
+#ifdef CONFIG_COAP_FOTA_DIRECT_TO_FLASH
+	cf.direct = p->direct;
+	if (cf.direct) {
+		r = flash_open(abs_path, p->offset);
+	} else
+#endif
+	{
+		r = file_open(abs_path, p->offset);
+	}
+	if (r == 0) {
+		r = coap_start_client(p);
+	}
 	while (r == 0) {
-		r = send_get_firmware(p);
+		/* Keep the window full of block requests. */
+		r = fill_window(p);
 		BREAK_ON_ERROR(r);
 
-		/* Append the file before waiting for the next chunk. */
-		if (cf.reply_payload_length > 0) {
-			r = file_manager(abs_path, false);
-			BREAK_ON_ERROR(r);
+		/* A receive timeout isn't fatal.  The blocks that haven't been
+		 * answered are requested again.
+		 */
+		r = process_get_firmware_reply(p);
+		if (receive_timed_out(r)) {
+			LOG_DBG("No block received");
+			r = 0;
 		}
+		BREAK_ON_ERROR(r);
 
-		r = process_get_firmware_reply(p);
-		if (r == LAST_BLOCK_RETVAL) {
-			/* All blocks but the last are pipelined. */
-			r = file_manager(abs_path, true);
+		r = write_received_blocks();
+		BREAK_ON_ERROR(r);
+
+		if (cf.next_write >= cf.end_block) {
+			r = file_flush();
 			break;
 		}
-		BREAK_ON_ERROR(r);
+
+		r = retransmit_expired(p);
 	}
 
+	file_close();
+
+	int64_t elapsed = k_uptime_delta(&start);
+	p->throughput = (uint32_t)(((uint64_t)cf.payload_total * MSEC_PER_SEC) /
+				   MAX(elapsed, 1));
+	p->retransmits = cf.retransmits;
+	LOG_INF("Downloaded %u bytes in %u ms (%u B/s) with %u retransmits",
+		cf.payload_total, (uint32_t)elapsed, p->throughput,
+		p->retransmits);
+
 	LOG_DBG("payload_total: %u", cf.payload_total);
 	size_t expected = (p->size - p->offset);
 	if (cf.payload_total != expected) {
@@ -295,7 +407,11 @@ static int process_coap_reply(coap_fota_query_t *p)
 
 		r = coap_packet_parse(&cf.reply, cf.reply_buffer,
 				      (uint16_t)cf.reply_length, NULL, 0);
-		BREAK_ON_ERROR(r);
+		if (r < 0) {
+			LOG_ERR("Unable to parse reply (%d)", r);
+			r = -EBADMSG;
+			break;
+		}
 
 		/* The CoAP bridge acks the request and then forwards it on. */
 		uint8_t type = coap_header_get_type(&cf.reply);
@@ -338,59 +454,347 @@ static void coap_block_context_init(coap_fota_query_t *p)
 	cf.block_context.current = p->offset;
 #endif
 
+	/* Blocks are requested by number.  The window slot of a block is its
+	 * number modulo the window size.
+	 */
+	size_t block_bytes =
+		coap_block_size_to_bytes(cf.block_context.block_size);
+	cf.next_send = cf.block_context.current / block_bytes;
+	cf.next_write = cf.next_send;
+	cf.end_block = ceiling_fraction(cf.block_context.total_size,
+					block_bytes);
+	cf.retransmits = 0;
+	memset(cf.window, 0, sizeof(cf.window));
+
 	LOG_WRN("Block xfer init %d of %d", cf.block_context.current,
 		cf.block_context.total_size);
 }
 
-static int coap_block_context_update(void)
+static int process_get_firmware_reply(coap_fota_query_t *p)
 {
-	LOG_DBG("%d of %d", cf.block_context.current,
-		cf.block_context.total_size);
+	int r = 0;
+	while (1) {
+		r = process_coap_reply(p);
+		if (r == -EBADMSG) {
+			/* Ignore it, the block is requested again */
+			r = 0;
+			break;
+		}
+		BREAK_ON_ERROR(r);
 
-	int r = coap_update_from_block(&cf.reply, &cf.block_context);
-	if (r < 0) {
-		LOG_ERR("Update block error %d", r);
-		/* Is data formatted as expected? */
-	} else {
-		size_t block_offset =
-			coap_next_block(&cf.reply, &cf.block_context);
-		if (block_offset == 0) {
-			LOG_DBG("Last Block");
-			r = LAST_BLOCK_RETVAL;
+		/* In a block-wise transfer the only payload is the block data. */
+		if (get_payload() < 0) {
+			r = 0;
+			break;
+		}
+
+		int opt = coap_get_option_int(&cf.reply, COAP_OPTION_BLOCK2);
+		if (opt < 0) {
+			LOG_ERR("Reply is missing block2 option");
+			r = 0;
+			break;
 		}
+
+		uint32_t num = BLOCK2_NUM(opt);
+		if (BLOCK2_SZX(opt) != cf.block_context.block_size) {
+			r = adapt_block_size(num, BLOCK2_SZX(opt));
+			if (r != 0) {
+				/* Aborted or not the head of the window */
+				r = MIN(r, 0);
+				break;
+			}
+		}
+
+		block_slot_t *slot =
+			&cf.window[num % CONFIG_COAP_FOTA_WINDOW_SIZE];
+		r = 0;
+		if (num < cf.next_write || num >= cf.next_send ||
+		    slot->num != num || slot->received) {
+			/* Reply to a request that was sent again */
+			LOG_DBG("Duplicate block %u", num);
+			break;
+		}
+
+		if (cf.reply_payload_length > sizeof(slot->payload)) {
+			LOG_ERR("Block %u is too large", num);
+			r = -EMSGSIZE;
+			break;
+		}
+
+		memcpy(slot->payload, cf.reply_payload_ptr,
+		       cf.reply_payload_length);
+		slot->length = cf.reply_payload_length;
+		slot->received = true;
+		LOG_DBG("Block %u of %u", num, cf.end_block);
+		break;
 	}
 	return r;
 }
 
-static int process_get_firmware_reply(coap_fota_query_t *p)
+/* A server may answer with a smaller block than was requested (RFC 7959
+ * 2.2).  The block number of the reply is in units of the smaller size.  The
+ * transfer continues at that size from the first block that hasn't been
+ * written; replies to the requests already in flight are ignored.
+ *
+ * Returns 0 when num is the first block of the new window and 1 when the
+ * reply is ignored.
+ */
+static int adapt_block_size(uint32_t num, enum coap_block_size szx)
+{
+	size_t old_bytes =
+		coap_block_size_to_bytes(cf.block_context.block_size);
+	size_t new_bytes = coap_block_size_to_bytes(szx);
+
+	if (szx > cf.block_context.block_size) {
+		LOG_ERR("Block size %u is larger than requested (%u)",
+			new_bytes, old_bytes);
+		return -EBADMSG;
+	}
+
+	if ((num * new_bytes) != (cf.next_write * old_bytes)) {
+		return 1;
+	}
+
+	LOG_WRN("Block size changed from %u to %u", old_bytes, new_bytes);
+	cf.block_context.block_size = szx;
+	cf.block_context.current = num * new_bytes;
+	cf.next_write = num;
+	cf.next_send = num + 1;
+	cf.end_block =
+		ceiling_fraction(cf.block_context.total_size, new_bytes);
+	memset(cf.window, 0, sizeof(cf.window));
+
+	block_slot_t *slot = &cf.window[num % CONFIG_COAP_FOTA_WINDOW_SIZE];
+	slot->num = num;
+	slot->sent = k_uptime_get();
+	return 0;
+}
+
+/* The socket layer reports a receive timeout as -EAGAIN or -ETIMEDOUT */
+static bool receive_timed_out(int r)
+{
+	return (r == -EAGAIN || r == -ETIMEDOUT);
+}
+
+static int fill_window(coap_fota_query_t *p)
 {
 	int r = 0;
-	while (1) {
-		r = process_coap_reply(p);
+	while (cf.next_send < cf.end_block &&
+	       cf.next_send < cf.next_write + CONFIG_COAP_FOTA_WINDOW_SIZE) {
+		block_slot_t *slot =
+			&cf.window[cf.next_send % CONFIG_COAP_FOTA_WINDOW_SIZE];
+		slot->num = cf.next_send;
+		slot->retries = 0;
+		slot->received = false;
+		slot->length = 0;
+		slot->sent = k_uptime_get();
+
+		r = send_get_firmware(p, slot->num);
 		BREAK_ON_ERROR(r);
 
-		/* In a block-wise transfer the only payload is the block data. */
-		r = get_payload();
+		cf.next_send += 1;
+	}
+	/* Send returns the number of bytes sent */
+	return MIN(r, 0);
+}
+
+static int retransmit_expired(coap_fota_query_t *p)
+{
+	int r = 0;
+	uint32_t num;
+	for (num = cf.next_write; num < cf.next_send; num++) {
+		block_slot_t *slot =
+			&cf.window[num % CONFIG_COAP_FOTA_WINDOW_SIZE];
+		int64_t waiting = k_uptime_get() - slot->sent;
+		if (slot->received ||
+		    waiting < CONFIG_COAP_FOTA_RESPONSE_TIMEOUT_MS) {
+			continue;
+		}
+
+		if (slot->retries >= CONFIG_COAP_FOTA_MAX_RETRANSMITS) {
+			LOG_ERR("No reply for block %u", num);
+			r = -ETIMEDOUT;
+			break;
+		}
+
+		slot->retries += 1;
+		slot->sent = k_uptime_get();
+		cf.retransmits += 1;
+		LOG_WRN("Requesting block %u again", num);
+		r = send_get_firmware(p, num);
 		BREAK_ON_ERROR(r);
+	}
+	return MIN(r, 0);
+}
+
+/* Blocks are written in order.  A block that arrived early stays in its
+ * window slot until the blocks in front of it have been written.
+ */
+static int write_received_blocks(void)
+{
+	int r = 0;
+	while (cf.next_write < cf.next_send) {
+		uint32_t i = cf.next_write % CONFIG_COAP_FOTA_WINDOW_SIZE;
+		block_slot_t *slot = &cf.window[i];
+		if (!slot->received) {
+			break;
+		}
 
-		r = coap_block_context_update();
+		r = file_manager(slot->payload, slot->length);
 		BREAK_ON_ERROR(r);
 
-		break;
+		slot->received = false;
+		cf.next_write += 1;
 	}
 	return r;
 }
 
-/* The response time averaged 250 ms for each packet regardless of
- * size.  With the pipeline this means that opening, appending, and closing
- * the file takes the same amount of time as opening the file once, appending,
- * and automatic file system flushes.  This is because the extra time for the
- * close is absorbed in the wait.
+/* The file stays open for the whole download.  Blocks are collected in the
+ * write buffer and the file is synced each time the buffer is written, so
+ * the writes line up with the erase size of the file system.
  *
- * When power was removed during a download, the close method rarely resulted
- * in corrupted files that couldn't be restarted.
+ * When power was removed during a download, closing the file after every
+ * block rarely resulted in corrupted files that couldn't be restarted.  A sync
+ * gives the same guarantee; at most one buffer is lost and the download
+ * resumes from the size of the file.
  */
-static int file_manager(const char *abs_path, bool last_block)
+static int file_open(const char *abs_path, int32_t offset)
+{
+	fs_file_t_init(&cf.file);
+	int r = fs_open(&cf.file, abs_path, FS_O_CREATE | FS_O_RDWR);
+	if (r < 0) {
+		LOG_ERR("Unable to open %s (%d)", log_strdup(abs_path), r);
+		return r;
+	}
+
+	r = fs_seek(&cf.file, 0, FS_SEEK_END);
+	if (r < 0) {
+		LOG_ERR("Unable to seek to end of file (%d)", r);
+		(void)fs_close(&cf.file);
+		return r;
+	}
+
+#ifdef CONFIG_FOTA_STREAMING_HASH
+	/* If there isn't a hash state for a resumed file, then the file is
+	 * read when it is verified.
+	 */
+	(void)fota_hash_start(&cf.hash, abs_path, offset);
+#endif
+
+	/* A resumed file may not end on a buffer boundary */
+	cf.write_length = 0;
+	cf.write_limit = sizeof(cf.write_buffer) -
+			 (offset % sizeof(cf.write_buffer));
+	return 0;
+}
+
+static void file_close(void)
+{
+#ifdef CONFIG_COAP_FOTA_DIRECT_TO_FLASH
+	if (cf.direct) {
+		return;
+	}
+#endif
+
+	if (cf.file.filep != NULL) {
+		(void)fs_close(&cf.file);
+	}
+}
+
+#ifdef CONFIG_COAP_FOTA_DIRECT_TO_FLASH
+/* The image is written to the secondary slot as it is received.  Sectors are
+ * erased just ahead of the write pointer (IMG_ERASE_PROGRESSIVELY).
+ *
+ * The hash state is the resume metadata.  It is saved at checkpoints that
+ * are on page boundaries and have been written to the slot, and when the
+ * image is complete.  The FOTA task checks the slot against the expected
+ * hash before a download is resumed at a checkpoint.
+ */
+static int flash_open(const char *abs_path, int32_t offset)
+{
+	int r = flash_img_init(&cf.flash_ctx);
+	if (r < 0) {
+		LOG_ERR("Unable to init flash image (%d)", r);
+		return r;
+	}
+
+	r = fota_hash_start(&cf.hash, abs_path, offset);
+	if (r < 0) {
+		return r;
+	}
+
+	/* flash_img doesn't have a seek, so a resumed download starts the
+	 * stream again at the checkpoint.  The page at the checkpoint is
+	 * erased before the first write.
+	 */
+	cf.flash_offset = offset;
+	if (offset > 0) {
+		const struct flash_area *fa = cf.flash_ctx.flash_area;
+		r = stream_flash_init(&cf.flash_ctx.stream,
+				      device_get_binding(fa->fa_dev_name),
+				      cf.flash_ctx.buf,
+				      CONFIG_IMG_BLOCK_BUF_SIZE,
+				      fa->fa_off + offset, fa->fa_size - offset,
+				      NULL);
+		if (r < 0) {
+			LOG_ERR("Unable to resume flash image (%d)", r);
+			return r;
+		}
+	}
+
+	/* A resumed download requests the block at the checkpoint, so
+	 * progress is only saved where a block ends on a checkpoint.  Base64
+	 * blocks decode to a multiple of 3 bytes, so that isn't every
+	 * checkpoint.  A smaller block size from the server divides this.
+	 */
+	size_t block = coap_block_size_to_bytes(cf.block_context.block_size);
+#ifdef CONFIG_COAP_FOTA_BASE64
+	block = (block / 4) * 3;
+#endif
+	size_t interval = CONFIG_COAP_FOTA_DIRECT_CHECKPOINT_SIZE;
+	while ((interval % block) != 0) {
+		interval += CONFIG_COAP_FOTA_DIRECT_CHECKPOINT_SIZE;
+	}
+	cf.checkpoint_interval = interval;
+
+	LOG_DBG("Writing image to secondary slot at %d", offset);
+	return 0;
+}
+
+static int flash_write(const uint8_t *data, size_t length)
+{
+	int r = flash_img_buffered_write(&cf.flash_ctx, data, length, false);
+	if (r < 0) {
+		LOG_ERR("Unable to write to slot (%d)", r);
+		return r;
+	}
+
+	fota_hash_update(&cf.hash, data, length);
+	cf.payload_total += length;
+
+	/* The buffer of the stream is empty at a checkpoint */
+	if ((cf.hash.offset % cf.checkpoint_interval) == 0 &&
+	    (cf.flash_offset + flash_img_bytes_written(&cf.flash_ctx)) ==
+		    cf.hash.offset) {
+		(void)fota_hash_save(&cf.hash);
+	}
+	return 0;
+}
+
+static int flash_flush(void)
+{
+	int r = flash_img_buffered_write(&cf.flash_ctx, cf.write_buffer, 0,
+					 true);
+	if (r < 0) {
+		LOG_ERR("Unable to flush slot (%d)", r);
+		return r;
+	}
+
+	return fota_hash_save(&cf.hash);
+}
+#endif
+
+static int file_manager(const uint8_t *data, size_t length)
 {
 	int r = 0;
 #ifdef CONFIG_COAP_FOTA_BASE64
@@ -398,29 +802,90 @@ static int file_manager(const char *abs_path, bool last_block)
 	 * If an unexpected size is received, then the hash will fail.
 	 */
 	r = mbedtls_base64_decode(cf.binary_payload, sizeof(cf.binary_payload),
-				  &cf.binary_length, cf.reply_payload_ptr,
-				  cf.reply_payload_length);
+				  &cf.binary_length, data, length);
 	if (r == 0) {
-		r = fsu_append_abs(abs_path, cf.binary_payload,
-				   cf.binary_length);
-		if (r > 0) {
-			r = 0;
-			cf.payload_total += cf.binary_length;
-		} else {
-			r = -1;
-		}
+		r = file_write(cf.binary_payload, cf.binary_length);
 	} else {
 		LOG_ERR("Base64 conversion error");
 		r = -1;
 	}
 #else
-	r = fsu_append_abs(abs_path, (void *)cf.reply_payload_ptr,
-			   cf.reply_payload_length);
-	cf.payload_total += cf.reply_payload_length;
+	r = file_write(data, length);
 #endif
 	return r;
 }
 
+static int file_write(const uint8_t *data, size_t length)
+{
+#ifdef CONFIG_COAP_FOTA_DIRECT_TO_FLASH
+	if (cf.direct) {
+		return flash_write(data, length);
+	}
+#endif
+
+	/* Blocks aren't split across flushes.  Otherwise, when the block size
+	 * doesn't divide the buffer size, the file could end in the middle of
+	 * a block and a resume would append the whole block again.
+	 */
+	int r = 0;
+	if (length > sizeof(cf.write_buffer)) {
+		LOG_ERR("Block too large for write buffer");
+		return -EINVAL;
+	}
+
+	if ((cf.write_length + length) > cf.write_limit) {
+		r = file_flush();
+	}
+
+	if (r == 0) {
+		memcpy(&cf.write_buffer[cf.write_length], data, length);
+		cf.write_length += length;
+
+		if (cf.write_length >= cf.write_limit) {
+			r = file_flush();
+		}
+	}
+	return r;
+}
+
+static int file_flush(void)
+{
+#ifdef CONFIG_COAP_FOTA_DIRECT_TO_FLASH
+	if (cf.direct) {
+		return flash_flush();
+	}
+#endif
+
+	if (cf.write_length == 0) {
+		return 0;
+	}
+
+	ssize_t written = fs_write(&cf.file, cf.write_buffer, cf.write_length);
+	if (written != cf.write_length) {
+		LOG_ERR("Unable to write file (%d)", (int)written);
+		return (written < 0) ? (int)written : -ENOSPC;
+	}
+
+	int r = fs_sync(&cf.file);
+	if (r < 0) {
+		LOG_ERR("Unable to sync file (%d)", r);
+		return r;
+	}
+
+#ifdef CONFIG_FOTA_STREAMING_HASH
+	/* The state is saved after the data is synced so that it never covers
+	 * more than the file.
+	 */
+	fota_hash_update(&cf.hash, cf.write_buffer, cf.write_length);
+	(void)fota_hash_save(&cf.hash);
+#endif
+
+	cf.payload_total += cf.write_length;
+	cf.write_length = 0;
+	cf.write_limit = sizeof(cf.write_buffer);
+	return 0;
+}
+
 static void coap_hexdump(const uint8_t *str, const uint8_t *packet,
 			 size_t length)
 {
@@ -698,8 +1163,14 @@ static int packet_append_get_hash_query(coap_fota_query_t *p)
 	return r;
 }
 
-static int send_get_firmware(coap_fota_query_t *p)
+static int send_get_firmware(coap_fota_query_t *p, uint32_t num)
 {
+	/* The block context of the transfer isn't advanced by the replies.
+	 * It is copied so that any block can be requested.
+	 */
+	struct coap_block_context ctx = cf.block_context;
+	ctx.current = num * coap_block_size_to_bytes(ctx.block_size);
+
 	int r = 0;
 	while (1) {
 		r = packet_start(p, COAP_METHOD_GET);
@@ -708,7 +1179,7 @@ static int send_get_firmware(coap_fota_query_t *p)
 		r = packet_append_get_firmware_query(p);
 		BREAK_ON_ERROR(r);
 
-		r = coap_append_block2_option(&cf.request, &cf.block_context);
+		r = coap_append_block2_option(&cf.request, &ctx);
 		if (r < 0) {
 			LOG_ERR("Unable to add block2 option.");
 			break;
@@ -29,18 +29,22 @@ LOG_MODULE_REGISTER(coap_fota_json_parser,
 /******************************************************************************/
 int coap_fota_json_parser_get_size(const char *p, const char *name)
 {
+	struct jsmn_context ctx;
+	struct jsmn_cursor cursor;
 	int result = -1;
 
-	jsmn_start(p);
-	if (jsmn_valid()) {
-		jsmn_find_type("result", JSMN_OBJECT, NEXT_PARENT);
-		int location =
-			jsmn_find_type(name, JSMN_PRIMITIVE, NEXT_PARENT);
+	jsmn_start(&ctx, p);
+	jsmn_reset_index(&cursor);
+	if (jsmn_valid(&ctx)) {
+		jsmn_find_type(&ctx, &cursor, "result", JSMN_OBJECT,
+			       NEXT_PARENT);
+		int location = jsmn_find_type(&ctx, &cursor, name,
+					      JSMN_PRIMITIVE, NEXT_PARENT);
 		if (location > 0) {
-			result = jsmn_convert_uint(location);
+			result = jsmn_convert_uint(&ctx, location);
 		}
 	}
-	jsmn_end();
+	jsmn_end(&ctx);
 
 	return result;
 }
@@ -48,6 +52,8 @@ int coap_fota_json_parser_get_size(const char *p, const char *name)
 int coap_fota_json_parser_get_hash(uint8_t hash[FSU_HASH_SIZE], const char *p,
 				   const char *name)
 {
+	struct jsmn_context ctx;
+	struct jsmn_cursor cursor;
 	int result = -1;
 	memset(hash, 0, FSU_HASH_SIZE);
 
@@ -59,18 +65,21 @@ int coap_fota_json_parser_get_hash(uint8_t hash[FSU_HASH_SIZE], const char *p,
 	* "protocol-version": 1
 	* }
 	*/
-	jsmn_start(p);
-	if (jsmn_valid()) {
-		jsmn_find_type("result", JSMN_OBJECT, NEXT_PARENT);
-		int location = jsmn_find_type(name, JSMN_STRING, NEXT_PARENT);
+	jsmn_start(&ctx, p);
+	jsmn_reset_index(&cursor);
+	if (jsmn_valid(&ctx)) {
+		jsmn_find_type(&ctx, &cursor, "result", JSMN_OBJECT,
+			       NEXT_PARENT);
+		int location = jsmn_find_type(&ctx, &cursor, name, JSMN_STRING,
+					      NEXT_PARENT);
 		if (location > 0) {
-			size_t length = hex2bin(jsmn_string(location),
-						jsmn_strlen(location), hash,
-						FSU_HASH_SIZE);
+			size_t length = hex2bin(jsmn_string(&ctx, location),
+						jsmn_strlen(&ctx, location),
+						hash, FSU_HASH_SIZE);
 			result = (length == FSU_HASH_SIZE) ? 0 : -1;
 		}
 	}
-	jsmn_end();
+	jsmn_end(&ctx);
 
 	return result;
 }
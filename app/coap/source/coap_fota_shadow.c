@@ -45,6 +45,8 @@ typedef struct fota_shadow {
 	fota_shadow_image_t modem;
 	char bridge[CONFIG_COAP_FOTA_MAX_PARAMETER_SIZE];
 	uint32_t blocksize;
+	uint32_t throughput;
+	uint32_t retransmits;
 	bool null_host;
 	bool null_blocksize;
 	bool json_update_request;
@@ -79,13 +81,15 @@ typedef struct fota_shadow {
 	"\"" SHADOW_FOTA_MODEM_STR "\":" SHADOW_FOTA_IMAGE_FMT_STR ","         \
 	"\"" SHADOW_FOTA_BRIDGE_STR "\":\"%s\","                               \
 	"\"" SHADOW_FOTA_PRODUCT_STR "\":\"%s\","                              \
-	"\"" SHADOW_FOTA_BLOCKSIZE_STR "\":%u" SHADOW_FOTA_END
+	"\"" SHADOW_FOTA_BLOCKSIZE_STR "\":%u,"                              \
+	"\"" SHADOW_FOTA_THROUGHPUT_STR "\":%u,"                             \
+	"\"" SHADOW_FOTA_RETRANSMITS_STR "\":%u" SHADOW_FOTA_END
 
 #define SHADOW_FOTA_FMT_STR_MAX_CONVERSION_SIZE                                \
 	(sizeof(SHADOW_FOTA_FMT_STR) +                                         \
 	 (2 * SHADOW_FOTA_IMAGE_FMT_MAX_CONVERSION_SIZE) +                     \
 	 (2 * CONFIG_COAP_FOTA_MAX_PARAMETER_SIZE) +                           \
-	 INT_CONVERSION_MAX_STR_LEN)
+	 (3 * INT_CONVERSION_MAX_STR_LEN))
 
 /* The delta topic is processed.  However, desired should still be cleared when
  * it has been processed.
@@ -325,6 +329,16 @@ void coap_fota_set_blocksize(uint32_t value)
 	k_mutex_unlock(&fota_shadow_mutex);
 }
 
+void coap_fota_set_download_stats(uint32_t throughput, uint32_t retransmits)
+{
+	bool updated = set_shadow_uint32(&fota_shadow.throughput, throughput);
+	updated |= set_shadow_uint32(&fota_shadow.retransmits, retransmits);
+	if (updated) {
+		LOG_DBG("throughput: %u B/s retransmits: %u", throughput,
+			retransmits);
+	}
+}
+
 bool coap_fota_request(enum fota_image_type type)
 {
 	bool request = false;
@@ -500,13 +514,19 @@ static void fota_shadow_handler(void)
 			 fota_shadow.modem.downloaded_filename,
 			 fota_shadow.modem.start, fota_shadow.modem.switchover,
 			 fota_shadow.modem.error_count, fota_shadow.bridge,
-			 product, fota_shadow.blocksize);
+			 product, fota_shadow.blocksize,
+			 fota_shadow.throughput, fota_shadow.retransmits);
 
 #ifdef CONFIG_BLUEGRASS
 		LOG_DBG("Update FOTA shadow");
 		rc = awsSendData(msg, GATEWAY_TOPIC);
 #endif
-		if (rc < 0) {
+		/* The request remains set and is retried when the
+		 * in-flight window is full.
+		 */
+		if (rc == -EAGAIN) {
+			LOG_DBG("FOTA state deferred");
+		} else if (rc < 0) {
 			LOG_ERR("Could not send FOTA state to AWS");
 		} else {
 			fota_shadow.json_update_request = false;
@@ -568,7 +588,7 @@ static int fota_null_desired_handler(const char *name)
 	rc = awsSendData(msg, GATEWAY_TOPIC);
 #endif
 
-	if (rc < 0) {
+	if (rc < 0 && rc != -EAGAIN) {
 		LOG_ERR("Could not set FOTA %s desired to null",
 			log_strdup(name));
 	}
@@ -37,6 +37,9 @@ LOG_MODULE_REGISTER(coap_fota_task, CONFIG_COAP_FOTA_LOG_LEVEL);
 #include "coap_fota_query.h"
 #include "coap_fota_shadow.h"
 #include "coap_fota.h"
+#ifdef CONFIG_FOTA_STREAMING_HASH
+#include "fota_hash.h"
+#endif
 
 /******************************************************************************/
 /* Local Constant, Macro and Type Definitions                                 */
@@ -145,6 +148,10 @@ static int initiate_modem_update(coap_fota_query_t *q);
 static int copy_app(struct flash_img_context *flash_ctx, const char *path,
 		    const char *name, size_t size);
 static bool transport_not_required(void);
+#ifdef CONFIG_COAP_FOTA_DIRECT_TO_FLASH
+static bool use_direct_to_flash(fota_context_t *pCtx, bool staged);
+static bool slot_hash_match(coap_fota_query_t *q, size_t size);
+#endif
 
 /******************************************************************************/
 /* Framework Message Dispatcher                                               */
@@ -450,6 +457,9 @@ static void fota_fsm(fota_context_t *pCtx)
 		} else {
 			pCtx->query.offset = r;
 		}
+#ifdef CONFIG_COAP_FOTA_DIRECT_TO_FLASH
+		pCtx->query.direct = use_direct_to_flash(pCtx, (r >= 0));
+#endif
 		next_state = FOTA_FSM_GET_HASH;
 		break;
 
@@ -498,6 +508,8 @@ static void fota_fsm(fota_context_t *pCtx)
 
 	case FOTA_FSM_START_DOWNLOAD:
 		r = coap_fota_get_firmware(&pCtx->query);
+		coap_fota_set_download_stats(pCtx->query.throughput,
+					     pCtx->query.retransmits);
 		if (r < 0) {
 			next_state = FOTA_FSM_ERROR;
 		} else {
@@ -577,6 +589,60 @@ static bool transport_not_required(void)
 	return true;
 }
 
+#ifdef CONFIG_COAP_FOTA_DIRECT_TO_FLASH
+/* A partially staged image is finished on the file system.  Otherwise a
+ * direct download continues from the offset of its saved hash state.  The
+ * state isn't trusted; the slot is checked against the hash from the server
+ * before the download is skipped or resumed.
+ */
+static bool use_direct_to_flash(fota_context_t *pCtx, bool staged)
+{
+	coap_fota_query_t *q = &pCtx->query;
+	char abs_path[FSU_MAX_ABS_PATH_SIZE];
+	int offset;
+
+	if (pCtx->type != APP_IMAGE_TYPE || staged) {
+		return false;
+	}
+
+	(void)fsu_build_full_name(abs_path, sizeof(abs_path), q->fs_path,
+				  q->filename);
+	offset = fota_hash_get_saved_offset(abs_path);
+	if (offset > 0 && offset <= q->size) {
+		LOG_DBG("Secondary slot checkpoint at %d", offset);
+		q->offset = offset;
+	}
+
+	return true;
+}
+
+/* The slot is read so that an image that was changed by another writer
+ * (a staged update or the image manager) isn't used.
+ */
+static bool slot_hash_match(coap_fota_query_t *q, size_t size)
+{
+	struct flash_img_check fic = { .match = q->expected_hash,
+				       .clen = size };
+	struct flash_img_context *flash_ctx = NULL;
+	int r;
+
+	if (size == 0) {
+		return false;
+	}
+
+	flash_ctx =
+		k_calloc(sizeof(struct flash_img_context), sizeof(uint8_t));
+	if (flash_ctx == NULL) {
+		LOG_ERR("Unable to allocate flash context");
+		return false;
+	}
+
+	r = flash_img_check(flash_ctx, &fic, FLASH_AREA_IMAGE_SECONDARY);
+	k_free(flash_ctx);
+	return (r == 0);
+}
+#endif
+
 static int initiate_update(fota_context_t *pCtx)
 {
 	int r = 0;
@@ -594,6 +660,13 @@ static int initiate_update(fota_context_t *pCtx)
 #ifdef CONFIG_COAP_FOTA_DELETE_FILE_AFTER_UPDATE
 	if (r == 0) {
 		fsu_delete(pCtx->query.fs_path, pCtx->query.filename);
+#ifdef CONFIG_FOTA_STREAMING_HASH
+		char abs_path[FSU_MAX_ABS_PATH_SIZE];
+		(void)fsu_build_full_name(abs_path, sizeof(abs_path),
+					  pCtx->query.fs_path,
+					  pCtx->query.filename);
+		fota_hash_delete(abs_path);
+#endif
 	}
 #endif
 
@@ -645,6 +718,24 @@ static int initiate_app_update(coap_fota_query_t *q)
 {
 	int r = 0;
 	struct flash_img_context *flash_ctx = NULL;
+
+#ifdef CONFIG_COAP_FOTA_DIRECT_TO_FLASH
+	if (q->direct) {
+		/* The image was written to the secondary slot during the
+		 * download.
+		 */
+		char abs_path[FSU_MAX_ABS_PATH_SIZE];
+		(void)fsu_build_full_name(abs_path, sizeof(abs_path),
+					  q->fs_path, q->filename);
+		r = boot_request_upgrade(BOOT_UPGRADE_PERMANENT);
+		if (r < 0) {
+			LOG_ERR("Unable to initiate boot request");
+		} else {
+			fota_hash_delete(abs_path);
+		}
+		return r;
+	}
+#endif
 	while (1) {
 		flash_ctx = k_calloc(sizeof(struct flash_img_context),
 				     sizeof(uint8_t));
@@ -702,7 +793,24 @@ static int initiate_modem_update(coap_fota_query_t *q)
 
 static bool hash_match(coap_fota_query_t *q, size_t size)
 {
-	int r = fsu_sha256(q->computed_hash, q->fs_path, q->filename, size);
+	int r = -ENOENT;
+#ifdef CONFIG_COAP_FOTA_DIRECT_TO_FLASH
+	if (q->direct) {
+		return slot_hash_match(q, size);
+	}
+#endif
+#ifdef CONFIG_FOTA_STREAMING_HASH
+	/* The hash is computed during the download.  The image is only read
+	 * when the saved state doesn't cover it.
+	 */
+	char abs_path[FSU_MAX_ABS_PATH_SIZE];
+	(void)fsu_build_full_name(abs_path, sizeof(abs_path), q->fs_path,
+				  q->filename);
+	r = fota_hash_get_saved(q->computed_hash, abs_path, size);
+#endif
+	if (r < 0) {
+		r = fsu_sha256(q->computed_hash, q->fs_path, q->filename, size);
+	}
 	if (r == 0) {
 		return (memcmp(q->expected_hash, q->computed_hash,
 			       FSU_HASH_SIZE) == 0);
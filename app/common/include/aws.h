@@ -34,6 +34,23 @@ extern "C" {
 
 #define GATEWAY_TOPIC NULL
 
+/* Upper limits (ms) of the PUBACK latency histogram buckets are
+ * 100, 250, 500, 1000, 2500, 5000, 10000 and unbounded.
+ */
+#define AWS_ACK_LATENCY_BUCKETS 8
+
+struct aws_ack_stats {
+	uint32_t inflight; /* publishes waiting for a PUBACK */
+	uint32_t inflight_max;
+	uint32_t window_full; /* publishes rejected because of backpressure */
+	uint32_t retransmits;
+	uint32_t expired; /* abandoned after the last retransmission */
+	uint32_t abandoned; /* outstanding when the connection closed */
+	uint32_t unknown_acks;
+	int64_t last_latency;
+	uint32_t latency[AWS_ACK_LATENCY_BUCKETS];
+};
+
 /******************************************************************************/
 /* Global Function Prototypes                                                 */
 /******************************************************************************/
@@ -43,6 +60,9 @@ int awsConnect(void);
 bool awsConnected(void);
 bool awsPublished(void);
 int awsDisconnect(void);
+/* -EAGAIN is returned when the in-flight window is full.  It isn't
+ * counted as a failure and the publish should be retried later.
+ */
 int awsSendData(char *data, uint8_t *topic);
 int awsSendBinData(char *data, uint32_t len, uint8_t *topic);
 int awsPublishShadowPersistentData(void);
@@ -58,6 +78,11 @@ void awsDisconnectCallback(void);
 char *awsGetGatewayUpdateDeltaTopic(void);
 struct mqtt_client *awsGetMqttClient(void);
 
+/**
+ * @brief Get a copy of the QoS1 publish window and PUBACK latency statistics.
+ */
+void awsGetAckStats(struct aws_ack_stats *stats);
+
 #ifdef __cplusplus
 }
 #endif
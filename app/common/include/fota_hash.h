@@ -0,0 +1,116 @@
+/**
+ * @file fota_hash.h
+ * @brief SHA-256 of a firmware image that is computed as the image is
+ * written.  The hash state can be saved next to the image so that a
+ * download that is resumed after a reset continues with the partial digest.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __FOTA_HASH_H__
+#define __FOTA_HASH_H__
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr/types.h>
+#include <stddef.h>
+#include <mbedtls/sha256.h>
+
+#include "file_system_utilities.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+#define FOTA_HASH_MAX_PATH_SIZE                                                \
+	(FSU_MAX_ABS_PATH_SIZE + sizeof(CONFIG_FOTA_HASH_STATE_SUFFIX))
+
+struct fota_hash {
+	mbedtls_sha256_context ctx;
+	/* Number of image bytes that have been hashed */
+	uint32_t offset;
+	/* Identifies the image that the state belongs to */
+	uint32_t image_id;
+	/* False when the state didn't match the image */
+	bool valid;
+	char state_path[FOTA_HASH_MAX_PATH_SIZE];
+};
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Start hashing an image.  When offset is 0 a new hash is started
+ * and any saved state is deleted.  Otherwise the saved state is restored.
+ *
+ * @param abs_path of the image
+ * @param offset is the current size of the image
+ *
+ * @retval 0 on success, -ENOENT if the saved state doesn't match the image.
+ * The hash isn't updated and the image must be read to verify it.
+ */
+int fota_hash_start(struct fota_hash *h, const char *abs_path,
+		    uint32_t offset);
+
+/**
+ * @brief Start hashing an image.  A saved state is only restored when it
+ * was saved for the same image_id (for example, a CRC of the source and
+ * size of the image).
+ *
+ * @retval 0 on success, -ENOENT if the saved state doesn't match the image.
+ */
+int fota_hash_start_image(struct fota_hash *h, const char *abs_path,
+			  uint32_t offset, uint32_t image_id);
+
+/**
+ * @brief Add data that was written to the end of the image.
+ */
+void fota_hash_update(struct fota_hash *h, const uint8_t *data, size_t length);
+
+/**
+ * @brief Save the hash state.  Should be called after the image has been
+ * synced so that the state never describes more data than the file holds.
+ *
+ * @retval negative error code, 0 on success
+ */
+int fota_hash_save(struct fota_hash *h);
+
+/**
+ * @brief Get the hash of the first size bytes of the image.
+ *
+ * @retval 0 on success, -ENOENT if the state doesn't cover exactly size bytes
+ */
+int fota_hash_finish(struct fota_hash *h, uint8_t hash[FSU_HASH_SIZE],
+		     uint32_t size);
+
+/**
+ * @brief Get the hash of the first size bytes of an image from the
+ * saved state.
+ *
+ * @retval 0 on success, -ENOENT if there isn't a state for size bytes
+ */
+int fota_hash_get_saved(uint8_t hash[FSU_HASH_SIZE], const char *abs_path,
+			uint32_t size);
+
+/**
+ * @brief Get the number of image bytes that the saved state covers.
+ *
+ * @retval offset, -ENOENT if there isn't a valid state
+ */
+int fota_hash_get_saved_offset(const char *abs_path);
+
+/**
+ * @brief Delete the saved state of an image.
+ */
+void fota_hash_delete(const char *abs_path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __FOTA_HASH_H__ */
@@ -29,10 +29,19 @@ void gateway_fsm_init(void);
 
 /**
  * @brief The gateway state machine must be periodically run.
- * For example, once per second.
+ * For example, once per second.  The period only sets the resolution of
+ * timeouts; events reported with gateway_fsm_event() are handled without
+ * waiting for it.
  */
 void gateway_fsm(void);
 
+/**
+ * @brief Notify the state machine that the network or cloud connection
+ * has changed.  Safe to call from any thread.  Repeated calls are combined
+ * until the state machine is next run.
+ */
+void gateway_fsm_event(void);
+
 /**
  * @brief Request decommissioning.  This will cause the cloud connection
  * to close and the certificates to be unloaded.
@@ -64,6 +73,12 @@ void gateway_fsm_network_disconnected_callback(void);
 void gateway_fsm_cloud_connected_callback(void);
 void gateway_fsm_cloud_disconnected_callback(void);
 
+/**
+ * @brief Weak implementation that should be overriden to schedule a run of
+ * gateway_fsm() from the thread that owns it.
+ */
+void gateway_fsm_event_callback(void);
+
 #ifdef __cplusplus
 }
 #endif
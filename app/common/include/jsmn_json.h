@@ -44,46 +44,72 @@ extern "C" {
 /* Global Constants, Macros and Type Definitions                              */
 /******************************************************************************/
 /* JSON strings aren't null terminated. */
-#define JSMN_STRNCPY(str, idx)                                                 \
-	strncpy(str, jsmn_string(idx), MIN(jsmn_strlen(idx), sizeof(str) - 1))
+#define JSMN_STRNCPY(str, ctx, idx)                                            \
+	strncpy(str, jsmn_string(ctx, idx),                                    \
+		MIN(jsmn_strlen(ctx, idx), sizeof(str) - 1))
 
-/******************************************************************************/
-/* Global Function Prototypes                                                 */
-/******************************************************************************/
 /* Use next parent if the heirarchy matters. */
 typedef enum parent_type { NO_PARENT = 0, NEXT_PARENT } parent_type_t;
 
 /**
- * @brief Take jsmn mutex.  Tokenize JSON.
+ * @brief A tokenized document.  Owned by the caller.
+ * The token arena is sized for the document and freed by jsmn_end.
+ */
+struct jsmn_context {
+	const char *json;
+	jsmntok_t *tokens;
+	int tokens_found;
+	uint16_t *index; /* key index (when enabled) */
+	uint32_t index_mask;
+};
+
+/**
+ * @brief Search position within a document.  A copy can be used to
+ * save and restore the position.
+ */
+struct jsmn_cursor {
+	int index;
+	int parent;
+};
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Tokenize JSON.  The token arena is allocated from the jsmn heap.
+ * Contexts are independent so they may be used by multiple threads.
  *
  * @note It is assumed any user of this module will call this first.
  *
- * @param p is a pointer to JSON
+ * @param ctx is the context to initialize
+ * @param p is a pointer to JSON that must remain valid until jsmn_end
+ *
+ * @retval less than or equal to zero on error, otherwise number of tokens.
  */
-void jsmn_start(const char *p);
+int jsmn_start(struct jsmn_context *ctx, const char *p);
 
 /**
- * @brief Release jsmn mutex.
+ * @brief Free the token arena.
  */
-void jsmn_end(void);
+void jsmn_end(struct jsmn_context *ctx);
 
 /**
  * @brief Accessor function
  *
  * @retval true if the JSON was tokenized properly.
  */
-bool jsmn_valid(void);
+bool jsmn_valid(const struct jsmn_context *ctx);
 
 /**
  * @brief Accessor function
  *
  * @retval less than or equal to zero on error, otherwise number of tokens.
  */
-int jsmn_tokens_found(void);
+int jsmn_tokens_found(const struct jsmn_context *ctx);
 
 /**
- * @brief This function updates the global index to the next token when an
- * item + type is found.  Otherwise, the index is set to zero.
+ * @brief This function updates the cursor to the next token when an
+ * item + type is found.  Otherwise, the cursor index is set to zero.
  *
  * @param s is the string to find
  * @param type is the type of JSON element to find.
@@ -93,64 +119,55 @@ int jsmn_tokens_found(void);
  * @retval > 0 then then the location of the data is returned.
  * @retval <= 0, then the item was not found
  */
-int jsmn_find_type(const char *s, jsmntype_t type, parent_type_t parent_type);
+int jsmn_find_type(const struct jsmn_context *ctx, struct jsmn_cursor *cursor,
+		   const char *s, jsmntype_t type, parent_type_t parent_type);
 
 /**
  * @brief Accessor function
  *
  * @retval the current token index
  */
-int jsmn_index(void);
+int jsmn_index(const struct jsmn_cursor *cursor);
 
 /**
  * @brief Helper function that resets index and parent
  */
-void jsmn_reset_index(void);
-
-/**
- * @brief Helper function that saves index and parent.
- */
-void jsmn_save_index(void);
-
-/**
- * @brief Helper function that restores index and parent from saved values.
- */
-void jsmn_restore_index(void);
+void jsmn_reset_index(struct jsmn_cursor *cursor);
 
 /**
  * @brief Converts string to uint
  *
  * @note If the string is larger than a 11 digits, then 0 is returned.
  */
-uint32_t jsmn_convert_uint(int index);
+uint32_t jsmn_convert_uint(const struct jsmn_context *ctx, int index);
 
 /**
  * @brief Converts hex string to uint
  *
  * @note If the string is larger than a 8 digits, then 0 is returned.
  */
-uint32_t jsmn_convert_hex(int index);
+uint32_t jsmn_convert_hex(const struct jsmn_context *ctx, int index);
 
 /**
  * @brief Accessor function
  *
  * @retval The type of the token at the specified index.
  */
-jsmntype_t jsmn_type(int index);
+jsmntype_t jsmn_type(const struct jsmn_context *ctx, int index);
 
 /**
  * @brief Accessor function
  *
  * @retval The size of the token at the specified index.
  */
-int jsmn_size(int index);
+int jsmn_size(const struct jsmn_context *ctx, int index);
 
 /**
  * @brief Accessor function
  *
  * @retval The size of the string at the specified token index.
  */
-int jsmn_strlen(int index);
+int jsmn_strlen(const struct jsmn_context *ctx, int index);
 
 /**
  * @brief Accessor function
@@ -158,7 +175,7 @@ int jsmn_strlen(int index);
  * @retval A pointer to a string the specified token.
  * Undefined if token @ index is not a string.
  */
-const char *jsmn_string(int index);
+const char *jsmn_string(const struct jsmn_context *ctx, int index);
 
 #ifdef __cplusplus
 }
@@ -14,6 +14,7 @@
 /******************************************************************************/
 #include <zephyr/types.h>
 #include <stddef.h>
+#include <stdbool.h>
 
 #if defined(CONFIG_SCAN_FOR_BT510) || defined(CONFIG_ESS_SENSOR)
 #include "FrameworkIncludes.h"
@@ -33,6 +34,27 @@ extern "C" {
 /******************************************************************************/
 #define SDCARD_LOG_DEFAULT_MAX_LENGTH 32
 
+typedef struct SdCardLogStats {
+	uint32_t records;
+	uint32_t commits; /* group commits (write + sync) */
+	uint32_t bytesWritten;
+	uint32_t bytesDropped; /* staged data lost because a commit failed */
+	uint32_t errors;
+	uint32_t staged; /* bytes waiting in RAM */
+} SdCardLogStats_t;
+
+#ifdef CONFIG_SD_CARD_LOG_AD_BINARY
+/* State of a CSV export of the binary sensor log.
+ * Zero initialize before the first call.
+ */
+typedef struct SdCardLogExport {
+	bool started;
+	uint32_t index; /* ring slot of the next record */
+	uint32_t remaining;
+	uint32_t corrupt; /* records skipped because of a CRC error */
+} SdCardLogExport_t;
+#endif
+
 #ifdef CONFIG_CONTACT_TRACING
 typedef struct log_get_state_s {
 	rpc_params_log_get_t rpc_params;
@@ -86,6 +108,22 @@ int sdCardLogBatteryData(void *data, int length);
 int sdCardLogAdEvent(LczSensorAdEvent_t *event);
 #endif
 
+#ifdef CONFIG_SD_CARD_LOG_AD_BINARY
+/**
+ * @brief Convert the binary sensor log to CSV (oldest record first).
+ * The CSV lines are identical to those of the text log.
+ * Call repeatedly until 0 is returned.
+ *
+ * @param state export state
+ * @param buf destination for complete CSV lines (NUL terminated)
+ * @param maxlen size of buf
+ *
+ * @retval number of characters written to buf, 0 when the export is
+ * complete, otherwise a negative error code.
+ */
+int sdCardLogAdEventExport(SdCardLogExport_t *state, char *buf, size_t maxlen);
+#endif
+
 #ifdef CONFIG_ESS_SENSOR
 /**
  * @brief this function writes data to the log. It will append data to
@@ -142,6 +180,20 @@ int sdCardLogGetSize(void);
  */
 int sdCardLogGetFree(void);
 
+/**
+ * @brief Write the records that are staged in RAM to the SD card.
+ * Records are otherwise committed when CONFIG_SD_CARD_LOG_FLUSH_BYTES
+ * are staged or after CONFIG_SD_CARD_LOG_FLUSH_MS.
+ *
+ * @retval negative error code, 0 on success
+ */
+int sdCardLogFlush(void);
+
+/**
+ * @brief Get a copy of the statistics summed over all log files.
+ */
+void sdCardLogGetStats(SdCardLogStats_t *stats);
+
 /**
  * @brief list the contents of a directory on the SD card
  *
@@ -156,6 +208,14 @@ int sdCardLogCleanup(void);
 
 int sdCardLogLsDirToString(const char *path, char *buf, int maxlen);
 
+/**
+ * @brief Update the log file index after a log file in the root directory
+ * of the SD card was created, written or deleted outside this module.
+ *
+ * @param path absolute path of the file, e.g. "/SD:/21061514.log"
+ */
+void sdCardLogIndexUpdate(const char *path);
+
 int sdCardLogGet(char *pbuf, log_get_state_t *lstate, uint32_t maxlen);
 
 void sdCardLogTest(void);
@@ -36,6 +36,7 @@ LOG_MODULE_REGISTER(aws, CONFIG_AWS_LOG_LEVEL);
 #include "lte.h"
 #include "attr.h"
 #include "fota_smp.h"
+#include "gateway_fsm.h"
 
 #ifdef CONFIG_BLUEGRASS
 #include "sensor_gateway_parser.h"
@@ -80,6 +81,51 @@ struct topics {
 	uint8_t get_accepted[CONFIG_AWS_TOPIC_MAX_SIZE];
 };
 
+/* A QoS1 publish that hasn't been acknowledged.
+ * A message id of zero means the entry is free.
+ */
+struct inflight {
+	uint16_t message_id;
+	uint8_t retries;
+	bool binary;
+	bool lent; /* data is being retransmitted outside the mutex */
+	int64_t first_sent;
+	int64_t last_sent;
+	char *data; /* NULL if a copy couldn't be allocated */
+	uint32_t len;
+	uint8_t topic[CONFIG_AWS_TOPIC_MAX_SIZE];
+};
+
+BUILD_ASSERT(CONFIG_AWS_INFLIGHT_MAX <= UINT8_MAX, "Invalid window size");
+
+#define FLUSH_CHUNK_SIZE 64
+
+#ifdef CONFIG_BLUEGRASS
+/* The metadata (timestamps) that AWS adds to shadow documents is removed
+ * as the payload is received.  The root version, timestamp, and client token
+ * are also removed so that parsers only see the state.  Positions are offsets
+ * into the subscription buffer.
+ */
+struct metadata_filter {
+	size_t out;
+	size_t key_start;
+	size_t comma;
+	int depth;
+	bool in_string;
+	bool escape;
+	bool key;
+	bool expect_key;
+	bool has_comma;
+	bool skip;
+	bool skip_has_comma;
+	bool overflow;
+};
+
+static const char *const REMOVED_ROOT_KEYS[] = {
+	"\"metadata\"", "\"version\"", "\"timestamp\"", "\"clientToken\""
+};
+#endif
+
 #if CONFIG_AWS_PUBLISH_WATCHDOG_SECONDS != 0
 BUILD_ASSERT((CONFIG_AWS_PUBLISH_WATCHDOG_SECONDS / 2) >
 		     CONFIG_AWS_HEARTBEAT_SECONDS,
@@ -131,6 +177,17 @@ static struct topics topics;
 
 static struct k_work_delayable publish_watchdog;
 static struct k_work_delayable keep_alive;
+static struct k_work_delayable retransmit;
+
+static struct k_mutex inflight_mutex;
+static struct inflight inflight[CONFIG_AWS_INFLIGHT_MAX];
+/* Copies of the entries that are being retransmitted */
+static struct inflight resend[CONFIG_AWS_INFLIGHT_MAX];
+static struct aws_ack_stats ack_stats;
+
+static const int64_t LATENCY_LIMITS[AWS_ACK_LATENCY_BUCKETS - 1] = {
+	100, 250, 500, 1000, 2500, 5000, 10000
+};
 
 static struct {
 	uint32_t consecutive_connection_failures;
@@ -140,9 +197,6 @@ static struct {
 	uint32_t success;
 	uint32_t failure;
 	uint32_t consecutive_fails;
-	int64_t time;
-	int64_t delta;
-	int64_t delta_max;
 	uint32_t tx_payload_bytes;
 	uint32_t rx_payload_bytes;
 } aws_stats;
@@ -158,14 +212,25 @@ static void mqtt_evt_handler(struct mqtt_client *const client,
 static int subscription_handler(struct mqtt_client *const client,
 				const struct mqtt_evt *evt);
 static void subscription_flush(struct mqtt_client *const client, size_t length);
+#ifdef CONFIG_BLUEGRASS
+static void metadata_filter(struct metadata_filter *f, uint8_t *buf,
+			    size_t size, size_t length);
+#endif
 static int publish(struct mqtt_client *client, enum mqtt_qos qos, char *data,
-		   uint32_t len, uint8_t *topic, bool binary);
+		   uint32_t len, uint8_t *topic, bool binary,
+		   uint16_t message_id, bool dup);
 static void client_init(struct mqtt_client *client);
 static int try_to_connect(struct mqtt_client *client);
 static void aws_rx_thread(void *arg1, void *arg2, void *arg3);
 static uint16_t rand16_nonzero_get(void);
 static void publish_watchdog_work_handler(struct k_work *work);
 static void keep_alive_work_handler(struct k_work *work);
+static void retransmit_work_handler(struct k_work *work);
+static struct inflight *inflight_allocate(void);
+static struct inflight *inflight_find(uint16_t message_id);
+static void inflight_free(struct inflight *entry);
+static void inflight_abandon_all(void);
+static void inflight_ack(uint16_t message_id);
 static int aws_send_data(bool binary, char *data, uint32_t len, uint8_t *topic);
 
 #ifdef CONFIG_NET_L2_ETHERNET
@@ -187,6 +252,7 @@ int awsInit(void)
 
 	k_sem_init(&connected_sem, 0, 1);
 	k_sem_init(&disconnected_sem, 0, 1);
+	k_mutex_init(&inflight_mutex);
 
 	/* init shadow data */
 	reported->os_version = KERNEL_VERSION_STRING;
@@ -217,6 +283,7 @@ int awsInit(void)
 
 	k_work_init_delayable(&publish_watchdog, publish_watchdog_work_handler);
 	k_work_init_delayable(&keep_alive, keep_alive_work_handler);
+	k_work_init_delayable(&retransmit, retransmit_work_handler);
 
 	return 0;
 }
@@ -403,14 +470,19 @@ int awsPublishShadowPersistentData()
 	/* Clear the shadow and start fresh */
 	rc = awsSendData(SHADOW_STATE_NULL, GATEWAY_TOPIC);
 	if (rc < 0) {
-		AWS_LOG_ERR("Clear shadow failed");
+		if (rc != -EAGAIN) {
+			AWS_LOG_ERR("Clear shadow failed");
+		}
 		goto done;
 	}
 #endif
 
+	/* The caller retries when the in-flight window is full (-EAGAIN). */
 	rc = awsSendData(msg, GATEWAY_TOPIC);
 	if (rc < 0) {
-		AWS_LOG_ERR("Update persistent shadow data failed");
+		if (rc != -EAGAIN) {
+			AWS_LOG_ERR("Update persistent shadow data failed");
+		}
 		goto done;
 	} else {
 		AWS_LOG_INF("Sent persistent shadow data");
@@ -570,6 +642,13 @@ struct mqtt_client *awsGetMqttClient(void)
 	return &client_ctx;
 }
 
+void awsGetAckStats(struct aws_ack_stats *stats)
+{
+	k_mutex_lock(&inflight_mutex, K_FOREVER);
+	memcpy(stats, &ack_stats, sizeof(struct aws_ack_stats));
+	k_mutex_unlock(&inflight_mutex);
+}
+
 /******************************************************************************/
 /* Local Function Definitions                                                 */
 /******************************************************************************/
@@ -608,6 +687,7 @@ static void mqtt_evt_handler(struct mqtt_client *const client,
 
 		aws_connected = true;
 		k_sem_give(&connected_sem);
+		gateway_fsm_event();
 		AWS_LOG_INF("MQTT client connected!");
 		k_work_schedule(&keep_alive,
 				K_SECONDS(CONFIG_MQTT_KEEPALIVE / 2));
@@ -627,15 +707,8 @@ static void mqtt_evt_handler(struct mqtt_client *const client,
 			break;
 		}
 
-		/* Unless a single caller/semaphore is used the delta isn't foolproof. */
 		aws_stats.acks += 1;
-		aws_stats.delta = k_uptime_delta(&aws_stats.time);
-		aws_stats.delta_max = MAX(aws_stats.delta_max, aws_stats.delta);
-
-		AWS_LOG_ACK("PUBACK packet id: %u delta: %d",
-			    evt->param.puback.message_id,
-			    (int32_t)aws_stats.delta);
-
+		inflight_ack(evt->param.puback.message_id);
 		break;
 
 	case MQTT_EVT_PUBLISH:
@@ -651,11 +724,8 @@ static void mqtt_evt_handler(struct mqtt_client *const client,
 			evt->param.publish.message.payload.len);
 
 		rc = subscription_handler(client, evt);
-		if ((rc >= 0) &&
-		    (rc < evt->param.publish.message.payload.len)) {
-			subscription_flush(
-				client,
-				evt->param.publish.message.payload.len - rc);
+		if (rc < 0) {
+			AWS_LOG_ERR("MQTT read payload error %d", rc);
 		}
 		break;
 	default:
@@ -666,60 +736,204 @@ static void mqtt_evt_handler(struct mqtt_client *const client,
 /* The timestamps can make the shadow size larger than 4K.
  * This is too large to be allocated by malloc or the buffer pool.
  * Therefore, messages are processed here.
+ *
+ * The payload is read in chunks directly into the subscription buffer and
+ * the metadata is filtered out in place.  Only the remainder of the
+ * document must fit into the buffer.
  */
 static int subscription_handler(struct mqtt_client *const client,
 				const struct mqtt_evt *evt)
 {
 	int rc = 0;
+	uint32_t length = evt->param.publish.message.payload.len;
 #ifdef CONFIG_BLUEGRASS
 	uint16_t id = evt->param.publish.message_id;
-	uint32_t length = evt->param.publish.message.payload.len;
 	uint8_t qos = evt->param.publish.message.topic.qos;
 	const uint8_t *topic = evt->param.publish.message.topic.topic.utf8;
+	struct metadata_filter f;
+	size_t remaining = length;
+	size_t chunk;
 
-	/* Leave room for null to allow easy printing */
-	size_t size = length + 1;
-	if (size > CONFIG_SHADOW_IN_MAX_SIZE) {
-		return 0;
+	aws_stats.rx_payload_bytes += length;
+
+	memset(&f, 0, sizeof(f));
+	while (remaining > 0 && !f.overflow) {
+		/* Leave room for null to allow easy printing */
+		chunk = MIN(remaining, sizeof(subscription_buffer) - 1 - f.out);
+		if (chunk == 0) {
+			f.overflow = true;
+			break;
+		}
+
+		rc = mqtt_read_publish_payload_blocking(
+			client, subscription_buffer + f.out, chunk);
+		if (rc <= 0) {
+			return (rc < 0) ? rc : -EIO;
+		}
+		remaining -= rc;
+		metadata_filter(&f, subscription_buffer,
+				sizeof(subscription_buffer), rc);
 	}
 
-	aws_stats.rx_payload_bytes += length;
+	if (f.overflow) {
+		AWS_LOG_ERR("Subscription too large (%u)", length);
+		subscription_flush(client, remaining);
+		return 0;
+	}
 
-	rc = mqtt_read_publish_payload(client, subscription_buffer, length);
-	if (rc == length) {
-		subscription_buffer[length] = 0; /* null terminate */
+	subscription_buffer[f.out] = 0; /* null terminate */
 
 #ifdef CONFIG_JSON_LOG_MQTT_RX_DATA
-		print_json("MQTT Read data", rc, subscription_buffer);
+	print_json("MQTT Read data", f.out, subscription_buffer);
 #endif
 
-		SensorGatewayParser(topic, subscription_buffer);
+	SensorGatewayParser(topic, subscription_buffer);
 
-		if (qos == MQTT_QOS_1_AT_LEAST_ONCE) {
-			struct mqtt_puback_param param = { .message_id = id };
-			(void)mqtt_publish_qos1_ack(client, &param);
-		} else if (qos == MQTT_QOS_2_EXACTLY_ONCE) {
-			AWS_LOG_ERR("QOS 2 not supported");
-		}
+	if (qos == MQTT_QOS_1_AT_LEAST_ONCE) {
+		struct mqtt_puback_param param = { .message_id = id };
+		(void)mqtt_publish_qos1_ack(client, &param);
+	} else if (qos == MQTT_QOS_2_EXACTLY_ONCE) {
+		AWS_LOG_ERR("QOS 2 not supported");
 	}
+#else
+	subscription_flush(client, length);
 #endif
 	return rc;
 }
 
 static void subscription_flush(struct mqtt_client *const client, size_t length)
 {
-	LOG_ERR("Subscription Flush %u", length);
-	char junk;
+	uint8_t junk[FLUSH_CHUNK_SIZE];
+	int rc;
+
+	if (length > 0) {
+		LOG_ERR("Subscription Flush %u", length);
+	}
+
+	while (length > 0) {
+		rc = mqtt_read_publish_payload_blocking(
+			client, junk, MIN(length, sizeof(junk)));
+		if (rc <= 0) {
+			break;
+		}
+		length -= rc;
+	}
+}
+
+#ifdef CONFIG_BLUEGRASS
+static void metadata_emit(struct metadata_filter *f, uint8_t *buf,
+			  size_t size, uint8_t c)
+{
+	if (f->skip) {
+		return;
+	}
+
+	if (f->out < (size - 1)) {
+		buf[f->out++] = c;
+	} else {
+		f->overflow = true;
+	}
+}
+
+static bool removed_root_key(const uint8_t *key, size_t length)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(REMOVED_ROOT_KEYS); i++) {
+		if (length == strlen(REMOVED_ROOT_KEYS[i]) &&
+		    memcmp(key, REMOVED_ROOT_KEYS[i], length) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Process length bytes that were read into the buffer at the output
+ * position.  The output never passes the input so it can be done in place.
+ * Only the members of the root object in REMOVED_ROOT_KEYS are removed.
+ */
+static void metadata_filter(struct metadata_filter *f, uint8_t *buf,
+			    size_t size, size_t length)
+{
 	size_t i;
-	for (i = 0; i < length; i++) {
-		if (mqtt_read_publish_payload(client, &junk, 1) != 1) {
+	size_t end = f->out + length;
+	uint8_t c;
+
+	for (i = f->out; i < end && !f->overflow; i++) {
+		c = buf[i];
+
+		if (f->in_string) {
+			metadata_emit(f, buf, size, c);
+			if (f->escape) {
+				f->escape = false;
+			} else if (c == '\\') {
+				f->escape = true;
+			} else if (c == '"') {
+				f->in_string = false;
+				if (f->key &&
+				    removed_root_key(buf + f->key_start,
+						     f->out - f->key_start)) {
+					/* Remove the key and preceding comma */
+					f->out = f->has_comma ? f->comma :
+								f->key_start;
+					f->skip = true;
+					f->skip_has_comma = f->has_comma;
+				}
+				f->key = false;
+			}
+			continue;
+		}
+
+		/* The value ends with the next separator in the root object. */
+		if (f->skip && f->depth == 1 && (c == ',' || c == '}')) {
+			f->skip = false;
+			if (c == ',' && !f->skip_has_comma) {
+				f->expect_key = true;
+				continue;
+			}
+		}
+
+		switch (c) {
+		case '"':
+			f->in_string = true;
+			f->key = (f->depth == 1 && f->expect_key && !f->skip);
+			f->key_start = f->out;
+			break;
+		case '{':
+		case '[':
+			f->depth += 1;
+			if (f->depth == 1) {
+				f->expect_key = true;
+			}
+			break;
+		case '}':
+		case ']':
+			f->depth -= 1;
+			break;
+		case ',':
+			if (f->depth == 1 && !f->skip) {
+				f->expect_key = true;
+				f->has_comma = true;
+				f->comma = f->out;
+			}
+			break;
+		case ':':
+			if (f->depth == 1) {
+				f->expect_key = false;
+			}
+			break;
+		default:
 			break;
 		}
+
+		metadata_emit(f, buf, size, c);
 	}
 }
+#endif
 
 static int publish(struct mqtt_client *client, enum mqtt_qos qos, char *data,
-		   uint32_t len, uint8_t *topic, bool binary)
+		   uint32_t len, uint8_t *topic, bool binary,
+		   uint16_t message_id, bool dup)
 {
 	struct mqtt_publish_param param;
 
@@ -729,8 +943,8 @@ static int publish(struct mqtt_client *client, enum mqtt_qos qos, char *data,
 	param.message.topic.topic.size = strlen(param.message.topic.topic.utf8);
 	param.message.payload.data = data;
 	param.message.payload.len = len;
-	param.message_id = rand16_nonzero_get();
-	param.dup_flag = 0U;
+	param.message_id = message_id;
+	param.dup_flag = dup ? 1U : 0U;
 	param.retain_flag = 0U;
 
 #ifdef CONFIG_JSON_LOG_TOPIC
@@ -749,8 +963,6 @@ static int publish(struct mqtt_client *client, enum mqtt_qos qos, char *data,
 		AWS_LOG_WRN("len: %u", len);
 	}
 
-	aws_stats.time = k_uptime_get();
-
 	return mqtt_publish(client, &param);
 }
 
@@ -844,7 +1056,9 @@ static void aws_rx_thread(void *arg1, void *arg2, void *arg3)
 				clear_fds();
 				aws_disconnect = false;
 				aws_connected = false;
+				inflight_abandon_all();
 				k_sem_give(&disconnected_sem);
+				gateway_fsm_event();
 				awsDisconnectCallback();
 			}
 		} else {
@@ -899,10 +1113,168 @@ static void keep_alive_work_handler(struct k_work *work)
 	}
 }
 
+/* Entries are copied under the mutex and published after it is released so
+ * that the receive thread can process PUBACKs while the socket is busy.
+ * The payload is lent to the copy and returned if the entry is still
+ * waiting for its PUBACK.
+ */
+static void retransmit_work_handler(struct k_work *work)
+{
+	ARG_UNUSED(work);
+	const int64_t timeout = CONFIG_AWS_INFLIGHT_RETRANSMIT_MS;
+	int64_t now = k_uptime_get();
+	int64_t next = timeout;
+	struct inflight *p;
+	size_t count = 0;
+	size_t i;
+	int rc;
+
+	k_mutex_lock(&inflight_mutex, K_FOREVER);
+	for (i = 0; i < CONFIG_AWS_INFLIGHT_MAX; i++) {
+		p = &inflight[i];
+		if (p->message_id == 0) {
+			continue;
+		}
+
+		if ((now - p->last_sent) >= timeout) {
+			if (!aws_connected || p->data == NULL ||
+			    p->retries >= CONFIG_AWS_INFLIGHT_RETRIES) {
+				AWS_LOG_WRN("PUBACK not received for id: %u",
+					    p->message_id);
+				ack_stats.expired += 1;
+				inflight_free(p);
+				continue;
+			}
+
+			p->retries += 1;
+			p->last_sent = now;
+			ack_stats.retransmits += 1;
+			resend[count++] = *p;
+			p->data = NULL;
+			p->lent = true;
+		}
+
+		next = MIN(next, p->last_sent + timeout - now);
+	}
+	k_mutex_unlock(&inflight_mutex);
+
+	for (i = 0; i < count; i++) {
+		p = &resend[i];
+		rc = publish(&client_ctx, MQTT_QOS_1_AT_LEAST_ONCE, p->data,
+			     p->len, p->topic, p->binary, p->message_id, true);
+		if (rc != 0) {
+			AWS_LOG_ERR("MQTT retransmit id: %u (%d)",
+				    p->message_id, rc);
+		}
+	}
+
+	k_mutex_lock(&inflight_mutex, K_FOREVER);
+	for (i = 0; i < count; i++) {
+		p = inflight_find(resend[i].message_id);
+		if (p != NULL && p->lent) {
+			p->data = resend[i].data;
+			p->lent = false;
+		} else {
+			k_free(resend[i].data);
+		}
+		resend[i].data = NULL;
+	}
+
+	if (ack_stats.inflight != 0) {
+		k_work_schedule(&retransmit, K_MSEC(MAX(next, 1)));
+	}
+	k_mutex_unlock(&inflight_mutex);
+}
+
+/* Callers must hold the inflight mutex */
+static struct inflight *inflight_allocate(void)
+{
+	struct inflight *entry = inflight_find(0);
+	uint16_t id;
+
+	if (entry != NULL) {
+		/* Message ids must be unique within the window. */
+		do {
+			id = rand16_nonzero_get();
+		} while (inflight_find(id) != NULL);
+
+		memset(entry, 0, sizeof(struct inflight));
+		entry->message_id = id;
+		ack_stats.inflight += 1;
+		ack_stats.inflight_max =
+			MAX(ack_stats.inflight_max, ack_stats.inflight);
+	}
+	return entry;
+}
+
+static struct inflight *inflight_find(uint16_t message_id)
+{
+	size_t i;
+	for (i = 0; i < CONFIG_AWS_INFLIGHT_MAX; i++) {
+		if (inflight[i].message_id == message_id) {
+			return &inflight[i];
+		}
+	}
+	return NULL;
+}
+
+static void inflight_free(struct inflight *entry)
+{
+	k_free(entry->data);
+	entry->data = NULL;
+	entry->message_id = 0;
+	ack_stats.inflight -= 1;
+}
+
+/* The broker discards the state of a clean session when it is closed. */
+static void inflight_abandon_all(void)
+{
+	size_t i;
+
+	k_work_cancel_delayable(&retransmit);
+	k_mutex_lock(&inflight_mutex, K_FOREVER);
+	for (i = 0; i < CONFIG_AWS_INFLIGHT_MAX; i++) {
+		if (inflight[i].message_id != 0) {
+			ack_stats.abandoned += 1;
+			inflight_free(&inflight[i]);
+		}
+	}
+	k_mutex_unlock(&inflight_mutex);
+}
+
+static void inflight_ack(uint16_t message_id)
+{
+	struct inflight *entry;
+	int64_t latency;
+	size_t i;
+
+	k_mutex_lock(&inflight_mutex, K_FOREVER);
+	entry = (message_id == 0) ? NULL : inflight_find(message_id);
+	if (entry == NULL) {
+		ack_stats.unknown_acks += 1;
+		AWS_LOG_WRN("Unexpected PUBACK id: %u", message_id);
+	} else {
+		latency = k_uptime_get() - entry->first_sent;
+		for (i = 0; i < ARRAY_SIZE(LATENCY_LIMITS); i++) {
+			if (latency < LATENCY_LIMITS[i]) {
+				break;
+			}
+		}
+		ack_stats.latency[i] += 1;
+		ack_stats.last_latency = latency;
+		AWS_LOG_ACK("PUBACK packet id: %u latency: %d", message_id,
+			    (int32_t)latency);
+		inflight_free(entry);
+	}
+	k_mutex_unlock(&inflight_mutex);
+}
+
 static int aws_send_data(bool binary, char *data, uint32_t len, uint8_t *topic)
 {
 	int rc = -EPERM;
 	uint32_t length;
+	struct inflight *entry;
+	uint16_t message_id;
 
 	if (!aws_connected) {
 		return rc;
@@ -914,11 +1286,49 @@ static int aws_send_data(bool binary, char *data, uint32_t len, uint8_t *topic)
 		length = strlen(data);
 	}
 
+	k_mutex_lock(&inflight_mutex, K_FOREVER);
+	entry = inflight_allocate();
+	if (entry == NULL) {
+		ack_stats.window_full += 1;
+		k_mutex_unlock(&inflight_mutex);
+		AWS_LOG_DBG("Publish window full");
+		return -EAGAIN;
+	}
+
+	/* The caller owns the payload, so a copy is required for retransmission.
+	 * If the heap is exhausted the message is still sent (once).
+	 */
+	entry->binary = binary;
+	entry->len = length;
+	strncpy(entry->topic, topic, sizeof(entry->topic) - 1);
+	entry->data = k_malloc(length);
+	if (entry->data != NULL) {
+		memcpy(entry->data, data, length);
+	}
+
+	entry->first_sent = k_uptime_get();
+	entry->last_sent = entry->first_sent;
+	message_id = entry->message_id;
+	k_mutex_unlock(&inflight_mutex);
+
 	aws_stats.sends += 1;
 	aws_stats.tx_payload_bytes += length;
 
+	/* The entry exists before the publish so a fast PUBACK can find it. */
 	rc = publish(&client_ctx, MQTT_QOS_1_AT_LEAST_ONCE, data, length, topic,
-		     binary);
+		     binary, message_id, false);
+
+	if (rc == 0) {
+		k_work_schedule(&retransmit,
+				K_MSEC(CONFIG_AWS_INFLIGHT_RETRANSMIT_MS));
+	} else {
+		k_mutex_lock(&inflight_mutex, K_FOREVER);
+		entry = inflight_find(message_id);
+		if (entry != NULL) {
+			inflight_free(entry);
+		}
+		k_mutex_unlock(&inflight_mutex);
+	}
 
 	if (rc == 0) {
 		aws_stats.success += 1;
@@ -928,6 +1338,9 @@ static int aws_send_data(bool binary, char *data, uint32_t len, uint8_t *topic)
 				&publish_watchdog,
 				K_SECONDS(CONFIG_AWS_PUBLISH_WATCHDOG_SECONDS));
 		}
+	} else if (rc == -EAGAIN) {
+		/* Socket backpressure isn't a failure; the caller retries. */
+		AWS_LOG_DBG("MQTT publish deferred");
 	} else {
 		aws_stats.failure += 1;
 		aws_stats.consecutive_fails += 1;
@@ -90,6 +90,7 @@ static void control_task_thread_internal(void *, void *, void *);
 
 static FwkMsgHandler_t software_reset_msg_handler;
 static FwkMsgHandler_t gateway_fsm_tick_handler;
+static FwkMsgHandler_t gateway_fsm_event_handler;
 static FwkMsgHandler_t attr_broadcast_msg_handler;
 static FwkMsgHandler_t factory_reset_msg_handler;
 static FwkMsgHandler_t cloud_state_msg_handler;
@@ -120,6 +121,7 @@ static FwkMsgHandler_t *control_task_msg_dispatcher(FwkMsgCode_t MsgCode)
 	switch (MsgCode) {
 	case FMC_INVALID:                    return Framework_UnknownMsgHandler;
 	case FMC_PERIODIC:                   return gateway_fsm_tick_handler;
+	case FMC_GATEWAY_FSM_EVENT:          return gateway_fsm_event_handler;
 	case FMC_SOFTWARE_RESET:             return software_reset_msg_handler;
 	case FMC_ATTR_CHANGED:               return attr_broadcast_msg_handler;
 	case FMC_FACTORY_RESET:              return factory_reset_msg_handler;
@@ -204,6 +206,17 @@ static DispatchResult_t gateway_fsm_tick_handler(FwkMsgReceiver_t *pMsgRxer,
 	return DISPATCH_OK;
 }
 
+static DispatchResult_t gateway_fsm_event_handler(FwkMsgReceiver_t *pMsgRxer,
+						  FwkMsg_t *pMsg)
+{
+	ARG_UNUSED(pMsgRxer);
+	ARG_UNUSED(pMsg);
+
+	gateway_fsm();
+
+	return DISPATCH_OK;
+}
+
 static DispatchResult_t attr_broadcast_msg_handler(FwkMsgReceiver_t *pMsgRxer,
 						   FwkMsg_t *pMsg)
 {
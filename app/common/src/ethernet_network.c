@@ -35,6 +35,7 @@ LOG_MODULE_REGISTER(ethernet_network, CONFIG_ETHERNET_LOG_LEVEL);
 #include "led_configuration.h"
 #include "attr.h"
 #include "gateway_common.h"
+#include "gateway_fsm.h"
 
 #ifdef CONFIG_BLUEGRASS
 #include "bluegrass.h"
@@ -351,6 +352,7 @@ static void iface_dns_added_evt_handler(struct net_mgmt_event_callback *cb,
 	lcz_led_turn_on(NETWORK_LED);
 	ethernet_network_event(ETHERNET_EVT_READY);
 	connected = true;
+	gateway_fsm_event();
 
 	set_ip_config(iface);
 
@@ -422,6 +424,7 @@ static void iface_down_evt_handler(struct net_mgmt_event_callback *cb,
 	lcz_led_turn_off(NETWORK_LED);
 	ethernet_network_event(ETHERNET_EVT_DISCONNECTED);
 	connected = false;
+	gateway_fsm_event();
 
 	/* Reset IP details to empty */
 	reset_iface_details();
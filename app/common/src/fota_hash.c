@@ -0,0 +1,230 @@
+/**
+ * @file fota_hash.c
+ * @brief
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(fota_hash, CONFIG_FOTA_HASH_LOG_LEVEL);
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <fs/fs.h>
+#include <sys/crc.h>
+
+#include "fota_hash.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define FOTA_HASH_MAGIC 0x48534846 /* FHSH */
+
+/* The context doesn't contain pointers so it can be saved as is. */
+struct fota_hash_record {
+	uint32_t magic;
+	uint32_t offset;
+	uint32_t image_id;
+	mbedtls_sha256_context ctx;
+	uint32_t crc;
+};
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static void build_state_path(char *dest, const char *abs_path);
+static int load_state(struct fota_hash_record *rec, const char *state_path);
+static uint32_t record_crc(const struct fota_hash_record *rec);
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+int fota_hash_start(struct fota_hash *h, const char *abs_path,
+		    uint32_t offset)
+{
+	return fota_hash_start_image(h, abs_path, offset, 0);
+}
+
+int fota_hash_start_image(struct fota_hash *h, const char *abs_path,
+			  uint32_t offset, uint32_t image_id)
+{
+	struct fota_hash_record rec;
+
+	build_state_path(h->state_path, abs_path);
+	mbedtls_sha256_init(&h->ctx);
+	h->offset = 0;
+	h->image_id = image_id;
+	h->valid = false;
+
+	if (offset == 0) {
+		(void)fs_unlink(h->state_path);
+		if (mbedtls_sha256_starts_ret(&h->ctx, 0) == 0) {
+			h->valid = true;
+		}
+	} else if (load_state(&rec, h->state_path) == 0 &&
+		   rec.offset == offset && rec.image_id == image_id) {
+		mbedtls_sha256_clone(&h->ctx, &rec.ctx);
+		h->offset = rec.offset;
+		h->valid = true;
+		LOG_DBG("Resuming hash at %u", h->offset);
+	}
+
+	if (!h->valid) {
+		LOG_WRN("Hash state doesn't match image");
+		return -ENOENT;
+	}
+	return 0;
+}
+
+void fota_hash_update(struct fota_hash *h, const uint8_t *data, size_t length)
+{
+	if (!h->valid) {
+		return;
+	}
+
+	if (mbedtls_sha256_update_ret(&h->ctx, data, length) == 0) {
+		h->offset += length;
+	} else {
+		h->valid = false;
+	}
+}
+
+int fota_hash_save(struct fota_hash *h)
+{
+	struct fota_hash_record rec;
+	struct fs_file_t f;
+	int r;
+
+	if (!h->valid) {
+		return -ENOENT;
+	}
+
+	rec.magic = FOTA_HASH_MAGIC;
+	rec.offset = h->offset;
+	rec.image_id = h->image_id;
+	mbedtls_sha256_clone(&rec.ctx, &h->ctx);
+	rec.crc = record_crc(&rec);
+
+	fs_file_t_init(&f);
+	r = fs_open(&f, h->state_path, FS_O_CREATE | FS_O_RDWR);
+	if (r < 0) {
+		return r;
+	}
+
+	ssize_t written = fs_write(&f, &rec, sizeof(rec));
+	if (written == sizeof(rec)) {
+		r = fs_sync(&f);
+	} else {
+		r = (written < 0) ? (int)written : -ENOSPC;
+	}
+	(void)fs_close(&f);
+
+	if (r < 0) {
+		LOG_ERR("Unable to save hash state (%d)", r);
+	}
+	return r;
+}
+
+int fota_hash_finish(struct fota_hash *h, uint8_t hash[FSU_HASH_SIZE],
+		     uint32_t size)
+{
+	mbedtls_sha256_context ctx;
+	int r = -ENOENT;
+
+	if (!h->valid || h->offset != size) {
+		return r;
+	}
+
+	/* Finish a copy so that more data can still be added */
+	mbedtls_sha256_init(&ctx);
+	mbedtls_sha256_clone(&ctx, &h->ctx);
+	if (mbedtls_sha256_finish_ret(&ctx, hash) == 0) {
+		r = 0;
+	}
+	mbedtls_sha256_free(&ctx);
+	return r;
+}
+
+int fota_hash_get_saved(uint8_t hash[FSU_HASH_SIZE], const char *abs_path,
+			uint32_t size)
+{
+	struct fota_hash_record rec;
+	struct fota_hash h;
+
+	build_state_path(h.state_path, abs_path);
+	if (load_state(&rec, h.state_path) < 0) {
+		return -ENOENT;
+	}
+
+	mbedtls_sha256_init(&h.ctx);
+	mbedtls_sha256_clone(&h.ctx, &rec.ctx);
+	h.offset = rec.offset;
+	h.valid = true;
+	int r = fota_hash_finish(&h, hash, size);
+	mbedtls_sha256_free(&h.ctx);
+	return r;
+}
+
+int fota_hash_get_saved_offset(const char *abs_path)
+{
+	struct fota_hash_record rec;
+	char state_path[FOTA_HASH_MAX_PATH_SIZE];
+
+	build_state_path(state_path, abs_path);
+	if (load_state(&rec, state_path) < 0 || rec.offset > INT32_MAX) {
+		return -ENOENT;
+	}
+	return (int)rec.offset;
+}
+
+void fota_hash_delete(const char *abs_path)
+{
+	char state_path[FOTA_HASH_MAX_PATH_SIZE];
+
+	build_state_path(state_path, abs_path);
+	(void)fs_unlink(state_path);
+}
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static void build_state_path(char *dest, const char *abs_path)
+{
+	snprintk(dest, FOTA_HASH_MAX_PATH_SIZE, "%s%s", abs_path,
+		 CONFIG_FOTA_HASH_STATE_SUFFIX);
+}
+
+static int load_state(struct fota_hash_record *rec, const char *state_path)
+{
+	struct fs_file_t f;
+	ssize_t bytes_read;
+	int r;
+
+	fs_file_t_init(&f);
+	r = fs_open(&f, state_path, FS_O_READ);
+	if (r < 0) {
+		return r;
+	}
+
+	bytes_read = fs_read(&f, rec, sizeof(*rec));
+	(void)fs_close(&f);
+
+	/* A reset while the state was written leaves a record that
+	 * doesn't pass the check.
+	 */
+	if (bytes_read != sizeof(*rec) || rec->magic != FOTA_HASH_MAGIC ||
+	    rec->crc != record_crc(rec)) {
+		return -EIO;
+	}
+	return 0;
+}
+
+static uint32_t record_crc(const struct fota_hash_record *rec)
+{
+	return crc32_ieee((const uint8_t *)rec,
+			  offsetof(struct fota_hash_record, crc));
+}
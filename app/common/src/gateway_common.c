@@ -301,6 +301,12 @@ void gateway_fsm_cloud_disconnected_callback(void)
 					   FMC_CLOUD_DISCONNECTED);
 }
 
+void gateway_fsm_event_callback(void)
+{
+	FRAMEWORK_MSG_CREATE_AND_SEND(FWK_ID_CONTROL_TASK, FWK_ID_CONTROL_TASK,
+				      FMC_GATEWAY_FSM_EVENT);
+}
+
 int attr_prepare_upTime(void)
 {
 	return attr_set_signed64(ATTR_ID_upTime, k_uptime_get());
@@ -46,15 +46,29 @@ LOG_MODULE_REGISTER(gateway_fsm, CONFIG_GATEWAY_FSM_LOG_LEVEL);
 
 #define CLOUD_CONNECT_TIMEOUT 10
 
+/* Limit on the number of states that one run of the state machine can pass
+ * through. States that only make a decision are chained so that an event
+ * isn't left waiting for the next tick.
+ */
+#define MAX_TRANSITIONS_PER_RUN 8
+
 typedef int gsm_func(void);
 typedef bool gsm_status_func(void);
 
 /******************************************************************************/
 /* Local Data Definitions                                                     */
 /******************************************************************************/
+#if defined(CONFIG_GATEWAY_FSM_TIME_TO_CLOUD)
+struct state_time {
+	enum gateway_state state;
+	uint32_t ms;
+};
+#endif
+
 static struct {
 	enum gateway_state state;
-	uint32_t timer;
+	int64_t deadline;
+	atomic_t event_pending;
 
 	bool modem_and_network_init_complete;
 	bool server_resolved;
@@ -70,6 +84,13 @@ static struct {
 	gsm_status_func *cloud_is_connected;
 	gsm_func *cert_load;
 	gsm_func *cert_unload;
+
+#if defined(CONFIG_GATEWAY_FSM_TIME_TO_CLOUD)
+	int64_t attempt_start;
+	int64_t state_start;
+	uint32_t transitions;
+	struct state_time trace[CONFIG_GATEWAY_FSM_TIME_TO_CLOUD_TRACE_SIZE];
+#endif
 } gsm;
 
 /******************************************************************************/
@@ -87,10 +108,18 @@ static void disconnected_handler(void);
 static void fota_handler(void);
 static void decommission_handler(void);
 
+static void run_state(void);
+
+static void start_timer(uint32_t seconds);
 static bool timer_expired(void);
 
 static void set_state(enum gateway_state next_state);
 
+#if defined(CONFIG_GATEWAY_FSM_TIME_TO_CLOUD)
+static void time_state(enum gateway_state next_state);
+static void log_time_to_cloud(void);
+#endif
+
 static uint32_t get_modem_init_delay(void);
 static uint32_t get_join_network_delay(void);
 static uint32_t get_join_cloud_delay(void);
@@ -154,11 +183,54 @@ void gateway_fsm_init(void)
 }
 
 void gateway_fsm(void)
+{
+	enum gateway_state start = gsm.state;
+	enum gateway_state prev;
+	int i;
+
+	atomic_clear(&gsm.event_pending);
+
+	/* Stop when the machine settles or comes back around to where it
+	 * started (the FOTA and disconnect states form a loop).
+	 */
+	for (i = 0; i < MAX_TRANSITIONS_PER_RUN; i++) {
+		prev = gsm.state;
+		run_state();
+		if (gsm.state == prev || gsm.state == start) {
+			break;
+		}
+	}
+}
+
+void gateway_fsm_event(void)
+{
+	if (atomic_set(&gsm.event_pending, 1) == 0) {
+		gateway_fsm_event_callback();
+	}
+}
+
+void gateway_fsm_request_decommission(void)
+{
+	gsm.cloud_disconnect_request = true;
+	gsm.decommission_request = true;
+	gateway_fsm_event();
+}
+
+void gateway_fsm_request_cloud_disconnect(void)
+{
+	gsm.cloud_disconnect_request = true;
+	gateway_fsm_event();
+}
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static void run_state(void)
 {
 	switch (gsm.state) {
 	case GATEWAY_STATE_POWER_UP_INIT:
 		set_state(GATEWAY_STATE_MODEM_INIT);
-		gsm.timer = get_modem_init_delay();
+		start_timer(get_modem_init_delay());
 		break;
 
 	case GATEWAY_STATE_MODEM_INIT:
@@ -201,7 +273,7 @@ void gateway_fsm(void)
 	case GATEWAY_STATE_NETWORK_ERROR:
 		if (gateway_fsm_network_error_callback() == 0) {
 			set_state(GATEWAY_STATE_MODEM_INIT);
-			gsm.timer = ERROR_RETRY_SECONDS;
+			start_timer(ERROR_RETRY_SECONDS);
 		}
 		break;
 
@@ -262,40 +334,77 @@ void gateway_fsm(void)
 	}
 }
 
-void gateway_fsm_request_decommission(void)
-{
-	gsm.cloud_disconnect_request = true;
-	gsm.decommission_request = true;
-}
-
-void gateway_fsm_request_cloud_disconnect(void)
-{
-	gsm.cloud_disconnect_request = true;
-}
-
-/******************************************************************************/
-/* Local Function Definitions                                                 */
-/******************************************************************************/
 static void set_state(enum gateway_state next_state)
 {
 	if (next_state != gsm.state) {
+#if defined(CONFIG_GATEWAY_FSM_TIME_TO_CLOUD)
+		time_state(next_state);
+#endif
 		gsm.state = next_state;
 		attr_set_uint32(ATTR_ID_gatewayState, gsm.state);
 	}
 }
 
+/**
+ * @brief Timeouts are kept as a deadline so that running the state machine
+ * for an event doesn't shorten them.
+ */
+static void start_timer(uint32_t seconds)
+{
+	gsm.deadline = k_uptime_get() + ((int64_t)seconds * MSEC_PER_SEC);
+}
+
 static bool timer_expired(void)
 {
-	if (gsm.timer > 0) {
-		gsm.timer -= 1;
+	return (k_uptime_get() >= gsm.deadline);
+}
+
+#if defined(CONFIG_GATEWAY_FSM_TIME_TO_CLOUD)
+/**
+ * @brief Record how long was spent in the current state. A connection
+ * attempt starts at power up and whenever the cloud connection is lost.
+ */
+static void time_state(enum gateway_state next_state)
+{
+	int64_t now = k_uptime_get();
+	struct state_time *entry;
+
+	if (gsm.transitions < ARRAY_SIZE(gsm.trace)) {
+		entry = &gsm.trace[gsm.transitions];
+		entry->state = gsm.state;
+		entry->ms = (uint32_t)(now - gsm.state_start);
 	}
+	gsm.transitions += 1;
+	gsm.state_start = now;
+
+	if (next_state == GATEWAY_STATE_CLOUD_CONNECTED) {
+		log_time_to_cloud();
+	} else if (gsm.state == GATEWAY_STATE_CLOUD_CONNECTED) {
+		gsm.attempt_start = now;
+		gsm.transitions = 0;
+	}
+}
 
-	if (gsm.timer == 0) {
-		return true;
-	} else {
-		return false;
+static void log_time_to_cloud(void)
+{
+	size_t i;
+	size_t n = MIN(gsm.transitions, ARRAY_SIZE(gsm.trace));
+
+	LOG_INF("Time to cloud %u ms (%u transitions)",
+		(uint32_t)(gsm.state_start - gsm.attempt_start),
+		gsm.transitions);
+	for (i = 0; i < n; i++) {
+		LOG_INF("  state %u: %u ms", gsm.trace[i].state,
+			gsm.trace[i].ms);
+	}
+	if (gsm.transitions > n) {
+		LOG_INF("  %u more transitions not recorded",
+			gsm.transitions - n);
 	}
+
+	gsm.transitions = 0;
 }
+#endif
 
 /**
  * @brief Initialize modem after wait has expired.
@@ -306,7 +415,7 @@ static void modem_init_handler(void)
 		if (gsm.modem_init() < 0) {
 			set_state(GATEWAY_STATE_MODEM_ERROR);
 		} else {
-			gsm.timer = get_join_network_delay();
+			start_timer(get_join_network_delay());
 			set_state(GATEWAY_STATE_NETWORK_INIT);
 			gateway_fsm_modem_init_complete_callback();
 		}
@@ -324,7 +433,7 @@ static void network_init_handler(void)
 			set_state(GATEWAY_STATE_NETWORK_ERROR);
 		} else {
 			gsm.modem_and_network_init_complete = true;
-			gsm.timer = NETWORK_CONNECT_CALLBACK_DELAY;
+			start_timer(NETWORK_CONNECT_CALLBACK_DELAY);
 			set_state(GATEWAY_STATE_WAIT_FOR_NETWORK);
 			gateway_fsm_network_init_complete_callback();
 		}
@@ -341,7 +450,7 @@ static void wait_for_network_handler(void)
 			set_state(GATEWAY_STATE_NETWORK_CONNECTED);
 		}
 	} else {
-		gsm.timer = NETWORK_CONNECT_CALLBACK_DELAY;
+		start_timer(NETWORK_CONNECT_CALLBACK_DELAY);
 	}
 }
 
@@ -362,15 +471,15 @@ static void resolve_server_handler(void)
 		set_state(GATEWAY_STATE_NETWORK_DISCONNECTED);
 	} else if (gsm.server_resolved) {
 		set_state(GATEWAY_STATE_WAIT_BEFORE_CLOUD_CONNECT);
-		gsm.timer = get_join_cloud_delay();
+		start_timer(get_join_cloud_delay());
 	} else if (timer_expired()) {
 		if (gsm.resolve_server() == 0) {
 			set_state(GATEWAY_STATE_WAIT_BEFORE_CLOUD_CONNECT);
-			gsm.timer = get_join_cloud_delay();
+			start_timer(get_join_cloud_delay());
 			gsm.server_resolved = true;
 		} else {
 			set_state(GATEWAY_STATE_RESOLVE_SERVER);
-			gsm.timer = RESOLVE_SERVER_RETRY_SECONDS;
+			start_timer(RESOLVE_SERVER_RETRY_SECONDS);
 		}
 	}
 }
@@ -384,7 +493,7 @@ static void wait_before_cloud_connect_handler(void)
 	} else if (timer_expired()) {
 		set_state(GATEWAY_STATE_CLOUD_CONNECTING);
 		if (gsm.cloud_connect() == 0) {
-			gsm.timer = CLOUD_CONNECT_TIMEOUT;
+			start_timer(CLOUD_CONNECT_TIMEOUT);
 		} else {
 			set_state(GATEWAY_STATE_CLOUD_ERROR);
 			attr_set_uint32(ATTR_ID_commissioningBusy, false);
@@ -417,7 +526,7 @@ static void cloud_connected_handler(void)
 
 static void disconnected_handler(void)
 {
-	gsm.timer = get_reconnect_cloud_delay();
+	start_timer(get_reconnect_cloud_delay());
 
 	if (gateway_fsm_fota_request()) {
 		set_state(GATEWAY_STATE_FOTA_BUSY);
@@ -544,3 +653,8 @@ __weak void gateway_fsm_cloud_disconnected_callback(void)
 {
 	return;
 }
+
+__weak void gateway_fsm_event_callback(void)
+{
+	return;
+}
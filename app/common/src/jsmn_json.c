@@ -31,207 +31,384 @@ LOG_MODULE_REGISTER(jsmn, CONFIG_JSMN_LOG_LEVEL);
 
 #define ASSERT_BAD_INDEX() __ASSERT(false, "Invalid Index")
 
+#define BAD_INDEX(ctx, i) (((i) < 0) || ((i) >= (ctx)->tokens_found))
+
+#ifdef CONFIG_JSMN_KEY_INDEX
+/* At most every other token is a key.  Each of the two tables has a
+ * load factor of one half or less.
+ */
+#define JSMN_KEY_INDEX_SIZE                                                    \
+	(CONFIG_JSMN_NUMBER_OF_TOKENS * 4 * sizeof(uint16_t))
+#define KEY_INDEX_EMPTY 0
+#define ANY_PARENT -1
+BUILD_ASSERT(CONFIG_JSMN_NUMBER_OF_TOKENS < UINT16_MAX,
+	     "Token index must fit in key index");
+#else
+#define JSMN_KEY_INDEX_SIZE 0
+#endif
+
+/* An arena for the largest document plus allocator overhead
+ * for each parse that can be in progress at the same time
+ */
+#define JSMN_HEAP_OVERHEAD 256
+#define JSMN_ARENA_SIZE                                                        \
+	((CONFIG_JSMN_NUMBER_OF_TOKENS * sizeof(jsmntok_t)) +                  \
+	 JSMN_KEY_INDEX_SIZE + JSMN_HEAP_OVERHEAD)
+#define JSMN_HEAP_SIZE (CONFIG_JSMN_CONCURRENT_PARSES * JSMN_ARENA_SIZE)
+
 const char EMPTY_STRING[] = "";
 
 /******************************************************************************/
-/* Global Data Definitions                                                    */
+/* Local Data Definitions                                                     */
 /******************************************************************************/
-K_MUTEX_DEFINE(jsmn_mutex);
+K_HEAP_DEFINE(jsmn_heap, JSMN_HEAP_SIZE);
 
 /******************************************************************************/
-/* Local Data Definitions                                                     */
+/* Local Function Prototypes                                                  */
 /******************************************************************************/
-struct jsmn {
-	jsmn_parser parser;
-	jsmntok_t tokens[CONFIG_JSMN_NUMBER_OF_TOKENS];
-	int tokens_found;
-	int next_parent;
-	int index;
-	int saved_index;
-	int saved_parent;
-	const char *json;
-};
-
-static struct jsmn jsmn;
+#ifdef CONFIG_JSMN_KEY_INDEX
+static void key_index_build(struct jsmn_context *ctx);
+static int key_index_lookup(const struct jsmn_context *ctx, const char *s,
+			    size_t length, int parent);
+#endif
 
 /******************************************************************************/
 /* Global Function Definitions                                                */
 /******************************************************************************/
-void jsmn_start(const char *p)
+int jsmn_start(struct jsmn_context *ctx, const char *p)
 {
-	k_mutex_lock(&jsmn_mutex, K_FOREVER);
-
-	jsmn_init(&jsmn.parser);
-
-	/* Strip off metadata from AWS because it is too much to process. */
-	/* This assumes order to the JSON ... */
-	char *ignore = strstr(p, ",\"metadata\":");
-	if (ignore != NULL) {
-		*ignore = '}';
-		*(ignore + 1) = 0;
+	jsmn_parser parser;
+	size_t length = strlen(p);
+	int count;
+
+	memset(ctx, 0, sizeof(struct jsmn_context));
+	ctx->json = p;
+
+	/* The first pass counts the tokens so that the arena can be sized. */
+	jsmn_init(&parser);
+	count = jsmn_parse(&parser, p, length, NULL, 0);
+	if (count > CONFIG_JSMN_NUMBER_OF_TOKENS) {
+		count = JSMN_ERROR_NOMEM;
+	} else if (count > 0) {
+		/* Don't hold up the receive thread when the heap is in use. */
+		ctx->tokens = k_heap_alloc(&jsmn_heap,
+					   count * sizeof(jsmntok_t),
+					   K_NO_WAIT);
+		if (ctx->tokens == NULL) {
+			count = JSMN_ERROR_NOMEM;
+		} else {
+			jsmn_init(&parser);
+			count = jsmn_parse(&parser, p, length, ctx->tokens,
+					   count);
+		}
 	}
+	ctx->tokens_found = count;
 
-	jsmn.json = p;
-	jsmn.tokens_found =
-		jsmn_parse(&jsmn.parser, jsmn.json, strlen(jsmn.json),
-			   jsmn.tokens, CONFIG_JSMN_NUMBER_OF_TOKENS);
+#ifdef CONFIG_JSMN_KEY_INDEX
+	key_index_build(ctx);
+#endif
 
-	if (jsmn.tokens_found < 0) {
-		LOG_ERR("jsmn status: %d", jsmn.tokens_found);
+	if (ctx->tokens_found < 0) {
+		LOG_ERR("jsmn status: %d", ctx->tokens_found);
 	} else {
-		LOG_DBG("jsmn jsmn.tokens required: %d", jsmn.tokens_found);
+		LOG_DBG("jsmn tokens required: %d", ctx->tokens_found);
 	}
 
-	(void)jsmn_reset_index();
+	return ctx->tokens_found;
 }
 
-void jsmn_end(void)
+void jsmn_end(struct jsmn_context *ctx)
 {
-	jsmn.json = "";
-	k_mutex_unlock(&jsmn_mutex);
+	if (ctx->index != NULL) {
+		k_heap_free(&jsmn_heap, ctx->index);
+	}
+	if (ctx->tokens != NULL) {
+		k_heap_free(&jsmn_heap, ctx->tokens);
+	}
+	ctx->index = NULL;
+	ctx->tokens = NULL;
+	ctx->tokens_found = 0;
+	ctx->json = EMPTY_STRING;
 }
 
-/* Check that there were enough jsmn.tokens to parse string.
+/* Check that there were enough tokens to parse string.
  * After parsing the first thing should be the JSON object { }.
  */
-bool jsmn_valid(void)
+bool jsmn_valid(const struct jsmn_context *ctx)
 {
-	return ((jsmn.tokens_found > 0) &&
-		(jsmn.tokens[0].type == JSMN_OBJECT));
+	return ((ctx->tokens_found > 0) &&
+		(ctx->tokens[0].type == JSMN_OBJECT));
 }
 
-int jsmn_tokens_found(void)
+int jsmn_tokens_found(const struct jsmn_context *ctx)
 {
-	return jsmn.tokens_found;
+	return ctx->tokens_found;
 }
 
-int jsmn_find_type(const char *s, jsmntype_t type, parent_type_t parent_type)
+int jsmn_find_type(const struct jsmn_context *ctx, struct jsmn_cursor *cursor,
+		   const char *s, jsmntype_t type, parent_type_t parent_type)
 {
 	int location = 0;
-	if (jsmn.index == 0) {
+	if (cursor->index == 0) {
 		return location;
 	}
 
-	/* Analyze a pair of jsmn.tokens of the form <string>, <type> */
-	size_t i = jsmn.index;
-	jsmn.index = 0;
-	for (; ((i + 1) < jsmn.tokens_found); i++) {
-		int length = jsmn.tokens[i].end - jsmn.tokens[i].start;
-		if ((jsmn.tokens[i].type == JSMN_STRING) &&
+	/* Analyze a pair of tokens of the form <string>, <type> */
+	const jsmntok_t *tokens = ctx->tokens;
+	size_t i = cursor->index;
+	cursor->index = 0;
+
+#ifdef CONFIG_JSMN_KEY_INDEX
+	if (ctx->index != NULL) {
+		int key = key_index_lookup(ctx, s, strlen(s),
+					   (parent_type == NO_PARENT) ?
+						   ANY_PARENT :
+						   cursor->parent);
+
+		/* The first occurrence of the key is the answer unless it is
+		 * behind the cursor or a duplicate key has a different type.
+		 * Anything else, including a miss, falls back to the scan so
+		 * that the result never depends on the index.
+		 */
+		if ((key >= 0) && ((size_t)key >= i) &&
+		    ((key + 1) < ctx->tokens_found) &&
+		    (tokens[key + 1].type == type)) {
+			cursor->parent = key + 1;
+			cursor->index = key + 2;
+			return key + 1;
+		}
+	}
+#endif
+
+	for (; ((i + 1) < ctx->tokens_found); i++) {
+		int length = tokens[i].end - tokens[i].start;
+		if ((tokens[i].type == JSMN_STRING) &&
 		    ((int)strlen(s) == length) &&
-		    (strncmp(jsmn.json + jsmn.tokens[i].start, s, length) ==
-		     0) &&
-		    (jsmn.tokens[i + 1].type == type) &&
+		    (strncmp(ctx->json + tokens[i].start, s, length) == 0) &&
+		    (tokens[i + 1].type == type) &&
 		    ((parent_type == NO_PARENT) ||
-		     (jsmn.tokens[i].parent == jsmn.next_parent))) {
+		     (tokens[i].parent == cursor->parent))) {
 			LOG_DBG("Found '%s' at index %d with parent %d", s, i,
-				jsmn.tokens[i].parent);
-			jsmn.next_parent = i + 1;
-			jsmn.index = i + 2;
+				tokens[i].parent);
+			cursor->parent = i + 1;
+			cursor->index = i + 2;
 			break;
 		}
 	}
-	location = jsmn.index - 2 + 1; /* location of the data */
+	location = cursor->index - 2 + 1; /* location of the data */
 	return location;
 }
 
-int jsmn_index(void)
+int jsmn_index(const struct jsmn_cursor *cursor)
 {
-	return jsmn.index;
+	return cursor->index;
 }
 
-void jsmn_reset_index(void)
+void jsmn_reset_index(struct jsmn_cursor *cursor)
 {
-	jsmn.index = 1;
-	jsmn.next_parent = 0;
+	cursor->index = 1;
+	cursor->parent = 0;
 }
 
-void jsmn_save_index(void)
+uint32_t jsmn_convert_uint(const struct jsmn_context *ctx, int index)
 {
-	jsmn.saved_index = jsmn.index;
-	jsmn.saved_parent = jsmn.next_parent;
-}
-
-void jsmn_restore_index(void)
-{
-	jsmn.index = jsmn.saved_index;
-	jsmn.next_parent = jsmn.saved_parent;
-}
-
-uint32_t jsmn_convert_uint(int index)
-{
-	if (index > jsmn.tokens_found) {
+	if (BAD_INDEX(ctx, index)) {
 		ASSERT_BAD_INDEX();
 		return 0;
 	}
 
 	/* Pieces of the JSON message are not null terminated. */
 	char str[MAX_DEC_CONVERSION_STR_SIZE];
-	size_t length = jsmn_strlen(index);
+	size_t length = jsmn_strlen(ctx, index);
 	if (length < sizeof(str)) {
 		memset(str, 0, sizeof(str));
-		memcpy(str, jsmn_string(index), length);
+		memcpy(str, jsmn_string(ctx, index), length);
 		return MIN(UINT32_MAX, strtoul(str, NULL, 10));
 	} else {
 		return 0;
 	}
 }
 
-uint32_t jsmn_convert_hex(int index)
+uint32_t jsmn_convert_hex(const struct jsmn_context *ctx, int index)
 {
-	if (index > jsmn.tokens_found) {
+	if (BAD_INDEX(ctx, index)) {
 		ASSERT_BAD_INDEX();
 		return 0;
 	}
 
 	char str[MAX_HEX_CONVERSION_STR_SIZE];
-	size_t length = jsmn_strlen(index);
+	size_t length = jsmn_strlen(ctx, index);
 	if (length < sizeof(str)) {
 		memset(str, 0, sizeof(str));
-		memcpy(str, jsmn_string(index), length);
+		memcpy(str, jsmn_string(ctx, index), length);
 		return strtoul(str, NULL, 16);
 	} else {
 		return 0;
 	}
 }
 
-jsmntype_t jsmn_type(int index)
+jsmntype_t jsmn_type(const struct jsmn_context *ctx, int index)
 {
-	if (index > jsmn.tokens_found) {
+	if (BAD_INDEX(ctx, index)) {
 		ASSERT_BAD_INDEX();
 		return JSMN_UNDEFINED;
 	}
 
-	return jsmn.tokens[index].type;
+	return ctx->tokens[index].type;
 }
 
-int jsmn_size(int index)
+int jsmn_size(const struct jsmn_context *ctx, int index)
 {
-	if (index > jsmn.tokens_found) {
+	if (BAD_INDEX(ctx, index)) {
 		ASSERT_BAD_INDEX();
 		return 0;
 	}
 
-	return jsmn.tokens[index].size;
+	return ctx->tokens[index].size;
 }
 
-int jsmn_strlen(int index)
+int jsmn_strlen(const struct jsmn_context *ctx, int index)
 {
-	if (index > jsmn.tokens_found) {
+	if (BAD_INDEX(ctx, index)) {
 		ASSERT_BAD_INDEX();
 		return 0;
 	}
 
-	jsmntok_t *tok = &jsmn.tokens[index];
+	const jsmntok_t *tok = &ctx->tokens[index];
 	return (tok->end - tok->start);
 }
 
-const char *jsmn_string(int index)
+const char *jsmn_string(const struct jsmn_context *ctx, int index)
 {
-	if (index > jsmn.tokens_found) {
+	if (BAD_INDEX(ctx, index)) {
 		ASSERT_BAD_INDEX();
 		return EMPTY_STRING;
 	}
 
-	return &jsmn.json[jsmn.tokens[index].start];
+	return &ctx->json[ctx->tokens[index].start];
+}
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+#ifdef CONFIG_JSMN_KEY_INDEX
+/* FNV-1a */
+static uint32_t key_hash(const char *s, size_t length, int parent)
+{
+	uint32_t h = 2166136261U ^ (uint32_t)parent;
+	size_t i;
+
+	for (i = 0; i < length; i++) {
+		h ^= (uint8_t)s[i];
+		h *= 16777619U;
+	}
+	return h;
+}
+
+static bool key_equal(const struct jsmn_context *ctx, int t, const char *s,
+		      size_t length)
+{
+	const jsmntok_t *tok = &ctx->tokens[t];
+
+	return (((size_t)(tok->end - tok->start) == length) &&
+		(strncmp(ctx->json + tok->start, s, length) == 0));
+}
+
+static bool is_key(const struct jsmn_context *ctx, int t)
+{
+	const jsmntok_t *tok = &ctx->tokens[t];
+
+	return ((tok->type == JSMN_STRING) && (tok->size == 1) &&
+		(tok->parent >= 0) &&
+		(ctx->tokens[tok->parent].type == JSMN_OBJECT));
+}
+
+/* Slots hold the token index + 1.  The first occurrence of a key is kept. */
+static void key_index_insert(const struct jsmn_context *ctx, uint16_t *table,
+			     int t, int parent)
+{
+	const jsmntok_t *tok = &ctx->tokens[t];
+	const char *s = ctx->json + tok->start;
+	size_t length = tok->end - tok->start;
+	uint32_t h = key_hash(s, length, parent) & ctx->index_mask;
+	int other;
+
+	while (table[h] != KEY_INDEX_EMPTY) {
+		other = table[h] - 1;
+		if (key_equal(ctx, other, s, length) &&
+		    ((parent == ANY_PARENT) ||
+		     (ctx->tokens[other].parent == parent))) {
+			return;
+		}
+		h = (h + 1) & ctx->index_mask;
+	}
+	table[h] = t + 1;
+}
+
+/* Build a table keyed by (parent, key) and a table keyed by key.
+ * If there isn't enough memory the linear search is used.
+ */
+static void key_index_build(struct jsmn_context *ctx)
+{
+	size_t keys = 0;
+	size_t slots = 1;
+	int i;
+
+	for (i = 1; i < ctx->tokens_found; i++) {
+		if (is_key(ctx, i)) {
+			keys += 1;
+		}
+	}
+	if (keys == 0) {
+		return;
+	}
+
+	while (slots < (2 * keys)) {
+		slots <<= 1;
+	}
+
+	ctx->index = k_heap_alloc(&jsmn_heap, 2 * slots * sizeof(uint16_t),
+				  K_NO_WAIT);
+	if (ctx->index == NULL) {
+		LOG_WRN("Unable to allocate key index");
+		return;
+	}
+	memset(ctx->index, 0, 2 * slots * sizeof(uint16_t));
+	ctx->index_mask = slots - 1;
+
+	for (i = 1; i < ctx->tokens_found; i++) {
+		if (is_key(ctx, i)) {
+			key_index_insert(ctx, ctx->index, i,
+					 ctx->tokens[i].parent);
+			key_index_insert(ctx, ctx->index + slots, i,
+					 ANY_PARENT);
+		}
+	}
+}
+
+/**
+ * @retval token index of the first key with a matching parent, otherwise -1
+ */
+static int key_index_lookup(const struct jsmn_context *ctx, const char *s,
+			    size_t length, int parent)
+{
+	const uint16_t *table = ctx->index;
+	uint32_t h = key_hash(s, length, parent) & ctx->index_mask;
+	int t;
+
+	if (parent == ANY_PARENT) {
+		table += ctx->index_mask + 1;
+	}
+
+	while (table[h] != KEY_INDEX_EMPTY) {
+		t = table[h] - 1;
+		if (key_equal(ctx, t, s, length) &&
+		    ((parent == ANY_PARENT) ||
+		     (ctx->tokens[t].parent == parent))) {
+			return t;
+		}
+		h = (h + 1) & ctx->index_mask;
+	}
+	return -1;
 }
+#endif
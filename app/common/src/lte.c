@@ -33,6 +33,7 @@ LOG_MODULE_REGISTER(lte, CONFIG_LTE_LOG_LEVEL);
 #include "lcz_qrtc.h"
 #include "attr.h"
 #include "gateway_common.h"
+#include "gateway_fsm.h"
 
 #ifdef CONFIG_BLUEGRASS
 #include "bluegrass.h"
@@ -364,6 +365,7 @@ static void iface_ready_evt_handler(struct net_mgmt_event_callback *cb,
 #if defined(CONFIG_LCZ_LWM2M_CONN_MON)
 	lcz_lwm2m_conn_mon_update_values();
 #endif
+	gateway_fsm_event();
 }
 
 static void iface_down_evt_handler(struct net_mgmt_event_callback *cb,
@@ -375,6 +377,7 @@ static void iface_down_evt_handler(struct net_mgmt_event_callback *cb,
 
 	LTE_LOG_DBG("LTE is down");
 	lcz_led_turn_off(NETWORK_LED);
+	gateway_fsm_event();
 }
 
 /**
@@ -438,6 +441,7 @@ static void modem_event_callback(enum mdm_hl7800_event event, void *event_data)
 			lcz_led_turn_off(NETWORK_LED);
 			break;
 		}
+		gateway_fsm_event();
 		break;
 
 	case HL7800_EVENT_APN_UPDATE:
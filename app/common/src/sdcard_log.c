@@ -18,6 +18,9 @@ LOG_MODULE_REGISTER(sdcard_log, CONFIG_SD_CARD_LOG_LEVEL);
 #include <fs/fs.h>
 #include <drivers/gpio.h>
 #include <ff.h>
+#include <sys/crc.h>
+#include <sys/timeutil.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -48,6 +51,114 @@ LOG_MODULE_REGISTER(sdcard_log, CONFIG_SD_CARD_LOG_LEVEL);
 
 #define SD_ACCESS_SEM_TIMEOUT K_MSEC(2000)
 
+#define SD_LOG_SECTOR_SIZE 512
+
+BUILD_ASSERT((CONFIG_SD_CARD_LOG_BUFFER_SIZE % SD_LOG_SECTOR_SIZE) == 0,
+	     "Staging buffer must be a multiple of the sector size");
+BUILD_ASSERT(CONFIG_SD_CARD_LOG_FLUSH_BYTES <= CONFIG_SD_CARD_LOG_BUFFER_SIZE,
+	     "Flush threshold is larger than the staging buffer");
+
+#ifdef CONFIG_SD_CARD_LOG_AD_BINARY
+/* The sensor log is a ring of fixed size records that follows a one sector
+ * header holding two copies of the ring index.
+ */
+#define SD_LOG_RING_MAGIC 0x4244414C /* LADB */
+#define SD_LOG_RING_VERSION 1
+#define SD_LOG_RING_HEADER_SIZE SD_LOG_SECTOR_SIZE
+#define SD_LOG_RING_SLOT_SIZE (SD_LOG_RING_HEADER_SIZE / 2)
+#define SD_LOG_RING_RECORD_OFFSET(i)                                           \
+	(SD_LOG_RING_HEADER_SIZE + ((i) * sizeof(SdLogAdRecord_t)))
+
+/* Longest CSV line (including the terminator) created by the export */
+#define SD_LOG_EXPORT_LINE_MAX 48
+#define SD_LOG_EXPORT_BATCH 8
+
+typedef struct __packed SdLogRingHeader {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t recordSize;
+	uint32_t capacity;
+	uint32_t head; /* index of the next record */
+	uint32_t count;
+	uint32_t sequence;
+	uint32_t crc;
+} SdLogRingHeader_t;
+
+typedef struct __packed SdLogAdRecord {
+	uint8_t addr[sizeof(bt_addr_t)];
+	uint8_t recordType;
+	uint16_t id;
+	uint16_t data;
+	uint32_t epoch;
+	uint8_t crc; /* CRC-8 of the preceding bytes */
+} SdLogAdRecord_t;
+
+BUILD_ASSERT((SD_LOG_SECTOR_SIZE % sizeof(SdLogAdRecord_t)) == 0,
+	     "Records must not span sectors");
+
+typedef struct SdLogRing {
+	uint32_t capacity;
+	uint32_t head;
+	uint32_t count;
+	uint32_t sequence;
+} SdLogRing_t;
+#endif
+
+#ifdef CONFIG_CONTACT_TRACING
+/* The numbered log files (YYMMDDHH.log) in the root directory are tracked
+ * by an index on the card so that they can be listed and removed without
+ * reading the directory.  The directory is only read when the index is
+ * missing or is too far behind to be brought up to date by checking for
+ * the files of the hours since it was last refreshed.
+ */
+#define SD_LOG_INDEX_PATH "/SD:/logindex.bin"
+#define SD_LOG_INDEX_MAGIC 0x58444E49 /* INDX */
+#define SD_LOG_INDEX_VERSION 1
+/* Number of files kept by the cleanup */
+#define SD_LOG_INDEX_KEEP 255
+/* Room for the files created between cleanups */
+#define SD_LOG_INDEX_MAX (SD_LOG_INDEX_KEEP + 33)
+#define SD_LOG_INDEX_MAX_GAP_HOURS 72
+#define SECONDS_PER_HOUR 3600
+#define SD_LOG_INDEX_PURGE_BATCH 16
+
+typedef struct SdLogIndexEntry {
+	uint32_t number; /* file name */
+	uint32_t size;
+	uint32_t epoch; /* start of the hour in the name */
+} SdLogIndexEntry_t;
+
+typedef struct SdLogIndexHeader {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t count;
+	uint32_t scanned;
+	uint32_t evicted;
+	uint32_t crc; /* of the header (up to here) and the entries */
+} SdLogIndexHeader_t;
+#endif
+
+/* Records are staged in RAM and written to a file that is kept open.
+ * A commit writes the staged data and syncs the file (size and FAT).
+ */
+typedef struct SdLog {
+	const char *path;
+	struct fs_file_t zfp;
+	struct k_mutex mutex;
+	struct k_work_delayable flushWork;
+	bool opened;
+	bool seek;
+	/* file offset of the first staged byte */
+	int seekOffset;
+	int maxLength;
+	size_t staged;
+	SdCardLogStats_t stats;
+#ifdef CONFIG_SD_CARD_LOG_AD_BINARY
+	SdLogRing_t *ring; /* NULL for CSV logs */
+#endif
+	uint8_t buf[CONFIG_SD_CARD_LOG_BUFFER_SIZE];
+} SdLog_t;
+
 /******************************************************************************/
 /* Global Data Definitions                                                    */
 /******************************************************************************/
@@ -65,42 +176,112 @@ static struct fs_mount_t mp = {
 static const char *mountPoint = "/SD:";
 #if defined(CONFIG_BOARD_MG100)
 static const char *batteryFilePath = "/SD:/mg100B.csv";
+#ifdef CONFIG_SD_CARD_LOG_AD_BINARY
+static const char *sensorFilePath = "/SD:/mg100Ad.bin";
+#else
 static const char *sensorFilePath = "/SD:/mg100Ad.csv";
+#endif
 static const char *essFilePath = "/SD:/mg100ess.csv";
 #elif defined(CONFIG_BOARD_BL5340_DVK_CPUAPP) || \
       defined(CONFIG_BOARD_BL5340PA_DVK_CPUAPP)
 static const char *batteryFilePath = "/SD:/bl5340B.csv";
+#ifdef CONFIG_SD_CARD_LOG_AD_BINARY
+static const char *sensorFilePath = "/SD:/bl5340Ad.bin";
+#else
 static const char *sensorFilePath = "/SD:/bl5340Ad.csv";
+#endif
 static const char *essFilePath = "/SD:/bl5340es.csv";
 #endif
 
 static bool sdCardPresent = false;
-static struct fs_file_t batteryLogZfp;
-static int batteryLogSeekOffset = 0;
-static int batteryLogMaxLength = SDCARD_LOG_DEFAULT_MAX_LENGTH * B_PER_MB;
-static bool batteryLogFileOpened = false;
-static int sensorLogMaxLength = SDCARD_LOG_DEFAULT_MAX_LENGTH * B_PER_MB;
-static int essLogMaxLength = SDCARD_LOG_DEFAULT_MAX_LENGTH * B_PER_MB;
 
+static SdLog_t batteryLog = {
+	.maxLength = SDCARD_LOG_DEFAULT_MAX_LENGTH * B_PER_MB
+};
 #ifdef CONFIG_SCAN_FOR_BT510
-static struct fs_file_t sensorLogFileZfp;
-static int sensorLogSeekOffset = 0;
-static bool sensorLogFileOpened = false;
+#ifdef CONFIG_SD_CARD_LOG_AD_BINARY
+static SdLogRing_t sensorRing;
+#endif
+static SdLog_t sensorLog = {
+	.maxLength = SDCARD_LOG_DEFAULT_MAX_LENGTH * B_PER_MB,
+#ifdef CONFIG_SD_CARD_LOG_AD_BINARY
+	.ring = &sensorRing,
+#endif
+};
+#endif
+#ifdef CONFIG_ESS_SENSOR
+static SdLog_t essLog = {
+	.maxLength = SDCARD_LOG_DEFAULT_MAX_LENGTH * B_PER_MB
+};
 #endif
 
+static SdLog_t *const logs[] = {
+	&batteryLog,
+#ifdef CONFIG_SCAN_FOR_BT510
+	&sensorLog,
+#endif
 #ifdef CONFIG_ESS_SENSOR
-static struct fs_file_t essLogFileZfp;
-static int essLogSeekOffset = 0;
-static bool essLogFileOpened = false;
+	&essLog,
+#endif
+};
+
+/* Each log keeps its file open.  The log index, log downloads and FOTA
+ * need at least two more handles.
+ */
+#ifdef CONFIG_FS_FATFS_NUM_FILES
+BUILD_ASSERT(CONFIG_FS_FATFS_NUM_FILES >= (ARRAY_SIZE(logs) + 2),
+	     "Not enough FATFS file handles for the SD card logs");
 #endif
 
 #ifdef CONFIG_CONTACT_TRACING
 static struct fs_file_t sdLogZfp;
+
+static struct {
+	bool loaded;
+	bool dirty;
+	uint16_t count;
+	/* start of the hour of the most recent refresh */
+	uint32_t scanned;
+	/* newest file that didn't fit in the index (0 if none) */
+	uint32_t evicted;
+	/* sorted by number (oldest first) */
+	SdLogIndexEntry_t entries[SD_LOG_INDEX_MAX];
+} logIndex;
 #endif
 
 /******************************************************************************/
 /* Local Function Prototypes                                                  */
 /******************************************************************************/
+static void sdLogInit(SdLog_t *pLog, const char *path);
+static int sdLogOpen(SdLog_t *pLog);
+static int sdLogCommit(SdLog_t *pLog, bool all);
+static int sdLogPrintf(SdLog_t *pLog, const char *fmt, ...);
+static int sdLogStaged(SdLog_t *pLog);
+static void sdLogFlushWorkHandler(struct k_work *work);
+
+#ifdef CONFIG_CONTACT_TRACING
+static uint32_t sdLogIndexEpoch(uint32_t number);
+static uint32_t sdLogIndexNumber(uint32_t epoch);
+static bool sdLogIndexParse(const char *name, uint32_t *number);
+static void sdLogIndexInsert(uint32_t number, uint32_t size);
+static void sdLogIndexRemove(int position);
+static uint32_t sdLogIndexCrc(SdLogIndexHeader_t *pHeader);
+static int sdLogIndexLoad(void);
+static int sdLogIndexSave(void);
+static int sdLogIndexRebuild(void);
+static void sdLogIndexPurge(void);
+static void sdLogIndexRefresh(void);
+static int sdLogLsDirScan(const char *full_path, char *buf, int maxlen);
+#endif
+
+#ifdef CONFIG_SD_CARD_LOG_AD_BINARY
+static int sdLogAppend(SdLog_t *pLog, const void *data, size_t length);
+static uint32_t sdLogRingCapacity(SdLog_t *pLog);
+static uint32_t sdLogRingHeaderCrc(const SdLogRingHeader_t *pHeader);
+static void sdLogRingLoad(SdLog_t *pLog);
+static void sdLogRingResize(SdLog_t *pLog);
+static int sdLogRingUpdate(SdLog_t *pLog, size_t length);
+#endif
 
 /******************************************************************************/
 /* Global Function Definitions                                                */
@@ -108,9 +289,18 @@ static struct fs_file_t sdLogZfp;
 int sdCardLogUpdateMaxSize(int Value)
 {
 	int ValueB = Value * B_PER_MB;
-	sensorLogMaxLength = ValueB;
-	essLogMaxLength = ValueB;
-	batteryLogMaxLength = ValueB;
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(logs); i++) {
+		/* The flush work may be committing if the card is present */
+		if (sdCardPresent) {
+			k_mutex_lock(&logs[i]->mutex, K_FOREVER);
+			logs[i]->maxLength = ValueB;
+			k_mutex_unlock(&logs[i]->mutex);
+		} else {
+			logs[i]->maxLength = ValueB;
+		}
+	}
 	LOG_INF("Max log file size = %d MB", Value);
 
 	return attr_set_uint32(ATTR_ID_sdLogMaxSize, Value);
@@ -118,7 +308,7 @@ int sdCardLogUpdateMaxSize(int Value)
 
 int sdCardLogGetMaxSize(void)
 {
-	int LengthB = sensorLogMaxLength / B_PER_MB;
+	int LengthB = batteryLog.maxLength / B_PER_MB;
 	return (LengthB);
 }
 
@@ -152,6 +342,7 @@ int sdCardLogGetSize(void)
 	int Ret = -1;
 
 	if (sdCardPresent == true) {
+		sdCardLogFlush();
 		Status = fs_stat(essFilePath, &fileStat);
 		if (Status == 0) {
 			LogSize += fileStat.size;
@@ -238,18 +429,18 @@ int sdCardLogInit(void)
 
 		if (ret == 0) {
 			LOG_INF("Disk mounted.\n");
-			sdCardPresent = true;
 
-			fs_file_t_init(&batteryLogZfp);
+			sdLogInit(&batteryLog, batteryFilePath);
 #ifdef CONFIG_SCAN_FOR_BT510
-			fs_file_t_init(&sensorLogFileZfp);
+			sdLogInit(&sensorLog, sensorFilePath);
 #endif
 #ifdef CONFIG_ESS_SENSOR
-			fs_file_t_init(&essLogFileZfp);
+			sdLogInit(&essLog, essFilePath);
 #endif
 #ifdef CONFIG_CONTACT_TRACING
 			fs_file_t_init(&sdLogZfp);
 #endif
+			sdCardPresent = true;
 		} else {
 			LOG_ERR("Error mounting disk.\n");
 		}
@@ -261,305 +452,207 @@ int sdCardLogInit(void)
 #ifdef CONFIG_ESS_SENSOR
 int sdCardLogESSData(ESSSensorMsg_t *msg)
 {
-	int ret = -ENODEV;
-	int totalLength = 0;
-	char *logData = 0;
-	struct fs_dirent fileStat;
-
-	if (sdCardPresent) {
-		/* if this is the first open, we want to
-		*	be sure to append to the end rather than overwrite from
-		*	the beginning.
-		*/
-		if (essLogFileOpened == false) {
-			ret = fs_stat(essFilePath, &fileStat);
-			if (ret == 0) {
-				essLogSeekOffset = fileStat.size;
-				essLogFileOpened = true;
-			}
-		}
-
-		/* open and close the file every time to help ensure integrity
-		*	of the file system if power were to be lost in between writes.
-		*/
-		ret = fs_open(&essLogFileZfp, essFilePath,
-			      FS_O_RDWR | FS_O_CREATE);
-		if (ret >= 0) {
-			totalLength = EVENT_MAX_STR_LEN + EVENT_FMT_CHAR_LEN;
-			logData = k_malloc(totalLength);
-			if (logData > 0) {
-				/* find the end of the file */
-				ret = fs_seek(&essLogFileZfp,
-					      essLogSeekOffset, 0);
-
-				/* only try to write if the seek succeeded. */
-				if (ret >= 0) {
-					/* append the timestamp and data */
-					snprintf(logData, totalLength,
-						 "%d,%d,%d,%d\n",
-						 lcz_qrtc_get_epoch(),
-						 (uint32_t)(msg->temperatureC *
-							    100),
-						 (uint32_t)(
-							 msg->humidityPercent *
-							 100),
-						 (uint32_t)(msg->pressurePa *
-							    10));
-
-					ret = fs_write(&essLogFileZfp,
-						       logData,
-						       strlen(logData));
-
-					/* only update the offset if the write succeeded. */
-					if (ret >= 0) {
-						essLogSeekOffset +=
-							strlen(logData);
-						/* treat this as a circular buffer to limit log file growth */
-						if (essLogSeekOffset >
-						    essLogMaxLength) {
-							essLogSeekOffset = 0;
-						}
-					}
-				}
-				k_free(logData);
-				logData = 0;
-			}
-			/* close the file (this also flushes data to the physical media) */
-			ret = fs_close(&essLogFileZfp);
-		}
-	}
-
-	return ret;
+	return sdLogPrintf(&essLog, "%d,%d,%d,%d\n", lcz_qrtc_get_epoch(),
+			   (uint32_t)(msg->temperatureC * 100),
+			   (uint32_t)(msg->humidityPercent * 100),
+			   (uint32_t)(msg->pressurePa * 10));
 }
 #endif
 
 #ifdef CONFIG_SCAN_FOR_BT510
 int sdCardLogAdEvent(LczSensorAdEvent_t *event)
 {
-	int ret = 0;
-	int totalLength = 0;
-	char *logData = 0;
-	struct fs_dirent fileStat;
+#ifdef CONFIG_SD_CARD_LOG_AD_BINARY
+	SdLogAdRecord_t record;
+
+	memcpy(record.addr, &event->addr, sizeof(record.addr));
+	record.recordType = event->recordType;
+	record.id = event->id;
+	record.data = event->data.u16;
+	record.epoch = event->epoch;
+	record.crc = crc8_ccitt(0xFF, &record, offsetof(SdLogAdRecord_t, crc));
+	return sdLogAppend(&sensorLog, &record, sizeof(record));
+#else
 	char bleAddrStr[BT_ADDR_STR_LEN];
 
-	if (sdCardPresent) {
-		/* if this is the first open, we want to
-		*	be sure to append to the end rather than overwrite from
-		*	the beginning.
-		*/
-		if (sensorLogFileOpened == false) {
-			ret = fs_stat(sensorFilePath, &fileStat);
-			if (ret == 0) {
-				sensorLogSeekOffset = fileStat.size;
-				sensorLogFileOpened = true;
-			}
+	bt_addr_to_str(&event->addr, bleAddrStr, sizeof(bleAddrStr));
+	return sdLogPrintf(&sensorLog, "%s,%d,%d,%d,%d\n", bleAddrStr,
+			   event->epoch, event->recordType, event->id,
+			   event->data.u16);
+#endif
+}
+#endif
+
+#ifdef CONFIG_SD_CARD_LOG_AD_BINARY
+int sdCardLogAdEventExport(SdCardLogExport_t *state, char *buf, size_t maxlen)
+{
+	SdLog_t *pLog = &sensorLog;
+	SdLogRing_t *pRing = pLog->ring;
+	SdLogAdRecord_t records[SD_LOG_EXPORT_BATCH];
+	char bleAddrStr[BT_ADDR_STR_LEN];
+	bt_addr_t addr;
+	size_t written = 0;
+	size_t length;
+	uint32_t n;
+	uint32_t i;
+	int ret = 0;
+
+	if (!sdCardPresent) {
+		return -ENODEV;
+	}
+
+	k_mutex_lock(&pLog->mutex, K_FOREVER);
+
+	if (!state->started) {
+		ret = sdLogCommit(pLog, true);
+		if (ret == 0) {
+			ret = sdLogOpen(pLog);
+		}
+		if (ret == 0) {
+			state->started = true;
+			state->remaining = pRing->count;
+			state->index = (pRing->head + pRing->capacity -
+					pRing->count) %
+				       pRing->capacity;
+			state->corrupt = 0;
 		}
+	}
 
-		/* open and close the file every time to help ensure integrity
-		*	of the file system if power were to be lost in between writes.
-		*/
-		ret = fs_open(&sensorLogFileZfp, sensorFilePath,
-			      FS_O_RDWR | FS_O_CREATE);
-		if (ret >= 0) {
-			totalLength = EVENT_MAX_STR_LEN + EVENT_FMT_CHAR_LEN +
-				      BT_ADDR_STR_LEN;
-			logData = k_malloc(totalLength);
-			if (logData > 0) {
-				/* find the end of the file */
-				ret = fs_seek(&sensorLogFileZfp,
-					      sensorLogSeekOffset, 0);
-
-				/* only try to write if the seek succeeded. */
-				if (ret >= 0) {
-					/* append the timestamp and data */
-					bt_addr_to_str(&event->addr, bleAddrStr,
-						       sizeof(bleAddrStr));
-					snprintf(logData, totalLength,
-						 "%s,%d,%d,%d,%d\n", bleAddrStr,
-						 event->epoch,
-						 event->recordType, event->id,
-						 event->data.u16);
-					ret = fs_write(&sensorLogFileZfp,
-						       logData,
-						       strlen(logData));
-
-					/* only update the offset if the write succeeded. */
-					if (ret >= 0) {
-						sensorLogSeekOffset +=
-							strlen(logData);
-						/* treat this as a circular buffer to limit log file growth */
-						if (sensorLogSeekOffset >
-						    sensorLogMaxLength) {
-							sensorLogSeekOffset = 0;
-						}
-					}
-				}
-				k_free(logData);
-				logData = 0;
+	/* Records that are overwritten during the export are replaced by
+	 * newer ones.  The export stops if the log is resized.
+	 */
+	if (state->index >= pRing->capacity) {
+		state->remaining = 0;
+	}
+
+	while (ret == 0 && state->remaining > 0 &&
+	       (maxlen - written) > SD_LOG_EXPORT_LINE_MAX) {
+		n = MIN(state->remaining, ARRAY_SIZE(records));
+		n = MIN(n, pRing->capacity - state->index);
+		n = MIN(n, (maxlen - written) / SD_LOG_EXPORT_LINE_MAX);
+		length = n * sizeof(SdLogAdRecord_t);
+
+		pLog->seek = true;
+		ret = fs_seek(&pLog->zfp,
+			      SD_LOG_RING_RECORD_OFFSET(state->index),
+			      FS_SEEK_SET);
+		if (ret == 0) {
+			ret = fs_read(&pLog->zfp, records, length);
+			ret = (ret == (ssize_t)length) ? 0 : -EIO;
+		}
+
+		for (i = 0; ret == 0 && i < n; i++) {
+			if (records[i].crc !=
+			    crc8_ccitt(0xFF, &records[i],
+				       offsetof(SdLogAdRecord_t, crc))) {
+				state->corrupt += 1;
+				continue;
 			}
-			/* close the file (this also flushes data to the physical media) */
-			ret = fs_close(&sensorLogFileZfp);
+			memcpy(&addr, records[i].addr, sizeof(addr));
+			bt_addr_to_str(&addr, bleAddrStr, sizeof(bleAddrStr));
+			written += snprintf(&buf[written], maxlen - written,
+					    "%s,%u,%u,%u,%u\n", bleAddrStr,
+					    records[i].epoch,
+					    records[i].recordType,
+					    records[i].id, records[i].data);
 		}
+
+		state->index = (state->index + n) % pRing->capacity;
+		state->remaining -= n;
 	}
 
-	return ret;
+	k_mutex_unlock(&pLog->mutex);
+
+	return (ret < 0) ? ret : (int)written;
 }
 #endif
 
 int sdCardLogBatteryData(void *data, int length)
+{
+	return sdLogPrintf(&batteryLog, "%d,%.*s\n", lcz_qrtc_get_epoch(),
+			   length, (char *)data);
+}
+
+int sdCardLogFlush(void)
 {
 	int ret = 0;
-	int totalLength = 0;
-	char *logData = 0;
-	struct fs_dirent fileStat;
+	int status;
+	size_t i;
 
-	if (sdCardPresent) {
-		/* if this is the first open, we want to
-		*	be sure to append to the end rather than overwrite from
-		*	the beginning.
-		*/
-		if (batteryLogFileOpened == false) {
-			ret = fs_stat(batteryFilePath, &fileStat);
-			if (ret == 0) {
-				batteryLogSeekOffset = fileStat.size;
-				batteryLogFileOpened = true;
-			}
-		}
+	if (!sdCardPresent) {
+		return -ENODEV;
+	}
 
-		/* open and close the file every time to help ensure integrity
-		*	of the file system if power were to be lost in between writes.
-		*/
-		ret = fs_open(&batteryLogZfp, batteryFilePath,
-			      FS_O_RDWR | FS_O_CREATE);
-		if (ret >= 0) {
-			totalLength = length + TIMESTAMP_LEN + FMT_CHAR_LEN;
-			logData = k_malloc(totalLength);
-			if (logData > 0) {
-				/* find the end of the file */
-				ret = fs_seek(&batteryLogZfp,
-					      batteryLogSeekOffset, 0);
-
-				/* only try to write if the seek succeeded. */
-				if (ret >= 0) {
-					/* append the timestamp and data */
-					snprintk(logData, totalLength,
-						 "%d,%s\n",
-						 lcz_qrtc_get_epoch(),
-						 (char *)data);
-					ret = fs_write(&batteryLogZfp, logData,
-						       strlen(logData));
-
-					/* only update the offset if the write succeeded. */
-					if (ret >= 0) {
-						batteryLogSeekOffset +=
-							strlen(logData);
-						/* treat this as a circular buffer to limit log file growth */
-						if (batteryLogSeekOffset >
-						    batteryLogMaxLength) {
-							batteryLogSeekOffset =
-								0;
-						}
-					}
-				}
-				k_free(logData);
-				logData = 0;
-			}
-			/* close the file (this also flushes) */
-			ret = fs_close(&batteryLogZfp);
+	for (i = 0; i < ARRAY_SIZE(logs); i++) {
+		k_mutex_lock(&logs[i]->mutex, K_FOREVER);
+		status = sdLogCommit(logs[i], true);
+		k_mutex_unlock(&logs[i]->mutex);
+		if (status < 0) {
+			ret = status;
 		}
 	}
 
 	return ret;
 }
 
-#ifdef CONFIG_CONTACT_TRACING
-
-int sdCardLogCleanup(void)
+void sdCardLogGetStats(SdCardLogStats_t *stats)
 {
-	/* if there are more than 256 entries, delete the oldest files beyond 256 */
+	size_t i;
 
-	int ret, i;
-	struct fs_dir_t dirp;
-	struct fs_dirent entry;
-	char full_path[32] = "/SD:/";
-	int total_files = 0;
-	int delete_idx = 0;
-	uint32_t *dir_listing;
+	memset(stats, 0, sizeof(*stats));
+	if (!sdCardPresent) {
+		return;
+	}
 
-	if (k_sem_take(&sd_card_access_sem, SD_ACCESS_SEM_TIMEOUT) != 0) {
-		return -1;
+	for (i = 0; i < ARRAY_SIZE(logs); i++) {
+		k_mutex_lock(&logs[i]->mutex, K_FOREVER);
+		stats->records += logs[i]->stats.records;
+		stats->commits += logs[i]->stats.commits;
+		stats->bytesWritten += logs[i]->stats.bytesWritten;
+		stats->bytesDropped += logs[i]->stats.bytesDropped;
+		stats->errors += logs[i]->stats.errors;
+		stats->staged += logs[i]->staged;
+		k_mutex_unlock(&logs[i]->mutex);
 	}
+}
 
-	fs_dir_t_init(&dirp);
+#ifdef CONFIG_CONTACT_TRACING
 
-	ret = fs_opendir(&dirp, full_path);
-	if (ret) {
-		k_sem_give(&sd_card_access_sem);
-		return ret;
-	}
+int sdCardLogCleanup(void)
+{
+	char full_path[32];
+	int ret;
 
-	dir_listing = (uint32_t *)k_malloc(4 * 256);
-	if (!dir_listing) {
-		k_sem_give(&sd_card_access_sem);
+	if (k_sem_take(&sd_card_access_sem, SD_ACCESS_SEM_TIMEOUT) != 0) {
 		return -1;
 	}
 
-	memset(dir_listing, 0, 4 * 256);
-
-	for (;;) {
-		ret = fs_readdir(&dirp, &entry);
-
-		/* entry.name[0] == 0 means end-of-dir */
-		if (ret || entry.name[0] == 0) {
-			break;
-		}
-
-		if (entry.type == FS_DIR_ENTRY_FILE) {
-			if (strstr(entry.name, ".LOG") != NULL) {
-				if (total_files < 256) {
-					dir_listing[total_files] =
-						strtoul(entry.name, NULL, 10) &
-						0xFFFFFFFF;
-				}
-				total_files++;
-			}
-		}
+	sdLogIndexRefresh();
+	if (logIndex.evicted != 0) {
+		sdLogIndexPurge();
 	}
-	ret = fs_closedir(&dirp);
-	k_sem_give(&sd_card_access_sem);
 
-	if (total_files > 255) {
+	/* delete the oldest (lowest numbered) files beyond the limit */
+	if (logIndex.count > SD_LOG_INDEX_KEEP) {
 		LOG_WRN("cleaning up SD card, too many log files (%d)",
-			total_files);
-	} else {
-		k_free(dir_listing);
-		return 0;
-	}
-
-	if (k_sem_take(&sd_card_access_sem, SD_ACCESS_SEM_TIMEOUT) != 0) {
-		k_free(dir_listing);
-		return -1;
-	}
-
-	/* now, delete the oldest file (lowest numbered file) */
-	delete_idx = -1;
-	int min = 0xFFFFFFFF;
-	for (i = 0; i < 255; i++) {
-		if (dir_listing[i] < min && dir_listing[i]) {
-			min = dir_listing[i];
-			delete_idx = i;
-		}
+			logIndex.count);
 	}
 
-	if (delete_idx >= 0) {
+	while (logIndex.count > SD_LOG_INDEX_KEEP) {
 		snprintf(full_path, sizeof(full_path), "/SD:/%08u.log",
-			 dir_listing[delete_idx]);
-		fs_unlink(full_path);
+			 logIndex.entries[0].number);
+		ret = fs_unlink(full_path);
+		if (ret < 0 && ret != -ENOENT) {
+			LOG_ERR("Unable to remove %s (%d)",
+				log_strdup(full_path), ret);
+			break;
+		}
+		LOG_WRN("removed %s", log_strdup(full_path));
+		sdLogIndexRemove(0);
 	}
 
-	k_free(dir_listing);
+	sdLogIndexSave();
 	k_sem_give(&sd_card_access_sem);
-	LOG_WRN("removed %s", log_strdup(full_path));
 	return 0;
 }
 
@@ -613,14 +706,11 @@ int sdCardLsDir(const char *path)
 
 int sdCardLogLsDirToString(const char *path, char *buf, int maxlen)
 {
-	/* ("/", sd_log_publish_buf, SD_LOG_PUBLISH_MAX_CHUNK_LEN); */
-	int ret, i;
-	struct fs_dir_t dirp;
-	struct fs_dirent entry;
-	char full_path[128] = "/SD:";
-	uint32_t dir_index = 0;
-	uint32_t *dir_listing;
-	uint32_t *dir_fsize;
+	SdLogIndexEntry_t *pEntry;
+	int bytes_written = 0;
+	int part;
+	int ret;
+	int i;
 
 	if (!path)
 		return -1;
@@ -629,99 +719,81 @@ int sdCardLogLsDirToString(const char *path, char *buf, int maxlen)
 	if (maxlen < 64)
 		return -1;
 
-	strncat(full_path, path, sizeof(full_path) - strlen(full_path) - 1);
 	memset(buf, 0, maxlen);
 
 	if (k_sem_take(&sd_card_access_sem, SD_ACCESS_SEM_TIMEOUT) != 0) {
 		return -1;
 	}
 
-	fs_dir_t_init(&dirp);
+	/* The index only contains the log files in the root directory */
+	if (strcmp(path, "/") != 0) {
+		char full_path[128] = "/SD:";
 
-	ret = fs_opendir(&dirp, full_path);
-	if (ret) {
+		strncat(full_path, path,
+			sizeof(full_path) - strlen(full_path) - 1);
+		ret = sdLogLsDirScan(full_path, buf, maxlen);
 		k_sem_give(&sd_card_access_sem);
 		return ret;
 	}
 
-	dir_listing = (uint32_t *)k_malloc(4 * 256);
-	if (!dir_listing) {
-		k_sem_give(&sd_card_access_sem);
-		return -1;
-	}
-
-	dir_fsize = (uint32_t *)k_malloc(4 * 256);
-	if (!dir_fsize) {
-		k_free(dir_listing);
-		k_sem_give(&sd_card_access_sem);
-		return -1;
-	}
-
-	memset(dir_listing, 0, 4 * 256);
-
-	for (;;) {
-		ret = fs_readdir(&dirp, &entry);
+	sdLogIndexRefresh();
 
-		/* entry.name[0] == 0 means end-of-dir */
-		if (ret || entry.name[0] == 0) {
+	/* newest first */
+	for (i = logIndex.count - 1; i >= 0; i--) {
+		if ((maxlen - bytes_written) <= 32) {
 			break;
 		}
-
-		if (entry.type == FS_DIR_ENTRY_FILE) {
-			if (strstr(entry.name, ".LOG") != NULL) {
-				dir_listing[dir_index] =
-					strtoul(entry.name, NULL, 10) &
-					0xFFFFFFFF;
-				dir_fsize[dir_index++] = entry.size;
-				dir_index = (dir_index & 0xFF);
-			}
+		pEntry = &logIndex.entries[i];
+		if (pEntry->size == 0) {
+			continue;
 		}
+		part = snprintf(&buf[bytes_written], 32, "%08u.log %u\n",
+				pEntry->number, pEntry->size);
+		if (part <= 0) {
+			break;
+		}
+		bytes_written += part;
 	}
 
-	ret = fs_closedir(&dirp);
+	k_sem_give(&sd_card_access_sem);
 
-	int bytes_written = 0;
-	int part = 0;
-	uint32_t max;
-	uint32_t max_idx;
-	while (1) {
-		/* find the maximum integer in the list */
-		max = 0;
-		max_idx = 0xFFFFFFFF;
-		for (i = 0; i < 255; i++) {
-			if (dir_listing[i] > max && dir_listing[i]) {
-				max = dir_listing[i];
-				max_idx = i;
-			}
-		}
+	return 0;
+}
 
-		if (max_idx < 0xFFFFFFFF) {
-			if ((maxlen - bytes_written) > 32 &&
-			    dir_listing[max_idx] && dir_fsize[max_idx]) {
-				part = snprintf(&buf[bytes_written], 32,
-						"%08u.log %u\n",
-						dir_listing[max_idx],
-						dir_fsize[max_idx]);
-				/* set this entry to 0 so it is no longer the max */
-				dir_listing[max_idx] = 0;
-				if (part > 0) {
-					bytes_written += part;
-				} else {
+void sdCardLogIndexUpdate(const char *path)
+{
+	size_t root = strlen(mountPoint) + 1;
+	struct fs_dirent fileStat;
+	uint32_t number;
+	int i;
+
+	/* Only the log files in the root directory are indexed */
+	if (strncmp(path, mountPoint, root - 1) != 0 ||
+	    path[root - 1] != '/' || strchr(&path[root], '/') != NULL ||
+	    !sdLogIndexParse(&path[root], &number)) {
+		return;
+	}
+
+	if (k_sem_take(&sd_card_access_sem, SD_ACCESS_SEM_TIMEOUT) != 0) {
+		return;
+	}
+
+	/* The index is read or rebuilt on the first refresh */
+	if (logIndex.loaded) {
+		if (fs_stat(path, &fileStat) == 0) {
+			sdLogIndexInsert(number, fileStat.size);
+		} else {
+			for (i = 0; i < logIndex.count; i++) {
+				if (logIndex.entries[i].number == number) {
+					sdLogIndexRemove(i);
 					break;
 				}
-			} else {
-				break;
 			}
-		} else {
-			break;
 		}
+		sdLogIndexSave();
 	}
 
-	k_free(dir_listing);
-	k_free(dir_fsize);
 	k_sem_give(&sd_card_access_sem);
-
-	return ret;
 }
 
 int sdCardLogGet(char *pbuf, log_get_state_t *lstate, uint32_t maxlen)
@@ -859,3 +931,801 @@ void sdCardLogTest(void)
 	}
 }
 #endif
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static void sdLogInit(SdLog_t *pLog, const char *path)
+{
+	pLog->path = path;
+	fs_file_t_init(&pLog->zfp);
+	k_mutex_init(&pLog->mutex);
+	k_work_init_delayable(&pLog->flushWork, sdLogFlushWorkHandler);
+}
+
+static int sdLogOpen(SdLog_t *pLog)
+{
+	struct fs_dirent fileStat;
+	int ret;
+
+	if (pLog->opened) {
+		return 0;
+	}
+
+	/* Append to the end rather than overwrite from the beginning */
+	ret = fs_stat(pLog->path, &fileStat);
+	pLog->seekOffset = (ret == 0) ? fileStat.size : 0;
+
+	ret = fs_open(&pLog->zfp, pLog->path, FS_O_RDWR | FS_O_CREATE);
+	if (ret < 0) {
+		LOG_ERR("Unable to open %s (%d)", log_strdup(pLog->path), ret);
+		return ret;
+	}
+
+	pLog->opened = true;
+	pLog->seek = true;
+#ifdef CONFIG_SD_CARD_LOG_AD_BINARY
+	if (pLog->ring != NULL) {
+		sdLogRingLoad(pLog);
+	}
+#endif
+	return 0;
+}
+
+/* When all isn't set only the data up to the last sector boundary is written
+ * so that the next commit doesn't have to read-modify-write the same sector.
+ * The remainder is written when the flush timer expires.
+ */
+static int sdLogCommit(SdLog_t *pLog, bool all)
+{
+	size_t length = pLog->staged;
+	size_t end;
+	int ret;
+
+	if (length == 0) {
+		return 0;
+	}
+
+	ret = sdLogOpen(pLog);
+	if (ret == 0 && !all) {
+		end = ROUND_DOWN(pLog->seekOffset + length, SD_LOG_SECTOR_SIZE);
+		if (end > (size_t)pLog->seekOffset) {
+			length = end - pLog->seekOffset;
+		}
+	}
+
+#ifdef CONFIG_SD_CARD_LOG_AD_BINARY
+	if (ret == 0 && pLog->ring != NULL) {
+		sdLogRingResize(pLog);
+		/* records don't wrap around the end of the file */
+		length = MIN(length, (pLog->ring->capacity - pLog->ring->head) *
+					     sizeof(SdLogAdRecord_t));
+	}
+#endif
+
+	if (ret == 0 && pLog->seek) {
+		ret = fs_seek(&pLog->zfp, pLog->seekOffset, FS_SEEK_SET);
+		pLog->seek = (ret < 0);
+	}
+
+	if (ret >= 0) {
+		ret = fs_write(&pLog->zfp, pLog->buf, length);
+		if (ret >= 0 && (size_t)ret != length) {
+			ret = -ENOSPC;
+		}
+	}
+
+#ifdef CONFIG_SD_CARD_LOG_AD_BINARY
+	if (ret >= 0 && pLog->ring != NULL) {
+		ret = sdLogRingUpdate(pLog, length);
+	}
+#endif
+
+	/* sync updates the directory entry (this is what makes it durable) */
+	if (ret >= 0) {
+		ret = fs_sync(&pLog->zfp);
+	}
+
+	if (ret < 0) {
+		LOG_ERR("Unable to write %s (%d)", log_strdup(pLog->path), ret);
+		pLog->stats.errors += 1;
+		pLog->stats.bytesDropped += pLog->staged;
+		pLog->staged = 0;
+		/* The file is reopened (and the offset read again) on the next
+		 * commit in case the card was removed.
+		 */
+		if (pLog->opened) {
+			fs_close(&pLog->zfp);
+			pLog->opened = false;
+		}
+		return ret;
+	}
+
+	pLog->stats.commits += 1;
+	pLog->stats.bytesWritten += length;
+	pLog->seekOffset += length;
+#ifdef CONFIG_SD_CARD_LOG_AD_BINARY
+	if (pLog->ring != NULL) {
+		pLog->seekOffset = SD_LOG_RING_RECORD_OFFSET(pLog->ring->head);
+	}
+#endif
+	/* treat this as a circular buffer to limit log file growth */
+	if (pLog->seekOffset > pLog->maxLength) {
+		pLog->seekOffset = 0;
+		pLog->seek = true;
+	}
+
+	pLog->staged -= length;
+	memmove(pLog->buf, &pLog->buf[length], pLog->staged);
+
+	/* The ring wrapped in the middle of the staged records */
+	if (all && pLog->staged > 0) {
+		return sdLogCommit(pLog, true);
+	}
+	return 0;
+}
+
+/* Commit or schedule a commit after a record has been staged */
+static int sdLogStaged(SdLog_t *pLog)
+{
+	int ret = 0;
+
+	pLog->stats.records += 1;
+	if (CONFIG_SD_CARD_LOG_FLUSH_MS == 0) {
+		ret = sdLogCommit(pLog, true);
+	} else if (pLog->staged >= CONFIG_SD_CARD_LOG_FLUSH_BYTES) {
+		ret = sdLogCommit(pLog, false);
+	}
+
+	if (pLog->staged > 0) {
+		k_work_schedule(&pLog->flushWork,
+				K_MSEC(CONFIG_SD_CARD_LOG_FLUSH_MS));
+	}
+
+	return ret;
+}
+
+static int sdLogPrintf(SdLog_t *pLog, const char *fmt, ...)
+{
+	va_list ap;
+	size_t space;
+	int length;
+	int ret = 0;
+
+	if (!sdCardPresent) {
+		return -ENODEV;
+	}
+
+	k_mutex_lock(&pLog->mutex, K_FOREVER);
+
+	/* Format in place; commit the staged records if this one won't fit */
+	space = sizeof(pLog->buf) - pLog->staged;
+	va_start(ap, fmt);
+	length = vsnprintf(&pLog->buf[pLog->staged], space, fmt, ap);
+	va_end(ap);
+	if (length >= 0 && (size_t)length >= space && pLog->staged > 0) {
+		ret = sdLogCommit(pLog, true);
+		if (ret == 0) {
+			space = sizeof(pLog->buf);
+			va_start(ap, fmt);
+			length = vsnprintf(pLog->buf, space, fmt, ap);
+			va_end(ap);
+		}
+	}
+
+	if (ret == 0 && (length < 0 || (size_t)length >= space)) {
+		ret = -EFBIG;
+		pLog->stats.errors += 1;
+	}
+
+	if (ret == 0) {
+		pLog->staged += length;
+		ret = sdLogStaged(pLog);
+	}
+
+	k_mutex_unlock(&pLog->mutex);
+	return ret;
+}
+
+#ifdef CONFIG_SD_CARD_LOG_AD_BINARY
+static int sdLogAppend(SdLog_t *pLog, const void *data, size_t length)
+{
+	int ret = 0;
+
+	if (!sdCardPresent) {
+		return -ENODEV;
+	}
+
+	k_mutex_lock(&pLog->mutex, K_FOREVER);
+
+	if (length > sizeof(pLog->buf) - pLog->staged) {
+		ret = sdLogCommit(pLog, true);
+	}
+
+	if (ret == 0) {
+		memcpy(&pLog->buf[pLog->staged], data, length);
+		pLog->staged += length;
+		ret = sdLogStaged(pLog);
+	}
+
+	k_mutex_unlock(&pLog->mutex);
+	return ret;
+}
+
+static uint32_t sdLogRingCapacity(SdLog_t *pLog)
+{
+	if (pLog->maxLength < SD_LOG_RING_RECORD_OFFSET(1)) {
+		return 1;
+	}
+
+	return (pLog->maxLength - SD_LOG_RING_HEADER_SIZE) /
+	       sizeof(SdLogAdRecord_t);
+}
+
+static uint32_t sdLogRingHeaderCrc(const SdLogRingHeader_t *pHeader)
+{
+	return crc32_ieee((const uint8_t *)pHeader,
+			  offsetof(SdLogRingHeader_t, crc));
+}
+
+/* The index is written alternately to two slots so that a torn write
+ * leaves the previous copy intact.  The valid copy with the highest sequence
+ * number is used.
+ */
+static void sdLogRingLoad(SdLog_t *pLog)
+{
+	SdLogRing_t *pRing = pLog->ring;
+	SdLogRingHeader_t header[2];
+	int valid = -1;
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(header); i++) {
+		if (fs_seek(&pLog->zfp, i * SD_LOG_RING_SLOT_SIZE,
+			    FS_SEEK_SET) < 0) {
+			continue;
+		}
+		if (fs_read(&pLog->zfp, &header[i], sizeof(header[i])) !=
+		    (ssize_t)sizeof(header[i])) {
+			continue;
+		}
+		if (header[i].magic != SD_LOG_RING_MAGIC ||
+		    header[i].version != SD_LOG_RING_VERSION ||
+		    header[i].recordSize != sizeof(SdLogAdRecord_t) ||
+		    header[i].crc != sdLogRingHeaderCrc(&header[i]) ||
+		    header[i].head >= header[i].capacity ||
+		    header[i].count > header[i].capacity) {
+			continue;
+		}
+		if (valid < 0 || (int32_t)(header[i].sequence -
+					   header[valid].sequence) > 0) {
+			valid = (int)i;
+		}
+	}
+
+	if (valid < 0) {
+		LOG_INF("Starting new sensor log");
+		memset(pRing, 0, sizeof(SdLogRing_t));
+		pRing->capacity = sdLogRingCapacity(pLog);
+	} else {
+		pRing->capacity = header[valid].capacity;
+		pRing->head = header[valid].head;
+		pRing->count = header[valid].count;
+		pRing->sequence = header[valid].sequence;
+		LOG_INF("Sensor log has %u records", pRing->count);
+	}
+
+	sdLogRingResize(pLog);
+	pLog->seekOffset = SD_LOG_RING_RECORD_OFFSET(pRing->head);
+	pLog->seek = true;
+}
+
+/* Apply a change in the maximum log size */
+static void sdLogRingResize(SdLog_t *pLog)
+{
+	SdLogRing_t *pRing = pLog->ring;
+	uint32_t capacity = sdLogRingCapacity(pLog);
+
+	if (capacity == pRing->capacity) {
+		return;
+	}
+
+	if (pRing->head == pRing->count && pRing->count <= capacity) {
+		/* The ring hasn't wrapped so the records stay in order */
+		pRing->head %= capacity;
+	} else {
+		LOG_WRN("Sensor log size changed, discarding %u records",
+			pRing->count);
+		pRing->head = 0;
+		pRing->count = 0;
+	}
+
+	pRing->capacity = capacity;
+	pLog->seekOffset = SD_LOG_RING_RECORD_OFFSET(pRing->head);
+	pLog->seek = true;
+}
+
+/* Records are written before the index so that the index never refers to
+ * records that haven't been written (seeking away flushes the file buffer).
+ */
+static int sdLogRingUpdate(SdLog_t *pLog, size_t length)
+{
+	SdLogRing_t *pRing = pLog->ring;
+	SdLogRingHeader_t header;
+	uint32_t records = length / sizeof(SdLogAdRecord_t);
+	int ret;
+
+	pRing->head = (pRing->head + records) % pRing->capacity;
+	pRing->count = MIN(pRing->count + records, pRing->capacity);
+	pRing->sequence += 1;
+
+	header.magic = SD_LOG_RING_MAGIC;
+	header.version = SD_LOG_RING_VERSION;
+	header.recordSize = sizeof(SdLogAdRecord_t);
+	header.capacity = pRing->capacity;
+	header.head = pRing->head;
+	header.count = pRing->count;
+	header.sequence = pRing->sequence;
+	header.crc = sdLogRingHeaderCrc(&header);
+
+	pLog->seek = true;
+	ret = fs_seek(&pLog->zfp,
+		      (pRing->sequence & 1) * SD_LOG_RING_SLOT_SIZE,
+		      FS_SEEK_SET);
+	if (ret >= 0) {
+		ret = fs_write(&pLog->zfp, &header, sizeof(header));
+		if (ret >= 0 && (size_t)ret != sizeof(header)) {
+			ret = -ENOSPC;
+		}
+	}
+
+	return ret;
+}
+#endif /* CONFIG_SD_CARD_LOG_AD_BINARY */
+
+static void sdLogFlushWorkHandler(struct k_work *work)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+	SdLog_t *pLog = CONTAINER_OF(dwork, SdLog_t, flushWork);
+
+	k_mutex_lock(&pLog->mutex, K_FOREVER);
+	sdLogCommit(pLog, true);
+	k_mutex_unlock(&pLog->mutex);
+}
+
+#ifdef CONFIG_CONTACT_TRACING
+static uint32_t sdLogIndexEpoch(uint32_t number)
+{
+	struct tm tm = { 0 };
+
+	tm.tm_year = 100 + (number / 1000000);
+	tm.tm_mon = ((number / 10000) % 100) - 1;
+	tm.tm_mday = (number / 100) % 100;
+	tm.tm_hour = number % 100;
+
+	if (tm.tm_mon < 0 || tm.tm_mon > 11 || tm.tm_mday < 1 ||
+	    tm.tm_mday > 31 || tm.tm_hour > 23) {
+		return 0;
+	}
+
+	return (uint32_t)timeutil_timegm(&tm);
+}
+
+static uint32_t sdLogIndexNumber(uint32_t epoch)
+{
+	time_t now = epoch;
+	struct tm now_tm;
+	uint32_t number;
+
+	gmtime_r(&now, &now_tm);
+	number = (now_tm.tm_year % 100) * 1000000;
+	number += (now_tm.tm_mon + 1) * 10000;
+	number += (now_tm.tm_mday) * 100;
+	number += now_tm.tm_hour;
+	return number;
+}
+
+/* Log files are named with eight digits and have a .log extension */
+static bool sdLogIndexParse(const char *name, uint32_t *number)
+{
+	char *end;
+
+	if (strlen(name) != 12 ||
+	    (strcmp(&name[8], ".LOG") != 0 && strcmp(&name[8], ".log") != 0)) {
+		return false;
+	}
+
+	*number = strtoul(name, &end, 10);
+	return (end == &name[8] && *number != 0);
+}
+
+static void sdLogIndexInsert(uint32_t number, uint32_t size)
+{
+	SdLogIndexEntry_t *pEntry;
+	int lo = 0;
+	int hi = logIndex.count;
+	int mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (logIndex.entries[mid].number < number) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	pEntry = &logIndex.entries[lo];
+	if (lo < logIndex.count && pEntry->number == number) {
+		logIndex.dirty |= (pEntry->size != size);
+		pEntry->size = size;
+		return;
+	}
+
+	/* When the index is full the oldest file is forgotten.  The cleanup
+	 * normally keeps the number of files below the limit.
+	 */
+	if (logIndex.count == SD_LOG_INDEX_MAX) {
+		if (lo == 0) {
+			logIndex.evicted = MAX(logIndex.evicted, number);
+			logIndex.dirty = true;
+			return;
+		}
+		logIndex.evicted =
+			MAX(logIndex.evicted, logIndex.entries[0].number);
+		sdLogIndexRemove(0);
+		lo -= 1;
+		pEntry = &logIndex.entries[lo];
+	}
+
+	memmove(pEntry + 1, pEntry,
+		(logIndex.count - lo) * sizeof(SdLogIndexEntry_t));
+	pEntry->number = number;
+	pEntry->size = size;
+	pEntry->epoch = sdLogIndexEpoch(number);
+	logIndex.count += 1;
+	logIndex.dirty = true;
+}
+
+static void sdLogIndexRemove(int position)
+{
+	logIndex.count -= 1;
+	memmove(&logIndex.entries[position], &logIndex.entries[position + 1],
+		(logIndex.count - position) * sizeof(SdLogIndexEntry_t));
+	logIndex.dirty = true;
+}
+
+static uint32_t sdLogIndexCrc(SdLogIndexHeader_t *pHeader)
+{
+	uint32_t crc;
+
+	crc = crc32_ieee((const uint8_t *)pHeader,
+			 offsetof(SdLogIndexHeader_t, crc));
+	return crc32_ieee_update(crc, (const uint8_t *)logIndex.entries,
+				 pHeader->count * sizeof(SdLogIndexEntry_t));
+}
+
+static int sdLogIndexLoad(void)
+{
+	SdLogIndexHeader_t header;
+	size_t length;
+	ssize_t ret;
+
+	ret = fs_open(&sdLogZfp, SD_LOG_INDEX_PATH, FS_O_READ);
+	if (ret < 0) {
+		return ret;
+	}
+
+	ret = fs_read(&sdLogZfp, &header, sizeof(header));
+	if (ret == sizeof(header) && header.magic == SD_LOG_INDEX_MAGIC &&
+	    header.version == SD_LOG_INDEX_VERSION &&
+	    header.count <= SD_LOG_INDEX_MAX) {
+		length = header.count * sizeof(SdLogIndexEntry_t);
+		ret = fs_read(&sdLogZfp, logIndex.entries, length);
+		ret = (ret == (ssize_t)length &&
+		       header.crc == sdLogIndexCrc(&header)) ?
+			      0 :
+			      -EINVAL;
+	} else {
+		ret = -EINVAL;
+	}
+
+	fs_close(&sdLogZfp);
+
+	if (ret == 0) {
+		logIndex.count = header.count;
+		logIndex.scanned = header.scanned;
+		logIndex.evicted = header.evicted;
+	}
+	return ret;
+}
+
+static int sdLogIndexSave(void)
+{
+	SdLogIndexHeader_t header;
+	size_t length = logIndex.count * sizeof(SdLogIndexEntry_t);
+	int ret;
+
+	if (!logIndex.dirty) {
+		return 0;
+	}
+
+	header.magic = SD_LOG_INDEX_MAGIC;
+	header.version = SD_LOG_INDEX_VERSION;
+	header.count = logIndex.count;
+	header.scanned = logIndex.scanned;
+	header.evicted = logIndex.evicted;
+	header.crc = sdLogIndexCrc(&header);
+
+	ret = fs_open(&sdLogZfp, SD_LOG_INDEX_PATH, FS_O_RDWR | FS_O_CREATE);
+	if (ret < 0) {
+		return ret;
+	}
+
+	ret = fs_write(&sdLogZfp, &header, sizeof(header));
+	if (ret == sizeof(header)) {
+		ret = fs_write(&sdLogZfp, logIndex.entries, length);
+		ret = (ret == (ssize_t)length) ?
+			      fs_truncate(&sdLogZfp, sizeof(header) + length) :
+			      -EIO;
+	} else {
+		ret = -EIO;
+	}
+
+	fs_close(&sdLogZfp);
+
+	if (ret < 0) {
+		LOG_ERR("Unable to save log index (%d)", ret);
+	} else {
+		logIndex.dirty = false;
+	}
+	return ret;
+}
+
+static int sdLogIndexRebuild(void)
+{
+	struct fs_dir_t dirp;
+	struct fs_dirent entry;
+	uint32_t number;
+	int ret;
+
+	LOG_WRN("Rebuilding log index");
+	logIndex.count = 0;
+	logIndex.evicted = 0;
+	logIndex.dirty = true;
+
+	fs_dir_t_init(&dirp);
+	ret = fs_opendir(&dirp, "/SD:/");
+	if (ret) {
+		return ret;
+	}
+
+	for (;;) {
+		ret = fs_readdir(&dirp, &entry);
+
+		/* entry.name[0] == 0 means end-of-dir */
+		if (ret || entry.name[0] == 0) {
+			break;
+		}
+
+		if (entry.type == FS_DIR_ENTRY_FILE &&
+		    sdLogIndexParse(entry.name, &number)) {
+			sdLogIndexInsert(number, entry.size);
+		}
+	}
+
+	fs_closedir(&dirp);
+	return ret;
+}
+
+/* Remove the files that are older than those in the index.  This requires
+ * reading the directory, but only happens when there were too many files
+ * when the index was rebuilt.
+ */
+static void sdLogIndexPurge(void)
+{
+	uint32_t purge[SD_LOG_INDEX_PURGE_BATCH];
+	struct fs_dir_t dirp;
+	struct fs_dirent entry;
+	char full_path[32];
+	uint32_t number;
+	size_t count;
+	size_t i;
+	int ret;
+
+	do {
+		count = 0;
+		fs_dir_t_init(&dirp);
+		ret = fs_opendir(&dirp, "/SD:/");
+		if (ret) {
+			return;
+		}
+
+		/* files aren't removed while the directory is open */
+		while (count < ARRAY_SIZE(purge)) {
+			ret = fs_readdir(&dirp, &entry);
+			if (ret || entry.name[0] == 0) {
+				break;
+			}
+			if (entry.type == FS_DIR_ENTRY_FILE &&
+			    sdLogIndexParse(entry.name, &number) &&
+			    number <= logIndex.evicted) {
+				purge[count++] = number;
+			}
+		}
+
+		fs_closedir(&dirp);
+
+		for (i = 0; i < count; i++) {
+			snprintf(full_path, sizeof(full_path), "/SD:/%08u.log",
+				 purge[i]);
+			fs_unlink(full_path);
+		}
+		LOG_WRN("removed %zu old log files", count);
+	} while (count == ARRAY_SIZE(purge));
+
+	logIndex.evicted = 0;
+	logIndex.dirty = true;
+}
+
+/* Bring the index up to date.  Files are created for the current hour, so
+ * only the files of the hours since the previous refresh need to be checked.
+ * The newest file is still growing and the one before it may have grown
+ * since it was indexed, so their sizes are read again.
+ */
+static void sdLogIndexRefresh(void)
+{
+	struct fs_dirent fileStat;
+	char full_path[32];
+	uint32_t now = 0;
+	uint32_t hour;
+	uint32_t number;
+	int i;
+
+	if (lcz_qrtc_epoch_was_set()) {
+		now = lcz_qrtc_get_epoch();
+		now -= now % SECONDS_PER_HOUR;
+	}
+
+	if (!logIndex.loaded) {
+		logIndex.loaded = true;
+		if (sdLogIndexLoad() < 0) {
+			sdLogIndexRebuild();
+			logIndex.scanned = now;
+		}
+	}
+
+	if (now == 0) {
+		sdLogIndexSave();
+		return;
+	}
+
+	if (logIndex.scanned > now ||
+	    (now - logIndex.scanned) >
+		    (SD_LOG_INDEX_MAX_GAP_HOURS * SECONDS_PER_HOUR)) {
+		sdLogIndexRebuild();
+	} else {
+		for (i = MAX(logIndex.count - 2, 0); i < logIndex.count; i++) {
+			snprintf(full_path, sizeof(full_path), "/SD:/%08u.log",
+				 logIndex.entries[i].number);
+			if (fs_stat(full_path, &fileStat) == 0) {
+				sdLogIndexInsert(logIndex.entries[i].number,
+						 fileStat.size);
+			} else {
+				sdLogIndexRemove(i--);
+			}
+		}
+
+		for (hour = logIndex.scanned; hour <= now;
+		     hour += SECONDS_PER_HOUR) {
+			number = sdLogIndexNumber(hour);
+			snprintf(full_path, sizeof(full_path), "/SD:/%08u.log",
+				 number);
+			if (fs_stat(full_path, &fileStat) == 0) {
+				sdLogIndexInsert(number, fileStat.size);
+			}
+		}
+	}
+
+	logIndex.dirty |= (logIndex.scanned != now);
+	logIndex.scanned = now;
+	sdLogIndexSave();
+}
+
+/* Directories other than the root aren't indexed, so they are read and the
+ * log files are listed newest first.
+ */
+static int sdLogLsDirScan(const char *full_path, char *buf, int maxlen)
+{
+	int ret, i;
+	struct fs_dir_t dirp;
+	struct fs_dirent entry;
+	uint32_t dir_index = 0;
+	uint32_t *dir_listing;
+	uint32_t *dir_fsize;
+
+	fs_dir_t_init(&dirp);
+
+	ret = fs_opendir(&dirp, full_path);
+	if (ret) {
+		return ret;
+	}
+
+	dir_listing = (uint32_t *)k_malloc(4 * 256);
+	if (!dir_listing) {
+		fs_closedir(&dirp);
+		return -1;
+	}
+
+	dir_fsize = (uint32_t *)k_malloc(4 * 256);
+	if (!dir_fsize) {
+		k_free(dir_listing);
+		fs_closedir(&dirp);
+		return -1;
+	}
+
+	memset(dir_listing, 0, 4 * 256);
+
+	for (;;) {
+		ret = fs_readdir(&dirp, &entry);
+
+		/* entry.name[0] == 0 means end-of-dir */
+		if (ret || entry.name[0] == 0) {
+			break;
+		}
+
+		if (entry.type == FS_DIR_ENTRY_FILE) {
+			if (strstr(entry.name, ".LOG") != NULL) {
+				dir_listing[dir_index] =
+					strtoul(entry.name, NULL, 10) &
+					0xFFFFFFFF;
+				dir_fsize[dir_index++] = entry.size;
+				dir_index = (dir_index & 0xFF);
+			}
+		}
+	}
+
+	ret = fs_closedir(&dirp);
+
+	int bytes_written = 0;
+	int part = 0;
+	uint32_t max;
+	uint32_t max_idx;
+	while (1) {
+		/* find the maximum integer in the list */
+		max = 0;
+		max_idx = 0xFFFFFFFF;
+		for (i = 0; i < 255; i++) {
+			if (dir_listing[i] > max && dir_listing[i]) {
+				max = dir_listing[i];
+				max_idx = i;
+			}
+		}
+
+		if (max_idx < 0xFFFFFFFF) {
+			if ((maxlen - bytes_written) > 32 &&
+			    dir_listing[max_idx] && dir_fsize[max_idx]) {
+				part = snprintf(&buf[bytes_written], 32,
+						"%08u.log %u\n",
+						dir_listing[max_idx],
+						dir_fsize[max_idx]);
+				/* so that it is no longer the max */
+				dir_listing[max_idx] = 0;
+				if (part > 0) {
+					bytes_written += part;
+				} else {
+					break;
+				}
+			} else {
+				break;
+			}
+		} else {
+			break;
+		}
+	}
+
+	k_free(dir_listing);
+	k_free(dir_fsize);
+
+	return ret;
+}
+#endif /* CONFIG_CONTACT_TRACING */
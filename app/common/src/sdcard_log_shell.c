@@ -0,0 +1,98 @@
+/**
+ * @file sdcard_log_shell.c
+ * @brief
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <shell/shell.h>
+#include <init.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sdcard_log.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define EXPORT_CHUNK_SIZE 256
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static int shell_sdlog_flush_cmd(const struct shell *shell, size_t argc,
+				 char **argv)
+{
+	int rc = sdCardLogFlush();
+
+	if (rc < 0) {
+		shell_error(shell, "Flush failed: %d", rc);
+	}
+
+	return rc;
+}
+
+static int shell_sdlog_stats_cmd(const struct shell *shell, size_t argc,
+				 char **argv)
+{
+	SdCardLogStats_t stats;
+
+	sdCardLogGetStats(&stats);
+	shell_print(shell, "records: %u", stats.records);
+	shell_print(shell, "commits: %u", stats.commits);
+	shell_print(shell, "bytes written: %u", stats.bytesWritten);
+	shell_print(shell, "bytes dropped: %u", stats.bytesDropped);
+	shell_print(shell, "errors: %u", stats.errors);
+	shell_print(shell, "staged: %u", stats.staged);
+
+	return 0;
+}
+
+static int shell_sdlog_export_cmd(const struct shell *shell, size_t argc,
+				  char **argv)
+{
+#ifdef CONFIG_SD_CARD_LOG_AD_BINARY
+	SdCardLogExport_t state = { 0 };
+	static char buf[EXPORT_CHUNK_SIZE];
+	int rc;
+
+	do {
+		rc = sdCardLogAdEventExport(&state, buf, sizeof(buf));
+		if (rc > 0) {
+			shell_fprintf(shell, SHELL_NORMAL, "%s", buf);
+		}
+	} while (rc > 0);
+
+	if (rc < 0) {
+		shell_error(shell, "Export failed: %d", rc);
+	} else if (state.corrupt > 0) {
+		shell_warn(shell, "Skipped %u corrupt records", state.corrupt);
+	}
+
+	return rc;
+#else
+	shell_error(shell, "Binary sensor log not enabled");
+	return -ENOTSUP;
+#endif
+}
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+SHELL_STATIC_SUBCMD_SET_CREATE(
+	sdlog_cmds,
+	SHELL_CMD(export, NULL, "Print the sensor log as CSV",
+		  shell_sdlog_export_cmd),
+	SHELL_CMD(flush, NULL, "Write staged records to the card",
+		  shell_sdlog_flush_cmd),
+	SHELL_CMD(stats, NULL, "Logging statistics", shell_sdlog_stats_cmd),
+	SHELL_SUBCMD_SET_END /* Array terminated. */
+);
+
+SHELL_CMD_REGISTER(sdlog, &sdlog_cmds, "SD card log commands", NULL);
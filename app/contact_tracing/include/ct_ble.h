@@ -19,6 +19,22 @@ extern "C" {
 #include <zephyr/types.h>
 #include <stddef.h>
 
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+struct bt_gatt_dfu_smp_c;
+
+struct ct_ble_link_stats {
+	uint8_t tx_phy;
+	uint8_t rx_phy;
+	uint16_t rx_max_len;
+	/* 1.25 ms units */
+	uint16_t interval;
+	uint16_t mtu;
+	/* bytes per second for the last log download */
+	uint32_t throughput;
+};
+
 /******************************************************************************/
 /* Global Function Prototypes                                                 */
 /******************************************************************************/
@@ -43,6 +59,14 @@ int ct_adv_on_button_isr(void);
  */
 bool ct_ble_is_not_downloading_logs(void);
 
+/**
+ * @brief Accessor function
+ *
+ * @retval true if the log of the sensor that dfu_smp_c belongs to is being
+ * downloaded
+ */
+bool ct_ble_is_downloading_log(struct bt_gatt_dfu_smp_c *dfu_smp_c);
+
 /**
  * @brief SMP echo command used for testing.
  */
@@ -53,7 +77,18 @@ void ct_ble_smp_echo_test(void);
  *
  * @retval true if next request can be sent, false otherwise.
  */
-bool ct_ble_send_next_smp_request(uint32_t new_off);
+bool ct_ble_send_next_smp_request(struct bt_gatt_dfu_smp_c *dfu_smp_c,
+				  uint32_t new_off);
+
+/**
+ * @brief Parse the entries of the last log download response. With
+ * CONFIG_CT_SMP_PIPELINE this is deferred until the request for the next
+ * part of the log has been sent.
+ *
+ * @retval 0 on success, otherwise an SMP error and the transfer should be
+ * aborted.
+ */
+int ct_ble_process_log_data(struct bt_gatt_dfu_smp_c *dfu_smp_c);
 
 /**
  * @brief Determine if entries that weren't able to be sent can now be
@@ -73,10 +108,26 @@ bool ct_ble_is_publishing_log(void);
  */
 bool ct_ble_get_log_transfer_active_flag(void);
 bool ct_ble_is_connected_to_sensor(void);
+uint32_t ct_ble_get_num_connected_sensors(void);
 bool ct_ble_is_connected_to_central(void);
 uint32_t ct_ble_get_num_connections(void);
 uint32_t ct_ble_get_num_ct_dl_starts(void);
 uint32_t ct_ble_get_num_download_completes(void);
+uint32_t ct_ble_get_last_download_time(void);
+uint32_t ct_ble_get_last_download_size(void);
+uint32_t ct_ble_get_avg_download_time(void);
+void ct_ble_get_link_stats(struct ct_ble_link_stats *stats);
+
+#ifdef CONFIG_CT_CRYPTO_BENCHMARK
+/**
+ * @brief Measure the average time to decrypt a log chunk when a session is
+ * started for each chunk and when one session is used for all of them.
+ *
+ * @retval negative error code, 0 on success
+ */
+int ct_ble_crypto_benchmark(uint32_t iterations, uint32_t *session_ns,
+			    uint32_t *reuse_ns);
+#endif
 uint32_t ct_ble_get_num_scan_results(void);
 uint32_t ct_ble_get_num_ct_scan_results(void);
 
@@ -31,6 +31,11 @@ extern "C" {
 #define LOG_ENTRY_PROTOCOL_V1 0x0001
 #define LOG_ENTRY_PROTOCOL_V2 0x0002
 
+/* Set in the entry_protocol_version of a ct_publish_header_t when it is
+ * followed by one or more entries that are each preceded by a 16-bit length.
+ */
+#define LOG_ENTRY_PROTOCOL_BATCH 0x8000
+
 #define LOG_ENTRY_FW_VERSION_SIZE 4
 
 #define LOG_ENTRY_DEVICE_ID_SIZE 6
@@ -21,6 +21,8 @@ extern "C" {
 /******************************************************************************/
 /* Global Constants, Macros and Type Definitions                              */
 /******************************************************************************/
+struct jsmn_context;
+
 /* clang-format off */
 #define CONFIG_RPC_PARAMS_METHOD_MAX_SIZE     32
 #define CONFIG_RPC_PARAMS_BUF_MAX_SIZE        1024
@@ -55,10 +57,12 @@ typedef struct rpc_params_exec_s {
  * @note This function assumes that the AWS task acknowledges the publish so
  * that it isn't repeatedly sent to the gateway.
  *
+ * @param ctx tokenized shadow
  * @param get_accepted_topic true when topic contains /accepted
  *
  */
-void rpc_params_gateway_parser(bool get_accepted_topic);
+void rpc_params_gateway_parser(const struct jsmn_context *ctx,
+			       bool get_accepted_topic);
 
 /**
  * @brief Get the last rpc method sent via device shadow (if any)
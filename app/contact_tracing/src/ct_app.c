@@ -55,6 +55,10 @@ static uint32_t lastLogPublish = 0;
 static bool awsRebootCommandReceived = false;
 static bool awsSendLogCommandReceived = false;
 static bool awsExecCommandReceived = false;
+/* Publishes that didn't fit in the MQTT in-flight window are retried */
+static bool clearRpcPending = false;
+static bool logChunkPending = false;
+static bool logDirPending = false;
 
 static uint8_t sd_log_publish_buf[SD_LOG_PUBLISH_BUF_SIZE];
 static log_get_state_t log_get_state;
@@ -113,12 +117,21 @@ static void ct_publisher(uint32_t now)
 {
 	int r;
 
+	if (clearRpcPending) {
+		clearRpcPending = (awsSendData((char *)CLEAR_RPC_MSG,
+					       GATEWAY_TOPIC) == -EAGAIN);
+	}
+
 	if (ct_ble_is_publishing_log() == false) {
+		if (logDirPending) {
+			process_log_dir_command();
+		}
+
 		char *cmd = rpc_params_get_method();
 		if (cmd[0]) {
 			LOG_DBG("received rpc: '%s'", log_strdup(cmd));
 			aws_handle_command(cmd);
-			publish_clear_command();
+			clearRpcPending = (publish_clear_command() == -EAGAIN);
 			LOG_DBG("cleared rpc");
 
 			if (awsRebootCommandReceived) {
@@ -164,6 +177,21 @@ static void ct_publisher(uint32_t now)
 static void handle_sd_card_log_get(void)
 {
 	char *sd_log_pbuf;
+	int r;
+
+	/* A chunk that didn't fit in the in-flight window is sent again
+	 * before the next one is read.
+	 */
+	if (logChunkPending) {
+		logChunkPending = (awsSendData(sd_log_publish_buf,
+					       ct_ble_get_log_topic()) ==
+				   -EAGAIN);
+		if (!logChunkPending && log_get_state.bytes_remaining == 0) {
+			awsSendLogCommandReceived = false;
+			log_get_state.rpc_params.filename[0] = '\0';
+		}
+		return;
+	}
 
 	sd_log_pbuf = sd_log_publish_buf;
 	memset(sd_log_publish_buf, 0, sizeof(sd_log_publish_buf));
@@ -192,14 +220,16 @@ static void handle_sd_card_log_get(void)
 				strncat(sd_log_publish_buf, "\r<eof>",
 					sizeof(sd_log_publish_buf) - 1);
 			}
-			awsSendData(sd_log_publish_buf, ct_ble_get_log_topic());
+			r = awsSendData(sd_log_publish_buf,
+					ct_ble_get_log_topic());
+			logChunkPending = (r == -EAGAIN);
 		} else {
 			/* abort if no bytes are ready, likely file not found
 			 * or other fs error */
 			log_get_state.bytes_remaining = 0;
 		}
 
-		if (log_get_state.bytes_remaining == 0) {
+		if (log_get_state.bytes_remaining == 0 && !logChunkPending) {
 			awsSendLogCommandReceived = false;
 			/* clear the filename in prep for next command */
 			log_get_state.rpc_params.filename[0] = '\0';
@@ -257,10 +287,19 @@ static void process_log_dir_command(void)
 #ifdef CONFIG_SD_CARD_LOG
 	char *topic = ct_ble_get_log_topic();
 
+	/* The buffer holds a log chunk that hasn't been sent yet. */
+	logDirPending = true;
+	if (logChunkPending) {
+		return;
+	}
+
 	if (0 == sdCardLogLsDirToString("/", sd_log_publish_buf,
 					SD_LOG_PUBLISH_MAX_CHUNK_LEN)) {
 		LOG_DBG("\t\tpublishing log dir to %s", log_strdup(topic));
-		awsSendData(sd_log_publish_buf, topic);
+		logDirPending =
+			(awsSendData(sd_log_publish_buf, topic) == -EAGAIN);
+	} else {
+		logDirPending = false;
 	}
 #else
 	LOG_WRN("ignoring log_get command, SD card not present");
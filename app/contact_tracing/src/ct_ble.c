@@ -86,7 +86,24 @@ enum aws_publish_state {
 	AWS_PUBLISH_STATE_FAIL
 };
 
-#define SEND_TO_AWS_TIMEOUT_TICKS K_SECONDS(5)
+#define SEND_TO_AWS_TIMEOUT_MS 5000
+#define SEND_TO_AWS_TIMEOUT_TICKS K_MSEC(SEND_TO_AWS_TIMEOUT_MS)
+
+/* A publish is retried while the MQTT in-flight window is full.  The total
+ * is kept well below SEND_TO_AWS_TIMEOUT_TICKS.
+ */
+#define AWS_SEND_RETRY_DELAY K_MSEC(100)
+#define AWS_SEND_MAX_RETRIES 20
+#define AWS_BATCH_RETRY_TICKS K_MSEC(100)
+
+#if CONFIG_CT_AWS_BATCH_MAX_ENTRIES > 1
+#define CT_AWS_BATCH_ENABLED 1
+#define CT_AWS_BATCH_PREFIX_SIZE sizeof(uint16_t)
+#else
+#define CT_AWS_BATCH_ENABLED 0
+#define CT_AWS_BATCH_PREFIX_SIZE 0
+#endif
+
 #define AWS_TOPIC_UP_SUFFIX "/up"
 #define AWS_TOPIC_LOG_SUFFIX "/log"
 
@@ -99,11 +116,21 @@ enum aws_publish_state {
 
 #define SENSOR_CONNECTION_TIMEOUT_TICKS K_SECONDS(10)
 
+/* Adverts older than this aren't used to choose the next sensor */
+#define SENSOR_CANDIDATE_MAX_AGE_MS 10000
+
+/* One connection is always left for a central */
+BUILD_ASSERT(CONFIG_CT_SENSOR_CONNECTIONS < CONFIG_BT_MAX_CONN,
+	     "Too many sensor connections");
+
 #define BT_GAP_INIT_CONN_INT_MIN_CT 6
 #define BT_GAP_INIT_CONN_INT_MAX_CT 20
 #define BT_LE_CONN_PARAM_CT                                                    \
 	BT_LE_CONN_PARAM(BT_GAP_INIT_CONN_INT_MIN_CT,                          \
 			 BT_GAP_INIT_CONN_INT_MAX_CT, 0, 25)
+#define BT_LE_CONN_PARAM_CT_DOWNLOAD                                           \
+	BT_LE_CONN_PARAM(CONFIG_CT_CONN_INTERVAL_DOWNLOAD,                     \
+			 CONFIG_CT_CONN_INTERVAL_DOWNLOAD, 0, 25)
 
 static const struct bt_data ad[] = {
 	BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
@@ -136,6 +163,96 @@ struct smp_buffer {
 
 BUILD_ASSERT((AES_CBC_IV_SIZE % 4) == 0, "IV must be a multiple of 4");
 
+/* State of the connection to a sensor and the download of its log */
+struct ct_sensor {
+	enum central_state app_state;
+	struct bt_conn *conn;
+	bt_addr_le_t addr;
+	uint32_t inactivity;
+	uint16_t mtu;
+	bool encrypt_req;
+	bool log_ble_xfer_active;
+	bool negotiating;
+	bool publishing;
+	int64_t download_start;
+	struct ct_ble_link_stats link;
+	/* AES session that is kept open while a log is downloaded */
+	struct cipher_ctx decrypt_ctx;
+	uint8_t decrypt_key[ATTR_CT_AES_KEY_SIZE];
+	bool decrypt_open;
+	/* Must be 16 bytes (IV size) greater than challenge (plaintext),
+	 * which is assumed to be 64 bytes
+	 */
+	uint8_t challenge_rsp[80];
+	uint8_t challenge_rsp_len;
+
+	struct bt_gatt_discover_params dp;
+	struct bt_gatt_exchange_params mp;
+	struct bt_gatt_dfu_smp_c dfu_smp_c;
+	struct smp_buffer smp_rsp_buff;
+	char smp_fs_download_filename[FS_MGMT_PATH_SIZE + 1];
+	uint8_t log_buffer[CONFIG_CT_LOG_DOWNLOAD_BUFFER_SIZE];
+
+	/* Length of the last response to a log download request. The data
+	 * is decrypted in place in log_buffer and parsed later.
+	 */
+	struct {
+		bool pending;
+		size_t len;
+	} smp_chunk;
+
+	struct k_work discover_services_work;
+	struct k_work smp_challenge_req_work;
+	struct k_work smp_fs_download_work;
+	struct k_work att_timeout_work;
+	struct k_timer conn_timeout_timer;
+	struct k_timer smp_xfer_timeout_timer;
+	/* Publishes the rest of the batch after a disconnect and then
+	 * releases the connection.
+	 */
+	struct k_work_delayable release_work;
+	int64_t release_deadline;
+	bool release_flushed;
+
+	/* Entries waiting to be published, each preceded by its length */
+	struct {
+		struct k_mutex mutex;
+		struct k_work_delayable flush_work;
+		struct ct_publish_header_t hdr;
+		uint8_t buf[CONFIG_CT_AWS_BUF_SIZE -
+			    sizeof(struct ct_publish_header_t)];
+		size_t len;
+		uint16_t count;
+	} aws_batch;
+
+	/* A ct_publish_header_t followed by length prefixed entries. Room is
+	 * left for a batch that is being published plus a download buffer of
+	 * entries.
+	 */
+	struct {
+		bool available;
+		uint8_t buffer[CONFIG_CT_LOG_DOWNLOAD_BUFFER_SIZE +
+			       CONFIG_CT_AWS_BUF_SIZE];
+		uint32_t len;
+		uint32_t idx;
+		uint8_t timeouts;
+		uint8_t failure_cnt;
+		uint32_t prev_ent_size;
+	} stashed_entries;
+};
+
+/* A sensor that advertises log data. The size of the last log downloaded
+ * from it is used to rank it against the others.
+ */
+struct ct_candidate {
+	bt_addr_le_t addr;
+	int64_t last_seen;
+	uint32_t log_size;
+	int8_t rssi;
+	bool has_log;
+	bool downloaded;
+};
+
 /******************************************************************************/
 /* Local Function Prototypes                                                  */
 /******************************************************************************/
@@ -143,7 +260,17 @@ static void disconnected(struct bt_conn *conn, uint8_t reason);
 static void connected(struct bt_conn *conn, uint8_t err);
 static void sensor_disconnected(struct bt_conn *conn, uint8_t reason);
 static void sensor_connected(struct bt_conn *conn, uint8_t err);
-static void sensor_disconnect_cleanup(struct bt_conn *conn);
+static void sensor_disconnect_cleanup(struct ct_sensor *sensor);
+#ifdef CONFIG_CT_CONN_HIGH_THROUGHPUT
+static void sensor_le_param_updated(struct bt_conn *conn, uint16_t interval,
+				    uint16_t latency, uint16_t timeout);
+static void sensor_le_phy_updated(struct bt_conn *conn,
+				  struct bt_conn_le_phy_info *param);
+static void sensor_le_data_len_updated(struct bt_conn *conn,
+				       struct bt_conn_le_data_len_info *info);
+static void negotiate_link(struct ct_sensor *sensor);
+static void speed_up_link(struct ct_sensor *sensor);
+#endif
 
 static void discover_services_work_callback(struct k_work *work);
 static void discover_failed_handler(struct bt_conn *conn, int err);
@@ -159,7 +286,8 @@ static void smp_challenge_req_work_handler(struct k_work *work);
 static void smp_fs_download_work_handler(struct k_work *work);
 static void change_advert_type_work_handler(struct k_work *work);
 static void send_stashed_entries_work_handler(struct k_work *work);
-static void ResetEntryStashInformation(bool giveSemaphore);
+static void ResetEntryStashInformation(struct ct_sensor *sensor,
+				       bool giveSemaphore);
 static int send_smp_challenge_request(struct bt_gatt_dfu_smp_c *dfu_smp_c,
 				      const char *filename, uint32_t offset);
 static int send_smp_challenge_response(struct bt_gatt_dfu_smp_c *dfu_smp_c,
@@ -167,7 +295,7 @@ static int send_smp_challenge_response(struct bt_gatt_dfu_smp_c *dfu_smp_c,
 				       uint8_t *pData, uint32_t dataLen);
 static int send_smp_download_request(struct bt_gatt_dfu_smp_c *dfu_smp_c,
 				     const char *filename, uint32_t offset);
-static void smp_xfer_timeout_handler(struct k_timer *dummy);
+static void smp_xfer_timeout_handler(struct k_timer *timer);
 static int calculate_record_bytes_in_entry(uint8_t *buf, uint16_t record_size,
 					   uint16_t len);
 static bool is_encryption_enabled(void);
@@ -175,14 +303,18 @@ static uint32_t validate_hw_compatibility(const struct device *dev);
 static uint32_t encrypt_cbc(uint8_t *data, uint32_t dataLen, uint8_t *encrypted,
 			    uint32_t encrypted_data_len_max, uint8_t *key,
 			    uint8_t key_size);
-static uint32_t decrypt_cbc(uint8_t *encrypted, uint32_t encrypted_data_len,
-			    uint8_t *decrypted, uint32_t decrypted_data_len_max,
-			    uint8_t *key, uint8_t key_size);
+static int begin_cbc_session(struct cipher_ctx *ctx, uint8_t *key,
+			     enum cipher_op op);
+static uint32_t decrypt_cbc_in_place(struct cipher_ctx *ctx, uint8_t *buf,
+				     uint32_t len);
+static uint32_t decrypt_cbc(struct ct_sensor *sensor, uint8_t *buf,
+			    uint32_t len);
+static void end_decrypt_session(struct ct_sensor *sensor);
 
 static void sensor_scan_conn_init();
 static void sensor_att_timeout_callback(struct k_work *work);
 static void sensor_disconnected(struct bt_conn *conn, uint8_t reason);
-static void sensor_conn_timeout_handler(struct k_timer *dummy);
+static void sensor_conn_timeout_handler(struct k_timer *timer);
 static void ct_sensor_adv_handler(const bt_addr_le_t *addr, int8_t rssi,
 				  uint8_t type, struct net_buf_simple *ad);
 
@@ -191,30 +323,59 @@ static bool valid_ct_record_type(uint8_t type);
 
 static void sensor_att_timeout_callback(struct k_work *work);
 
-static void set_ble_state(enum central_state state);
+static struct ct_sensor *find_sensor(struct bt_conn *conn);
+static struct ct_sensor *find_sensor_by_addr(const bt_addr_le_t *addr);
+static struct ct_sensor *smp_sensor(struct bt_gatt_dfu_smp_c *dfu_smp_c);
+static struct ct_sensor *alloc_sensor(void);
+static struct ct_sensor *stashed_sensor(void);
+static bool sensors_idle(void);
+static struct ct_candidate *find_candidate(const bt_addr_le_t *addr,
+					   bool add);
+static bool candidate_is_better(const struct ct_candidate *a,
+				const struct ct_candidate *b);
+static void rank_candidate(const bt_addr_le_t *addr, uint32_t log_size);
+static void connect_sensor(struct ct_sensor *sensor,
+			   const bt_addr_le_t *addr);
+static void connect_work_handler(struct k_work *work);
+
+static void set_ble_state(struct ct_sensor *sensor, enum central_state state);
 
 static void change_advert_type(enum adv_type adv_type);
-static void disconnect_sensor(void);
+static void disconnect_sensor(struct ct_sensor *sensor);
 
 static void ct_adv_watchdog_work_handler(struct k_work *work);
-static bool ct_ble_remote_active_handler(void);
+static bool ct_ble_remote_active_handler(struct ct_sensor *sensor);
 static void ct_conn_inactivity_work_handler(struct k_work *work);
 static void disable_connectable_adv_work_handler(struct k_work *work);
 
 static void adv_log_filter(const char *msg);
 
 static void aws_work_handler(struct k_work *item);
+static void submit_aws_work(void);
+static int log_data_proc(struct bt_gatt_dfu_smp_c *dfu_smp_c,
+			 size_t data_len);
+static size_t load_aws_work(const struct ct_publish_header_t *hdr,
+			    const uint8_t *src, size_t len);
+static bool stash_entries(struct ct_sensor *sensor,
+			  const struct ct_publish_header_t *hdr,
+			  const uint8_t *src, size_t len);
+static void settle_aws_publish(void);
+static void aws_batch_add(struct ct_sensor *sensor, const uint8_t *entry,
+			  uint16_t size);
+static int aws_batch_flush(struct ct_sensor *sensor, k_timeout_t timeout);
+static void aws_batch_send(struct ct_sensor *sensor);
+static void aws_batch_stash(struct ct_sensor *sensor);
+static void aws_batch_finish(struct ct_sensor *sensor);
+static void aws_batch_flush_work_handler(struct k_work *work);
+static void sensor_release_work_handler(struct k_work *work);
 
 /******************************************************************************/
 /* Local Data Definitions                                                     */
 /******************************************************************************/
-static uint8_t log_buffer[CONFIG_CT_LOG_DOWNLOAD_BUFFER_SIZE];
-static struct smp_buffer smp_rsp_buff;
-static char smp_fs_download_filename[FS_MGMT_PATH_SIZE + 1];
 static uint8_t file_data[FS_MGMT_DL_CHUNK_SIZE];
 
-static struct k_work sensor_att_timeout_work;
-static struct k_timer sensor_conn_timeout_timer;
+static struct ct_sensor sensors[CONFIG_CT_SENSOR_CONNECTIONS];
+static struct ct_candidate candidates[CONFIG_CT_SENSOR_CANDIDATES];
 
 static struct bt_conn_cb conn_callbacks = {
 	.connected = connected,
@@ -224,46 +385,33 @@ static struct bt_conn_cb conn_callbacks = {
 static struct bt_conn_cb sensor_callbacks = {
 	.connected = sensor_connected,
 	.disconnected = sensor_disconnected,
+#ifdef CONFIG_CT_CONN_HIGH_THROUGHPUT
+	.le_param_updated = sensor_le_param_updated,
+	.le_phy_updated = sensor_le_phy_updated,
+	.le_data_len_updated = sensor_le_data_len_updated,
+#endif
 };
 
 static struct bt_conn *central_conn;
 
-static struct bt_gatt_discover_params dp;
-static struct bt_gatt_subscribe_params sp;
-static struct bt_gatt_exchange_params mp;
-static struct bt_gatt_dfu_smp_c dfu_smp_c;
-
-static struct {
-	enum central_state app_state;
-	uint16_t smp_service_handle;
-	struct bt_gatt_subscribe_params smp_subscribe_params;
-	uint32_t inactivity;
-	struct k_work_delayable inactivity_work;
-	uint16_t mtu;
-	struct bt_conn *conn;
-	bool encrypt_req;
-	bool log_ble_xfer_active;
-} remote;
-
-static struct k_work discover_services_work;
 static struct k_work update_advert_work;
-static struct k_work smp_challenge_req_work;
-static struct k_work smp_fs_download_work;
 static struct k_work change_advert_type_work;
 static struct k_work send_stashed_entries_work;
 static struct k_work_delayable ct_adv_watchdog;
 static struct k_work_delayable disable_connectable_adv_work;
+static struct k_work_delayable connect_work;
+static struct k_work_delayable inactivity_work;
 
 static struct k_sem sending_to_aws_sem;
 
 static struct {
-	struct k_work work;
+	struct k_work_delayable work;
 	uint8_t buf[CONFIG_CT_AWS_BUF_SIZE];
 	size_t buf_len;
+	uint32_t retries;
 } aws_work;
 
 static struct k_timer update_advert_timer;
-static struct k_timer smp_xfer_timeout_timer;
 
 static LczContactTracingAd_t ct_mfg_data = {
 	.companyId = LAIRD_CONNECTIVITY_MANUFACTURER_SPECIFIC_COMPANY_ID1,
@@ -287,17 +435,6 @@ static const struct bt_data contact_tracing_ad[] = {
 	BT_DATA(BT_DATA_MANUFACTURER_DATA, &ct_mfg_data, sizeof(ct_mfg_data))
 };
 
-static struct {
-	bool available;
-	uint8_t buffer[CONFIG_CT_LOG_DOWNLOAD_BUFFER_SIZE +
-		       sizeof(struct ct_log_header_v2)];
-	uint32_t len;
-	uint32_t idx;
-	uint8_t timeouts;
-	uint8_t failure_cnt;
-	uint16_t prev_ent_size;
-} stashed_entries;
-
 static struct {
 	bool ble_initialized;
 	enum adv_type adv_type;
@@ -305,20 +442,26 @@ static struct {
 	uint32_t all_ads;
 	uint32_t ads;
 	enum aws_publish_state aws_publish_state;
+	/* Sensor whose entries are being published */
+	struct ct_sensor *aws_owner;
+	/* Entries are being sent from a stash */
 	bool log_publishing;
+	/* Sensor that a connection is being created to */
+	struct ct_sensor *connecting;
 	uint32_t num_connections;
 	uint32_t num_download_starts;
 	uint32_t num_download_completions;
+	uint32_t last_download_time;
+	uint32_t last_download_size;
+	uint32_t total_download_time;
+	/* Link of the last sensor that a log was downloaded from */
+	struct ct_ble_link_stats link;
+	/* Last sensor that dropped the connection during link negotiation */
+	bt_addr_le_t link_refused;
 	uint8_t up_topic[CONFIG_AWS_TOPIC_MAX_SIZE];
 	uint8_t log_topic[CONFIG_AWS_TOPIC_MAX_SIZE];
 } ct;
 
-/* Must be 16 bytes (IV size) greater than challenge (plaintext),
- * which is assumed to be 64 bytes
- */
-static uint8_t challenge_rsp[80];
-static uint8_t challenge_rsp_len;
-
 static const struct device *crypto_dev;
 static uint32_t crypto_cap_flags;
 
@@ -328,6 +471,8 @@ static uint32_t crypto_cap_flags;
 
 void ct_ble_initialize(void)
 {
+	size_t i;
+
 	if (ct.ble_initialized) {
 		LOG_DBG("CT BLE already initialized");
 		return;
@@ -338,24 +483,20 @@ void ct_ble_initialize(void)
 	bt_conn_cb_register(&conn_callbacks);
 
 	k_timer_init(&update_advert_timer, update_advert_timer_handler, NULL);
-	k_timer_init(&smp_xfer_timeout_timer, smp_xfer_timeout_handler, NULL);
 
-	k_work_init(&discover_services_work, discover_services_work_callback);
 	k_work_init(&update_advert_work, update_advert);
-	k_work_init(&smp_challenge_req_work, smp_challenge_req_work_handler);
-	k_work_init(&smp_fs_download_work, smp_fs_download_work_handler);
 	k_work_init(&change_advert_type_work, change_advert_type_work_handler);
 	k_work_init(&send_stashed_entries_work,
 		    send_stashed_entries_work_handler);
 	k_sem_init(&sending_to_aws_sem, 1, 1);
-	k_work_init(&aws_work.work, aws_work_handler);
+	k_work_init_delayable(&aws_work.work, aws_work_handler);
 	k_work_init_delayable(&ct_adv_watchdog, ct_adv_watchdog_work_handler);
-	k_work_init_delayable(&remote.inactivity_work,
+	k_work_init_delayable(&inactivity_work,
 			      ct_conn_inactivity_work_handler);
 
 	if (CONFIG_CT_CONN_INACTIVITY_TICK_RATE_SECONDS != 0) {
 		k_work_schedule(
-			&remote.inactivity_work,
+			&inactivity_work,
 			K_SECONDS(CONFIG_CT_CONN_INACTIVITY_TICK_RATE_SECONDS));
 	}
 
@@ -376,7 +517,9 @@ void ct_ble_initialize(void)
 	start_advertising();
 
 	/* Initialize the state to 'looking for device' */
-	set_ble_state(CENTRAL_STATE_FINDING_DEVICE);
+	for (i = 0; i < ARRAY_SIZE(sensors); i++) {
+		set_ble_state(&sensors[i], CENTRAL_STATE_FINDING_DEVICE);
+	}
 
 	ct.ble_initialized = true;
 }
@@ -392,17 +535,47 @@ void ct_ble_check_stashed_log_entries(void)
 
 bool ct_ble_is_publishing_log(void)
 {
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(sensors); i++) {
+		if (sensors[i].publishing) {
+			return true;
+		}
+	}
+
 	return ct.log_publishing;
 }
 
 bool ct_ble_get_log_transfer_active_flag(void)
 {
-	return remote.log_ble_xfer_active;
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(sensors); i++) {
+		if (sensors[i].log_ble_xfer_active) {
+			return true;
+		}
+	}
+
+	return false;
 }
 
 bool ct_ble_is_connected_to_sensor(void)
 {
-	return (remote.conn != NULL);
+	return (ct_ble_get_num_connected_sensors() != 0);
+}
+
+uint32_t ct_ble_get_num_connected_sensors(void)
+{
+	uint32_t count = 0;
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(sensors); i++) {
+		if (sensors[i].conn != NULL) {
+			count++;
+		}
+	}
+
+	return count;
 }
 
 bool ct_ble_is_connected_to_central(void)
@@ -425,6 +598,30 @@ uint32_t ct_ble_get_num_download_completes(void)
 	return ct.num_download_completions;
 }
 
+uint32_t ct_ble_get_last_download_time(void)
+{
+	return ct.last_download_time;
+}
+
+uint32_t ct_ble_get_last_download_size(void)
+{
+	return ct.last_download_size;
+}
+
+uint32_t ct_ble_get_avg_download_time(void)
+{
+	if (ct.num_download_completions == 0) {
+		return 0;
+	}
+
+	return ct.total_download_time / ct.num_download_completions;
+}
+
+void ct_ble_get_link_stats(struct ct_ble_link_stats *stats)
+{
+	*stats = ct.link;
+}
+
 uint32_t ct_ble_get_num_scan_results(void)
 {
 	return ct.all_ads;
@@ -544,7 +741,21 @@ int ct_ble_publish_dummy_data_to_aws(void)
 
 bool ct_ble_is_not_downloading_logs(void)
 {
-	return (remote.app_state != CENTRAL_STATE_LOG_DOWNLOAD);
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(sensors); i++) {
+		if (sensors[i].app_state == CENTRAL_STATE_LOG_DOWNLOAD) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool ct_ble_is_downloading_log(struct bt_gatt_dfu_smp_c *dfu_smp_c)
+{
+	return (smp_sensor(dfu_smp_c)->app_state ==
+		CENTRAL_STATE_LOG_DOWNLOAD);
 }
 
 /******************************************************************************/
@@ -553,38 +764,40 @@ bool ct_ble_is_not_downloading_logs(void)
 static void mtu_callback(struct bt_conn *conn, uint8_t err,
 			 struct bt_gatt_exchange_params *params)
 {
+	struct ct_sensor *sensor = CONTAINER_OF(params, struct ct_sensor, mp);
 	int r;
 
-	if (conn == remote.conn && conn != NULL) {
-		remote.mtu = bt_gatt_get_mtu(conn);
-		LOG_VRB("MTU: %u", remote.mtu);
-		if (remote.mtu) {
+	if (conn == sensor->conn && conn != NULL) {
+		sensor->mtu = bt_gatt_get_mtu(conn);
+		LOG_VRB("MTU: %u", sensor->mtu);
+		if (sensor->mtu) {
 			/* Update discovery parameters before initiating discovery. */
-			dp.uuid = NULL;
-			dp.func = discover_func_smp;
-			dp.start_handle = 0x0001;
-			dp.end_handle = 0xffff;
-			dp.type = BT_GATT_DISCOVER_PRIMARY;
+			sensor->dp.uuid = NULL;
+			sensor->dp.func = discover_func_smp;
+			sensor->dp.start_handle = 0x0001;
+			sensor->dp.end_handle = 0xffff;
+			sensor->dp.type = BT_GATT_DISCOVER_PRIMARY;
 
-			r = bt_gatt_discover(remote.conn, &dp);
+			r = bt_gatt_discover(sensor->conn, &sensor->dp);
 			if (r) {
-				discover_failed_handler(remote.conn, r);
+				discover_failed_handler(sensor->conn, r);
 			}
 		}
 	}
 }
 
-static int exchange_mtu(struct bt_conn *conn)
+static int exchange_mtu(struct ct_sensor *sensor)
 {
-	mp.func = mtu_callback;
-	return bt_gatt_exchange_mtu(conn, &mp);
+	sensor->mp.func = mtu_callback;
+	return bt_gatt_exchange_mtu(sensor->conn, &sensor->mp);
 }
 
 static void discover_services_work_callback(struct k_work *work)
 {
-	ARG_UNUSED(work);
+	struct ct_sensor *sensor =
+		CONTAINER_OF(work, struct ct_sensor, discover_services_work);
 
-	exchange_mtu(remote.conn);
+	exchange_mtu(sensor);
 }
 
 static void discover_failed_handler(struct bt_conn *conn, int err)
@@ -600,6 +813,8 @@ static uint8_t discover_func_smp(struct bt_conn *conn,
 				 const struct bt_gatt_attr *attr,
 				 struct bt_gatt_discover_params *params)
 {
+	struct ct_sensor *sensor = CONTAINER_OF(params, struct ct_sensor, dp);
+	struct bt_gatt_dfu_smp_c *dfu_smp_c = &sensor->dfu_smp_c;
 	int err;
 	struct bt_gatt_service_val *gatt_service;
 
@@ -615,11 +830,12 @@ static uint8_t discover_func_smp(struct bt_conn *conn,
 
 	if (bt_uuid_cmp(gatt_service->uuid, DFU_SMP_UUID_SERVICE) == 0) {
 		LOG_VRB("Found SMP service (handle: %d)", attr->handle);
-		dp.uuid = NULL;
-		dp.start_handle = LBT_NEXT_HANDLE_AFTER_SERVICE(attr->handle);
-		dp.type = BT_GATT_DISCOVER_CHARACTERISTIC;
+		params->uuid = NULL;
+		params->start_handle =
+			LBT_NEXT_HANDLE_AFTER_SERVICE(attr->handle);
+		params->type = BT_GATT_DISCOVER_CHARACTERISTIC;
 
-		err = bt_gatt_discover(conn, &dp);
+		err = bt_gatt_discover(conn, params);
 		if (err) {
 			LOG_ERR("Discover failed (err %d)", err);
 		}
@@ -627,42 +843,43 @@ static uint8_t discover_func_smp(struct bt_conn *conn,
 	} else if (bt_uuid_cmp(gatt_service->uuid, DFU_SMP_UUID_CHAR) == 0) {
 		LOG_VRB("Found SMP characteristic (value handle: %d)",
 			LBT_NEXT_HANDLE_AFTER_SERVICE(attr->handle));
-		dfu_smp_c.handles.smp =
+		dfu_smp_c->handles.smp =
 			LBT_NEXT_HANDLE_AFTER_SERVICE(attr->handle);
-		dp.uuid = BT_UUID_GATT_CCC;
-		dp.start_handle = LBT_NEXT_HANDLE_AFTER_CHAR(attr->handle);
-		dp.type = BT_GATT_DISCOVER_DESCRIPTOR;
-		sp.value_handle = bt_gatt_attr_value_handle(attr);
+		params->uuid = BT_UUID_GATT_CCC;
+		params->start_handle = LBT_NEXT_HANDLE_AFTER_CHAR(attr->handle);
+		params->type = BT_GATT_DISCOVER_DESCRIPTOR;
 
-		err = bt_gatt_discover(conn, &dp);
+		err = bt_gatt_discover(conn, params);
 		if (err) {
 			LOG_ERR("Discover failed (err %d)", err);
 		}
 		return BT_GATT_ITER_STOP;
 	} else if (params->type == BT_GATT_DISCOVER_DESCRIPTOR) {
-		dfu_smp_c.conn = conn;
-		dfu_smp_c.notification_params.notify = bt_gatt_dfu_smp_c_notify;
-		dfu_smp_c.notification_params.value = BT_GATT_CCC_NOTIFY;
-		dfu_smp_c.handles.smp_ccc = attr->handle;
-		dfu_smp_c.notification_params.value_handle =
-			dfu_smp_c.handles.smp;
-		dfu_smp_c.notification_params.ccc_handle =
-			dfu_smp_c.handles.smp_ccc;
-		atomic_set_bit(dfu_smp_c.notification_params.flags,
+		dfu_smp_c->conn = conn;
+		dfu_smp_c->notification_params.notify =
+			bt_gatt_dfu_smp_c_notify;
+		dfu_smp_c->notification_params.value = BT_GATT_CCC_NOTIFY;
+		dfu_smp_c->handles.smp_ccc = attr->handle;
+		dfu_smp_c->notification_params.value_handle =
+			dfu_smp_c->handles.smp;
+		dfu_smp_c->notification_params.ccc_handle =
+			dfu_smp_c->handles.smp_ccc;
+		atomic_set_bit(dfu_smp_c->notification_params.flags,
 			       BT_GATT_SUBSCRIBE_FLAG_VOLATILE);
 
-		err = bt_gatt_subscribe(conn, &dfu_smp_c.notification_params);
+		err = bt_gatt_subscribe(conn, &dfu_smp_c->notification_params);
 		if (err && err != -EALREADY) {
 			LOG_ERR("Subscribe failed (err %d)", err);
 		} else {
 			/* now, send a download command to grab the log */
-			set_ble_state(CENTRAL_STATE_CONNECTED_AND_CONFIGURED);
+			set_ble_state(sensor,
+				      CENTRAL_STATE_CONNECTED_AND_CONFIGURED);
 
 			if (is_encryption_enabled()) {
-				k_work_submit(&smp_challenge_req_work);
+				k_work_submit(&sensor->smp_challenge_req_work);
 			} else {
-				remote.encrypt_req = false;
-				k_work_submit(&smp_fs_download_work);
+				sensor->encrypt_req = false;
+				k_work_submit(&sensor->smp_fs_download_work);
 			}
 		}
 
@@ -741,7 +958,7 @@ static int start_advertising(void)
  */
 static void connected(struct bt_conn *conn, uint8_t err)
 {
-	if (conn == remote.conn) {
+	if (find_sensor(conn) != NULL) {
 		return;
 	}
 
@@ -796,12 +1013,18 @@ static void disconnected(struct bt_conn *conn, uint8_t reason)
 static void sensor_connected(struct bt_conn *conn, uint8_t err)
 {
 	char addr[BT_ADDR_LE_STR_LEN];
-	if (conn != remote.conn) {
+	struct ct_sensor *sensor = find_sensor(conn);
+	if (sensor == NULL) {
 		return;
 	}
 
 	bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
 
+	k_timer_stop(&sensor->conn_timeout_timer);
+	if (ct.connecting == sensor) {
+		ct.connecting = NULL;
+	}
+
 	if (err || conn == NULL) {
 		goto fail;
 	}
@@ -809,24 +1032,32 @@ static void sensor_connected(struct bt_conn *conn, uint8_t err)
 	LOG_INF("Connected sensor: %s", log_strdup(addr));
 	attr_set_string(ATTR_ID_sensorBluetoothAddress, addr, strlen(addr));
 
-	remote.encrypt_req = false;
-	remote.log_ble_xfer_active = true;
+	sensor->encrypt_req = false;
+	sensor->log_ble_xfer_active = true;
 	ct.num_connections++;
-	k_timer_stop(&sensor_conn_timeout_timer);
-	k_work_submit(&discover_services_work);
+#ifdef CONFIG_CT_CONN_HIGH_THROUGHPUT
+	negotiate_link(sensor);
+#endif
+	k_work_submit(&sensor->discover_services_work);
+
+	/* Look for other sensors while this log is downloaded */
+	lcz_bt_scan_resume(ct.scan_id);
+	k_work_schedule(&connect_work,
+			K_MSEC(CONFIG_CT_SENSOR_SELECT_WINDOW_MS));
 
 	return;
 
 fail:
 	LOG_ERR("Failed to connect to sensor %s (%u %s)", log_strdup(addr), err,
 		lbt_get_hci_err_string(err));
-	sensor_disconnect_cleanup(conn);
+	sensor_disconnect_cleanup(sensor);
 }
 
 static void sensor_disconnected(struct bt_conn *conn, uint8_t reason)
 {
 	char addr[BT_ADDR_LE_STR_LEN];
-	if (conn != remote.conn) {
+	struct ct_sensor *sensor = find_sensor(conn);
+	if (sensor == NULL) {
 		return;
 	}
 
@@ -834,210 +1065,652 @@ static void sensor_disconnected(struct bt_conn *conn, uint8_t reason)
 
 	LOG_INF("Disconnected sensor: %s reason: %s", log_strdup(addr),
 		lbt_get_hci_err_string(reason));
-	sensor_disconnect_cleanup(conn);
-}
-
-static void sensor_disconnect_cleanup(struct bt_conn *conn)
-{
-	k_timer_stop(&smp_xfer_timeout_timer);
 
-	ct.log_publishing = false;
-	bt_conn_unref(conn);
-	remote.conn = NULL;
-	remote.encrypt_req = false;
+	if (sensor->negotiating && reason != BT_HCI_ERR_LOCALHOST_TERM_CONN) {
+		/* Don't ask this sensor for a faster link next time */
+		bt_addr_le_copy(&ct.link_refused, bt_conn_get_dst(conn));
+	}
 
-	set_ble_state(CENTRAL_STATE_FINDING_DEVICE);
+	sensor_disconnect_cleanup(sensor);
 }
 
-static void disconnect_sensor(void)
+static void sensor_disconnect_cleanup(struct ct_sensor *sensor)
 {
-	if (remote.conn) {
-		bt_conn_disconnect(remote.conn,
-				   BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+	struct bt_gatt_dfu_smp_c *dfu_smp_c = &sensor->dfu_smp_c;
+
+	k_timer_stop(&sensor->smp_xfer_timeout_timer);
+	k_timer_stop(&sensor->conn_timeout_timer);
+	if (ct.connecting == sensor) {
+		ct.connecting = NULL;
 	}
 
-	if (stashed_entries.len > sizeof(struct ct_publish_header_t)) {
-		/* There are stashed entries so set flag for them to be sent (after AWS reconnect) */
-		stashed_entries.available = true;
+	ct_ble_process_log_data(dfu_smp_c);
+	end_decrypt_session(sensor);
+
+	/* A sensor whose log couldn't be downloaded goes to the back of the
+	 * queue so that it doesn't hold up the others.
+	 */
+	if (dfu_smp_c->file_size == 0 ||
+	    dfu_smp_c->downloaded_bytes != dfu_smp_c->file_size) {
+		rank_candidate(&sensor->addr, 0);
 	}
+
+	/* This runs in the Bluetooth RX thread so the rest of the batch is
+	 * published from a work item. The connection is held until then so
+	 * that the slot isn't reused before the stash is settled.
+	 */
+	sensor->release_deadline = k_uptime_get() + SEND_TO_AWS_TIMEOUT_MS;
+	sensor->release_flushed = false;
+	k_work_reschedule(&sensor->release_work, K_NO_WAIT);
 }
 
-static void sensor_scan_conn_init()
+static void sensor_release_work_handler(struct k_work *work)
 {
-	k_work_init(&sensor_att_timeout_work, sensor_att_timeout_callback);
+	struct ct_sensor *sensor =
+		CONTAINER_OF(k_work_delayable_from_work(work), struct ct_sensor,
+			     release_work);
+	bool expired = (k_uptime_get() >= sensor->release_deadline);
 
-	bt_conn_cb_register(&sensor_callbacks);
+	/* The publish that is waited for is queued on the same work queue,
+	 * so poll instead of blocking.
+	 */
+	if (k_mutex_lock(&sensor->aws_batch.mutex, K_NO_WAIT) != 0) {
+		k_work_reschedule(&sensor->release_work, AWS_BATCH_RETRY_TICKS);
+		return;
+	}
 
-	lcz_bt_scan_register(&ct.scan_id, ct_sensor_adv_handler);
+	if (!sensor->release_flushed) {
+		if (aws_batch_flush(sensor, K_NO_WAIT) != 0) {
+			if (!expired) {
+				k_mutex_unlock(&sensor->aws_batch.mutex);
+				k_work_reschedule(&sensor->release_work,
+						  AWS_BATCH_RETRY_TICKS);
+				return;
+			}
+			LOG_ERR("ble->aws pub timeout");
+			aws_batch_stash(sensor);
+		}
+		sensor->release_flushed = true;
+		sensor->release_deadline =
+			k_uptime_get() + SEND_TO_AWS_TIMEOUT_MS;
+		expired = false;
+	}
 
-	k_timer_init(&sensor_conn_timeout_timer, sensor_conn_timeout_handler,
-		     NULL);
-}
+	if (k_sem_take(&sending_to_aws_sem, K_NO_WAIT) != 0) {
+		if (!expired) {
+			k_mutex_unlock(&sensor->aws_batch.mutex);
+			k_work_reschedule(&sensor->release_work,
+					  AWS_BATCH_RETRY_TICKS);
+			return;
+		}
+		LOG_ERR("ble->aws pub timeout");
+		/* If publish times out, it must have failed. */
+		ct.aws_publish_state = AWS_PUBLISH_STATE_FAIL;
+		settle_aws_publish();
+	} else {
+		settle_aws_publish();
+		k_sem_give(&sending_to_aws_sem);
+	}
 
-static void sensor_att_timeout_callback(struct k_work *work)
-{
-	bt_conn_disconnect(remote.conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+	k_mutex_unlock(&sensor->aws_batch.mutex);
+
+	sensor->publishing = false;
+	bt_conn_unref(sensor->conn);
+	sensor->conn = NULL;
+	sensor->encrypt_req = false;
+	sensor->negotiating = false;
+
+	set_ble_state(sensor, CENTRAL_STATE_FINDING_DEVICE);
 }
 
-static void sensor_conn_timeout_handler(struct k_timer *dummy)
+static void disconnect_sensor(struct ct_sensor *sensor)
 {
-	/* if this timer expires, it means a connection attempt failed mid-stride
-	 * so disconnect */
-	if (remote.conn != NULL) {
-		LOG_ERR("Failed to connect - connection attempt timeout");
-		k_work_submit(&sensor_att_timeout_work);
+	if (sensor->conn) {
+		bt_conn_disconnect(sensor->conn,
+				   BT_HCI_ERR_REMOTE_USER_TERM_CONN);
 	}
-}
 
-static void adv_log_filter(const char *msg)
-{
-	if ((ct.all_ads % CONFIG_CT_ADV_LOG_FILTER_CNT) == 0) {
-		LOG_INF("Ignoring ad: %s; all ads: %d ct ads: %d",
-			log_strdup(msg), ct.all_ads, ct.ads);
+	if (sensor->stashed_entries.len > sizeof(struct ct_publish_header_t)) {
+		/* There are stashed entries so set flag for them to be sent (after AWS reconnect) */
+		sensor->stashed_entries.available = true;
 	}
 }
 
-static void ct_sensor_adv_handler(const bt_addr_le_t *addr, int8_t rssi,
-				  uint8_t type, struct net_buf_simple *ad)
+#ifdef CONFIG_CT_CONN_HIGH_THROUGHPUT
+/* Ask for 2M PHY and the longest data length as soon as the sensor is
+ * connected. Sensors that don't support them stay on 1M and 27 bytes.
+ */
+static void negotiate_link(struct ct_sensor *sensor)
 {
-	bool found = false;
-	char bt_addr[BT_ADDR_LE_STR_LEN];
-	AdHandle_t sensor_handle = { NULL, 0 };
-	LczContactTracingAd_t *mfg;
+	struct bt_conn_info info;
 	int err;
 
-	ct.all_ads++;
-
-	if (CONFIG_CT_ADV_WATCHDOG_SECONDS != 0) {
-		err = k_work_reschedule(
-			&ct_adv_watchdog,
-			K_SECONDS(CONFIG_CT_ADV_WATCHDOG_SECONDS));
-		if (err < 0) {
-			LOG_ERR("Unable to start adv watchdog");
-		}
+	sensor->link.tx_phy = BT_GAP_LE_PHY_1M;
+	sensor->link.rx_phy = BT_GAP_LE_PHY_1M;
+	sensor->link.rx_max_len = BT_GAP_DATA_LEN_DEFAULT;
+	sensor->link.throughput = 0;
+	if (bt_conn_get_info(sensor->conn, &info) == 0) {
+		sensor->link.interval = info.le.interval;
 	}
 
-	/* Leave this function if already connected */
-	if (remote.conn) {
-		adv_log_filter("already connected");
+	if (bt_addr_le_cmp(&sensor->addr, &ct.link_refused) == 0) {
+		LOG_WRN("Sensor dropped a faster link before, using defaults");
 		return;
 	}
 
-	/* Leave this function if not connected to AWS */
-	if (!bluegrass_ready_for_publish()) {
-		adv_log_filter("not connected to AWS");
-		return;
+	sensor->negotiating = true;
+
+	err = bt_conn_le_phy_update(sensor->conn, BT_CONN_LE_PHY_PARAM_2M);
+	if (err) {
+		LOG_WRN("Unable to request 2M PHY (%d)", err);
 	}
 
-	/* If there are queued entries to be sent over AWS, don't connect */
-	if (stashed_entries.available) {
-		adv_log_filter("send stash first");
-		return;
+	err = bt_conn_le_data_len_update(sensor->conn,
+					 BT_LE_DATA_LEN_PARAM_MAX);
+	if (err) {
+		LOG_WRN("Unable to request data length update (%d)", err);
 	}
+}
 
-	/* We're only interested in connectable events */
-	if (type != BT_GAP_ADV_TYPE_ADV_IND &&
-	    type != BT_GAP_ADV_TYPE_ADV_DIRECT_IND) {
+/* Shorten the connection interval once the log header has been received.
+ * The connection is closed when the download ends.
+ */
+static void speed_up_link(struct ct_sensor *sensor)
+{
+	int err;
+
+	if (!sensor->negotiating || sensor->conn == NULL) {
 		return;
 	}
 
-	/* Check if this is the device we are looking for */
-	sensor_handle = AdFind_Type(ad->data, ad->len,
-				    BT_DATA_MANUFACTURER_DATA, BT_DATA_INVALID);
-	if (sensor_handle.pPayload != NULL) {
-		found = find_ct_ad(&sensor_handle);
+	sensor->negotiating = false;
+
+	err = bt_conn_le_param_update(sensor->conn,
+				      BT_LE_CONN_PARAM_CT_DOWNLOAD);
+	if (err) {
+		LOG_WRN("Unable to request download interval (%d)", err);
 	}
+}
 
-	if (!found) {
-		adv_log_filter("non-contact tracing");
+static void sensor_le_param_updated(struct bt_conn *conn, uint16_t interval,
+				    uint16_t latency, uint16_t timeout)
+{
+	struct ct_sensor *sensor = find_sensor(conn);
+	if (sensor == NULL) {
 		return;
 	}
 
-	mfg = (LczContactTracingAd_t *)sensor_handle.pPayload;
-	if (!valid_ct_record_type(mfg->recordType)) {
-		adv_log_filter("Invalid record type");
+	sensor->link.interval = interval;
+	LOG_DBG("Sensor connection interval %d us, latency %d, timeout %d ms",
+		interval * 1250, latency, timeout * 10);
+}
+
+static void sensor_le_phy_updated(struct bt_conn *conn,
+				  struct bt_conn_le_phy_info *param)
+{
+	struct ct_sensor *sensor = find_sensor(conn);
+	if (sensor == NULL) {
 		return;
 	}
 
-	ct.ads++;
+	sensor->link.tx_phy = param->tx_phy;
+	sensor->link.rx_phy = param->rx_phy;
+	LOG_DBG("Sensor PHY TX %u RX %u", param->tx_phy, param->rx_phy);
+}
 
-	/* log_available flag is not set so do not connect */
-	if ((mfg->flags & CT_ADV_FLAGS_HAS_LOG_DATA) == 0) {
-		adv_log_filter("CT log data not present");
+static void sensor_le_data_len_updated(struct bt_conn *conn,
+				       struct bt_conn_le_data_len_info *info)
+{
+	struct ct_sensor *sensor = find_sensor(conn);
+	if (sensor == NULL) {
 		return;
 	}
 
-	LOG_DBG("CT sensor with log data found (rssi: %d)", rssi);
+	sensor->link.rx_max_len = info->rx_max_len;
+	LOG_DBG("Sensor data length TX %u RX %u", info->tx_max_len,
+		info->rx_max_len);
+}
+#endif
+
+static void sensor_scan_conn_init()
+{
+	struct ct_sensor *sensor;
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(sensors); i++) {
+		sensor = &sensors[i];
+		k_work_init(&sensor->att_timeout_work,
+			    sensor_att_timeout_callback);
+		k_work_init(&sensor->discover_services_work,
+			    discover_services_work_callback);
+		k_work_init(&sensor->smp_challenge_req_work,
+			    smp_challenge_req_work_handler);
+		k_work_init(&sensor->smp_fs_download_work,
+			    smp_fs_download_work_handler);
+		k_timer_init(&sensor->conn_timeout_timer,
+			     sensor_conn_timeout_handler, NULL);
+		k_timer_init(&sensor->smp_xfer_timeout_timer,
+			     smp_xfer_timeout_handler, NULL);
+		k_mutex_init(&sensor->aws_batch.mutex);
+		k_work_init_delayable(&sensor->aws_batch.flush_work,
+				      aws_batch_flush_work_handler);
+		k_work_init_delayable(&sensor->release_work,
+				      sensor_release_work_handler);
+	}
+
+	k_work_init_delayable(&connect_work, connect_work_handler);
 
-	/* Can't connect while scanning */
-	lcz_bt_scan_stop(ct.scan_id);
+	bt_conn_cb_register(&sensor_callbacks);
 
-	/* Connect to device */
-	bt_addr_le_to_str(addr, bt_addr, sizeof(bt_addr));
-	err = bt_conn_le_create(addr, BT_CONN_LE_CREATE_CONN,
-				BT_LE_CONN_PARAM_CT, &remote.conn);
-	if (err == 0) {
-		LOG_DBG("Attempting to connect to remote BLE device %s",
-			log_strdup(bt_addr));
-		k_timer_start(&sensor_conn_timeout_timer,
-			      SENSOR_CONNECTION_TIMEOUT_TICKS, K_NO_WAIT);
-	} else {
-		LOG_ERR("Failed to connect to remote BLE device %s err [%d]",
-			log_strdup(bt_addr), err);
-		set_ble_state(CENTRAL_STATE_FINDING_DEVICE);
+	lcz_bt_scan_register(&ct.scan_id, ct_sensor_adv_handler);
+}
+
+static void sensor_att_timeout_callback(struct k_work *work)
+{
+	struct ct_sensor *sensor =
+		CONTAINER_OF(work, struct ct_sensor, att_timeout_work);
+
+	bt_conn_disconnect(sensor->conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+}
+
+static void sensor_conn_timeout_handler(struct k_timer *timer)
+{
+	struct ct_sensor *sensor =
+		CONTAINER_OF(timer, struct ct_sensor, conn_timeout_timer);
+
+	/* if this timer expires, it means a connection attempt failed mid-stride
+	 * so disconnect */
+	if (sensor->conn != NULL) {
+		LOG_ERR("Failed to connect - connection attempt timeout");
+		k_work_submit(&sensor->att_timeout_work);
 	}
 }
 
-static bool find_ct_ad(AdHandle_t *handle)
+static struct ct_sensor *find_sensor(struct bt_conn *conn)
 {
-	bool found = false;
+	size_t i;
 
-	if (handle->pPayload != NULL) {
-		if (memcmp(handle->pPayload, CT_TRACKER_AD_HEADER,
-			   sizeof(CT_TRACKER_AD_HEADER)) == 0) {
-			found = true;
-		}
-		if (memcmp(handle->pPayload, CT_DATA_DOWNLOAD_AD_HEADER,
-			   sizeof(CT_DATA_DOWNLOAD_AD_HEADER)) == 0) {
-			found = true;
+	if (conn == NULL) {
+		return NULL;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(sensors); i++) {
+		if (sensors[i].conn == conn) {
+			return &sensors[i];
 		}
 	}
 
-	return found;
+	return NULL;
 }
 
-static bool valid_ct_record_type(uint8_t type)
+static struct ct_sensor *find_sensor_by_addr(const bt_addr_le_t *addr)
 {
-	bool found = false;
+	size_t i;
 
-	switch (type) {
-	case CT_ADV_REC_TYPE_V00:
-	case CT_ADV_REC_TYPE_V10:
-	case CT_ADV_REC_TYPE_V11:
-		found = true;
-		break;
-	default:
-		found = false;
-		break;
+	for (i = 0; i < ARRAY_SIZE(sensors); i++) {
+		if (sensors[i].conn != NULL &&
+		    bt_addr_le_cmp(&sensors[i].addr, addr) == 0) {
+			return &sensors[i];
+		}
 	}
 
-	return found;
+	return NULL;
 }
 
-static void smp_echo_rsp_proc(struct bt_gatt_dfu_smp_c *dfu_smp_c)
+static struct ct_sensor *smp_sensor(struct bt_gatt_dfu_smp_c *dfu_smp_c)
 {
-	char tmp_buf[128] = { 0 };
-	uint8_t *p_outdata = (uint8_t *)(&smp_rsp_buff);
-	const struct bt_gatt_dfu_smp_rsp_state *rsp_state;
-
-	rsp_state = bt_gatt_dfu_smp_c_rsp_state(dfu_smp_c);
-	LOG_SMP("Echo response part received, size: %zu.",
-		rsp_state->chunk_size);
+	return CONTAINER_OF(dfu_smp_c, struct ct_sensor, dfu_smp_c);
+}
 
-	if (rsp_state->offset + rsp_state->chunk_size > sizeof(smp_rsp_buff)) {
+/* A connection whose entries are still stashed can't be reused until they
+ * have been sent.
+ */
+static struct ct_sensor *alloc_sensor(void)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(sensors); i++) {
+		if (sensors[i].conn == NULL &&
+		    !sensors[i].stashed_entries.available) {
+			return &sensors[i];
+		}
+	}
+
+	return NULL;
+}
+
+static struct ct_sensor *stashed_sensor(void)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(sensors); i++) {
+		if (sensors[i].stashed_entries.available) {
+			return &sensors[i];
+		}
+	}
+
+	return NULL;
+}
+
+static bool sensors_idle(void)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(sensors); i++) {
+		if (sensors[i].app_state != CENTRAL_STATE_FINDING_DEVICE) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* Returns the candidate for addr. When add is set and there isn't one, the
+ * oldest candidate that isn't connected is replaced.
+ */
+static struct ct_candidate *find_candidate(const bt_addr_le_t *addr,
+					   bool add)
+{
+	struct ct_candidate *oldest = NULL;
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(candidates); i++) {
+		if (bt_addr_le_cmp(&candidates[i].addr, addr) == 0) {
+			return &candidates[i];
+		}
+
+		if (find_sensor_by_addr(&candidates[i].addr) != NULL) {
+			continue;
+		}
+
+		if (oldest == NULL ||
+		    candidates[i].last_seen < oldest->last_seen) {
+			oldest = &candidates[i];
+		}
+	}
+
+	if (!add || oldest == NULL) {
+		return NULL;
+	}
+
+	memset(oldest, 0, sizeof(*oldest));
+	bt_addr_le_copy(&oldest->addr, addr);
+	return oldest;
+}
+
+/* Sensors that haven't been downloaded from yet come first because their
+ * logs may go back to when they were deployed. Then the sensor with the
+ * largest log last time, as it is likely to be the busiest. RSSI breaks ties.
+ */
+static bool candidate_is_better(const struct ct_candidate *a,
+				const struct ct_candidate *b)
+{
+	if (b == NULL) {
+		return true;
+	}
+
+	if (a->downloaded != b->downloaded) {
+		return !a->downloaded;
+	}
+
+	if (a->log_size != b->log_size) {
+		return (a->log_size > b->log_size);
+	}
+
+	return (a->rssi > b->rssi);
+}
+
+static void rank_candidate(const bt_addr_le_t *addr, uint32_t log_size)
+{
+	struct ct_candidate *candidate = find_candidate(addr, false);
+
+	if (candidate != NULL) {
+		candidate->downloaded = true;
+		candidate->log_size = log_size;
+	}
+}
+
+static void connect_sensor(struct ct_sensor *sensor, const bt_addr_le_t *addr)
+{
+	char bt_addr[BT_ADDR_LE_STR_LEN];
+	int err;
+
+	bt_addr_le_copy(&sensor->addr, addr);
+	bt_gatt_dfu_smp_c_init(&sensor->dfu_smp_c, NULL);
+	sensor->smp_chunk.pending = false;
+	if (!sensor->stashed_entries.available) {
+		ResetEntryStashInformation(sensor, false);
+	}
+
+	/* Can't connect while scanning */
+	lcz_bt_scan_stop(ct.scan_id);
+
+	/* Connect to device */
+	bt_addr_le_to_str(addr, bt_addr, sizeof(bt_addr));
+	err = bt_conn_le_create(addr, BT_CONN_LE_CREATE_CONN,
+				BT_LE_CONN_PARAM_CT, &sensor->conn);
+	if (err == 0) {
+		LOG_DBG("Attempting to connect to remote BLE device %s",
+			log_strdup(bt_addr));
+		ct.connecting = sensor;
+		k_timer_start(&sensor->conn_timeout_timer,
+			      SENSOR_CONNECTION_TIMEOUT_TICKS, K_NO_WAIT);
+	} else {
+		LOG_ERR("Failed to connect to remote BLE device %s err [%d]",
+			log_strdup(bt_addr), err);
+		sensor->conn = NULL;
+		set_ble_state(sensor, CENTRAL_STATE_FINDING_DEVICE);
+	}
+}
+
+/* Connect to the best sensor that has advertised log data since the last
+ * connection was made.
+ */
+static void connect_work_handler(struct k_work *work)
+{
+	struct ct_candidate *best = NULL;
+	struct ct_sensor *sensor;
+	int64_t now = k_uptime_get();
+	size_t i;
+
+	ARG_UNUSED(work);
+
+	/* Only one connection can be created at a time */
+	if (ct.connecting != NULL) {
+		return;
+	}
+
+	if (!bluegrass_ready_for_publish() || stashed_sensor() != NULL) {
+		return;
+	}
+
+	sensor = alloc_sensor();
+	if (sensor == NULL) {
+		return;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(candidates); i++) {
+		if (!candidates[i].has_log ||
+		    (now - candidates[i].last_seen) >
+			    SENSOR_CANDIDATE_MAX_AGE_MS ||
+		    find_sensor_by_addr(&candidates[i].addr) != NULL) {
+			continue;
+		}
+
+		if (candidate_is_better(&candidates[i], best)) {
+			best = &candidates[i];
+		}
+	}
+
+	if (best == NULL) {
+		return;
+	}
+
+	LOG_DBG("Connecting to CT sensor (rssi: %d, last log: %u bytes)",
+		best->rssi, best->log_size);
+
+	/* It is chosen again once it advertises log data after this */
+	best->has_log = false;
+	connect_sensor(sensor, &best->addr);
+}
+
+static void adv_log_filter(const char *msg)
+{
+	if ((ct.all_ads % CONFIG_CT_ADV_LOG_FILTER_CNT) == 0) {
+		LOG_INF("Ignoring ad: %s; all ads: %d ct ads: %d",
+			log_strdup(msg), ct.all_ads, ct.ads);
+	}
+}
+
+static void ct_sensor_adv_handler(const bt_addr_le_t *addr, int8_t rssi,
+				  uint8_t type, struct net_buf_simple *ad)
+{
+	bool found = false;
+	AdHandle_t sensor_handle = { NULL, 0 };
+	LczContactTracingAd_t *mfg;
+	struct ct_candidate *candidate;
+	int err;
+
+	ct.all_ads++;
+
+	if (CONFIG_CT_ADV_WATCHDOG_SECONDS != 0) {
+		err = k_work_reschedule(
+			&ct_adv_watchdog,
+			K_SECONDS(CONFIG_CT_ADV_WATCHDOG_SECONDS));
+		if (err < 0) {
+			LOG_ERR("Unable to start adv watchdog");
+		}
+	}
+
+	/* Leave this function if not connected to AWS */
+	if (!bluegrass_ready_for_publish()) {
+		adv_log_filter("not connected to AWS");
+		return;
+	}
+
+	/* If there are queued entries to be sent over AWS, don't connect */
+	if (stashed_sensor() != NULL) {
+		adv_log_filter("send stash first");
+		return;
+	}
+
+	/* We're only interested in connectable events */
+	if (type != BT_GAP_ADV_TYPE_ADV_IND &&
+	    type != BT_GAP_ADV_TYPE_ADV_DIRECT_IND) {
+		return;
+	}
+
+	/* Check if this is the device we are looking for */
+	sensor_handle = AdFind_Type(ad->data, ad->len,
+				    BT_DATA_MANUFACTURER_DATA, BT_DATA_INVALID);
+	if (sensor_handle.pPayload != NULL) {
+		found = find_ct_ad(&sensor_handle);
+	}
+
+	if (!found) {
+		adv_log_filter("non-contact tracing");
+		return;
+	}
+
+	mfg = (LczContactTracingAd_t *)sensor_handle.pPayload;
+	if (!valid_ct_record_type(mfg->recordType)) {
+		adv_log_filter("Invalid record type");
+		return;
+	}
+
+	ct.ads++;
+
+	/* log_available flag is not set so do not connect */
+	if ((mfg->flags & CT_ADV_FLAGS_HAS_LOG_DATA) == 0) {
+		candidate = find_candidate(addr, false);
+		if (candidate != NULL) {
+			candidate->has_log = false;
+		}
+		adv_log_filter("CT log data not present");
+		return;
+	}
+
+	/* Leave this function if already connected */
+	if (find_sensor_by_addr(addr) != NULL) {
+		adv_log_filter("already connected");
+		return;
+	}
+
+	candidate = find_candidate(addr, true);
+	if (candidate == NULL) {
+		adv_log_filter("no room for candidate");
+		return;
+	}
+
+	candidate->rssi = rssi;
+	candidate->last_seen = k_uptime_get();
+	if (!candidate->has_log) {
+		LOG_DBG("CT sensor with log data found (rssi: %d)", rssi);
+		candidate->has_log = true;
+	}
+
+	if (alloc_sensor() == NULL) {
+		adv_log_filter("all sensor connections in use");
+		return;
+	}
+
+	/* Adverts from other sensors are collected before one is chosen */
+	k_work_schedule(&connect_work,
+			K_MSEC(CONFIG_CT_SENSOR_SELECT_WINDOW_MS));
+}
+
+static bool find_ct_ad(AdHandle_t *handle)
+{
+	bool found = false;
+
+	if (handle->pPayload != NULL) {
+		if (memcmp(handle->pPayload, CT_TRACKER_AD_HEADER,
+			   sizeof(CT_TRACKER_AD_HEADER)) == 0) {
+			found = true;
+		}
+		if (memcmp(handle->pPayload, CT_DATA_DOWNLOAD_AD_HEADER,
+			   sizeof(CT_DATA_DOWNLOAD_AD_HEADER)) == 0) {
+			found = true;
+		}
+	}
+
+	return found;
+}
+
+static bool valid_ct_record_type(uint8_t type)
+{
+	bool found = false;
+
+	switch (type) {
+	case CT_ADV_REC_TYPE_V00:
+	case CT_ADV_REC_TYPE_V10:
+	case CT_ADV_REC_TYPE_V11:
+		found = true;
+		break;
+	default:
+		found = false;
+		break;
+	}
+
+	return found;
+}
+
+static void smp_echo_rsp_proc(struct bt_gatt_dfu_smp_c *dfu_smp_c)
+{
+	struct ct_sensor *sensor = smp_sensor(dfu_smp_c);
+	struct smp_buffer *smp_rsp_buff = &sensor->smp_rsp_buff;
+	char tmp_buf[128] = { 0 };
+	uint8_t *p_outdata = (uint8_t *)smp_rsp_buff;
+	const struct bt_gatt_dfu_smp_rsp_state *rsp_state;
+
+	rsp_state = bt_gatt_dfu_smp_c_rsp_state(dfu_smp_c);
+	LOG_SMP("Echo response part received, size: %zu.",
+		rsp_state->chunk_size);
+
+	if (rsp_state->offset + rsp_state->chunk_size > sizeof(*smp_rsp_buff)) {
 		LOG_ERR("Response size buffer overflow (offset: %d, chunk_size: %d, sizeof(smp_rsp_buff): %d",
 			rsp_state->offset, rsp_state->chunk_size,
-			sizeof(smp_rsp_buff));
+			sizeof(*smp_rsp_buff));
 		dfu_smp_c->rsp_state.rc = MGMT_ERR_EMSGSIZE;
 		return;
 	} else {
@@ -1047,35 +1720,36 @@ static void smp_echo_rsp_proc(struct bt_gatt_dfu_smp_c *dfu_smp_c)
 
 	if (bt_gatt_dfu_smp_c_rsp_total_check(dfu_smp_c)) {
 		LOG_VRB("Total response received - decoding");
-		if (smp_rsp_buff.header.op != MGMT_OP_WRITE_RSP) {
+		if (smp_rsp_buff->header.op != MGMT_OP_WRITE_RSP) {
 			LOG_ERR("Unexpected operation code (%u)!",
-				smp_rsp_buff.header.op);
+				smp_rsp_buff->header.op);
 			dfu_smp_c->rsp_state.rc = MGMT_ERR_ENOTSUP;
 			return;
 		}
-		uint16_t group = ((uint16_t)smp_rsp_buff.header.group_h8) << 8 |
-				 smp_rsp_buff.header.group_l8;
+		uint16_t group =
+			((uint16_t)smp_rsp_buff->header.group_h8) << 8 |
+			smp_rsp_buff->header.group_l8;
 		if (group != MGMT_GROUP_ID_OS) {
 			LOG_ERR("Unexpected command group (%u)!", group);
 			dfu_smp_c->rsp_state.rc = MGMT_ERR_ENOTSUP;
 			return;
 		}
-		if (smp_rsp_buff.header.id != OS_MGMT_ID_ECHO) {
+		if (smp_rsp_buff->header.id != OS_MGMT_ID_ECHO) {
 			LOG_ERR("Unexpected command (%u)",
-				smp_rsp_buff.header.id);
+				smp_rsp_buff->header.id);
 			dfu_smp_c->rsp_state.rc = MGMT_ERR_ENOTSUP;
 			return;
 		}
-		size_t payload_len = ((uint16_t)smp_rsp_buff.header.len_h8)
+		size_t payload_len = ((uint16_t)smp_rsp_buff->header.len_h8)
 					     << 8 |
-				     smp_rsp_buff.header.len_l8;
+				     smp_rsp_buff->header.len_l8;
 
 		CborError cbor_error;
 		CborParser parser;
 		CborValue value;
 		struct cbor_buf_reader reader;
 
-		cbor_buf_reader_init(&reader, smp_rsp_buff.payload,
+		cbor_buf_reader_init(&reader, smp_rsp_buff->payload,
 				     payload_len);
 		cbor_error = cbor_parser_init(&reader.r, 0, &parser, &value);
 		if (cbor_error != CborNoError) {
@@ -1088,7 +1762,7 @@ static void smp_echo_rsp_proc(struct bt_gatt_dfu_smp_c *dfu_smp_c)
 		int i;
 		char *tb = &tmp_buf[0];
 		for (i = 0; i < payload_len; i++) {
-			tb += sprintf(tb, "%02X ", smp_rsp_buff.payload[i]);
+			tb += sprintf(tb, "%02X ", smp_rsp_buff->payload[i]);
 		}
 		LOG_SMP("%s", tmp_buf);
 
@@ -1138,86 +1812,115 @@ void ct_ble_smp_echo_test(void)
 	static unsigned int echo_cnt = 0;
 	char buffer[32];
 	int ret;
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(sensors); i++) {
+		if (sensors[i].conn != NULL) {
+			break;
+		}
+	}
+
+	if (i == ARRAY_SIZE(sensors)) {
+		LOG_ERR("Echo test requires a sensor connection");
+		return;
+	}
 
 	echo_cnt++;
 
 	LOG_DBG("Echo test: %d", echo_cnt);
 	snprintk(buffer, sizeof(buffer), "Echo message: %u", echo_cnt);
-	ret = send_smp_echo(&dfu_smp_c, buffer);
+	ret = send_smp_echo(&sensors[i].dfu_smp_c, buffer);
 	if (ret) {
 		LOG_ERR("Echo command send error (err: %d)", ret);
 	}
 }
 
-bool ct_ble_send_next_smp_request(uint32_t new_off)
+bool ct_ble_send_next_smp_request(struct bt_gatt_dfu_smp_c *dfu_smp_c,
+				  uint32_t new_off)
 {
+	struct ct_sensor *sensor = smp_sensor(dfu_smp_c);
 	bool success = false;
 
-	if (remote.app_state == CENTRAL_STATE_CHALLENGE_REQUEST) {
+	if (sensor->app_state == CENTRAL_STATE_CHALLENGE_REQUEST) {
 		LOG_DBG("/sys/challenge_rsp.bin");
-		bt_gatt_dfu_smp_c_init(&dfu_smp_c, NULL);
-		snprintk(smp_fs_download_filename,
-			 sizeof(smp_fs_download_filename),
+		bt_gatt_dfu_smp_c_init(dfu_smp_c, NULL);
+		snprintk(sensor->smp_fs_download_filename,
+			 sizeof(sensor->smp_fs_download_filename),
 			 "/sys/challenge_rsp.bin");
 		int32_t ret = send_smp_challenge_response(
-			&dfu_smp_c, smp_fs_download_filename, 0, challenge_rsp,
-			challenge_rsp_len);
+			dfu_smp_c, sensor->smp_fs_download_filename, 0,
+			sensor->challenge_rsp, sensor->challenge_rsp_len);
 
 		if (ret) {
 			LOG_ERR("Authenticate device command send error (err: %d)",
 				ret);
 		} else {
-			set_ble_state(CENTRAL_STATE_CHALLENGE_RESPONSE);
+			set_ble_state(sensor, CENTRAL_STATE_CHALLENGE_RESPONSE);
 			success = true;
-			k_timer_start(&smp_xfer_timeout_timer,
+			k_timer_start(&sensor->smp_xfer_timeout_timer,
 				      SMP_TIMEOUT_TICKS, K_NO_WAIT);
 		}
-	} else if ((remote.app_state == CENTRAL_STATE_CHALLENGE_RESPONSE) ||
-		   (remote.app_state == CENTRAL_STATE_LOG_DOWNLOAD)) {
-		if (remote.app_state == CENTRAL_STATE_CHALLENGE_RESPONSE) {
+	} else if ((sensor->app_state == CENTRAL_STATE_CHALLENGE_RESPONSE) ||
+		   (sensor->app_state == CENTRAL_STATE_LOG_DOWNLOAD)) {
+		if (sensor->app_state == CENTRAL_STATE_CHALLENGE_RESPONSE) {
 			/* reset dfu_smp_c structure only on first download request */
-			bt_gatt_dfu_smp_c_init(&dfu_smp_c, NULL);
+			bt_gatt_dfu_smp_c_init(dfu_smp_c, NULL);
 		}
-		snprintk(smp_fs_download_filename,
-			 sizeof(smp_fs_download_filename), "/log/ct");
+		snprintk(sensor->smp_fs_download_filename,
+			 sizeof(sensor->smp_fs_download_filename), "/log/ct");
 		int32_t ret = send_smp_download_request(
-			&dfu_smp_c, smp_fs_download_filename, new_off);
+			dfu_smp_c, sensor->smp_fs_download_filename, new_off);
 
 		if (ret) {
 			LOG_WRN("Download command send error (err: %d)", ret);
 		} else {
-			set_ble_state(CENTRAL_STATE_LOG_DOWNLOAD);
+			set_ble_state(sensor, CENTRAL_STATE_LOG_DOWNLOAD);
 			success = true;
-			k_timer_start(&smp_xfer_timeout_timer,
+			k_timer_start(&sensor->smp_xfer_timeout_timer,
 				      SMP_TIMEOUT_TICKS, K_NO_WAIT);
 		}
 	} else {
-		LOG_ERR("Unknown app state - %d", remote.app_state);
+		LOG_ERR("Unknown app state - %d", sensor->app_state);
 		success = false;
 	}
 
 	return success;
 }
 
+int ct_ble_process_log_data(struct bt_gatt_dfu_smp_c *dfu_smp_c)
+{
+	struct ct_sensor *sensor = smp_sensor(dfu_smp_c);
+
+	if (!sensor->smp_chunk.pending) {
+		return 0;
+	}
+
+	sensor->smp_chunk.pending = false;
+	return log_data_proc(dfu_smp_c, sensor->smp_chunk.len);
+}
+
 static void smp_challenge_req_proc_handler(struct bt_gatt_dfu_smp_c *dfu_smp_c)
 {
+	struct ct_sensor *sensor = smp_sensor(dfu_smp_c);
+	struct smp_buffer *smp_rsp_buff = &sensor->smp_rsp_buff;
+	uint8_t *log_buffer = sensor->log_buffer;
 	CborError cbor_error;
 	CborParser parser;
 	CborValue value;
 	struct cbor_buf_reader reader;
 
-	uint8_t *p_outdata = (uint8_t *)(&smp_rsp_buff);
+	uint8_t *p_outdata = (uint8_t *)smp_rsp_buff;
 	const struct bt_gatt_dfu_smp_rsp_state *rsp_state =
 		&dfu_smp_c->rsp_state;
 
 	LOG_VRB("file part, size: %zu offset %d.", rsp_state->chunk_size,
 		rsp_state->offset);
 
-	if (rsp_state->offset + rsp_state->chunk_size > sizeof(smp_rsp_buff) ||
-	    rsp_state->total_size > sizeof(smp_rsp_buff)) {
+	if (rsp_state->offset + rsp_state->chunk_size > sizeof(*smp_rsp_buff) ||
+	    rsp_state->total_size > sizeof(*smp_rsp_buff)) {
 		LOG_ERR("Response size buffer overflow (offset: %d, chunk_size: %d, sizeof(smp_rsp_buff): %d, total_size: %d",
 			rsp_state->offset, rsp_state->chunk_size,
-			sizeof(smp_rsp_buff), rsp_state->total_size);
+			sizeof(*smp_rsp_buff), rsp_state->total_size);
 		dfu_smp_c->rsp_state.rc = MGMT_ERR_EMSGSIZE;
 		return;
 	} else {
@@ -1229,35 +1932,36 @@ static void smp_challenge_req_proc_handler(struct bt_gatt_dfu_smp_c *dfu_smp_c)
 
 	if (bt_gatt_dfu_smp_c_rsp_total_check(dfu_smp_c)) {
 		/* SMP 8-byte HEADER PARSE START */
-		if (smp_rsp_buff.header.op != MGMT_OP_READ_RSP) {
+		if (smp_rsp_buff->header.op != MGMT_OP_READ_RSP) {
 			LOG_ERR("Unexpected operation code (%u)!",
-				smp_rsp_buff.header.op);
+				smp_rsp_buff->header.op);
 			dfu_smp_c->rsp_state.rc = MGMT_ERR_ENOTSUP;
 			return;
 		}
-		uint16_t group = ((uint16_t)smp_rsp_buff.header.group_h8) << 8 |
-				 smp_rsp_buff.header.group_l8;
+		uint16_t group =
+			((uint16_t)smp_rsp_buff->header.group_h8) << 8 |
+			smp_rsp_buff->header.group_l8;
 		if (group != MGMT_GROUP_ID_FS) {
 			LOG_ERR("Unexpected command group (%u)!", group);
 			dfu_smp_c->rsp_state.rc = MGMT_ERR_ENOTSUP;
 			return;
 		}
-		if (smp_rsp_buff.header.id != FS_MGMT_ID_FILE) {
+		if (smp_rsp_buff->header.id != FS_MGMT_ID_FILE) {
 			LOG_ERR("Unexpected command (%u)",
-				smp_rsp_buff.header.id);
+				smp_rsp_buff->header.id);
 			dfu_smp_c->rsp_state.rc = MGMT_ERR_ENOTSUP;
 			return;
 		}
 		/* payload_len represents the number of CBOR packet bytes available */
-		size_t payload_len = ((uint16_t)smp_rsp_buff.header.len_h8)
+		size_t payload_len = ((uint16_t)smp_rsp_buff->header.len_h8)
 					     << 8 |
-				     smp_rsp_buff.header.len_l8;
+				     smp_rsp_buff->header.len_l8;
 		/* same as "total_len" of this smp packet */
 		LOG_VRB("SMP payload_len: %d", payload_len);
 		/**** SMP 8-byte HEADER PARSE END */
 
 		/**** CBOR PARSE START */
-		cbor_buf_reader_init(&reader, smp_rsp_buff.payload,
+		cbor_buf_reader_init(&reader, smp_rsp_buff->payload,
 				     payload_len);
 		cbor_error = cbor_parser_init(&reader.r, 0, &parser, &value);
 		if (cbor_error != CborNoError) {
@@ -1318,8 +2022,9 @@ static void smp_challenge_req_proc_handler(struct bt_gatt_dfu_smp_c *dfu_smp_c)
 				LOG_ERR("Authentication not supported by remote device. Continue download...");
 				dfu_smp_c->rsp_state.rc = MGMT_ERR_EOK;
 				/* setting to this state will send the log download request */
-				set_ble_state(CENTRAL_STATE_CHALLENGE_RESPONSE);
-				remote.encrypt_req = false;
+				set_ble_state(sensor,
+					      CENTRAL_STATE_CHALLENGE_RESPONSE);
+				sensor->encrypt_req = false;
 			}
 			return;
 		}
@@ -1328,8 +2033,8 @@ static void smp_challenge_req_proc_handler(struct bt_gatt_dfu_smp_c *dfu_smp_c)
 			(uint32_t)data_len, (uint32_t)rc, (uint32_t)len);
 
 		/* reset the SMP transfer timeout timer */
-		k_timer_start(&smp_xfer_timeout_timer, SMP_TIMEOUT_TICKS,
-			      K_NO_WAIT);
+		k_timer_start(&sensor->smp_xfer_timeout_timer,
+			      SMP_TIMEOUT_TICKS, K_NO_WAIT);
 		LOG_VRB("smp tmr restart");
 
 		if (dfu_smp_c->downloaded_bytes == 0) {
@@ -1338,15 +2043,16 @@ static void smp_challenge_req_proc_handler(struct bt_gatt_dfu_smp_c *dfu_smp_c)
 				LOG_ERR("No auth data from remote device (auth not required). Continue download...");
 				dfu_smp_c->rsp_state.rc = MGMT_ERR_EOK;
 				/* setting to this state will send the log download request */
-				set_ble_state(CENTRAL_STATE_CHALLENGE_RESPONSE);
-				remote.encrypt_req = false;
+				set_ble_state(sensor,
+					      CENTRAL_STATE_CHALLENGE_RESPONSE);
+				sensor->encrypt_req = false;
 				return;
 			}
 			dfu_smp_c->file_size = len;
 		}
 
 		/* copy the file data into log_buffer */
-		if (sizeof(log_buffer) >
+		if (sizeof(sensor->log_buffer) >
 		    dfu_smp_c->downloaded_bytes + data_len) {
 			memcpy(&log_buffer[dfu_smp_c->downloaded_bytes],
 			       file_data, data_len);
@@ -1366,9 +2072,10 @@ static void smp_challenge_req_proc_handler(struct bt_gatt_dfu_smp_c *dfu_smp_c)
 			/* This function returns the output size of the cipher text + IV (0 if failed)
 			 * The output buffer max len must be "input len + 16" (challenge length + IV size)
 			 */
-			challenge_rsp_len = encrypt_cbc(
+			sensor->challenge_rsp_len = encrypt_cbc(
 				log_buffer, dfu_smp_c->downloaded_bytes,
-				challenge_rsp, sizeof(challenge_rsp),
+				sensor->challenge_rsp,
+				sizeof(sensor->challenge_rsp),
 				(uint8_t *)attr_get_quasi_static(
 					ATTR_ID_ctAesKey),
 				ATTR_CT_AES_KEY_SIZE);
@@ -1378,23 +2085,25 @@ static void smp_challenge_req_proc_handler(struct bt_gatt_dfu_smp_c *dfu_smp_c)
 
 static void smp_challenge_rsp_proc_handler(struct bt_gatt_dfu_smp_c *dfu_smp_c)
 {
+	struct ct_sensor *sensor = smp_sensor(dfu_smp_c);
+	struct smp_buffer *smp_rsp_buff = &sensor->smp_rsp_buff;
 	CborError cbor_error;
 	CborParser parser;
 	CborValue value;
 	struct cbor_buf_reader reader;
 
-	uint8_t *p_outdata = (uint8_t *)(&smp_rsp_buff);
+	uint8_t *p_outdata = (uint8_t *)smp_rsp_buff;
 	const struct bt_gatt_dfu_smp_rsp_state *rsp_state =
 		&dfu_smp_c->rsp_state;
 
 	LOG_VRB("file part, size: %zu offset %d.", rsp_state->chunk_size,
 		rsp_state->offset);
 
-	if (rsp_state->offset + rsp_state->chunk_size > sizeof(smp_rsp_buff) ||
-	    rsp_state->total_size > sizeof(smp_rsp_buff)) {
+	if (rsp_state->offset + rsp_state->chunk_size > sizeof(*smp_rsp_buff) ||
+	    rsp_state->total_size > sizeof(*smp_rsp_buff)) {
 		LOG_ERR("Response size buffer overflow (offset: %d, chunk_size: %d, sizeof(smp_rsp_buff): %d, total_size: %d",
 			rsp_state->offset, rsp_state->chunk_size,
-			sizeof(smp_rsp_buff), rsp_state->total_size);
+			sizeof(*smp_rsp_buff), rsp_state->total_size);
 		dfu_smp_c->rsp_state.rc = MGMT_ERR_EMSGSIZE;
 		return;
 	} else {
@@ -1406,35 +2115,36 @@ static void smp_challenge_rsp_proc_handler(struct bt_gatt_dfu_smp_c *dfu_smp_c)
 
 	if (bt_gatt_dfu_smp_c_rsp_total_check(dfu_smp_c)) {
 		/**** SMP 8-byte HEADER PARSE START */
-		if (smp_rsp_buff.header.op != MGMT_OP_WRITE_RSP) {
+		if (smp_rsp_buff->header.op != MGMT_OP_WRITE_RSP) {
 			LOG_ERR("Unexpected operation code (%u)!",
-				smp_rsp_buff.header.op);
+				smp_rsp_buff->header.op);
 			dfu_smp_c->rsp_state.rc = MGMT_ERR_ENOTSUP;
 			return;
 		}
-		uint16_t group = ((uint16_t)smp_rsp_buff.header.group_h8) << 8 |
-				 smp_rsp_buff.header.group_l8;
+		uint16_t group =
+			((uint16_t)smp_rsp_buff->header.group_h8) << 8 |
+			smp_rsp_buff->header.group_l8;
 		if (group != MGMT_GROUP_ID_FS) {
 			LOG_ERR("Unexpected command group (%u)!", group);
 			dfu_smp_c->rsp_state.rc = MGMT_ERR_ENOTSUP;
 			return;
 		}
-		if (smp_rsp_buff.header.id != 0 /* FS_MGMT_ID_FILE */) {
+		if (smp_rsp_buff->header.id != 0 /* FS_MGMT_ID_FILE */) {
 			LOG_ERR("Unexpected command (%u)",
-				smp_rsp_buff.header.id);
+				smp_rsp_buff->header.id);
 			dfu_smp_c->rsp_state.rc = MGMT_ERR_ENOTSUP;
 			return;
 		}
 		/* payload_len represents the number of CBOR packet bytes available */
-		size_t payload_len = ((uint16_t)smp_rsp_buff.header.len_h8)
+		size_t payload_len = ((uint16_t)smp_rsp_buff->header.len_h8)
 					     << 8 |
-				     smp_rsp_buff.header.len_l8;
+				     smp_rsp_buff->header.len_l8;
 		/* same as "total_len" of this smp packet */
 		LOG_VRB("SMP payload_len: %d", payload_len);
 		/**** SMP 8-byte HEADER PARSE END */
 
 		/**** CBOR PARSE START */
-		cbor_buf_reader_init(&reader, smp_rsp_buff.payload,
+		cbor_buf_reader_init(&reader, smp_rsp_buff->payload,
 				     payload_len);
 		cbor_error = cbor_parser_init(&reader.r, 0, &parser, &value);
 		if (cbor_error != CborNoError) {
@@ -1497,16 +2207,16 @@ static void smp_challenge_rsp_proc_handler(struct bt_gatt_dfu_smp_c *dfu_smp_c)
 			LOG_DBG("Authentication successful. Continue download...");
 			dfu_smp_c->rsp_state.rc = MGMT_ERR_EOK;
 			/* setting to this state will send the log download request */
-			set_ble_state(CENTRAL_STATE_CHALLENGE_RESPONSE);
-			remote.encrypt_req = true;
+			set_ble_state(sensor, CENTRAL_STATE_CHALLENGE_RESPONSE);
+			sensor->encrypt_req = true;
 		}
 
 		LOG_SMP("off: %d, data_len: %d, rc: %d, len: %d", (uint32_t)off,
 			(uint32_t)data_len, (uint32_t)rc, (uint32_t)len);
 
 		/* reset the SMP transfer timeout timer */
-		k_timer_start(&smp_xfer_timeout_timer, SMP_TIMEOUT_TICKS,
-			      K_NO_WAIT);
+		k_timer_start(&sensor->smp_xfer_timeout_timer,
+			      SMP_TIMEOUT_TICKS, K_NO_WAIT);
 		LOG_VRB("smp tmr restart");
 	}
 }
@@ -1542,6 +2252,9 @@ static int calculate_record_bytes_in_entry(uint8_t *buf, uint16_t record_size,
 /* clang-format off */
 static void smp_file_download_rsp_proc(struct bt_gatt_dfu_smp_c *dfu_smp_c)
 {
+	struct ct_sensor *sensor = smp_sensor(dfu_smp_c);
+	struct smp_buffer *smp_rsp_buff = &sensor->smp_rsp_buff;
+	uint8_t *log_buffer = sensor->log_buffer;
 	CborError cbor_error;
 	CborParser parser;
 	CborValue value;
@@ -1550,15 +2263,15 @@ static void smp_file_download_rsp_proc(struct bt_gatt_dfu_smp_c *dfu_smp_c)
 	char addr_str[BT_ADDR_LE_STR_LEN];
 	uint16_t crctmp, crcval;
 
-	uint8_t *p_outdata = (uint8_t *)(&smp_rsp_buff);
+	uint8_t *p_outdata = (uint8_t *)smp_rsp_buff;
 	const struct bt_gatt_dfu_smp_rsp_state *rsp_state = &dfu_smp_c->rsp_state;
 
 	LOG_VRB("file part, size: %zu offset %d.", rsp_state->chunk_size, rsp_state->offset);
 
-	if (rsp_state->offset + rsp_state->chunk_size > sizeof(smp_rsp_buff) ||
-	    rsp_state->total_size > sizeof(smp_rsp_buff)) {
+	if (rsp_state->offset + rsp_state->chunk_size > sizeof(*smp_rsp_buff) ||
+	    rsp_state->total_size > sizeof(*smp_rsp_buff)) {
 		LOG_ERR("Response size buffer overflow (offset: %d, chunk_size: %d, sizeof(smp_rsp_buff): %d, total_size: %d",
-			rsp_state->offset, rsp_state->chunk_size, sizeof(smp_rsp_buff), rsp_state->total_size);
+			rsp_state->offset, rsp_state->chunk_size, sizeof(*smp_rsp_buff), rsp_state->total_size);
 		dfu_smp_c->rsp_state.rc = MGMT_ERR_EMSGSIZE;
 		return;
 	} else {
@@ -1569,30 +2282,30 @@ static void smp_file_download_rsp_proc(struct bt_gatt_dfu_smp_c *dfu_smp_c)
 
 	if (bt_gatt_dfu_smp_c_rsp_total_check(dfu_smp_c)) {
 		/**** SMP 8-byte HEADER PARSE START */
-		if (smp_rsp_buff.header.op != MGMT_OP_READ_RSP /* READ RSP*/) {
-			LOG_ERR("Unexpected operation code (%u)!", smp_rsp_buff.header.op);
+		if (smp_rsp_buff->header.op != MGMT_OP_READ_RSP /* READ RSP*/) {
+			LOG_ERR("Unexpected operation code (%u)!", smp_rsp_buff->header.op);
 			dfu_smp_c->rsp_state.rc = MGMT_ERR_ENOTSUP;
 			return;
 		}
-		uint16_t group = ((uint16_t)smp_rsp_buff.header.group_h8) << 8 | smp_rsp_buff.header.group_l8;
+		uint16_t group = ((uint16_t)smp_rsp_buff->header.group_h8) << 8 | smp_rsp_buff->header.group_l8;
 		if (group != MGMT_GROUP_ID_FS) {
 			LOG_ERR("Unexpected command group (%u)!", group);
 			dfu_smp_c->rsp_state.rc = MGMT_ERR_ENOTSUP;
 			return;
 		}
-		if (smp_rsp_buff.header.id != 0 /* FS_MGMT_ID_FILE */) {
-			LOG_ERR("Unexpected command (%u)", smp_rsp_buff.header.id);
+		if (smp_rsp_buff->header.id != 0 /* FS_MGMT_ID_FILE */) {
+			LOG_ERR("Unexpected command (%u)", smp_rsp_buff->header.id);
 			dfu_smp_c->rsp_state.rc = MGMT_ERR_ENOTSUP;
 			return;
 		}
 		/* payload_len represents the number of CBOR packet bytes available */
-		size_t payload_len = ((uint16_t)smp_rsp_buff.header.len_h8) << 8 | smp_rsp_buff.header.len_l8;
+		size_t payload_len = ((uint16_t)smp_rsp_buff->header.len_h8) << 8 | smp_rsp_buff->header.len_l8;
 		/* same as "total_len" of this smp packet */
 		LOG_VRB("SMP payload_len: %d", payload_len);
 		/**** SMP 8-byte HEADER PARSE END */
 
 		/**** CBOR PARSE START */
-		cbor_buf_reader_init(&reader, smp_rsp_buff.payload, payload_len);
+		cbor_buf_reader_init(&reader, smp_rsp_buff->payload, payload_len);
 		cbor_error = cbor_parser_init(&reader.r, 0, &parser, &value);
 		if (cbor_error != CborNoError) {
 			LOG_ERR("CBOR parser initialization failed (err: %d)", cbor_error);
@@ -1600,6 +2313,18 @@ static void smp_file_download_rsp_proc(struct bt_gatt_dfu_smp_c *dfu_smp_c)
 			return;
 		}
 
+		/* The data is decoded straight into log_buffer, after the part of
+		 * the entry that has already been received.
+		 */
+		uint8_t *chunk = log_buffer;
+		if (dfu_smp_c->downloaded_bytes > 0) {
+			chunk = &log_buffer[dfu_smp_c->entry_downloaded_bytes];
+		}
+		if ((chunk + sizeof(file_data)) > (log_buffer + sizeof(sensor->log_buffer))) {
+			LOG_SMP("overflow, just keep downloading but don't store the data");
+			chunk = file_data;
+		}
+
 		long long int rc;
 		unsigned long long off;
 		unsigned long long len;
@@ -1611,7 +2336,7 @@ static void smp_file_download_rsp_proc(struct bt_gatt_dfu_smp_c *dfu_smp_c)
 				.nodefault = true },
 			[1] = { .attribute = "data",
 				.type = CborAttrByteStringType,
-				.addr.bytestring.data = file_data,
+				.addr.bytestring.data = chunk,
 				.addr.bytestring.len = &data_len,
 				.len = sizeof(file_data) },
 			[2] = { .attribute = "rc", .type = CborAttrIntegerType, .addr.integer = &rc, .nodefault = true },
@@ -1642,9 +2367,9 @@ static void smp_file_download_rsp_proc(struct bt_gatt_dfu_smp_c *dfu_smp_c)
 			LOG_ERR("AWS not connected during BLE transfer, aborting...");
 			dfu_smp_c->rsp_state.rc = MGMT_ERR_ENOENT;
 
-			if (stashed_entries.len > sizeof(struct ct_publish_header_t)) {
+			if (sensor->stashed_entries.len > sizeof(struct ct_publish_header_t)) {
 				/* There are stashed entries so set flag for them to be sent (after AWS reconnect) */
-				stashed_entries.available = true;
+				sensor->stashed_entries.available = true;
 			}
 
 			return;
@@ -1654,26 +2379,17 @@ static void smp_file_download_rsp_proc(struct bt_gatt_dfu_smp_c *dfu_smp_c)
 			(uint32_t)len);
 
 		/* reset the SMP transfer timeout timer */
-		k_timer_start(&smp_xfer_timeout_timer, SMP_TIMEOUT_TICKS, K_NO_WAIT);
+		k_timer_start(&sensor->smp_xfer_timeout_timer, SMP_TIMEOUT_TICKS, K_NO_WAIT);
 		LOG_VRB("smp tmr restart");
 
-		uint8_t dec_file_data[FS_MGMT_DL_CHUNK_SIZE];
-		if (remote.encrypt_req == true) {
-			/* max output len must be "input len - 16" */
-			uint32_t decrypted_length = decrypt_cbc(file_data, data_len, dec_file_data,
-							       data_len - AES_CBC_IV_SIZE,
-								   (uint8_t *)attr_get_quasi_static(ATTR_ID_ctAesKey),
-								   ATTR_CT_AES_KEY_SIZE);
-			data_len = decrypted_length;
-
-			if (decrypted_length == 0) {
+		if (sensor->encrypt_req == true) {
+			/* the plaintext overwrites the IV and ciphertext */
+			data_len = decrypt_cbc(sensor, chunk, data_len);
+			if (data_len == 0) {
 				/* decryption failed */
-				dfu_smp_c->downloaded_bytes += data_len;
 				dfu_smp_c->rsp_state.rc = MGMT_ERR_EINVAL;
 				return;
 			}
-		} else {
-			memcpy(dec_file_data, file_data, data_len);
 		}
 
 		if (dfu_smp_c->downloaded_bytes == 0) {
@@ -1686,21 +2402,13 @@ static void smp_file_download_rsp_proc(struct bt_gatt_dfu_smp_c *dfu_smp_c)
 			}
 
 			/* If we are downloading the first chunk, this is the ct_log_header */
-			bt_addr_le_to_str(bt_conn_get_dst(remote.conn), addr_str, sizeof(addr_str));
+			bt_addr_le_to_str(bt_conn_get_dst(sensor->conn), addr_str, sizeof(addr_str));
 
 			/* Record the file size */
 			dfu_smp_c->file_size = len;
 			dfu_smp_c->rec_cnt = 0;
 			dfu_smp_c->ent_cnt = 0;
 
-			/* copy the file data into log_buffer */
-			if (sizeof(log_buffer) > dfu_smp_c->downloaded_bytes + data_len) {
-				memcpy(&log_buffer[dfu_smp_c->downloaded_bytes], dec_file_data, data_len);
-				LOG_SMP("copied %d ct_log_header bytes into log_buffer", data_len);
-			} else {
-				LOG_SMP("overflow, just keep downloading but don't store the data");
-			}
-
 			dfu_smp_c->entry_protocol_version =
 				((struct ct_log_header_entry_protocol_version *)log_buffer)->entry_protocol_version;
 
@@ -1716,6 +2424,10 @@ static void smp_file_download_rsp_proc(struct bt_gatt_dfu_smp_c *dfu_smp_c)
 			dfu_smp_c->entry_downloaded_bytes = 0;
 
 			ct.num_download_starts++;
+			sensor->download_start = k_uptime_get();
+#ifdef CONFIG_CT_CONN_HIGH_THROUGHPUT
+			speed_up_link(sensor);
+#endif
 
 			switch (dfu_smp_c->entry_protocol_version) {
 			case LOG_ENTRY_PROTOCOL_V1:
@@ -1758,589 +2470,250 @@ static void smp_file_download_rsp_proc(struct bt_gatt_dfu_smp_c *dfu_smp_c)
 			}
 
 			LOG_VRB("entry_size: %d", dfu_smp_c->entry_size);
-
+			dfu_smp_c->downloaded_bytes += data_len;
 		} else {
-			/* copy a chunk of data into the log_buffer */
-			if (sizeof(log_buffer) > dfu_smp_c->entry_downloaded_bytes + data_len) {
-				memcpy(&log_buffer[dfu_smp_c->entry_downloaded_bytes], dec_file_data, data_len);
-				LOG_SMP("copied %d entry bytes into log_buffer", data_len);
+			dfu_smp_c->downloaded_bytes += data_len;
+#ifdef CONFIG_CT_SMP_PIPELINE
+			/* Entries are parsed after the request for the next chunk is sent */
+			sensor->smp_chunk.len = data_len;
+			sensor->smp_chunk.pending = true;
+#else
+			dfu_smp_c->rsp_state.rc = log_data_proc(dfu_smp_c, data_len);
+#endif
+		}
+	}
+}
+/* clang-format on */
+
+/* Parse the entries in a chunk of the log that follows the header */
+/* clang-format off */
+static int log_data_proc(struct bt_gatt_dfu_smp_c *dfu_smp_c, size_t data_len)
+{
+	struct ct_sensor *sensor = smp_sensor(dfu_smp_c);
+	uint8_t *log_buffer = sensor->log_buffer;
+	bt_addr_le_t addr;
+	char addr_str[BT_ADDR_LE_STR_LEN];
+	uint16_t crctmp, crcval;
+
+	sensor->publishing = true;
+	/* set flag indicating active data transfer */
+	sensor->log_ble_xfer_active = true;
+	/* if enough bytes have been downloaded to complete an entry + 2 bytes for crc16,
+	 * calculate the CRC16 and if it passes, copy the entry into the log buffer
+	 */
+	switch (dfu_smp_c->entry_protocol_version) {
+	case LOG_ENTRY_PROTOCOL_V1:
+		/*
+		 * Parser for Entry Protocol 0x0001
+		 *   Each entry is of fixed size (256 + 2 CRC bytes for total of 258)
+		 *   and all 256 bytes + CRC16 are sent in one SMP CBOR packet.
+		 */
+		if ((dfu_smp_c->entry_downloaded_bytes + data_len) >=
+		    (dfu_smp_c->entry_size + sizeof(uint16_t))) {
+			crctmp = *((uint16_t *)&log_buffer[dfu_smp_c->entry_size]);
+			crcval = crc16_ccitt(0, log_buffer, dfu_smp_c->entry_size);
+
+			if (crctmp == crcval) {
+				dfu_smp_c->ent_cnt++; /* count # of entries received */
+
+				/* CRC was good, queue the entry for the next AWS publish */
+				int record_bytes_in_entry = calculate_record_bytes_in_entry(
+					log_buffer, sizeof(log_entry_data_rssi_tracking_t),
+					dfu_smp_c->entry_size);
+				if (record_bytes_in_entry > 0) {
+					aws_batch_add(sensor, log_buffer,
+						      offsetof(log_entry_t, data) + record_bytes_in_entry);
+				} else {
+					LOG_DBG("0 records found in entry");
+				}
 			} else {
-				LOG_SMP("overflow, just keep downloading but don't store the data");
+				/* red */
+				LOG_DBG("\033[1;31m[ENT%3d] %s [%02X %02X %02X %02X...%02X %02X] rcv_crc: %04X, calc_crc: %04X ",
+					dfu_smp_c->entry_count, log_strdup(addr_str), log_buffer[0], log_buffer[1],
+					log_buffer[2], log_buffer[3],
+					log_buffer[dfu_smp_c->entry_size - 2],
+					log_buffer[dfu_smp_c->entry_size - 1], crctmp, crcval);
 			}
 
-			ct.log_publishing = true;
-			/* set flag indicating active data transfer */
-			remote.log_ble_xfer_active = true;
-			/* if enough bytes have been downloaded to complete an entry + 2 bytes for crc16,
-			 * calculate the CRC16 and if it passes, copy the entry into the log buffer
-			 */
-			switch (dfu_smp_c->entry_protocol_version) {
-			case LOG_ENTRY_PROTOCOL_V1:
-				/*
-				 * Parser for Entry Protocol 0x0001
-				 *   Each entry is of fixed size (256 + 2 CRC bytes for total of 258)
-				 *   and all 256 bytes + CRC16 are sent in one SMP CBOR packet.
-				 */
-				if ((dfu_smp_c->entry_downloaded_bytes + data_len) >=
-				    (dfu_smp_c->entry_size + sizeof(uint16_t))) {
-					crctmp = *((uint16_t *)&log_buffer[dfu_smp_c->entry_size]);
-					crcval = crc16_ccitt(0, log_buffer, dfu_smp_c->entry_size);
-
-					if (crctmp == crcval) {
-						dfu_smp_c->ent_cnt++; /* count # of entries received */
-
-						/* CRC was good, send the entry to AWS */
-						/* take sem if we can send to AWS */
-						if (k_sem_take(&sending_to_aws_sem, SEND_TO_AWS_TIMEOUT_TICKS) != 0) {
-							LOG_ERR("ble->aws pub timeout");
-
-							/* This entry was not able to be published due to timeout so need to stash this entry and force a disconnect */
-							/* to send after processing this packet. */
-							int record_bytes_in_entry = calculate_record_bytes_in_entry(
-								log_buffer, sizeof(log_entry_data_rssi_tracking_t),
-								dfu_smp_c->entry_size);
-							if (record_bytes_in_entry > 0 &&
-							    (record_bytes_in_entry + offsetof(log_entry_t, data) +
-							     sizeof(struct ct_publish_header_t)) <
-								    sizeof(aws_work.buf)) {
-								/* fill in the ct_publish_header_t */
-								struct ct_publish_header_t pub_hdr;
-								pub_hdr.entry_protocol_version =
-									dfu_smp_c->ct_log_header.entry_protocol_version;
-								memcpy(pub_hdr.device_id,
-								       dfu_smp_c->ct_log_header.device_id,
-								       BT_MAC_ADDR_LEN);
-								pub_hdr.device_time = lcz_qrtc_get_epoch();
-								pub_hdr.last_upload_time =
-									dfu_smp_c->ct_log_header.last_upload_time;
-
-								/* put in stash if fits. */
-								if ((stashed_entries.len +
-								     sizeof(struct ct_publish_header_t) +
-								     offsetof(log_entry_t, data) +
-								     record_bytes_in_entry) <
-								    CONFIG_CT_LOG_DOWNLOAD_BUFFER_SIZE) {
-									if (stashed_entries.len == 0) {
-										memcpy(stashed_entries.buffer, &pub_hdr,
-										       sizeof(struct ct_publish_header_t));
-										stashed_entries.len += sizeof(
-											struct ct_publish_header_t);
-										stashed_entries.idx = sizeof(
-											struct ct_publish_header_t);
-									}
-
-									/* current entry being stashed */
-									log_entry_t *entry = (log_entry_t *)&log_buffer
-										[0];
-									LOG_DBG("Stash entry %02x%02x, %d",
-										entry->header.serial[1],
-										entry->header.serial[0],
-										entry->header.timestamp);
-									memcpy(&stashed_entries.buffer[stashed_entries.len],
-									       log_buffer,
-									       offsetof(log_entry_t, data) +
-										       record_bytes_in_entry);
-									stashed_entries.len +=
-										sizeof(struct ct_publish_header_t) +
-										offsetof(log_entry_t, data) +
-										record_bytes_in_entry;
-								} else {
-									LOG_ERR("No space left in entry stash, have to discard entry");
-								}
-
-								LOG_VRB(">> %d %d %d", record_bytes_in_entry,
-									aws_work.buf_len,
-									sizeof(aws_work.buf));
-							} else {
-								if (record_bytes_in_entry == 0) {
-									LOG_DBG("0 records found in entry");
-								} else {
-									LOG_DBG("skipping AWS publish, entry too large for buffer");
-								}
-							}
+			/* copy the remaining bytes back into log_buffer if there are any */
+			if (dfu_smp_c->entry_downloaded_bytes + data_len >
+			    (dfu_smp_c->entry_size + sizeof(uint16_t))) {
+				uint16_t remaining = (dfu_smp_c->entry_downloaded_bytes + data_len -
+						      (dfu_smp_c->entry_size + sizeof(uint16_t)));
+				if (remaining > 0) {
+					memmove(log_buffer, &log_buffer[dfu_smp_c->entry_size + sizeof(uint16_t)],
+						remaining);
+					dfu_smp_c->entry_downloaded_bytes = remaining;
+				} else {
+					dfu_smp_c->entry_downloaded_bytes = 0;
+				}
+			} else {
+				dfu_smp_c->entry_downloaded_bytes = 0;
+			}
+			dfu_smp_c->entry_count++;
+		}
+		break;
 
-							disconnect_sensor();
-						} else {
-							int record_bytes_in_entry = calculate_record_bytes_in_entry(
-								log_buffer, sizeof(log_entry_data_rssi_tracking_t),
-								dfu_smp_c->entry_size);
-							if (record_bytes_in_entry > 0 &&
-							    (record_bytes_in_entry + offsetof(log_entry_t, data) +
-							     sizeof(struct ct_publish_header_t)) <
-								    sizeof(aws_work.buf)) {
-								/* fill in the ct_publish_header_t */
-								struct ct_publish_header_t pub_hdr;
-								pub_hdr.entry_protocol_version =
-									dfu_smp_c->ct_log_header.entry_protocol_version;
-								memcpy(pub_hdr.device_id,
-								       dfu_smp_c->ct_log_header.device_id,
-								       BT_MAC_ADDR_LEN);
-								pub_hdr.device_time = lcz_qrtc_get_epoch();
-								pub_hdr.last_upload_time =
-									dfu_smp_c->ct_log_header.last_upload_time;
-
-								memcpy(aws_work.buf, &pub_hdr,
-								       sizeof(struct ct_publish_header_t));
-								memcpy(&aws_work.buf[sizeof(
-									       struct ct_publish_header_t)],
-								       log_buffer,
-								       offsetof(log_entry_t, data) +
-									       record_bytes_in_entry);
-
-								aws_work.buf_len =
-									sizeof(struct ct_publish_header_t) +
-									offsetof(log_entry_t, data) +
-									record_bytes_in_entry;
-								ct.aws_publish_state =
-									AWS_PUBLISH_STATE_PENDING; /* set state to indicate waiting on publish result - check for publish success on next run of this function */
-
-								/* Preemptively put in stash if fits. If publish is successful, remove it from stash */
-								if ((stashed_entries.len +
-								     sizeof(struct ct_publish_header_t) +
-								     offsetof(log_entry_t, data) +
-								     record_bytes_in_entry) <
-								    CONFIG_CT_LOG_DOWNLOAD_BUFFER_SIZE) {
-									if (stashed_entries.len == 0) {
-										memcpy(stashed_entries.buffer, &pub_hdr,
-										       sizeof(struct ct_publish_header_t));
-										stashed_entries.len += sizeof(
-											struct ct_publish_header_t);
-										stashed_entries.idx = sizeof(
-											struct ct_publish_header_t);
-									}
-
-									memcpy(&stashed_entries.buffer[stashed_entries.len],
-									       log_buffer,
-									       offsetof(log_entry_t, data) +
-										       record_bytes_in_entry);
-									stashed_entries.len +=
-										sizeof(struct ct_publish_header_t) +
-										offsetof(log_entry_t, data) +
-										record_bytes_in_entry;
-									stashed_entries.prev_ent_size =
-										sizeof(struct ct_publish_header_t) +
-										offsetof(log_entry_t,
-											 data) +
-										record_bytes_in_entry; /* need a static variable to hold this value since ent_size will be updated before ct.aws_publish_state can be checked. */
-								} else {
-									LOG_ERR("No space left in entry stash, have to discard entry");
-								}
-
-								LOG_VRB(">> %d %d %d", record_bytes_in_entry,
-									aws_work.buf_len,
-									sizeof(aws_work.buf));
-							} else {
-								if (record_bytes_in_entry == 0) {
-									LOG_DBG("0 records found in entry");
-								} else {
-									LOG_DBG("skipping AWS publish, entry too large for buffer");
-								}
-							}
-							/* Send the data to AWS via work queue item */
-							k_work_submit(&aws_work.work);
-
-							/* Wait for publish completion immediately before moving on so that can stash entry if needed. */
-							/* (If not stashed here, publish status may not be checked later on and entry stash may not be correctly set) */
-							if (ct.aws_publish_state == AWS_PUBLISH_STATE_PENDING) {
-								if ((k_sem_take(&sending_to_aws_sem,
-										SEND_TO_AWS_TIMEOUT_TICKS) != 0)) {
-									LOG_ERR("aws pub timed out");
-									/* If publish times out, it must have failed. */
-									ct.aws_publish_state =
-										AWS_PUBLISH_STATE_FAIL;
-								} else {
-									/* Semaphore was taken. Only used to synchronize publish completion and no longer needed. */
-									k_sem_give(&sending_to_aws_sem);
-								}
-
-								if (ct.aws_publish_state ==
-								    AWS_PUBLISH_STATE_SUCCESS) {
-									/* Decrement stash length to discard the successfully published entry */
-									stashed_entries.len -= stashed_entries.prev_ent_size;
-								} else /* AWS_PUBLISH_STATE_FAIL || AWS_PUBLISH_STATE_PENDING */
-								{
-									log_entry_t *entry = (log_entry_t
-												      *)&stashed_entries.buffer
-										[stashed_entries.len -
-										 stashed_entries.prev_ent_size]; /* need to offset backwards to point to recently added entry */
-									LOG_DBG("Stash entry %02x%02x, %d",
-										entry->header.serial[1],
-										entry->header.serial[0],
-										entry->header.timestamp);
-									stashed_entries.available = true;
-								}
-								ct.aws_publish_state =
-									AWS_PUBLISH_STATE_NONE; /* reset state for next CT log download */
-							} else {
-								ct.aws_publish_state =
-									AWS_PUBLISH_STATE_NONE; /* reset state for next CT log download */
-							}
-						}
-					} else {
-						/* red */
-						LOG_DBG("\033[1;31m[ENT%3d] %s [%02X %02X %02X %02X...%02X %02X] rcv_crc: %04X, calc_crc: %04X ",
-							dfu_smp_c->entry_count, log_strdup(addr_str), log_buffer[0], log_buffer[1],
-							log_buffer[2], log_buffer[3],
-							log_buffer[dfu_smp_c->entry_size - 2],
-							log_buffer[dfu_smp_c->entry_size - 1], crctmp, crcval);
-					}
+	case LOG_ENTRY_PROTOCOL_V2: {
+		/* entry index iterator */
+		uint32_t ent_idx = 0;
+		/* byte offset into log_buffer for start of next entry */
+		uint32_t ent_offset = 0;
+		/* size of current entry */
+		uint16_t ent_size = 0;
+		/* record index iterator */
+		uint16_t rec_idx = 0;
+		/* count records per entry for debug output */
+		uint16_t rec_cnt = 0;
+		log_entry_t *entry;
+
+		LOG_VRB("Received V2 Entry: %d total, %d entry bytes", len,
+			dfu_smp_c->entry_downloaded_bytes + data_len);
+		/**
+		 * Parser for Entry Protocol 0x0002
+		 *   Each SMP packet length is a multiple of (max_entry_size + 2 CRC bytes)
+		 *   and entries may be variable length. One or more entries may be present
+		 *   in a single SMP CBOR packet.
+		 */
+		do {
+			/* reset the SMP transfer timeout timer */
+			k_timer_start(&sensor->smp_xfer_timeout_timer, SMP_TIMEOUT_TICKS, K_NO_WAIT);
+			LOG_VRB("smp tmr restart in msg");
+
+			/* iterate over the downloaded bytes parsing each entry */
+			entry = (log_entry_t *)&log_buffer[ent_offset];
+			if (entry->header.entryStart != LOG_ENTRY_START_BYTE) {
+				/* this is not an entry, break (could be padding bytes if encryption is enabled) */
+				LOG_ERR("start (0x%02X) != %02X", entry->header.entryStart,
+					LOG_ENTRY_START_BYTE);
+				break;
+			}
+			ent_size = *((uint16_t *)(&entry->header.reserved[0]));
 
-					/* copy the remaining bytes back into log_buffer if there are any */
-					if (dfu_smp_c->entry_downloaded_bytes + data_len >
-					    (dfu_smp_c->entry_size + sizeof(uint16_t))) {
-						uint16_t remaining = (dfu_smp_c->entry_downloaded_bytes + data_len -
-								      (dfu_smp_c->entry_size + sizeof(uint16_t)));
-						if (remaining > 0) {
-							memcpy(log_buffer, &dec_file_data[remaining], remaining);
-							dfu_smp_c->entry_downloaded_bytes = remaining;
-						} else {
-							dfu_smp_c->entry_downloaded_bytes = 0;
-						}
-					} else {
-						dfu_smp_c->entry_downloaded_bytes = 0;
-					}
-					dfu_smp_c->entry_count++;
-				}
+			if ((ent_offset + ent_size + sizeof(uint16_t)) > sizeof(sensor->log_buffer)) {
+				LOG_ERR("err ent_offset: %d, ent_size: %d", ent_offset, ent_size);
 				break;
+			}
 
-			case LOG_ENTRY_PROTOCOL_V2: {
-				/* entry index iterator */
-				uint32_t ent_idx = 0;
-				/* byte offset into log_buffer for start of next entry */
-				uint32_t ent_offset = 0;
-				/* size of current entry */
-				uint16_t ent_size = 0;
-				/* record index iterator */
-				uint16_t rec_idx = 0;
-				/* count records per entry for debug output */
-				uint16_t rec_cnt = 0;
-				log_entry_t *entry;
-
-				LOG_VRB("Received V2 Entry: %d total, %d entry bytes", len,
-					dfu_smp_c->entry_downloaded_bytes + data_len);
-				/**
-				 * Parser for Entry Protocol 0x0002
-				 *   Each SMP packet length is a multiple of (max_entry_size + 2 CRC bytes)
-				 *   and entries may be variable length. One or more entries may be present
-				 *   in a single SMP CBOR packet.
-				 */
-				do {
-					/* reset the SMP transfer timeout timer */
-					k_timer_start(&smp_xfer_timeout_timer, SMP_TIMEOUT_TICKS, K_NO_WAIT);
-					LOG_VRB("smp tmr restart in msg");
-
-					/* iterate over the downloaded bytes parsing each entry */
-					entry = (log_entry_t *)&log_buffer[ent_offset];
-					if (entry->header.entryStart != LOG_ENTRY_START_BYTE) {
-						/* this is not an entry, break (could be padding bytes if encryption is enabled) */
-						LOG_ERR("start (0x%02X) != %02X", entry->header.entryStart,
-							LOG_ENTRY_START_BYTE);
+			uint16_t crctmp = *((uint16_t *)&log_buffer[ent_offset + ent_size]);
+			uint16_t crcval = crc16_ccitt(0, &log_buffer[ent_offset], ent_size);
+
+			if (crctmp == crcval) {
+
+				addr.type = BT_ADDR_LE_RANDOM;
+				memcpy(addr.a.val,
+				       ((log_entry_t *)&log_buffer[ent_offset])->header.serial,
+				       sizeof(bt_addr_t));
+				bt_addr_le_to_str(&addr, addr_str, sizeof(addr_str));
+
+				LOG_VRB("\033[0;32m[ENT%3d] \033[38;5;68m%s ", ent_idx, log_strdup(addr_str));
+				rec_cnt = 0;
+				for (rec_idx = sizeof(entry->header); rec_idx < ent_size;) {
+					uint8_t rec_type = log_buffer[ent_offset + rec_idx];
+					switch (rec_type) {
+					case CT_ADV_REC_TYPE_V10:
+						rec_idx += 4;
+						dfu_smp_c->rec_cnt++;
+						rec_cnt++;
 						break;
-					}
-					ent_size = *((uint16_t *)(&entry->header.reserved[0]));
-
-					if ((ent_offset + ent_size + sizeof(uint16_t)) > sizeof(log_buffer)) {
-						LOG_ERR("err ent_offset: %d, ent_size: %d", ent_offset, ent_size);
+					case CT_ADV_REC_TYPE_V11:
+						rec_idx += 8;
+						dfu_smp_c->rec_cnt++;
+						rec_cnt++;
+						break;
+					default:
+						LOG_DBG("\033[38;5;196m[Unk%02X] ", rec_type);
+						rec_idx += 4;
 						break;
 					}
+				}
 
-					uint16_t crctmp = *((uint16_t *)&log_buffer[ent_offset + ent_size]);
-					uint16_t crcval = crc16_ccitt(0, &log_buffer[ent_offset], ent_size);
-
-					if (crctmp == crcval) {
-
-						addr.type = BT_ADDR_LE_RANDOM;
-						memcpy(addr.a.val,
-						       ((log_entry_t *)&log_buffer[ent_offset])->header.serial,
-						       sizeof(bt_addr_t));
-						bt_addr_le_to_str(&addr, addr_str, sizeof(addr_str));
-
-						LOG_VRB("\033[0;32m[ENT%3d] \033[38;5;68m%s ", ent_idx, log_strdup(addr_str));
-						rec_cnt = 0;
-						for (rec_idx = sizeof(entry->header); rec_idx < ent_size;) {
-							uint8_t rec_type = log_buffer[ent_offset + rec_idx];
-							switch (rec_type) {
-							case CT_ADV_REC_TYPE_V10:
-								rec_idx += 4;
-								dfu_smp_c->rec_cnt++;
-								rec_cnt++;
-								break;
-							case CT_ADV_REC_TYPE_V11:
-								rec_idx += 8;
-								dfu_smp_c->rec_cnt++;
-								rec_cnt++;
-								break;
-							default:
-								LOG_DBG("\033[38;5;196m[Unk%02X] ", rec_type);
-								rec_idx += 4;
-								break;
-							}
-						}
-
-						LOG_VRB("\033[38;5;163m[%2d rec] %3d \033[38;5;68m%s, %d", rec_cnt,
-							ent_size, log_strdup(addr_str),
-							((log_entry_t *)&log_buffer[ent_offset])->header.timestamp);
-						LOG_VRB("%8lld\033[38;5;163m %3d", k_uptime_get(), ent_size);
-						LOG_VRB("\033[0;32m[ENT%3d] %d", dfu_smp_c->downloaded_bytes);
+				LOG_VRB("\033[38;5;163m[%2d rec] %3d \033[38;5;68m%s, %d", rec_cnt,
+					ent_size, log_strdup(addr_str),
+					((log_entry_t *)&log_buffer[ent_offset])->header.timestamp);
+				LOG_VRB("%8lld\033[38;5;163m %3d", k_uptime_get(), ent_size);
+				LOG_VRB("\033[0;32m[ENT%3d] %d", dfu_smp_c->downloaded_bytes);
 
-						/* store the entry size in the last 2 bytes of the entry header */
-						*((uint16_t *)&((log_entry_t *)&log_buffer[ent_offset])
-							  ->header.reserved[0]) = ent_size;
+				/* store the entry size in the last 2 bytes of the entry header */
+				*((uint16_t *)&((log_entry_t *)&log_buffer[ent_offset])
+					  ->header.reserved[0]) = ent_size;
 
 #if defined(CONFIG_CT_AWS_PUBLISH_ENTRIES)
-						/* send the entry to AWS */
-						/* take sem if we can send to AWS */
-						if (k_sem_take(&sending_to_aws_sem, SEND_TO_AWS_TIMEOUT_TICKS) != 0) {
-							LOG_ERR("ble->aws pub timeout");
-
-							/* This entry was not able to be published due to timeout so need to stash this entry and force a disconnect
-							 * to send after processing this packet.
-							 * check that entry will fit in the aws send buffer
-							 */
-							if (ent_size > 0 &&
-							    (ent_size + sizeof(struct ct_publish_header_t)) <
-								    sizeof(aws_work.buf)) {
-								/* fill in the ct_publish_header_t */
-								struct ct_publish_header_t pub_hdr;
-								pub_hdr.entry_protocol_version =
-									dfu_smp_c->ct_log_header.entry_protocol_version;
-								memcpy(pub_hdr.device_id,
-								       dfu_smp_c->ct_log_header.device_id,
-								       BT_MAC_ADDR_LEN);
-								pub_hdr.device_time = lcz_qrtc_get_epoch();
-								pub_hdr.last_upload_time =
-									dfu_smp_c->ct_log_header.last_upload_time;
-								memcpy(pub_hdr.fw_version,
-								       dfu_smp_c->ct_log_header.local_info.fw_version,
-								       sizeof(pub_hdr.fw_version));
-								pub_hdr.battery_level =
-									dfu_smp_c->ct_log_header.local_info
-										.battery_level;
-								pub_hdr.network_id =
-									dfu_smp_c->ct_log_header.local_info.network_id;
-
-								/* Put in stash if fits. */
-								if ((stashed_entries.len +
-								     sizeof(struct ct_publish_header_t) + ent_size) <
-								    CONFIG_CT_LOG_DOWNLOAD_BUFFER_SIZE) {
-									if (stashed_entries.len == 0) {
-										memcpy(stashed_entries.buffer, &pub_hdr,
-										       sizeof(struct ct_publish_header_t));
-										stashed_entries.len += sizeof(
-											struct ct_publish_header_t);
-										stashed_entries.idx = sizeof(
-											struct ct_publish_header_t);
-									}
-
-									LOG_DBG("Stash entry %02x%02x, %d",
-										entry->header.serial[1],
-										entry->header.serial[0],
-										entry->header
-											.timestamp); /* current entry is being stashed */
-									memcpy(&stashed_entries.buffer[stashed_entries.len],
-									       &log_buffer[ent_offset], ent_size);
-									stashed_entries.len += ent_size;
-								} else {
-									LOG_ERR("No space left in entry stash, have to discard entry");
-								}
-							} else {
-								if (ent_size == 0) {
-									LOG_DBG("0 records found in entry");
-								} else {
-									LOG_DBG("skipping AWS publish, entry too large for buffer");
-								}
-							}
-
-							disconnect_sensor();
-						} else {
-							/* Check publish result if an entry was previously published (STATE_NONE indicates no publish has occurred yet) */
-							if (ct.aws_publish_state != AWS_PUBLISH_STATE_NONE) {
-								if (ct.aws_publish_state ==
-								    AWS_PUBLISH_STATE_SUCCESS) {
-									/* Decrement stash length to discard the successfully published entry */
-									stashed_entries.len -= stashed_entries.prev_ent_size;
-								} else /* AWS_PUBLISH_STATE_FAIL || AWS_PUBLISH_STATE_PENDING */
-								{
-									log_entry_t *entry = (log_entry_t
-												      *)&stashed_entries.buffer
-										[stashed_entries.len -
-										 stashed_entries.prev_ent_size]; /* need to offset backwards to point to recently added entry */
-									LOG_DBG("Stash entry %02x%02x, %d",
-										entry->header.serial[1],
-										entry->header.serial[0],
-										entry->header.timestamp);
-									stashed_entries.available = true;
-								}
-							}
-
-							/* check that entry will fit in the aws send buffer */
-							if (ent_size > 0 &&
-							    (ent_size + sizeof(struct ct_publish_header_t)) <
-								    sizeof(aws_work.buf)) {
-								/* fill in the ct_publish_header_t */
-								struct ct_publish_header_t pub_hdr;
-								pub_hdr.entry_protocol_version =
-									dfu_smp_c->ct_log_header.entry_protocol_version;
-								memcpy(pub_hdr.device_id,
-								       dfu_smp_c->ct_log_header.device_id,
-								       BT_MAC_ADDR_LEN);
-								pub_hdr.device_time = lcz_qrtc_get_epoch();
-								pub_hdr.last_upload_time =
-									dfu_smp_c->ct_log_header.last_upload_time;
-								memcpy(pub_hdr.fw_version,
-								       dfu_smp_c->ct_log_header.local_info.fw_version,
-								       sizeof(pub_hdr.fw_version));
-								pub_hdr.battery_level =
-									dfu_smp_c->ct_log_header.local_info
-										.battery_level;
-								pub_hdr.network_id =
-									dfu_smp_c->ct_log_header.local_info.network_id;
-								memcpy(aws_work.buf, &pub_hdr,
-								       sizeof(struct ct_publish_header_t));
-								memcpy(&aws_work.buf[sizeof(
-									       struct ct_publish_header_t)],
-								       &log_buffer[ent_offset], ent_size);
-								aws_work.buf_len =
-									sizeof(struct ct_publish_header_t) + ent_size;
-
-								LOG_VRB(">> %d %d %d", record_bytes_in_entry,
-									aws_work.buf_len,
-									sizeof(aws_work.buf));
-
-								ct.aws_publish_state =
-									AWS_PUBLISH_STATE_PENDING; /* set state to indicate waiting on publish result - check for publish success on next run of this function */
-
-								/* Preemptively put in stash if fits. If publish is successful, remove it from stash */
-								if ((stashed_entries.len +
-								     sizeof(struct ct_publish_header_t) + ent_size) <
-								    CONFIG_CT_LOG_DOWNLOAD_BUFFER_SIZE) {
-									if (stashed_entries.len == 0) {
-										memcpy(stashed_entries.buffer, &pub_hdr,
-										       sizeof(struct ct_publish_header_t));
-										stashed_entries.len += sizeof(
-											struct ct_publish_header_t);
-										stashed_entries.idx = sizeof(
-											struct ct_publish_header_t);
-									}
-
-									memcpy(&stashed_entries.buffer[stashed_entries.len],
-									       &log_buffer[ent_offset], ent_size);
-									stashed_entries.len += ent_size;
-									stashed_entries.prev_ent_size =
-										ent_size; /* need a static variable to hold this value since ent_size will be updated before ct.aws_publish_state can be checked. */
-
-								} else {
-									LOG_ERR("No space left in entry stash, have to discard entry");
-								}
-
-							} else {
-								if (ent_size == 0) {
-									LOG_DBG("0 records found in entry");
-								} else {
-									LOG_DBG("skipping AWS publish, entry too large for buffer");
-								}
-							}
-
-							/* Send the data to AWS via work queue item */
-							k_work_submit(&aws_work.work);
-						}
+				/* queue the entry for the next AWS publish */
+				aws_batch_add(sensor, &log_buffer[ent_offset], ent_size);
 #endif
 
-						ent_idx++;
-
-						ent_offset +=
-							ent_size +
-							sizeof(uint16_t); /* + sizeof(uint16_t) accounts for CRC16 from transfer, not counted in ent_size */
-						dfu_smp_c->ent_cnt++;
-					} else {
-						/* abort the transfer */
-						LOG_DBG("\033[1;31m[ENT%3d] rcv_crc: %04x, calc_crc: %04x CRC MISMATCH",
-							ent_idx, crctmp, crcval);
-						LOG_ERR("CRC mismatch in entry");
-						dfu_smp_c->rsp_state.rc = MGMT_ERR_ENOENT;
-						return;
-					}
-				} while (ent_offset < data_len);
-
-#if defined(CONFIG_CT_AWS_PUBLISH_ENTRIES)
-				/* If this was the last entry, need to wait for publish completion
-				 * Have to check here because if there was a failure, the rest of the log won't be downloaded immediately and so
-				 * status of the last entry needs to be checked to ensure stash is in correct state
-				 */
-				if (ct.aws_publish_state == AWS_PUBLISH_STATE_PENDING) {
-					if ((k_sem_take(&sending_to_aws_sem, SEND_TO_AWS_TIMEOUT_TICKS) != 0)) {
-						LOG_ERR("ble->aws pub timeout");
-						/* If publish times out, it must have failed. */
-						ct.aws_publish_state = AWS_PUBLISH_STATE_FAIL;
-					} else {
-						/* Semaphore was taken. Only used to synchronize publish completion and no longer needed. */
-						k_sem_give(&sending_to_aws_sem);
-					}
-
-					/* Check publish result if an entry was previously published (STATE_NONE indicates no publish has occurred yet) */
-					if (ct.aws_publish_state == AWS_PUBLISH_STATE_SUCCESS) {
-						/* Decrement stash length to discard the successfully published entry */
-						stashed_entries.len -= stashed_entries.prev_ent_size;
-					} else /* AWS_PUBLISH_STATE_FAIL || AWS_PUBLISH_STATE_PENDING */
-					{
-						log_entry_t *entry = (log_entry_t *)&stashed_entries.buffer
-							[stashed_entries.len -
-							 stashed_entries.prev_ent_size]; /* need to offset backwards to point to recently added entry */
-						LOG_DBG("Stash entry %02x%02x, %d", entry->header.serial[1],
-							entry->header.serial[0], entry->header.timestamp);
-						stashed_entries.available = true;
-					}
-					ct.aws_publish_state =
-						AWS_PUBLISH_STATE_NONE; /* reset state for next CT log download */
-				} else {
-					ct.aws_publish_state =
-						AWS_PUBLISH_STATE_NONE; /* reset state for next CT log download */
-				}
-#endif
-			} break;
+				ent_idx++;
 
-			default:
-				break;
+				ent_offset +=
+					ent_size +
+					sizeof(uint16_t); /* + sizeof(uint16_t) accounts for CRC16 from transfer, not counted in ent_size */
+				dfu_smp_c->ent_cnt++;
+			} else {
+				/* abort the transfer */
+				LOG_DBG("\033[1;31m[ENT%3d] rcv_crc: %04x, calc_crc: %04x CRC MISMATCH",
+					ent_idx, crctmp, crcval);
+				LOG_ERR("CRC mismatch in entry");
+				return MGMT_ERR_ENOENT;
 			}
-		}
+		} while (ent_offset < data_len);
+	} break;
 
-		LOG_VRB("%d", dfu_smp_c->downloaded_bytes);
-		LOG_VRB("\033[38;5;68m\033[8D->%02d%%    ",
-			(uint16_t)(((float)dfu_smp_c->downloaded_bytes / (float)dfu_smp_c->file_size) * 100));
-
-		dfu_smp_c->downloaded_bytes += data_len;
-
-		if (dfu_smp_c->downloaded_bytes > 0 && dfu_smp_c->downloaded_bytes == dfu_smp_c->file_size) {
-			LOG_VRB("\033[38;5;68m\033[8D---]\033[1;36m Done (%d bytes)\033[0m",
-				dfu_smp_c->downloaded_bytes);
-			/*  green */
-			LOG_VRB("\033[0;32m[%02X %02X %02X %02X...%02X %02X]", log_buffer[0], log_buffer[1],
-				log_buffer[2], log_buffer[3], log_buffer[dfu_smp_c->file_size - 2],
-				log_buffer[dfu_smp_c->file_size - 1]);
-
-			if (dfu_smp_c->entry_protocol_version == 1) {
-				LOG_DBG("\033[38;5;46m%d %s", dfu_smp_c->ent_cnt,
-					dfu_smp_c->ent_cnt > 1 ? "entries" : "entry");
-			} else if (dfu_smp_c->entry_protocol_version == 2) {
-				LOG_DBG("\033[38;5;51m%d %s, %d rec", dfu_smp_c->ent_cnt,
-					dfu_smp_c->ent_cnt > 1 ? "entries" : "entry", dfu_smp_c->rec_cnt);
-			}
+	default:
+		break;
+	}
 
-			ct.num_download_completions++;
+	LOG_VRB("%d", dfu_smp_c->downloaded_bytes);
+	LOG_VRB("\033[38;5;68m\033[8D->%02d%%    ",
+		(uint16_t)(((float)dfu_smp_c->downloaded_bytes / (float)dfu_smp_c->file_size) * 100));
+
+	if (dfu_smp_c->downloaded_bytes > 0 && dfu_smp_c->downloaded_bytes == dfu_smp_c->file_size) {
+		LOG_VRB("\033[38;5;68m\033[8D---]\033[1;36m Done (%d bytes)\033[0m",
+			dfu_smp_c->downloaded_bytes);
+		/*  green */
+		LOG_VRB("\033[0;32m[%02X %02X %02X %02X...%02X %02X]", log_buffer[0], log_buffer[1],
+			log_buffer[2], log_buffer[3], log_buffer[dfu_smp_c->file_size - 2],
+			log_buffer[dfu_smp_c->file_size - 1]);
+
+		if (dfu_smp_c->entry_protocol_version == 1) {
+			LOG_DBG("\033[38;5;46m%d %s", dfu_smp_c->ent_cnt,
+				dfu_smp_c->ent_cnt > 1 ? "entries" : "entry");
+		} else if (dfu_smp_c->entry_protocol_version == 2) {
+			LOG_DBG("\033[38;5;51m%d %s, %d rec", dfu_smp_c->ent_cnt,
+				dfu_smp_c->ent_cnt > 1 ? "entries" : "entry", dfu_smp_c->rec_cnt);
+		}
 
-			/* If there was no d/c or timeout after downloading entire log, then can clear entry stash */
-			if (!stashed_entries.available) {
-				ResetEntryStashInformation(false);
-			}
-			ct.log_publishing = false;
+		ct.num_download_completions++;
+
+		/* Publish the rest of the batch and settle the entry stash */
+		aws_batch_finish(sensor);
+
+		ct.last_download_time = (uint32_t)(k_uptime_get() - sensor->download_start);
+		ct.last_download_size = dfu_smp_c->file_size;
+		ct.total_download_time += ct.last_download_time;
+		ct.link = sensor->link;
+		ct.link.mtu = sensor->mtu;
+		ct.link.throughput = (ct.last_download_size * MSEC_PER_SEC) /
+				     MAX(ct.last_download_time, 1);
+		rank_candidate(&sensor->addr, dfu_smp_c->file_size);
+		LOG_DBG("Log download took %u ms (%u bytes)", ct.last_download_time,
+			ct.last_download_size);
+
+		/* If there was no d/c or timeout after downloading entire log, then can clear entry stash */
+		if (!sensor->stashed_entries.available) {
+			ResetEntryStashInformation(sensor, false);
 		}
+		sensor->publishing = false;
 	}
+
+	return 0;
 }
 /* clang-format on */
 
 static int send_smp_challenge_request(struct bt_gatt_dfu_smp_c *dfu_smp_c,
 				      const char *filename, uint32_t offset)
 {
+	struct smp_buffer *smp_rsp_buff = &smp_sensor(dfu_smp_c)->smp_rsp_buff;
 	static struct smp_buffer smp_cmd;
 	CborEncoder cbor, cbor_map;
 	size_t payload_len;
@@ -2368,7 +2741,7 @@ static int send_smp_challenge_request(struct bt_gatt_dfu_smp_c *dfu_smp_c,
 	smp_cmd.header.id = FS_MGMT_ID_FILE;
 
 	/* clear the smp_rsp_buff */
-	memset((uint8_t *)&smp_rsp_buff, 0, sizeof(smp_rsp_buff));
+	memset((uint8_t *)smp_rsp_buff, 0, sizeof(*smp_rsp_buff));
 
 	return bt_gatt_dfu_smp_c_command(dfu_smp_c,
 					 smp_challenge_req_proc_handler,
@@ -2380,6 +2753,7 @@ static int send_smp_challenge_response(struct bt_gatt_dfu_smp_c *dfu_smp_c,
 				       const char *filename, uint32_t offset,
 				       uint8_t *pData, uint32_t dataLen)
 {
+	struct smp_buffer *smp_rsp_buff = &smp_sensor(dfu_smp_c)->smp_rsp_buff;
 	static struct smp_buffer smp_cmd;
 	CborEncoder cbor, cbor_map;
 	size_t payload_len;
@@ -2410,7 +2784,7 @@ static int send_smp_challenge_response(struct bt_gatt_dfu_smp_c *dfu_smp_c,
 	smp_cmd.header.id = FS_MGMT_ID_FILE;
 
 	/* clear the smp_rsp_buff */
-	memset((uint8_t *)&smp_rsp_buff, 0, sizeof(smp_rsp_buff));
+	memset((uint8_t *)smp_rsp_buff, 0, sizeof(*smp_rsp_buff));
 
 	return bt_gatt_dfu_smp_c_command(dfu_smp_c,
 					 smp_challenge_rsp_proc_handler,
@@ -2421,6 +2795,7 @@ static int send_smp_challenge_response(struct bt_gatt_dfu_smp_c *dfu_smp_c,
 static int send_smp_download_request(struct bt_gatt_dfu_smp_c *dfu_smp_c,
 				     const char *filename, uint32_t offset)
 {
+	struct smp_buffer *smp_rsp_buff = &smp_sensor(dfu_smp_c)->smp_rsp_buff;
 	static struct smp_buffer smp_cmd;
 	CborEncoder cbor, cbor_map;
 	size_t payload_len;
@@ -2428,7 +2803,7 @@ static int send_smp_download_request(struct bt_gatt_dfu_smp_c *dfu_smp_c,
 
 	/* if continuing a download, caller may send NULL as filename */
 	if (filename == NULL) {
-		filename = smp_fs_download_filename;
+		filename = smp_sensor(dfu_smp_c)->smp_fs_download_filename;
 	}
 
 	cbor_buf_writer_init(&writer, smp_cmd.payload, sizeof(smp_cmd.payload));
@@ -2453,7 +2828,7 @@ static int send_smp_download_request(struct bt_gatt_dfu_smp_c *dfu_smp_c,
 	smp_cmd.header.id = FS_MGMT_ID_FILE;
 
 	/* clear the smp_rsp_buff */
-	memset((uint8_t *)&smp_rsp_buff, 0, sizeof(smp_rsp_buff));
+	memset((uint8_t *)smp_rsp_buff, 0, sizeof(*smp_rsp_buff));
 
 	return bt_gatt_dfu_smp_c_command(dfu_smp_c, smp_file_download_rsp_proc,
 					 sizeof(smp_cmd.header) + payload_len,
@@ -2462,44 +2837,49 @@ static int send_smp_download_request(struct bt_gatt_dfu_smp_c *dfu_smp_c,
 
 static void smp_challenge_req_work_handler(struct k_work *work)
 {
+	struct ct_sensor *sensor =
+		CONTAINER_OF(work, struct ct_sensor, smp_challenge_req_work);
 	int ret;
 
-	snprintk(smp_fs_download_filename, sizeof(smp_fs_download_filename),
+	snprintk(sensor->smp_fs_download_filename,
+		 sizeof(sensor->smp_fs_download_filename),
 		 "/sys/challenge.bin");
 
-	bt_gatt_dfu_smp_c_init(&dfu_smp_c, NULL);
-	ret = send_smp_challenge_request(&dfu_smp_c, smp_fs_download_filename,
-					 0);
+	bt_gatt_dfu_smp_c_init(&sensor->dfu_smp_c, NULL);
+	ret = send_smp_challenge_request(&sensor->dfu_smp_c,
+					 sensor->smp_fs_download_filename, 0);
 	if (ret) {
 		LOG_WRN("Authenticate device command send error (err: %d)",
 			ret);
-		bt_conn_disconnect(remote.conn,
+		bt_conn_disconnect(sensor->conn,
 				   BT_HCI_ERR_REMOTE_USER_TERM_CONN);
 	} else {
-		set_ble_state(CENTRAL_STATE_CHALLENGE_REQUEST);
-		k_timer_start(&smp_xfer_timeout_timer, SMP_TIMEOUT_TICKS,
-			      K_NO_WAIT);
+		set_ble_state(sensor, CENTRAL_STATE_CHALLENGE_REQUEST);
+		k_timer_start(&sensor->smp_xfer_timeout_timer,
+			      SMP_TIMEOUT_TICKS, K_NO_WAIT);
 	}
 }
 
 static void smp_fs_download_work_handler(struct k_work *work)
 {
+	struct ct_sensor *sensor =
+		CONTAINER_OF(work, struct ct_sensor, smp_fs_download_work);
 	int ret;
 
-	snprintk(smp_fs_download_filename, sizeof(smp_fs_download_filename),
-		 "/log/ct");
+	snprintk(sensor->smp_fs_download_filename,
+		 sizeof(sensor->smp_fs_download_filename), "/log/ct");
 
-	bt_gatt_dfu_smp_c_init(&dfu_smp_c, NULL);
-	ret = send_smp_download_request(&dfu_smp_c, smp_fs_download_filename,
-					0);
+	bt_gatt_dfu_smp_c_init(&sensor->dfu_smp_c, NULL);
+	ret = send_smp_download_request(&sensor->dfu_smp_c,
+					sensor->smp_fs_download_filename, 0);
 	if (ret) {
 		LOG_WRN("Download command send error (err: %d)", ret);
-		bt_conn_disconnect(remote.conn,
+		bt_conn_disconnect(sensor->conn,
 				   BT_HCI_ERR_REMOTE_USER_TERM_CONN);
 	} else {
-		set_ble_state(CENTRAL_STATE_LOG_DOWNLOAD);
-		k_timer_start(&smp_xfer_timeout_timer, SMP_TIMEOUT_TICKS,
-			      K_NO_WAIT);
+		set_ble_state(sensor, CENTRAL_STATE_LOG_DOWNLOAD);
+		k_timer_start(&sensor->smp_xfer_timeout_timer,
+			      SMP_TIMEOUT_TICKS, K_NO_WAIT);
 	}
 }
 
@@ -2513,40 +2893,44 @@ static void change_advert_type_work_handler(struct k_work *work)
 /* clang-format off */
 static void send_stashed_entries_work_handler(struct k_work *work)
 {
+	struct ct_sensor *sensor = stashed_sensor();
+	size_t consumed;
+	size_t i;
+
 	/* Make sure AWS is connected, and no other log download is occurring (normally over BLE) */
-	if (bluegrass_ready_for_publish() && (remote.app_state == CENTRAL_STATE_FINDING_DEVICE)) {
-		if (stashed_entries.available) {
-			if (stashed_entries.len >
+	if (bluegrass_ready_for_publish() && sensors_idle()) {
+		if (sensor != NULL) {
+			if (sensor->stashed_entries.len >
 			    sizeof(struct ct_publish_header_t)) /* make sure ct header has been copied */
 			{
 				if (k_sem_take(&sending_to_aws_sem, SEND_TO_AWS_TIMEOUT_TICKS) != 0) {
-					stashed_entries.timeouts++;
+					sensor->stashed_entries.timeouts++;
 
-					if (stashed_entries.timeouts > STASH_ENTRY_FAILURE_CNT_MAX) {
+					if (sensor->stashed_entries.timeouts > STASH_ENTRY_FAILURE_CNT_MAX) {
 						LOG_ERR("Entry stash publish semaphore timed out (%d). Reset stash and continue...",
-							stashed_entries.timeouts);
-						stashed_entries.timeouts = 0;
-						ResetEntryStashInformation(false); /* semaphore take timed out - another task must have it so this function shouldn't give */
+							sensor->stashed_entries.timeouts);
+						sensor->stashed_entries.timeouts = 0;
+						ResetEntryStashInformation(sensor, false); /* semaphore take timed out - another task must have it so this function shouldn't give */
 						return;
 					}
 					k_work_submit(&send_stashed_entries_work);
 				} else {
 					ct.log_publishing = true;
-					stashed_entries.timeouts = 0;
+					sensor->stashed_entries.timeouts = 0;
 
 					/* Check status of previous publish */
 					if (ct.aws_publish_state != AWS_PUBLISH_STATE_NONE) {
 						if (ct.aws_publish_state == AWS_PUBLISH_STATE_SUCCESS) {
-							stashed_entries.idx += stashed_entries.prev_ent_size;
+							sensor->stashed_entries.idx += sensor->stashed_entries.prev_ent_size;
 						} else /* AWS_PUBLISH_STATE_FAIL || AWS_PUBLISH_STATE_PENDING */
 						{
-							stashed_entries.failure_cnt++;
-							if (stashed_entries.failure_cnt > STASH_ENTRY_FAILURE_CNT_MAX) {
-								/* Too many failures so just have to move onto next entry */
+							sensor->stashed_entries.failure_cnt++;
+							if (sensor->stashed_entries.failure_cnt > STASH_ENTRY_FAILURE_CNT_MAX) {
+								/* Too many failures so just have to move onto next batch */
 								LOG_ERR("Entry stash publish failed to max (%d). Move to next entry and continue...",
-									stashed_entries.failure_cnt);
-								stashed_entries.idx += stashed_entries.prev_ent_size;
-								stashed_entries.failure_cnt = 0;
+									sensor->stashed_entries.failure_cnt);
+								sensor->stashed_entries.idx += sensor->stashed_entries.prev_ent_size;
+								sensor->stashed_entries.failure_cnt = 0;
 
 								/* after 2 minutes of failures, AWS unlikely to be working so just reboot */
 								lcz_software_reset_after_assert(1000);
@@ -2554,82 +2938,69 @@ static void send_stashed_entries_work_handler(struct k_work *work)
 						}
 					}
 
-					if (stashed_entries.idx >= stashed_entries.len) {
+					if (sensor->stashed_entries.idx >= sensor->stashed_entries.len) {
 						/* All stashed entries have been sent */
 						LOG_DBG("Entry Stash all sent. Reset stash and continue normal operation...");
-						ResetEntryStashInformation(true);
+						ResetEntryStashInformation(sensor, true);
+						if (stashed_sensor() != NULL) {
+							/* another connection left entries behind */
+							k_work_submit(&send_stashed_entries_work);
+						}
 						return;
 					}
 
-					/* iterate over the downloaded bytes parsing each entry */
-					log_entry_t *entry = (log_entry_t *)&stashed_entries.buffer[stashed_entries.idx];
-					if (entry->header.entryStart != LOG_ENTRY_START_BYTE) {
-						/* this is not an entry, break (could be padding bytes if encryption is enabled) */
-						LOG_ERR("Stash entry not found - 0x%02X not equal to start byte %02X",
-							entry->header.entryStart, LOG_ENTRY_START_BYTE);
-						ResetEntryStashInformation(true);
+					/* Send as many of the stashed entries as fit in one publish */
+					consumed = load_aws_work(
+						(struct ct_publish_header_t *)sensor->stashed_entries.buffer,
+						&sensor->stashed_entries.buffer[sensor->stashed_entries.idx],
+						sensor->stashed_entries.len - sensor->stashed_entries.idx);
+					if (consumed == 0) {
+						LOG_WRN("Stash entry at %d of %d is invalid. Reset stash and continue...",
+							sensor->stashed_entries.idx, sensor->stashed_entries.len);
+						ResetEntryStashInformation(sensor, true);
 						return;
 					}
 
-					/* Verify index seems valid after finding an entry */
-					if (stashed_entries.idx < stashed_entries.len) {
-						uint16_t ent_size = *((uint16_t *)(&entry->header.reserved[0]));
-
-						/* Validate entry size and then send next stashed */
-						if ((ent_size <= LOG_ENTRY_MAX_SIZE) &&
-						    stashed_entries.idx + ent_size <= stashed_entries.len) {
-							uint32_t epoch = lcz_qrtc_get_epoch();
-							*((uint32_t *)&stashed_entries.buffer[offsetof(
-								struct ct_publish_header_t, device_time)]) = epoch;
-
-							memcpy(aws_work.buf, stashed_entries.buffer,
-							       sizeof(struct ct_publish_header_t));
-							memcpy(&aws_work.buf[sizeof(struct ct_publish_header_t)],
-							       &stashed_entries.buffer[stashed_entries.idx], ent_size);
-							aws_work.buf_len =
-								sizeof(struct ct_publish_header_t) + ent_size;
-							ct.aws_publish_state =
-								AWS_PUBLISH_STATE_PENDING; /* set state to indicate waiting on publish result - check for publish success on next run of this function */
-							stashed_entries.prev_ent_size =
-								ent_size; /* store entry size to increment index accordingly on next run of this function */
-
-							/* Send the data to AWS via work queue item */
-							k_work_submit(&aws_work.work); /* will eventually give sending_to_aws_sem */
-
-							k_work_submit(&send_stashed_entries_work); /* queue next run to send next stashed entry or finish sending stash */
-						} else {
-							LOG_WRN("Stash entry size exceeds buffer length %d + %d > %d.  Reset stash and continue...",
-								stashed_entries.idx, ent_size, stashed_entries.len);
-							ResetEntryStashInformation(true);
-						}
-					} else {
-						LOG_WRN("Stash Index greater than buffer length %d > %d. Reset stash and continue...",
-							stashed_entries.idx, stashed_entries.len);
-						ResetEntryStashInformation(true);
-					}
+					ct.aws_owner = sensor;
+					ct.aws_publish_state =
+						AWS_PUBLISH_STATE_PENDING; /* set state to indicate waiting on publish result - check for publish success on next run of this function */
+					sensor->stashed_entries.prev_ent_size =
+						consumed; /* store stash bytes sent to increment index accordingly on next run of this function */
+
+					/* Send the data to AWS via work queue item */
+					submit_aws_work(); /* will eventually give sending_to_aws_sem */
+
+					k_work_submit(&send_stashed_entries_work); /* queue next run to send next stashed entries or finish sending stash */
 				}
 			} else {
 				/* No entries seem to be stashed. Reset stash information. */
-				ResetEntryStashInformation(true);
+				ResetEntryStashInformation(sensor, true);
 			}
 		} else {
 			/* Clear stash info */
-			ResetEntryStashInformation(false);
+			for (i = 0; i < ARRAY_SIZE(sensors); i++) {
+				ResetEntryStashInformation(&sensors[i], false);
+			}
 		}
 	}
 }
 /* clang-format on */
 
-static void ResetEntryStashInformation(bool giveSemaphore)
-{
-	memset(stashed_entries.buffer, 0, sizeof(stashed_entries.buffer));
-	stashed_entries.len = 0;
-	stashed_entries.idx = 0;
-	stashed_entries.available = false;
-	stashed_entries.timeouts = 0;
-	stashed_entries.failure_cnt = 0;
-	stashed_entries.prev_ent_size = 0;
-	ct.aws_publish_state = AWS_PUBLISH_STATE_NONE;
+static void ResetEntryStashInformation(struct ct_sensor *sensor,
+				       bool giveSemaphore)
+{
+	memset(sensor->stashed_entries.buffer, 0,
+	       sizeof(sensor->stashed_entries.buffer));
+	sensor->stashed_entries.len = 0;
+	sensor->stashed_entries.idx = 0;
+	sensor->stashed_entries.available = false;
+	sensor->stashed_entries.timeouts = 0;
+	sensor->stashed_entries.failure_cnt = 0;
+	sensor->stashed_entries.prev_ent_size = 0;
+	if (ct.aws_owner == sensor) {
+		ct.aws_publish_state = AWS_PUBLISH_STATE_NONE;
+		ct.aws_owner = NULL;
+	}
 	ct.log_publishing = false;
 
 	if (giveSemaphore) {
@@ -2637,21 +3008,29 @@ static void ResetEntryStashInformation(bool giveSemaphore)
 	}
 }
 
-static void smp_xfer_timeout_handler(struct k_timer *dummy)
+static void smp_xfer_timeout_handler(struct k_timer *timer)
 {
+	struct ct_sensor *sensor =
+		CONTAINER_OF(timer, struct ct_sensor, smp_xfer_timeout_timer);
+
 	/* a timeout has occurred waiting for an SMP response from the sensor, disconnect */
-	if (remote.conn) {
+	if (sensor->conn) {
 		LOG_ERR("SMP timeout");
-		bt_conn_disconnect(remote.conn,
+		bt_conn_disconnect(sensor->conn,
 				   BT_HCI_ERR_REMOTE_USER_TERM_CONN);
 	}
 }
 
-static void set_ble_state(enum central_state state)
+static void set_ble_state(struct ct_sensor *sensor, enum central_state state)
 {
-	if (remote.app_state != state) {
-		remote.app_state = state;
-		attr_set_uint32(ATTR_ID_centralState, state);
+	/* The attribute follows the connections that are still in use */
+	bool others = (ct_ble_get_num_connected_sensors() > 0);
+
+	if (sensor->app_state != state) {
+		sensor->app_state = state;
+		if (state != CENTRAL_STATE_FINDING_DEVICE || !others) {
+			attr_set_uint32(ATTR_ID_centralState, state);
+		}
 	}
 
 	switch (state) {
@@ -2660,9 +3039,11 @@ static void set_ble_state(enum central_state state)
 		break;
 
 	case CENTRAL_STATE_FINDING_DEVICE:
-		lcz_led_blink(BLUETOOTH_PERIPHERAL_LED,
-			      &CT_LED_SENSOR_SEARCH_PATTERN);
-		attr_set_string(ATTR_ID_sensorBluetoothAddress, "", 0);
+		if (!others) {
+			lcz_led_blink(BLUETOOTH_PERIPHERAL_LED,
+				      &CT_LED_SENSOR_SEARCH_PATTERN);
+			attr_set_string(ATTR_ID_sensorBluetoothAddress, "", 0);
+		}
 		lcz_bt_scan_restart(ct.scan_id);
 		break;
 
@@ -2682,40 +3063,47 @@ static void ct_adv_watchdog_work_handler(struct k_work *work)
 	}
 }
 
-static bool ct_ble_remote_active_handler(void)
+static bool ct_ble_remote_active_handler(struct ct_sensor *sensor)
 {
 	/* Init to active in case there is no CT connection */
 	bool active = true;
 
-	if (remote.conn != NULL) {
-		if (!remote.log_ble_xfer_active) {
+	if (sensor->conn != NULL) {
+		if (!sensor->log_ble_xfer_active) {
 			active = false;
 		}
 	}
 
-	remote.log_ble_xfer_active = false;
+	sensor->log_ble_xfer_active = false;
 
 	return active;
 }
 
 static void ct_conn_inactivity_work_handler(struct k_work *work)
 {
+	struct ct_sensor *sensor;
+	size_t i;
+
 	/* If peripheral bt is connected but no data is being sent, then disconnect. */
-	if (!ct_ble_remote_active_handler()) {
-		remote.inactivity +=
+	for (i = 0; i < ARRAY_SIZE(sensors); i++) {
+		sensor = &sensors[i];
+		if (ct_ble_remote_active_handler(sensor)) {
+			sensor->inactivity = 0;
+			continue;
+		}
+
+		sensor->inactivity +=
 			CONFIG_CT_CONN_INACTIVITY_TICK_RATE_SECONDS;
-		if (remote.inactivity >=
+		if (sensor->inactivity >=
 		    CONFIG_CT_CONN_INACTIVITY_WATCHDOG_TIMEOUT) {
 			/* Depending on when the connection occurs, this timeout
 			 * could be 2 or 3 minutes
 			 */
 			LOG_WRN("Detected inactive BT link %d, disconnect",
-				remote.inactivity);
-			remote.inactivity = 0;
-			disconnect_sensor();
+				sensor->inactivity);
+			sensor->inactivity = 0;
+			disconnect_sensor(sensor);
 		}
-	} else {
-		remote.inactivity = 0;
 	}
 }
 
@@ -2866,76 +3254,170 @@ static uint32_t encrypt_cbc(uint8_t *data, uint32_t dataLen, uint8_t *encrypted,
 	}
 }
 
-static uint32_t decrypt_cbc(uint8_t *encrypted, uint32_t encrypted_data_len,
-			    uint8_t *decrypted, uint32_t decrypted_data_len_max,
-			    uint8_t *key, uint8_t key_size)
+static int begin_cbc_session(struct cipher_ctx *ctx, uint8_t *key,
+			     enum cipher_op op)
 {
-	int rc = 0;
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->keylen = ATTR_CT_AES_KEY_SIZE;
+	ctx->key.bit_stream = key;
+	ctx->flags = crypto_cap_flags;
 
-	if (crypto_dev == NULL) {
-		return rc;
+	return cipher_begin_session(crypto_dev, ctx, CRYPTO_CIPHER_ALGO_AES,
+				    CRYPTO_CIPHER_MODE_CBC, op);
+}
+
+/* The buffer holds the IV followed by the ciphertext. TinyCrypt decrypts
+ * each block before the plaintext of the previous block is written, so the
+ * plaintext can be written from the start of the same buffer.
+ */
+static uint32_t decrypt_cbc_in_place(struct cipher_ctx *ctx, uint8_t *buf,
+				     uint32_t len)
+{
+	if (len <= AES_CBC_IV_SIZE) {
+		return 0;
 	}
 
-	struct cipher_ctx ini = {
-		.keylen = key_size,
-		.key.bit_stream = key,
-		.flags = crypto_cap_flags,
-	};
+	/* max output len must be "input len - 16" */
 	struct cipher_pkt decrypt = {
-		.in_buf = encrypted,
-		.in_len = encrypted_data_len,
-		.out_buf = decrypted,
-		.out_buf_max = decrypted_data_len_max,
+		.in_buf = buf,
+		.in_len = len,
+		.out_buf = buf,
+		.out_buf_max = len - AES_CBC_IV_SIZE,
 	};
 
-	rc = cipher_begin_session(crypto_dev, &ini, CRYPTO_CIPHER_ALGO_AES,
-				  CRYPTO_CIPHER_MODE_CBC,
-				  CRYPTO_CIPHER_OP_DECRYPT);
-	if (rc) {
-		LOG_ERR("DECRYPT begin session - Failed");
-		return 0;
-	}
-
 	/* input data buffer must include IV at start */
-	bool success = true;
-	if (cipher_cbc_op(&ini, &decrypt, encrypted)) {
+	if (cipher_cbc_op(ctx, &decrypt, buf)) {
 		LOG_ERR("DECRYPT - Failed");
-		success = false;
-		decrypt.out_len = 0;
-	}
-
-	if (success) {
-		LOG_DBG("Decryption success. Output length: %d",
-			decrypt.out_len);
+		return 0;
 	}
 
-	cipher_free_session(crypto_dev, &ini);
+	LOG_VRB("Decryption success. Output length: %d", decrypt.out_len);
 
 	/* TinyCrypt does include IV size in out_len
 	 * (though it does not include IV bytes in the output buffer)
 	 */
-	if (success && (decrypt.out_len > AES_CBC_IV_SIZE)) {
+	if (decrypt.out_len > AES_CBC_IV_SIZE) {
 		return decrypt.out_len - AES_CBC_IV_SIZE;
 	} else {
 		return 0;
 	}
 }
 
+/* Decrypt a chunk of the log. The session is started with the first chunk
+ * and ended when the sensor is disconnected.
+ */
+static uint32_t decrypt_cbc(struct ct_sensor *sensor, uint8_t *buf,
+			    uint32_t len)
+{
+	if (crypto_dev == NULL) {
+		return 0;
+	}
+
+	if (!sensor->decrypt_open) {
+		memcpy(sensor->decrypt_key,
+		       attr_get_quasi_static(ATTR_ID_ctAesKey),
+		       sizeof(sensor->decrypt_key));
+		if (begin_cbc_session(&sensor->decrypt_ctx, sensor->decrypt_key,
+				      CRYPTO_CIPHER_OP_DECRYPT)) {
+			LOG_ERR("DECRYPT begin session - Failed");
+			return 0;
+		}
+		sensor->decrypt_open = true;
+	}
+
+	return decrypt_cbc_in_place(&sensor->decrypt_ctx, buf, len);
+}
+
+static void end_decrypt_session(struct ct_sensor *sensor)
+{
+	if (sensor->decrypt_open) {
+		cipher_free_session(crypto_dev, &sensor->decrypt_ctx);
+		sensor->decrypt_open = false;
+	}
+}
+
+#ifdef CONFIG_CT_CRYPTO_BENCHMARK
+int ct_ble_crypto_benchmark(uint32_t iterations, uint32_t *session_ns,
+			    uint32_t *reuse_ns)
+{
+	static uint8_t plain[(FS_MGMT_DL_CHUNK_SIZE / AES_CBC_IV_SIZE - 1) *
+			     AES_CBC_IV_SIZE];
+	static uint8_t encrypted[FS_MGMT_DL_CHUNK_SIZE];
+	static uint8_t work[FS_MGMT_DL_CHUNK_SIZE];
+	uint8_t key[ATTR_CT_AES_KEY_SIZE];
+	struct cipher_ctx ctx;
+	uint32_t len;
+	uint32_t start;
+	uint32_t i;
+
+	if (crypto_dev == NULL || iterations == 0) {
+		return -EINVAL;
+	}
+
+	memset(key, 0x5A, sizeof(key));
+	memset(plain, 0xA5, sizeof(plain));
+	len = encrypt_cbc(plain, sizeof(plain), encrypted, sizeof(encrypted),
+			  key, sizeof(key));
+	if (len == 0) {
+		return -EIO;
+	}
+
+	/* A session for each chunk */
+	start = k_cycle_get_32();
+	for (i = 0; i < iterations; i++) {
+		memcpy(work, encrypted, len);
+		if (begin_cbc_session(&ctx, key, CRYPTO_CIPHER_OP_DECRYPT)) {
+			return -EIO;
+		}
+		decrypt_cbc_in_place(&ctx, work, len);
+		cipher_free_session(crypto_dev, &ctx);
+	}
+	*session_ns = k_cyc_to_ns_floor64(k_cycle_get_32() - start) /
+		      iterations;
+
+	/* One session for all chunks */
+	if (begin_cbc_session(&ctx, key, CRYPTO_CIPHER_OP_DECRYPT)) {
+		return -EIO;
+	}
+	start = k_cycle_get_32();
+	for (i = 0; i < iterations; i++) {
+		memcpy(work, encrypted, len);
+		decrypt_cbc_in_place(&ctx, work, len);
+	}
+	*reuse_ns = k_cyc_to_ns_floor64(k_cycle_get_32() - start) /
+		    iterations;
+	cipher_free_session(crypto_dev, &ctx);
+
+	return 0;
+}
+#endif
+
 static void aws_work_handler(struct k_work *item)
 {
 	ARG_UNUSED(item);
 
 	/* If not connected to AWS, set state to fail so entry is stashed. */
 	if (!awsConnected()) {
-		disconnect_sensor();
+		/* The owner is cleared if its stash was reset meanwhile */
+		if (ct.aws_owner != NULL) {
+			disconnect_sensor(ct.aws_owner);
+		}
 		ct.aws_publish_state = AWS_PUBLISH_STATE_FAIL;
 	} else {
 #if defined(CONFIG_CT_AWS_PUBLISH_ENTRIES)
 		/* perform the AWS send in system context */
 		int rc = awsSendBinData(aws_work.buf, aws_work.buf_len,
 					ct.up_topic);
+		if (rc == -EAGAIN && aws_work.retries < AWS_SEND_MAX_RETRIES) {
+			/* The MQTT in-flight window is full */
+			aws_work.retries += 1;
+			k_work_schedule(&aws_work.work, AWS_SEND_RETRY_DELAY);
+			return;
+		}
 		if (rc != 0) {
-			disconnect_sensor();
+			if (ct.aws_owner != NULL) {
+				disconnect_sensor(ct.aws_owner);
+			}
 			ct.aws_publish_state = AWS_PUBLISH_STATE_FAIL;
 		} else {
 			ct.aws_publish_state = AWS_PUBLISH_STATE_SUCCESS;
@@ -2945,3 +3427,281 @@ static void aws_work_handler(struct k_work *item)
 
 	k_sem_give(&sending_to_aws_sem);
 }
+
+static void submit_aws_work(void)
+{
+	aws_work.retries = 0;
+	k_work_schedule(&aws_work.work, K_NO_WAIT);
+}
+
+/* Build a publish from as many of the length prefixed entries in src as fit
+ * in the AWS buffer and the batch limit. Returns the number of bytes of src
+ * that were used.
+ */
+static size_t load_aws_work(const struct ct_publish_header_t *hdr,
+			    const uint8_t *src, size_t len)
+{
+	struct ct_publish_header_t *pub_hdr =
+		(struct ct_publish_header_t *)aws_work.buf;
+	size_t offset = 0;
+	uint16_t count = 0;
+	uint16_t size;
+
+	memcpy(pub_hdr, hdr, sizeof(struct ct_publish_header_t));
+	pub_hdr->device_time = lcz_qrtc_get_epoch();
+	aws_work.buf_len = sizeof(struct ct_publish_header_t);
+#if CT_AWS_BATCH_ENABLED
+	pub_hdr->entry_protocol_version |= LOG_ENTRY_PROTOCOL_BATCH;
+#endif
+
+	while (count < CONFIG_CT_AWS_BATCH_MAX_ENTRIES &&
+	       (offset + sizeof(size)) < len) {
+		memcpy(&size, &src[offset], sizeof(size));
+		if (size > LOG_ENTRY_MAX_SIZE ||
+		    (offset + sizeof(size) + size) > len ||
+		    src[offset + sizeof(size)] != LOG_ENTRY_START_BYTE) {
+			LOG_ERR("Invalid entry (%d bytes) at %d", size, offset);
+			break;
+		}
+
+		if ((aws_work.buf_len + CT_AWS_BATCH_PREFIX_SIZE + size) >
+		    sizeof(aws_work.buf)) {
+			break;
+		}
+
+#if CT_AWS_BATCH_ENABLED
+		memcpy(&aws_work.buf[aws_work.buf_len], &size, sizeof(size));
+		aws_work.buf_len += sizeof(size);
+#endif
+		memcpy(&aws_work.buf[aws_work.buf_len],
+		       &src[offset + sizeof(size)], size);
+		aws_work.buf_len += size;
+		offset += sizeof(size) + size;
+		count++;
+	}
+
+	return offset;
+}
+
+/* Append length prefixed entries to the stash. The publish header is saved
+ * ahead of the first entry.
+ */
+static bool stash_entries(struct ct_sensor *sensor,
+			  const struct ct_publish_header_t *hdr,
+			  const uint8_t *src, size_t len)
+{
+	if (sensor->stashed_entries.len == 0) {
+		memcpy(sensor->stashed_entries.buffer, hdr,
+		       sizeof(struct ct_publish_header_t));
+		sensor->stashed_entries.len =
+			sizeof(struct ct_publish_header_t);
+		sensor->stashed_entries.idx =
+			sizeof(struct ct_publish_header_t);
+	}
+
+	if ((sensor->stashed_entries.len + len) >
+	    sizeof(sensor->stashed_entries.buffer)) {
+		LOG_ERR("No space left in entry stash, "
+			"have to discard entries");
+		return false;
+	}
+
+	memcpy(&sensor->stashed_entries.buffer[sensor->stashed_entries.len],
+	       src, len);
+	sensor->stashed_entries.len += len;
+	return true;
+}
+
+/* Entries are stashed before they are published. They are dropped from the
+ * end of the stash once the publish succeeds. Otherwise the stash is marked
+ * for sending after the sensor disconnects. The publish may belong to any
+ * of the connected sensors.
+ */
+static void settle_aws_publish(void)
+{
+	struct ct_sensor *sensor = ct.aws_owner;
+
+	if (sensor != NULL) {
+		if (ct.aws_publish_state == AWS_PUBLISH_STATE_SUCCESS) {
+			sensor->stashed_entries.len -=
+				sensor->stashed_entries.prev_ent_size;
+		} else if (ct.aws_publish_state != AWS_PUBLISH_STATE_NONE) {
+			LOG_DBG("Stash %d bytes of entries",
+				sensor->stashed_entries.prev_ent_size);
+			sensor->stashed_entries.available = true;
+		}
+
+		sensor->stashed_entries.prev_ent_size = 0;
+	}
+
+	ct.aws_publish_state = AWS_PUBLISH_STATE_NONE;
+	ct.aws_owner = NULL;
+}
+
+static void aws_batch_add(struct ct_sensor *sensor, const uint8_t *entry,
+			  uint16_t size)
+{
+	const struct ct_log_header_v2 *log_hdr =
+		&sensor->dfu_smp_c.ct_log_header;
+
+	if (size == 0 ||
+	    (sizeof(size) + size) > sizeof(sensor->aws_batch.buf)) {
+		LOG_DBG("skipping AWS publish, entry too large for buffer");
+		return;
+	}
+
+	k_mutex_lock(&sensor->aws_batch.mutex, K_FOREVER);
+
+	if ((sensor->aws_batch.len + sizeof(size) + size) >
+	    sizeof(sensor->aws_batch.buf)) {
+		aws_batch_send(sensor);
+	}
+
+	if (sensor->aws_batch.count == 0) {
+		sensor->aws_batch.hdr.entry_protocol_version =
+			log_hdr->entry_protocol_version;
+		memcpy(sensor->aws_batch.hdr.device_id,
+		       log_hdr->device_id, BT_MAC_ADDR_LEN);
+		sensor->aws_batch.hdr.device_time = 0;
+		sensor->aws_batch.hdr.last_upload_time =
+			log_hdr->last_upload_time;
+		memcpy(sensor->aws_batch.hdr.fw_version,
+		       log_hdr->local_info.fw_version,
+		       sizeof(sensor->aws_batch.hdr.fw_version));
+		sensor->aws_batch.hdr.battery_level =
+			log_hdr->local_info.battery_level;
+		sensor->aws_batch.hdr.network_id =
+			log_hdr->local_info.network_id;
+
+		if (CONFIG_CT_AWS_BATCH_LATENCY_MS != 0) {
+			k_work_schedule(&sensor->aws_batch.flush_work,
+					K_MSEC(CONFIG_CT_AWS_BATCH_LATENCY_MS));
+		}
+	}
+
+	memcpy(&sensor->aws_batch.buf[sensor->aws_batch.len], &size,
+	       sizeof(size));
+	memcpy(&sensor->aws_batch.buf[sensor->aws_batch.len + sizeof(size)],
+	       entry, size);
+	sensor->aws_batch.len += sizeof(size) + size;
+	sensor->aws_batch.count++;
+
+	if (sensor->aws_batch.count >= CONFIG_CT_AWS_BATCH_MAX_ENTRIES) {
+		aws_batch_send(sensor);
+	}
+
+	k_mutex_unlock(&sensor->aws_batch.mutex);
+}
+
+/* Caller must hold the batch mutex */
+static int aws_batch_flush(struct ct_sensor *sensor, k_timeout_t timeout)
+{
+	size_t consumed;
+
+	if (sensor->aws_batch.count == 0) {
+		return 0;
+	}
+
+	if (k_sem_take(&sending_to_aws_sem, timeout) != 0) {
+		return -EAGAIN;
+	}
+
+	settle_aws_publish();
+
+	consumed = load_aws_work(&sensor->aws_batch.hdr, sensor->aws_batch.buf,
+				 sensor->aws_batch.len);
+	if (consumed != sensor->aws_batch.len) {
+		LOG_ERR("Dropped %d bytes of entries",
+			sensor->aws_batch.len - consumed);
+	}
+
+	/* Preemptively put in stash. If publish is successful, remove it. */
+	if (stash_entries(sensor, &sensor->aws_batch.hdr, sensor->aws_batch.buf,
+			  consumed)) {
+		sensor->stashed_entries.prev_ent_size = consumed;
+	}
+
+	LOG_VRB(">> %d %d %d", sensor->aws_batch.count, aws_work.buf_len,
+		sizeof(aws_work.buf));
+
+	sensor->aws_batch.len = 0;
+	sensor->aws_batch.count = 0;
+	k_work_cancel_delayable(&sensor->aws_batch.flush_work);
+
+	ct.aws_owner = sensor;
+	ct.aws_publish_state = AWS_PUBLISH_STATE_PENDING;
+	submit_aws_work();
+	return 0;
+}
+
+/* Caller must hold the batch mutex */
+static void aws_batch_send(struct ct_sensor *sensor)
+{
+	if (aws_batch_flush(sensor, SEND_TO_AWS_TIMEOUT_TICKS) == 0) {
+		return;
+	}
+
+	LOG_ERR("ble->aws pub timeout");
+	aws_batch_stash(sensor);
+	disconnect_sensor(sensor);
+}
+
+/* Caller must hold the batch mutex */
+static void aws_batch_stash(struct ct_sensor *sensor)
+{
+	/* The publish in progress is treated as failed so that the batch
+	 * can be stashed behind it and sent after the disconnect.
+	 */
+	settle_aws_publish();
+	stash_entries(sensor, &sensor->aws_batch.hdr, sensor->aws_batch.buf,
+		      sensor->aws_batch.len);
+	sensor->stashed_entries.available = true;
+	sensor->aws_batch.len = 0;
+	sensor->aws_batch.count = 0;
+	k_work_cancel_delayable(&sensor->aws_batch.flush_work);
+}
+
+/* Publish the rest of the batch and wait for the result so that the stash
+ * is settled before it is sent on its own.
+ */
+static void aws_batch_finish(struct ct_sensor *sensor)
+{
+	k_mutex_lock(&sensor->aws_batch.mutex, K_FOREVER);
+
+	aws_batch_send(sensor);
+
+	if (k_sem_take(&sending_to_aws_sem, SEND_TO_AWS_TIMEOUT_TICKS) != 0) {
+		LOG_ERR("ble->aws pub timeout");
+		/* If publish times out, it must have failed. */
+		ct.aws_publish_state = AWS_PUBLISH_STATE_FAIL;
+		settle_aws_publish();
+	} else {
+		settle_aws_publish();
+		k_sem_give(&sending_to_aws_sem);
+	}
+
+	k_mutex_unlock(&sensor->aws_batch.mutex);
+}
+
+static void aws_batch_flush_work_handler(struct k_work *work)
+{
+	struct ct_sensor *sensor =
+		CONTAINER_OF(k_work_delayable_from_work(work), struct ct_sensor,
+			     aws_batch.flush_work);
+
+	/* The download thread may be waiting for a publish that is queued
+	 * behind this work item, so don't block.
+	 */
+	if (k_mutex_lock(&sensor->aws_batch.mutex, K_NO_WAIT) != 0) {
+		k_work_reschedule(&sensor->aws_batch.flush_work,
+				  AWS_BATCH_RETRY_TICKS);
+		return;
+	}
+
+	if (aws_batch_flush(sensor, K_NO_WAIT) != 0) {
+		k_work_reschedule(&sensor->aws_batch.flush_work,
+				  AWS_BATCH_RETRY_TICKS);
+	}
+
+	k_mutex_unlock(&sensor->aws_batch.mutex);
+}
@@ -11,6 +11,7 @@
 /* Includes                                                                   */
 /******************************************************************************/
 #include <shell/shell.h>
+#include <stdlib.h>
 
 #include "lcz_bt_scan.h"
 #include "ct_ble.h"
@@ -37,10 +38,17 @@ static int print_status_cmd(const struct shell *shell, size_t argc, char **argv)
 	bool isPublishing = ct_ble_is_publishing_log();
 	bool logTransferActiveFlag = ct_ble_get_log_transfer_active_flag();
 	bool connectedToSensor = ct_ble_is_connected_to_sensor();
+	uint32_t connectedSensors = ct_ble_get_num_connected_sensors();
 	bool connectedToCentral = ct_ble_is_connected_to_central();
 	uint32_t numConns = ct_ble_get_num_connections();
 	uint32_t numDl = ct_ble_get_num_ct_dl_starts();
 	uint32_t numDlComplete = ct_ble_get_num_download_completes();
+	uint32_t lastDlTime = ct_ble_get_last_download_time();
+	uint32_t lastDlSize = ct_ble_get_last_download_size();
+	uint32_t avgDlTime = ct_ble_get_avg_download_time();
+	struct ct_ble_link_stats link;
+
+	ct_ble_get_link_stats(&link);
 
 	shell_print(shell,
 		    "Scanning: %d, starts: %d, stops: %d, ads: %d, ct-ads: %d",
@@ -50,11 +58,48 @@ static int print_status_cmd(const struct shell *shell, size_t argc, char **argv)
 	shell_print(shell, "Log transfer flag %d", logTransferActiveFlag);
 	shell_print(shell, "Connected to ct sensor: %d, %d, %d, %d",
 		    connectedToSensor, numConns, numDl, numDlComplete);
+	shell_print(shell, "Connected ct sensors: %u of %u", connectedSensors,
+		    CONFIG_CT_SENSOR_CONNECTIONS);
+	shell_print(shell,
+		    "Last download: %u ms, %u bytes, average download: %u ms",
+		    lastDlTime, lastDlSize, avgDlTime);
+	shell_print(shell,
+		    "Sensor link PHY TX: %u, RX: %u, data length: %u, "
+		    "interval: %u us, MTU: %u, throughput: %u B/s",
+		    link.tx_phy, link.rx_phy, link.rx_max_len,
+		    link.interval * 1250, link.mtu, link.throughput);
 	shell_print(shell, "Connected to central: %d", connectedToCentral);
 
 	return 0;
 }
 
+#ifdef CONFIG_CT_CRYPTO_BENCHMARK
+static int crypto_bench_cmd(const struct shell *shell, size_t argc,
+			    char **argv)
+{
+	uint32_t iterations = 100;
+	uint32_t sessionNs;
+	uint32_t reuseNs;
+	int r;
+
+	if (argc > 1) {
+		iterations = strtoul(argv[1], NULL, 0);
+	}
+
+	r = ct_ble_crypto_benchmark(iterations, &sessionNs, &reuseNs);
+	if (r < 0) {
+		shell_error(shell, "Benchmark failed (%d)", r);
+		return r;
+	}
+
+	shell_print(shell,
+		    "Chunk decrypt: %u ns with a session per chunk, "
+		    "%u ns with one session (%u iterations)",
+		    sessionNs, reuseNs, iterations);
+	return 0;
+}
+#endif
+
 /******************************************************************************/
 /* Shell                                                                      */
 /******************************************************************************/
@@ -62,6 +107,10 @@ SHELL_STATIC_SUBCMD_SET_CREATE(
 	ct_cmds, SHELL_CMD(gettime, NULL, "Get current time", get_time_cmd),
 	SHELL_CMD(status, NULL, "Print operating status info",
 		  print_status_cmd),
+#ifdef CONFIG_CT_CRYPTO_BENCHMARK
+	SHELL_CMD(crypto_bench, NULL,
+		  "Time log chunk decryption [iterations]", crypto_bench_cmd),
+#endif
 	SHELL_SUBCMD_SET_END);
 
 SHELL_CMD_REGISTER(ct, &ct_cmds, "Contact tracing commands", NULL);
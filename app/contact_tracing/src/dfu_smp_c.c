@@ -135,21 +135,28 @@ uint8_t bt_gatt_dfu_smp_c_notify(struct bt_conn *conn,
 			/* if there are more bytes in the download or if in the authentication
 			 * states, update the offset and send the next request.
 			 */
-			if (ct_ble_is_not_downloading_logs() ||
-			    (dfu_smp_c->file_size == 0 ||
-			     (dfu_smp_c->file_size > 0 &&
-			      new_off < dfu_smp_c->file_size))) {
-				int32_t success =
-					ct_ble_send_next_smp_request(new_off);
-				if (!success) {
-					/* Next command could not be sent due to error. Disconnect. */
-					bt_conn_disconnect(
-						conn,
-						BT_HCI_ERR_REMOTE_USER_TERM_CONN);
-					LOG_VRB("disconnecting...\n");
-					return BT_GATT_ITER_STOP;
-				}
-			} else {
+			bool more = (!ct_ble_is_downloading_log(dfu_smp_c) ||
+				     (dfu_smp_c->file_size == 0 ||
+				      (dfu_smp_c->file_size > 0 &&
+				       new_off < dfu_smp_c->file_size)));
+			bool success = true;
+
+			if (more) {
+				success = ct_ble_send_next_smp_request(
+					dfu_smp_c, new_off);
+			}
+
+			/* The entries in this response are parsed while the
+			 * sensor sends the next one.
+			 */
+			if (ct_ble_process_log_data(dfu_smp_c) != 0) {
+				success = false;
+			}
+
+			if (!more || !success) {
+				/* Download is complete or the next command could
+				 * not be sent due to error. Disconnect.
+				 */
 				bt_conn_disconnect(
 					conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
 				LOG_VRB("disconnecting...\n");
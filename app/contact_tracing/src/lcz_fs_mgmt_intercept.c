@@ -26,6 +26,9 @@ LOG_MODULE_REGISTER(ct_fs_intercept, CONFIG_CT_FS_INTERCEPT_LOG_LEVEL);
 #include "attr.h"
 #include "file_system_utilities.h"
 #include "ct_ble.h"
+#ifdef CONFIG_SD_CARD_LOG
+#include "sdcard_log.h"
+#endif
 
 #include "lcz_fs_mgmt_intercept.h"
 
@@ -79,6 +82,11 @@ static const smp_to_nv_map_t SMP_TO_NV_MAP[] = {
 	{ .smp_file_path = "/nv/aes_key.bin", .map_fn = smp_nv_mapper_aes_key },
 };
 
+#ifdef CONFIG_SD_CARD_LOG
+/* The length is only sent with the first chunk of an upload */
+static unsigned long long upload_len;
+#endif
+
 /******************************************************************************/
 /* Global Function Definitions                                                */
 /******************************************************************************/
@@ -106,6 +114,18 @@ int fs_mgmt_impl_app_intercept(char *file_name, fs_mgmt_ctxt_t *fs_mgmt_ctxt,
 	} else {
 		/* Write the data chunk to the file. */
 		rc = fs_mgmt_impl_write(file_name, off, file_data, data_len);
+
+#ifdef CONFIG_SD_CARD_LOG
+		/* A log file on the SD card is indexed when it is created and
+		 * when the upload is complete.
+		 */
+		if (off == 0) {
+			upload_len = len;
+		}
+		if (rc == 0 && (off == 0 || (off + data_len) >= upload_len)) {
+			sdCardLogIndexUpdate(file_name);
+		}
+#endif
 	}
 
 	return rc;
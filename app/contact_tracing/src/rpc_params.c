@@ -41,29 +41,36 @@ static uint8_t rpc_param_buf[CONFIG_RPC_PARAMS_BUF_MAX_SIZE];
 /******************************************************************************/
 /* Local Function Prototypes                                                  */
 /******************************************************************************/
-static int rpc_params_parse(void);
-static int rpc_parse(int location);
+static int rpc_params_parse(const struct jsmn_context *ctx,
+			    struct jsmn_cursor *cursor);
+static int rpc_parse(const struct jsmn_context *ctx, struct jsmn_cursor *cursor,
+		     int location);
 
 /******************************************************************************/
 /* Global Function Definitions                                                */
 /******************************************************************************/
-void rpc_params_gateway_parser(bool get_accepted_topic)
+void rpc_params_gateway_parser(const struct jsmn_context *ctx,
+			       bool get_accepted_topic)
 {
+	struct jsmn_cursor rpc;
+	struct jsmn_cursor *cursor = &rpc;
+	struct jsmn_cursor saved;
 	int location;
 
-	jsmn_reset_index();
+	jsmn_reset_index(cursor);
 
-	jsmn_find_type("state", JSMN_OBJECT, NEXT_PARENT);
+	jsmn_find_type(ctx, cursor, "state", JSMN_OBJECT, NEXT_PARENT);
 	if (get_accepted_topic) {
 		/* get an outstanding command (not the last command ['reported']) */
-		jsmn_find_type("desired", JSMN_OBJECT, NEXT_PARENT);
+		jsmn_find_type(ctx, cursor, "desired", JSMN_OBJECT,
+			       NEXT_PARENT);
 	}
-	jsmn_find_type("rpc", JSMN_OBJECT, NEXT_PARENT);
-	jsmn_save_index();
-	location = jsmn_find_type("m", JSMN_STRING, NEXT_PARENT);
-	if (jsmn_index() != 0) {
-		jsmn_restore_index();
-		rpc_parse(location);
+	jsmn_find_type(ctx, cursor, "rpc", JSMN_OBJECT, NEXT_PARENT);
+	saved = *cursor;
+	location = jsmn_find_type(ctx, cursor, "m", JSMN_STRING, NEXT_PARENT);
+	if (jsmn_index(cursor) != 0) {
+		*cursor = saved;
+		rpc_parse(ctx, cursor, location);
 	}
 }
 
@@ -87,18 +94,19 @@ void rpc_params_clear_method(void)
 /******************************************************************************/
 
 /*
- * Parse the RPC params from the module global JSON contents
- * currently being processed.
+ * Parse the RPC params from the JSON contents currently being processed.
  */
-static int rpc_params_parse(void)
+static int rpc_params_parse(const struct jsmn_context *ctx,
+			    struct jsmn_cursor *cursor)
 {
+	struct jsmn_cursor saved;
 	int r = 0;
 	int location = 0;
 
 	memset(rpc_param_buf, 0, sizeof(rpc_param_buf));
 
-	jsmn_find_type("p", JSMN_OBJECT, NEXT_PARENT);
-	jsmn_save_index();
+	jsmn_find_type(ctx, cursor, "p", JSMN_OBJECT, NEXT_PARENT);
+	saved = *cursor;
 
 	do {
 		/* log_get */
@@ -107,11 +115,11 @@ static int rpc_params_parse(void)
 				(rpc_params_log_get_t *)rpc_param_buf;
 
 			/* filename */
-			jsmn_restore_index();
-			location =
-				jsmn_find_type("f", JSMN_STRING, NEXT_PARENT);
+			*cursor = saved;
+			location = jsmn_find_type(ctx, cursor, "f", JSMN_STRING,
+						  NEXT_PARENT);
 			if (location > 0) {
-				JSMN_STRNCPY(params->filename, location);
+				JSMN_STRNCPY(params->filename, ctx, location);
 			} else {
 				LOG_ERR("Invalid filename");
 				r = -1;
@@ -119,11 +127,11 @@ static int rpc_params_parse(void)
 			}
 
 			/* whence */
-			jsmn_restore_index();
-			location =
-				jsmn_find_type("w", JSMN_STRING, NEXT_PARENT);
+			*cursor = saved;
+			location = jsmn_find_type(ctx, cursor, "w", JSMN_STRING,
+						  NEXT_PARENT);
 			if (location > 0) {
-				JSMN_STRNCPY(params->whence, location);
+				JSMN_STRNCPY(params->whence, ctx, location);
 			} else {
 				LOG_ERR("Invalid whence");
 				r = -1;
@@ -131,11 +139,12 @@ static int rpc_params_parse(void)
 			}
 
 			/* offset */
-			jsmn_restore_index();
-			location = jsmn_find_type("o", JSMN_PRIMITIVE,
-						  NEXT_PARENT);
+			*cursor = saved;
+			location = jsmn_find_type(ctx, cursor, "o",
+						  JSMN_PRIMITIVE, NEXT_PARENT);
 			if (location > 0) {
-				params->offset = jsmn_convert_uint(location);
+				params->offset = jsmn_convert_uint(ctx,
+								   location);
 			} else {
 				LOG_ERR("Invalid offset");
 				r = -1;
@@ -143,11 +152,12 @@ static int rpc_params_parse(void)
 			}
 
 			/* length */
-			jsmn_restore_index();
-			location = jsmn_find_type("l", JSMN_PRIMITIVE,
-						  NEXT_PARENT);
+			*cursor = saved;
+			location = jsmn_find_type(ctx, cursor, "l",
+						  JSMN_PRIMITIVE, NEXT_PARENT);
 			if (location > 0) {
-				params->length = jsmn_convert_uint(location);
+				params->length = jsmn_convert_uint(ctx,
+								   location);
 			} else {
 				LOG_ERR("Invalid length");
 				r = -1;
@@ -176,10 +186,10 @@ static int rpc_params_parse(void)
 				(rpc_params_exec_t *)rpc_param_buf;
 
 			/* cmd */
-			location =
-				jsmn_find_type("c", JSMN_STRING, NEXT_PARENT);
+			location = jsmn_find_type(ctx, cursor, "c", JSMN_STRING,
+						  NEXT_PARENT);
 			if (location > 0) {
-				JSMN_STRNCPY(params->cmd, location);
+				JSMN_STRNCPY(params->cmd, ctx, location);
 			} else {
 				LOG_ERR("Unable to find command");
 				r = -1;
@@ -206,18 +216,18 @@ static int rpc_params_parse(void)
 }
 
 /*
- * Parse the RPC method from the module global JSON contents
- * currently being processed.
+ * Parse the RPC method from the JSON contents currently being processed.
  */
-static int rpc_parse(int location)
+static int rpc_parse(const struct jsmn_context *ctx, struct jsmn_cursor *cursor,
+		     int location)
 {
 	int r = -EPERM;
 
-	if (jsmn_strlen(location) < sizeof(rpc_method)) {
+	if (jsmn_strlen(ctx, location) < sizeof(rpc_method)) {
 		rpc_params_clear_method();
-		JSMN_STRNCPY(rpc_method, location);
+		JSMN_STRNCPY(rpc_method, ctx, location);
 		LOG_DBG("rpc.m: %s", log_strdup(rpc_method));
-		r = rpc_params_parse();
+		r = rpc_params_parse(ctx, cursor);
 		if (r < 0) {
 			LOG_ERR("Unable to parse RPC command");
 			rpc_params_clear_method();
@@ -28,6 +28,7 @@ enum FwkMsgCodeEnum {
 	 */
 	FMC_ADV = FMC_APPLICATION_SPECIFIC_START,
 	FMC_SENSOR_PUBLISH,
+	FMC_SENSOR_REPUBLISH,
 	FMC_ESS_SENSOR_EVENT,
 	FMC_GATEWAY_OUT,
 	FMC_SENSOR_TICK,
@@ -44,6 +45,8 @@ enum FwkMsgCodeEnum {
 	FMC_SUBSCRIBE_ACK,
 	FMC_SENSOR_SHADOW_INIT,
 	FMC_AWS_HEARTBEAT,
+	FMC_AWS_BATCH_TIMEOUT,
+	FMC_AWS_JOURNAL_DRAIN,
 	FMC_AWS_DECOMMISSION,
 
 	FMC_AWS_CONNECTED,
@@ -59,6 +62,7 @@ enum FwkMsgCodeEnum {
 	FMC_NETWORK_DISCONNECTED,
 	FMC_CLOUD_CONNECTED,
 	FMC_CLOUD_DISCONNECTED,
+	FMC_GATEWAY_FSM_EVENT,
 
 	/* Last value (DO NOT DELETE) */
 	NUMBER_OF_FRAMEWORK_MSG_CODES
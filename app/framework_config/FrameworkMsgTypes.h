@@ -36,15 +36,6 @@ typedef struct Ad {
 	uint8_t data[CONFIG_SENSOR_MAX_AD_SIZE];
 } Ad_t;
 
-typedef struct AdvMsg {
-	FwkMsgHeader_t header;
-	bt_addr_le_t addr;
-	int8_t rssi;
-	uint8_t type;
-	Ad_t ad;
-} AdvMsg_t;
-CHECK_FWK_MSG_SIZE(AdvMsg_t);
-
 typedef struct ESSSensorMsg {
 	FwkMsgHeader_t header;
 	float temperatureC; /* xx.xxC format */
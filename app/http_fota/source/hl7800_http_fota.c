@@ -19,6 +19,9 @@ LOG_MODULE_REGISTER(hl7800_http_fota, CONFIG_HTTP_FOTA_TASK_LOG_LEVEL);
 #include <net/fota_download.h>
 
 #include "file_system_utilities.h"
+#ifdef CONFIG_FOTA_STREAMING_HASH
+#include "fota_hash.h"
+#endif
 #include "http_fota_task.h"
 #include "laird_utility_macros.h"
 
@@ -39,6 +42,10 @@ static fota_download_callback_t hl7800_fota_callback = NULL;
 static uint8_t hl7800_update_expected_hash[FSU_HASH_SIZE];
 static uint8_t hl7800_update_file_hash[FSU_HASH_SIZE];
 static char hl7800_update_abs_path[FSU_MAX_ABS_PATH_SIZE];
+#ifdef CONFIG_FOTA_STREAMING_HASH
+/* The offset isn't kept over a reset so the hash state isn't saved */
+static struct fota_hash hl7800_hash;
+#endif
 
 /******************************************************************************/
 /* Local Function Prototypes                                                  */
@@ -108,6 +115,13 @@ int hl7800_download_start(fota_context_t *pCtx, const char *host,
 		if (fsu_delete(CONFIG_FOTA_FS_MOUNT, pCtx->file_path) < 0) {
 			LOG_INF("HL7800 Firmware Update File Doesn't Exist");
 		}
+#ifdef CONFIG_FOTA_STREAMING_HASH
+		(void)fsu_build_full_name(hl7800_update_abs_path,
+					  sizeof(hl7800_update_abs_path),
+					  CONFIG_FOTA_FS_MOUNT,
+					  pCtx->file_path);
+		(void)fota_hash_start(&hl7800_hash, hl7800_update_abs_path, 0);
+#endif
 	}
 	err = download_client_start(&hl7800_dlc, file, hl7800_file_offset);
 	if (err != 0) {
@@ -136,10 +150,19 @@ int hl7800_initiate_modem_update(fota_context_t *pCtx)
 		memset(hl7800_update_expected_hash, 0, FSU_HASH_SIZE);
 		memset(hl7800_update_file_hash, 0, FSU_HASH_SIZE);
 
-		LOG_DBG("Computing hash for %s", log_strdup(pCtx->file_path));
-		sha_r = fsu_sha256(hl7800_update_file_hash,
-				   CONFIG_FOTA_FS_MOUNT, pCtx->file_path,
-				   file_size);
+		sha_r = -ENOENT;
+#ifdef CONFIG_FOTA_STREAMING_HASH
+		/* The hash was computed while the file was downloaded */
+		sha_r = fota_hash_finish(&hl7800_hash, hl7800_update_file_hash,
+					 file_size);
+#endif
+		if (sha_r < 0) {
+			LOG_DBG("Computing hash for %s",
+				log_strdup(pCtx->file_path));
+			sha_r = fsu_sha256(hl7800_update_file_hash,
+					   CONFIG_FOTA_FS_MOUNT,
+					   pCtx->file_path, file_size);
+		}
 
 		/* only attempt to compare hash values if we were able to compute a hash on the file */
 		if (sha_r == 0) {
@@ -209,6 +232,10 @@ hl7800_download_client_callback(const struct download_client_evt *event)
 			return err;
 		} else {
 			hl7800_file_offset += event->fragment.len;
+#ifdef CONFIG_FOTA_STREAMING_HASH
+			fota_hash_update(&hl7800_hash, event->fragment.buf,
+					 event->fragment.len);
+#endif
 		}
 #ifdef CONFIG_FOTA_DOWNLOAD_PROGRESS_EVT
 		if (file_size == 0) {
@@ -590,7 +590,12 @@ static void fota_shadow_handler(void)
 		LOG_DBG("Update FOTA shadow");
 		rc = awsSendData(msg, GATEWAY_TOPIC);
 #endif
-		if (rc < 0) {
+		/* The request remains set and is retried when the
+		 * in-flight window is full.
+		 */
+		if (rc == -EAGAIN) {
+			LOG_DBG("FOTA state deferred");
+		} else if (rc < 0) {
 			LOG_ERR("Could not send FOTA state to AWS");
 		} else {
 			fota_shadow.json_update_request = false;
@@ -632,7 +637,7 @@ static int fota_null_desired_handler(const char *name)
 	rc = awsSendData(msg, GATEWAY_TOPIC);
 #endif
 
-	if (rc < 0) {
+	if (rc < 0 && rc != -EAGAIN) {
 		LOG_ERR("Could not set FOTA %s desired to null",
 			log_strdup(name));
 	}
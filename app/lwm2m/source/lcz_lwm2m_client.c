@@ -37,6 +37,7 @@ LOG_MODULE_REGISTER(lwm2m_client, CONFIG_LCZ_LWM2M_LOG_LEVEL);
 #include "lcz_lwm2m_client.h"
 #include "lcz_lwm2m_fw_update.h"
 #include "lcz_lwm2m_conn_mon.h"
+#include "gateway_fsm.h"
 
 /******************************************************************************/
 /* Local Constant, Macro and Type Definitions                                 */
@@ -594,6 +595,8 @@ static void rd_client_event(struct lwm2m_ctx *client,
 		lw.connected = false;
 		break;
 	}
+
+	gateway_fsm_event();
 }
 
 static int led_on_off_cb(uint16_t obj_inst_id, uint16_t res_id,
@@ -25,6 +25,11 @@ LOG_MODULE_REGISTER(lwm2m_fw_update, CONFIG_LCZ_LWM2M_FW_UPDATE_LOG_LEVEL);
 #include <sys/reboot.h>
 
 #include "lcz_lwm2m_fw_update.h"
+#ifdef CONFIG_LCZ_LWM2M_FW_UPDATE_RESUME
+#include <sys/crc.h>
+#include <storage/flash_map.h>
+#include "fota_hash.h"
+#endif
 
 /******************************************************************************/
 /* Local Constant, Macro and Type Definitions                                 */
@@ -33,6 +38,27 @@ LOG_MODULE_REGISTER(lwm2m_fw_update, CONFIG_LCZ_LWM2M_FW_UPDATE_LOG_LEVEL);
 #define REBOOT_DELAY_SECONDS 10
 #define REBOOT_DELAY K_SECONDS(REBOOT_DELAY_SECONDS)
 
+/* A page that is written to the DFU target must not leave data in the
+ * MCUboot buffer.  Otherwise the committed offset isn't on flash.
+ */
+BUILD_ASSERT((CONFIG_LCZ_LWM2M_FW_UPDATE_PAGE_SIZE %
+	      CONFIG_LCZ_LWM2M_FW_UPDATE_MCUBOOT_FLASH_BUF_SIZE) == 0,
+	     "Page size must be a multiple of the MCUboot buffer size");
+
+struct fw_writer {
+	/* Blocks are collected until a page can be written */
+	uint8_t page[CONFIG_LCZ_LWM2M_FW_UPDATE_PAGE_SIZE];
+	size_t length;
+	/* Image bytes received in the current pull */
+	uint32_t received;
+	/* Image bytes written to the DFU target */
+	size_t committed;
+	int64_t start;
+#ifdef CONFIG_LCZ_LWM2M_FW_UPDATE_RESUME
+	struct fota_hash hash;
+#endif
+};
+
 /******************************************************************************/
 /* Local Data Definitions                                                     */
 /******************************************************************************/
@@ -41,6 +67,7 @@ static uint8_t
 		4);
 static uint8_t firmware_data_buf[CONFIG_LWM2M_COAP_BLOCK_SIZE];
 static struct k_work_delayable work_reboot;
+static struct fw_writer fw;
 
 /******************************************************************************/
 /* Local Function Prototypes                                                  */
@@ -51,6 +78,10 @@ static void lwm2m_set_fw_update_result(int result);
 static void dfu_target_cb(enum dfu_target_evt_id evt);
 static void *lwm2m_fw_prewrite_callback(uint16_t obj_inst_id, uint16_t res_id,
 					uint16_t res_inst_id, size_t *data_len);
+static void *lwm2m_fw_uri_prewrite_callback(uint16_t obj_inst_id,
+					    uint16_t res_id,
+					    uint16_t res_inst_id,
+					    size_t *data_len);
 static int lwm2m_fw_block_received_callback(uint16_t obj_inst_id,
 					    uint16_t res_id,
 					    uint16_t res_inst_id, uint8_t *data,
@@ -58,6 +89,14 @@ static int lwm2m_fw_block_received_callback(uint16_t obj_inst_id,
 					    size_t total_size);
 static int lwm2m_fw_update_callback(uint16_t obj_inst_id, uint8_t *args,
 				    uint16_t args_len);
+static int fw_writer_start(uint8_t *data, uint16_t data_len,
+			   size_t total_size);
+static int fw_writer_commit(void);
+static void fw_writer_discard(void);
+#ifdef CONFIG_LCZ_LWM2M_FW_UPDATE_RESUME
+static uint32_t fw_image_id(size_t total_size);
+static bool fw_slot_matches_hash(void);
+#endif
 
 /******************************************************************************/
 /* Global Function Definitions                                                */
@@ -74,6 +113,11 @@ int lcz_lwm2m_fw_update_init(void)
 	lwm2m_engine_register_pre_write_callback("5/0/0",
 						 lwm2m_fw_prewrite_callback);
 	lwm2m_firmware_set_write_cb(lwm2m_fw_block_received_callback);
+	/* A pull is started by writing the package URI.  The post-write
+	 * callback of the URI belongs to the firmware object.
+	 */
+	lwm2m_engine_register_pre_write_callback(
+		"5/0/1", lwm2m_fw_uri_prewrite_callback);
 #if defined(CONFIG_LWM2M_FIRMWARE_UPDATE_PULL_SUPPORT)
 	lwm2m_firmware_set_update_cb(lwm2m_fw_update_callback);
 #endif
@@ -146,112 +190,290 @@ static int lwm2m_fw_block_received_callback(uint16_t obj_inst_id,
 					    size_t total_size)
 {
 	static uint8_t percent_downloaded;
-	static uint32_t bytes_downloaded;
 	uint8_t curent_percent;
 	uint32_t current_bytes;
-	size_t offset;
 	size_t skip = 0;
+	size_t n;
 	int ret = 0;
-	int image_type;
 
 	if (!data_len) {
 		LOG_ERR("Data len is zero, nothing to write.");
 		return -EINVAL;
 	}
 
-	if (bytes_downloaded == 0) {
-		client_acknowledge();
-
-		image_type = dfu_target_img_type(data, data_len);
-
-		ret = dfu_target_init(image_type, total_size, dfu_target_cb);
+	if (fw.received == 0) {
+		percent_downloaded = 0;
+		ret = fw_writer_start(data, data_len, total_size);
 		if (ret < 0) {
-			LOG_ERR("Failed to init DFU target, err: %d", ret);
 			lwm2m_set_fw_update_state(STATE_IDLE);
 			lwm2m_set_fw_update_result(RESULT_UPDATE_FAILED);
 			goto cleanup;
 		}
-
-		LOG_INF("Firmware download started.");
-		lwm2m_set_fw_update_state(STATE_DOWNLOADING);
-	}
-
-	ret = dfu_target_offset_get(&offset);
-	if (ret < 0) {
-		LOG_ERR("Failed to obtain current offset, err: %d", ret);
-		lwm2m_set_fw_update_state(STATE_IDLE);
-		lwm2m_set_fw_update_result(RESULT_UPDATE_FAILED);
-		goto cleanup;
 	}
 
 	/* Display a % downloaded or byte progress, if no total size was
 	 * provided (this can happen in PULL mode FOTA)
 	 */
 	if (total_size > 0) {
-		curent_percent = bytes_downloaded * 100 / total_size;
+		curent_percent = fw.received * 100 / total_size;
 		if (curent_percent > percent_downloaded) {
 			percent_downloaded = curent_percent;
 			LOG_INF("Downloaded %d%%", percent_downloaded);
 		}
 	} else {
-		current_bytes = bytes_downloaded + data_len;
+		current_bytes = fw.received + data_len;
 		if (current_bytes / BYTE_PROGRESS_STEP >
-		    bytes_downloaded / BYTE_PROGRESS_STEP) {
+		    fw.received / BYTE_PROGRESS_STEP) {
 			LOG_INF("Downloaded %d kB", current_bytes / 1024);
 		}
 	}
 
-	if (bytes_downloaded < offset) {
-		skip = MIN(data_len, offset - bytes_downloaded);
+	/* A pull always starts at the beginning of the image */
+	if (fw.received < fw.committed) {
+		skip = MIN(data_len, fw.committed - fw.received);
 
-		LOG_INF("Skipping bytes %d-%d, already written.",
-			bytes_downloaded, bytes_downloaded + skip);
+		LOG_DBG("Skipping bytes %d-%d, already written.", fw.received,
+			fw.received + skip);
 	}
 
-	bytes_downloaded += data_len;
+	fw.received += data_len;
 
-	if (skip == data_len) {
-		/* Nothing to do. */
-		return 0;
-	}
+	while (skip < data_len) {
+		n = MIN(data_len - skip, sizeof(fw.page) - fw.length);
+		memcpy(&fw.page[fw.length], data + skip, n);
+		fw.length += n;
+		skip += n;
 
-	ret = dfu_target_write(data + skip, data_len - skip);
-	if (ret < 0) {
-		LOG_ERR("dfu_target_write error, err %d", ret);
-		lwm2m_set_fw_update_state(STATE_IDLE);
-		lwm2m_set_fw_update_result(RESULT_UPDATE_FAILED);
-		goto cleanup;
+		if (fw.length == sizeof(fw.page)) {
+			ret = fw_writer_commit();
+			if (ret < 0) {
+				goto fail;
+			}
+		}
 	}
 
 	if (!last_block) {
 		/* Keep going */
 		return 0;
-	} else {
-		LOG_INF("Firmware downloaded, %d bytes in total",
-			bytes_downloaded);
 	}
 
-	if (total_size && (bytes_downloaded != total_size)) {
+	ret = fw_writer_commit();
+	if (ret < 0) {
+		goto fail;
+	}
+
+	current_bytes = (uint32_t)(k_uptime_get() - fw.start);
+	LOG_INF("Firmware downloaded, %d bytes in total, %u ms", fw.received,
+		current_bytes);
+
+	if (total_size && (fw.received != total_size)) {
 		LOG_ERR("Early last block, downloaded %d, expecting %d",
-			bytes_downloaded, total_size);
+			fw.received, total_size);
 		ret = -EIO;
-		lwm2m_set_fw_update_state(STATE_IDLE);
-		lwm2m_set_fw_update_result(RESULT_UPDATE_FAILED);
+		goto fail;
 	}
 
+	goto cleanup;
+
+fail:
+	/* Not an interruption */
+	fw.received = 0;
+	lwm2m_set_fw_update_state(STATE_IDLE);
+	lwm2m_set_fw_update_result(RESULT_UPDATE_FAILED);
+
 cleanup:
 	if (ret < 0) {
 		if (dfu_target_reset() < 0) {
 			LOG_ERR("Failed to reset DFU target");
 		}
+		fw_writer_discard();
 	}
 
-	bytes_downloaded = 0;
-	percent_downloaded = 0;
+	fw.received = 0;
+	fw.length = 0;
 
 	return ret;
 }
 
+/* Only data that has been written to the DFU target is kept when a pull is
+ * interrupted.  The next pull skips the committed bytes.  A failed pull
+ * doesn't write the state resource, so the progress of the pull is reset
+ * when the URI for the next one is written.  The URI is still written to
+ * the buffer of the firmware object.
+ */
+static void *lwm2m_fw_uri_prewrite_callback(uint16_t obj_inst_id,
+					    uint16_t res_id,
+					    uint16_t res_inst_id,
+					    size_t *data_len)
+{
+	void *uri = NULL;
+	uint16_t uri_len;
+	uint8_t flags;
+	uint8_t state = STATE_IDLE;
+
+	/* The firmware object ignores the URI while a pull is in progress */
+	(void)lwm2m_engine_get_u8("5/0/3", &state);
+	if (state == STATE_IDLE && fw.received > 0) {
+		LOG_WRN("Download interrupted at %u, %u bytes committed",
+			fw.received, fw.committed);
+		fw.received = 0;
+		fw.length = 0;
+	}
+
+	(void)lwm2m_engine_get_res_data("5/0/1", &uri, &uri_len, &flags);
+	return uri;
+}
+
+static int fw_writer_start(uint8_t *data, uint16_t data_len, size_t total_size)
+{
+	int image_type;
+	int ret;
+
+	client_acknowledge();
+
+	image_type = dfu_target_img_type(data, data_len);
+
+	ret = dfu_target_init(image_type, total_size, dfu_target_cb);
+	if (ret < 0) {
+		LOG_ERR("Failed to init DFU target, err: %d", ret);
+		return ret;
+	}
+
+	ret = dfu_target_offset_get(&fw.committed);
+	if (ret < 0) {
+		LOG_ERR("Failed to obtain current offset, err: %d", ret);
+		return ret;
+	}
+
+#ifdef CONFIG_LCZ_LWM2M_FW_UPDATE_RESUME
+	/* Progress that isn't described by the saved state of the same URI
+	 * and size, or that isn't in the slot, can't be trusted.
+	 */
+	uint32_t image_id = fw_image_id(total_size);
+	if (fota_hash_start_image(&fw.hash,
+				  CONFIG_LCZ_LWM2M_FW_UPDATE_STATE_PATH,
+				  fw.committed, image_id) < 0 ||
+	    !fw_slot_matches_hash()) {
+		LOG_WRN("Restarting download, offset %u isn't saved",
+			fw.committed);
+		ret = dfu_target_reset();
+		if (ret == 0) {
+			ret = dfu_target_init(image_type, total_size,
+					      dfu_target_cb);
+		}
+		if (ret < 0) {
+			LOG_ERR("Failed to restart DFU target, err: %d", ret);
+			return ret;
+		}
+		fw.committed = 0;
+		(void)fota_hash_start_image(
+			&fw.hash, CONFIG_LCZ_LWM2M_FW_UPDATE_STATE_PATH, 0,
+			image_id);
+	}
+#endif
+
+	fw.length = 0;
+	fw.start = k_uptime_get();
+
+	if (fw.committed > 0) {
+		LOG_INF("Firmware download resumed at %u", fw.committed);
+	} else {
+		LOG_INF("Firmware download started.");
+	}
+	lwm2m_set_fw_update_state(STATE_DOWNLOADING);
+	return 0;
+}
+
+static int fw_writer_commit(void)
+{
+	int ret;
+
+	if (fw.length == 0) {
+		return 0;
+	}
+
+	ret = dfu_target_write(fw.page, fw.length);
+	if (ret < 0) {
+		LOG_ERR("dfu_target_write error, err %d", ret);
+		return ret;
+	}
+
+	fw.committed += fw.length;
+#ifdef CONFIG_LCZ_LWM2M_FW_UPDATE_RESUME
+	fota_hash_update(&fw.hash, fw.page, fw.length);
+	(void)fota_hash_save(&fw.hash);
+#endif
+	fw.length = 0;
+	return 0;
+}
+
+static void fw_writer_discard(void)
+{
+	fw.committed = 0;
+#ifdef CONFIG_LCZ_LWM2M_FW_UPDATE_RESUME
+	fota_hash_delete(CONFIG_LCZ_LWM2M_FW_UPDATE_STATE_PATH);
+#endif
+}
+
+#ifdef CONFIG_LCZ_LWM2M_FW_UPDATE_RESUME
+/* Saved progress only belongs to a pull of the same URI and size */
+static uint32_t fw_image_id(size_t total_size)
+{
+	void *uri = NULL;
+	uint16_t uri_len = 0;
+	uint8_t flags;
+	uint32_t size = (uint32_t)total_size;
+	uint32_t crc;
+
+	(void)lwm2m_engine_get_res_data("5/0/1", &uri, &uri_len, &flags);
+	if (uri != NULL) {
+		uri_len = strnlen(uri, uri_len);
+	} else {
+		uri_len = 0;
+	}
+
+	crc = crc32_ieee(uri, uri_len);
+	return crc32_ieee_update(crc, (uint8_t *)&size, sizeof(size));
+}
+
+/* The saved hash describes the committed part of the image.  It is checked
+ * against the secondary slot before a pull resumes so that a slot that was
+ * written by something else isn't continued.  The complete image is
+ * verified by MCUboot.
+ */
+static bool fw_slot_matches_hash(void)
+{
+	uint8_t digest[FSU_HASH_SIZE];
+	const struct flash_area *fa;
+	struct flash_area_check fac = { .match = digest,
+					.clen = fw.committed,
+					.off = 0,
+					.rbuf = fw.page,
+					.rblen = sizeof(fw.page) };
+	int r;
+
+	if (fw.committed == 0) {
+		return true;
+	}
+
+	if (fota_hash_finish(&fw.hash, digest, fw.committed) < 0) {
+		return false;
+	}
+
+	r = flash_area_open(FLASH_AREA_IMAGE_SECONDARY, &fa);
+	if (r < 0) {
+		return false;
+	}
+
+	r = flash_area_check_int_sha256(fa, &fac);
+	flash_area_close(fa);
+	if (r < 0) {
+		LOG_WRN("Secondary slot doesn't match the saved state");
+	}
+	return (r == 0);
+}
+#endif
+
 static int lwm2m_fw_update_callback(uint16_t obj_inst_id, uint8_t *args,
 				    uint16_t args_len)
 {
@@ -270,6 +492,7 @@ static int lwm2m_fw_update_callback(uint16_t obj_inst_id, uint8_t *args,
 		goto done;
 	} else {
 		lwm2m_set_fw_update_state(STATE_UPDATING);
+		fw_writer_discard();
 	}
 
 	LOG_INF("Rebooting device in %d seconds", REBOOT_DELAY_SECONDS);